@@ -5,26 +5,70 @@
 #include <QEvent>
 #include <QMenuBar>
 #include <QString>
+#include <QStringList>
+
+#include <memory>
+
+#include <calibrator.h>
+#include <fitscache.h>
+#include <openglrenderthread.h>
+#include <openglresourceregistry.h>
+#include <stacker.h>
 
 class Application:
 	public QApplication {
 	Q_OBJECT
 private:
+	// Declared before root_ to outlive all windows
+	OpenGLResourceRegistry resource_registry_;
+	// Started with the first OpenGL widget, stopped after all windows are closed
+	std::unique_ptr<OpenGLRenderThread> render_thread_;
+	// Declared before root_ to outlive the entries used by windows
+	FITSCache fits_cache_;
+	// Set when calibration frames are given, files are opened calibrated then
+	std::unique_ptr<Calibrator> calibrator_;
 	QObject root_;
+	QString trace_filename_;
+	QString startup_profile_format_;
+	bool first_frame_swapped_;
 public:
 	Application(int &argc, char **argv);
 	virtual ~Application() override;
 
+	// Opens the file calibrated when there is calibrator
 	void addInstance(const QString& filename);
+	// Plays the files back as frames of a single sequence
+	void addSequenceInstance(const QStringList& filenames, double frame_rate);
+	// Shows in-memory image, e.g. a processing result
+	void addImageInstance(std::shared_ptr<const FITS> fits, const QString& title);
+	// Shows the frames written to the file or directory as they come
+	void addWatchInstance(const QString& path);
+	// Shows the latest frames of the shared-memory ring, e.g. of a camera
+	void addRingInstance(const QString& name);
+	/* Plays back the image HDUs of the indexed directory tree satisfying the
+	 * conditions, a sequence per shape and BITPIX */
+	void addQueryInstances(const QString& directory, const QStringList& conditions, double frame_rate);
+	// Shows the stack of the first image HDUs of the files
+	void addStackInstance(const QStringList& filenames, const Stacker::Options& options);
 	inline static Application* instance() {
 		return static_cast<Application*>(QCoreApplication::instance());
 	}
+	inline OpenGLResourceRegistry& resourceRegistry() { return resource_registry_; }
+	inline FITSCache& fitsCache() { return fits_cache_; }
+	inline Calibrator* calibrator() { return calibrator_.get(); }
+	OpenGLRenderThread& renderThread();
+	// Called by OpenGL widgets on their first frame, finishes startup profile
+	void notifyFirstFrameSwapped();
+
+	// FITS files of the directory of the file, sorted by name
+	static QStringList directoryFiles(const QString& filename);
 
 #ifdef Q_OS_MAC
 	virtual bool event(QEvent* event) override;
 #endif
 public slots:
 	static void openFile();
+	static void stackFiles();
 };
 
 #endif // _APPLICATION_H_
@@ -0,0 +1,115 @@
+#ifndef _BATCHRENDERER_H
+#define _BATCHRENDERER_H
+
+#include <QImage>
+#include <QOffscreenSurface>
+#include <QOpenGLFramebufferObject>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+#include <QThread>
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <exception.h>
+#include <fits.h>
+#include <openglresourceregistry.h>
+#include <openglshaderunifroms.h>
+
+/* Renders image HDUs of FITS files into image files without any window.
+ *
+ * Every job is a thread with its own offscreen context and resource
+ * registry, so the jobs do not share shader programs and their uniforms.
+ * Files are taken from the common list until it is exhausted. Requires
+ * Qt::AA_ShareOpenGLContexts to be set before the application is created,
+ * unless the files are rendered in software with CPURenderer.
+ */
+class BatchRenderer {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	class NoImageInFITS: public Exception {
+	public:
+		NoImageInFITS();
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	struct Options {
+		int hdu_index;  // -1 for the first HDU having image
+		bool has_levels;
+		std::pair<double, double> levels;
+		int colormap_index;
+		OpenGLShaderUniforms::Stretch stretch;
+		double stretch_parameter;
+		QSize size;  // Empty dimension is derived from the image aspect ratio
+		QString output_directory;
+		QString format;
+		int jobs;
+		bool software;  // Render with CPURenderer, no OpenGL is used
+
+		Options();
+	};
+
+	struct Result {
+		quint64 rendered;
+		quint64 failed;
+		double seconds;
+
+		inline double fps() const { return seconds > 0 ? rendered / seconds : 0.0; }
+	};
+private:
+	// GL resources of a job, kept alive between the files
+	struct JobResources {
+		OpenGLResourceRegistry registry;
+		OpenGLResourceRegistry::colormaps_type colormaps;
+		std::map<QString, std::shared_ptr<OpenGLShaderProgram>> programs;
+		std::unique_ptr<QOpenGLFramebufferObject> fbo;
+	};
+
+	class Job: public QThread {
+	private:
+		BatchRenderer* batch_renderer_;
+		QOffscreenSurface* surface_;
+
+		void renderFiles(JobResources* resources);
+	public:
+		// Surface is null for software rendering
+		Job(BatchRenderer* batch_renderer, QOffscreenSurface* surface);
+	protected:
+		virtual void run() override;
+	};
+
+	Options options_;
+	QStringList filenames_;
+	std::atomic<int> next_file_;
+	std::atomic<quint64> rendered_;
+	std::atomic<quint64> failed_;
+
+	// Resources are null for software rendering
+	void renderFile(const QString& filename, JobResources* resources);
+	QImage renderImage(const FITS::HeaderDataUnit& hdu, const QSize& size, JobResources& resources) const;
+	QImage renderSoftware(const FITS::HeaderDataUnit& hdu, const QSize& size) const;
+public:
+	explicit BatchRenderer(const Options& options);
+
+	static const FITS::HeaderDataUnit& selectHDU(const FITS& fits, int hdu_index);
+	QString outputFilename(const QString& filename) const;
+	static QSize outputSize(const QSize& requested_size, const QSize& image_size);
+
+	/* Must be called from the GUI thread, blocks until all the files are
+	 * done. Nothing is rendered when two files have the same output name. */
+	Result run(const QStringList& filenames);
+};
+
+#endif //_BATCHRENDERER_H
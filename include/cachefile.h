@@ -0,0 +1,36 @@
+#ifndef _CACHEFILE_H_
+#define _CACHEFILE_H_
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QString>
+
+/* Writes the cache file at path by fun(QDataStream&), creating its
+ * directory. QSaveFile guarantees that concurrent instances never see
+ * partial entries: the file is written aside and renamed over path once
+ * complete. Returns false on failure and puts the reason into error, if
+ * given.
+ */
+template<class F> bool writeCacheFile(const QString& path, F fun, QString* error = Q_NULLPTR) {
+	const auto directory = QFileInfo(path).path();
+	if (!QDir().mkpath(directory)) {
+		if (error)
+			*error = directory + ": cannot create the directory";
+		return false;
+	}
+
+	QSaveFile file(path);
+	if (file.open(QIODevice::WriteOnly)) {
+		QDataStream stream(&file);
+		fun(stream);
+		if (stream.status() == QDataStream::Ok && file.commit())
+			return true;
+	}
+	if (error)
+		*error = path + ": " + file.errorString();
+	return false;
+}
+
+#endif // _CACHEFILE_H_
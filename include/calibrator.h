@@ -0,0 +1,108 @@
+#ifndef _CALIBRATOR_H
+#define _CALIBRATOR_H
+
+#include <QSize>
+#include <QString>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <exception.h>
+#include <fits.h>
+
+/* CCD calibration of raw frames by master bias, dark and flat frames.
+ *
+ * Calibrated value is (raw - bias - t * dark) / flat, where t is the
+ * exposure of the raw frame, dark is the dark current per second, i.e. the
+ * master dark having the bias removed, divided by its exposure, and flat is
+ * the master flat having the bias removed, normalized by its mean. Every
+ * master is optional. Masters are converted once, raw frames are calibrated
+ * in parallel bands of rows into BITPIX=-32 images.
+ *
+ * Calibrated files are cached by path, size and modification time, so a
+ * file opened again is not calibrated again unless it has been rewritten.
+ * Calibrated windows show the given files only and do not browse their
+ * directories; display levels, colormap and stretch are applied to the
+ * calibrated texture.
+ */
+class Calibrator {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	class ShapeMismatch: public Exception {
+	public:
+		explicit ShapeMismatch(const QString& filename = QString());
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	// Filenames of the master frames, empty when not used
+	struct Masters {
+		QString bias;
+		QString dark;
+		QString flat;
+
+		inline bool isEmpty() const { return bias.isEmpty() && dark.isEmpty() && flat.isEmpty(); }
+	};
+
+	static const qint64 default_budget = Q_INT64_C(256) << 20;
+	// Bytes of a single band of rows
+	static const int band_budget = 1 << 20;
+private:
+	Masters masters_;
+	QSize size_;
+	// Empty when the master is not used
+	std::vector<float> bias_;
+	std::vector<float> dark_current_;
+	// Reciprocal of the normalized flat, NaN for non-positive flat values
+	std::vector<float> flat_;
+
+	// Not thread-safe, used by GUI thread only, keyed as FITSCache
+	typedef std::pair<QString, std::shared_ptr<const FITS>> cache_entry_type;
+	qint64 budget_;
+	qint64 usage_;
+	std::list<cache_entry_type> entries_;  // Most recently used first
+	std::map<QString, std::list<cache_entry_type>::iterator> index_;
+	quint64 hits_;
+	quint64 misses_;
+
+	// Returns the physical values of the master, checks the shape
+	std::vector<float> load(const QString& filename, double* exposure);
+	void evict();
+public:
+	/* Throws Sequence::Exception when a master can not be opened,
+	 * ShapeMismatch when the masters differ by shape, and Exception when
+	 * the exposure of the dark is unknown. */
+	explicit Calibrator(const Masters& masters);
+
+	inline const Masters& masters() const { return masters_; }
+	inline QSize size() const { return size_; }
+
+	// Physical values row by row starting from the first FITS row
+	std::vector<float> calibrate(const FITS::HeaderDataUnit& raw) const;
+	// Calibrated image as in-memory FITS
+	std::unique_ptr<FITS> calibrateToFITS(const FITS::HeaderDataUnit& raw) const;
+	// Returns the cached calibrated first image HDU of the file
+	std::shared_ptr<const FITS> calibrated(const QString& filename);
+
+	void setBudget(qint64 budget);
+	inline qint64 budget() const { return budget_; }
+	inline qint64 usage() const { return usage_; }
+	inline quint64 hits() const { return hits_; }
+	inline quint64 misses() const { return misses_; }
+
+	// EXPTIME or EXPOSURE in seconds, NaN when neither is present
+	static double exposure(const FITS::HeaderUnit& header);
+};
+
+#endif //_CALIBRATOR_H
@@ -0,0 +1,49 @@
+#ifndef _CHECKSUM_H
+#define _CHECKSUM_H
+
+#include <QtGlobal>
+
+#include <fits.h>
+
+/* Verification of the CHECKSUM and DATASUM keywords of an HDU.
+ *
+ * Both are 32-bit ones' complement sums of the big-endian words as stored:
+ * DATASUM of the data, and CHECKSUM is chosen so that the sum of the whole
+ * HDU, header and data, is -0. The words are summed with SSE2 when it is
+ * available, bands of large data units in parallel.
+ */
+class Checksum {
+public:
+	enum Status {
+		Missing,
+		Valid,
+		Invalid
+	};
+private:
+	Status checksum_;
+	Status datasum_;
+	quint32 data_sum_;
+	quint32 hdu_sum_;
+public:
+	explicit Checksum(const FITS::HeaderDataUnit& hdu);
+
+	inline Status checksum() const { return checksum_; }
+	inline Status datasum()  const { return datasum_; }
+	inline quint32 dataSum() const { return data_sum_; }
+	inline quint32 hduSum()  const { return hdu_sum_; }
+
+	// Neither of the keywords is wrong, both may be missing
+	inline bool isValid() const { return checksum_ != Invalid && datasum_ != Invalid; }
+	inline bool isMissing() const { return checksum_ == Missing && datasum_ == Missing; }
+
+	/* Ones' complement sum of length bytes added to sum, the last word is
+	 * padded with zeros. The sum does not depend on the order of the words,
+	 * so the bands summed in parallel are combined exactly. */
+	static quint32 sum(const quint8* data, quint64 length, quint32 sum = 0);
+	// Ones' complement addition, the end-around carry is added back
+	static quint32 add(quint32 x, quint32 y);
+
+	static const char* statusText(Status status);
+};
+
+#endif //_CHECKSUM_H
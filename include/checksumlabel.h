@@ -0,0 +1,41 @@
+#ifndef _CHECKSUMLABEL_H
+#define _CHECKSUMLABEL_H
+
+#include <QLabel>
+#include <QMutex>
+#include <QWidget>
+
+#include <memory>
+
+#include <checksum.h>
+#include <fits.h>
+
+/* Status of CHECKSUM and DATASUM of the shown HDU. The HDU is summed on
+ * QThreadPool::globalInstance(), so the image is shown without waiting for
+ * its data to be read. HDUs without the keywords hide the label. */
+class ChecksumLabel: public QLabel {
+	Q_OBJECT
+private:
+	// Shared with the jobs, which may outlive the label
+	struct Shared {
+		QMutex mutex;
+		ChecksumLabel* label;
+	};
+
+	class Job;
+
+	std::shared_ptr<Shared> shared_;
+	// Results of the previously shown HDUs are dropped
+	int generation_;
+public:
+	explicit ChecksumLabel(QWidget* parent);
+	virtual ~ChecksumLabel() override;
+
+	// Empty HDU hides the label
+	void verify(std::shared_ptr<const FITS::HeaderDataUnit> hdu);
+
+private slots:
+	void showResult(int generation, int checksum, int datasum);
+};
+
+#endif //_CHECKSUMLABEL_H
@@ -0,0 +1,59 @@
+#ifndef _CPURENDERER_H
+#define _CPURENDERER_H
+
+#include <QImage>
+#include <QRectF>
+#include <QSize>
+
+#include <vector>
+
+#include <fits.h>
+#include <histogram.h>
+#include <openglcolormap.h>
+#include <openglshaderunifroms.h>
+
+/* Software implementation of the image fragment shader.
+ *
+ * Values are computed exactly as the shader does: texels are normalized
+ * into [0, 1] channels, the most significant channel is sign corrected, and
+ * the level transform dot(c, raw - z) uses the uniforms of
+ * OpenGLShaderUniforms in single precision followed by the stretch. Then
+ * the colormap is sampled with linear interpolation. The texture is sampled
+ * at the nearest texel, and pixels outside of the image are transparent
+ * black. The result only
+ * differs from the GPU one by the precision of the GPU arithmetic, so it
+ * can serve as a reference in tests.
+ *
+ * Rows are rendered in parallel bands. The per-BITPIX kernels use SSE2 when
+ * it is available.
+ */
+class CPURenderer {
+private:
+	const FITS::HeaderDataUnit* hdu_;
+	quint8 channels_;
+	quint8 channel_size_;
+	std::pair<double, double> minmax_;
+	OpenGLShaderUniforms uniforms_;
+	std::vector<quint8> colormap_;  // RGBA
+	Histogram histogram_;  // Scanned when the equalization is set for the first time
+
+	static quint8 channels(const QString& bitpix);
+	static quint8 channelSize(const QString& bitpix);
+public:
+	// Throws FITS::UnsupportedBitpix for the data the shader can not render
+	explicit CPURenderer(const FITS::HeaderDataUnit& hdu);
+
+	// Data range of the HDU, physical values
+	inline const std::pair<double, double>& hduMinMax() const { return minmax_; }
+	inline const OpenGLShaderUniforms& uniforms() const { return uniforms_; }
+
+	// Levels are the data range by default
+	void setLevels(const std::pair<double, double>& levels);
+	void setColorMap(const OpenGLColorMap& colormap);
+	void setStretch(OpenGLShaderUniforms::Stretch stretch, double parameter);
+
+	// Viewrect is in the same units as OpenGLWidget one
+	QImage render(const QSize& size, const QRectF& viewrect = QRectF(0, 0, 1, 1)) const;
+};
+
+#endif //_CPURENDERER_H
@@ -0,0 +1,69 @@
+#ifndef _CUBECOLLAPSER_H
+#define _CUBECOLLAPSER_H
+
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+#include <exception.h>
+#include <fits.h>
+
+/* Collapses a range of planes of NAXIS=3 cube into an image.
+ *
+ * The cube is streamed plane by plane in parallel bands of rows straight
+ * from the mapping, so only a band of every plane of the range is touched
+ * at once and nothing of the size of the cube is allocated. Values are
+ * physical ones, NaN values are ignored, pixels having no values left are
+ * NaN.
+ */
+class CubeCollapser {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	enum Operation {
+		SumOperation,
+		MeanOperation,
+		MaxOperation,
+		Moment0Operation,  // Sum multiplied by the channel width |CDELT3|
+		OperationCount
+	};
+
+	struct Options {
+		Operation operation;
+		// Inclusive range of zero-based planes, last is clamped to the depth
+		quint64 first;
+		quint64 last;
+
+		Options();
+	};
+
+	// Bytes of a single band of rows of a plane
+	static const int band_budget = 1 << 20;
+private:
+	const FITS::HeaderDataUnit& hdu_;
+public:
+	// Throws Exception when there is no image
+	explicit CubeCollapser(const FITS::HeaderDataUnit& hdu);
+
+	inline quint64 depth() const { return hdu_.data().imageDataUnit()->depth(); }
+
+	// Physical values row by row starting from the first FITS row
+	std::vector<float> collapse(const Options& options) const;
+	// Collapsed image as in-memory FITS
+	std::unique_ptr<FITS> collapseToFITS(const Options& options) const;
+
+	static const char* operationName(Operation operation);
+	// Returns OperationCount for unknown name
+	static Operation operationFromName(const QString& name);
+	// |CDELT3|, 1 when it is not present
+	static double channelWidth(const FITS::HeaderUnit& header);
+};
+
+#endif //_CUBECOLLAPSER_H
@@ -3,6 +3,7 @@
 
 #include <QFileDevice>
 #include <QSize>
+#include <QStringList>
 #include <QVariant>
 
 #include <abstractfitsstorage.h>
@@ -10,6 +11,7 @@
 
 #include <map>
 #include <memory>
+#include <vector>
 
 class FITS {
 public:
@@ -48,8 +50,19 @@ public:
 	class HeaderUnit {
 	private:
 		std::map<QString, QString> headers_;
+		// Cards in the storage, none when the header is made of the map
+		const char* cards_;
+		quint64 card_count_;
 	public:
 		HeaderUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end);
+		/* The cards, if any, are of the header the map has been made of,
+		 * e.g. of the table of tile-compressed image */
+		explicit HeaderUnit(std::map<QString, QString> headers, const char* cards = nullptr, quint64 card_count = 0);
+
+		inline const std::map<QString, QString>& headers() const { return headers_; }
+		// 80-byte cards as they are stored, without END
+		inline const char* cards() const { return cards_; }
+		inline quint64 cardCount() const { return card_count_; }
 
 		inline const QString& header(const QString& key) const {
 			return headers_.at(key);
@@ -72,21 +85,37 @@ public:
 
 		inline double bscale() const { return header_as<double>("BSCALE", 1.0); }
 		inline double bzero()  const { return header_as<double>("BZERO", 0.0); }
+
+		// String value without the quotes and the trailing spaces
+		static QString unquoted(const QString& value);
 	};
 
 	class AbstractDataUnit;
 	class ImageDataUnit;
 	class EmptyDataUnit;
+	class TableDataUnit;
 	template<class T> class DataUnit;
 
+	/* Data which is not mapped from the storage but decoded on the first
+	 * access, e.g. from compressed tiles */
+	class DeferredData {
+	public:
+		virtual ~DeferredData() = 0;
+
+		// Decodes the data at the first call, thread-safe
+		virtual const quint8* data() const = 0;
+	};
+
 	class AbstractDataUnit {
 	private:
 		const quint8* data_;
 		quint64 length_;
+		std::unique_ptr<const DeferredData> deferred_;
 	protected:
 		struct VisitorBase {
 			virtual ~VisitorBase() = 0;
 			virtual void visit(const EmptyDataUnit&) = 0;
+			virtual void visit(const TableDataUnit&) = 0;
 			virtual void visit(const DataUnit<quint8>&) = 0;
 			virtual void visit(const DataUnit<qint16>&) = 0;
 			virtual void visit(const DataUnit<qint32>&) = 0;
@@ -96,11 +125,17 @@ public:
 		};
 
 		virtual void do_apply(VisitorBase* visitor) const = 0;
+
+		// View of length bytes of data owned by another data unit
+		AbstractDataUnit(const quint8* data, quint64 length);
+		AbstractDataUnit(std::unique_ptr<const DeferredData> data, quint64 length);
 	public:
 		AbstractDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 length);
+		// Takes extent bytes of the storage, length of them are the data
+		AbstractDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 length, quint64 extent);
 		virtual ~AbstractDataUnit() = 0;
 
-		inline const quint8* data() const { return data_; }
+		inline const quint8* data() const { return deferred_ ? deferred_->data() : data_; }
 		inline quint64 length() const { return length_; }
 
 		template<class F> void apply(F fun) const {
@@ -110,6 +145,7 @@ public:
 				inline Visitor(F* fun): VisitorBase(), fun_(fun) {}
 
 				virtual void visit(const EmptyDataUnit& x) override { (*fun_)(x); };
+				virtual void visit(const TableDataUnit& x) override { (*fun_)(x); };
 				virtual void visit(const DataUnit<quint8>& x) override { (*fun_)(x); };
 				virtual void visit(const DataUnit<qint16>& x) override { (*fun_)(x); };
 				virtual void visit(const DataUnit<qint32>& x) override { (*fun_)(x); };
@@ -123,23 +159,41 @@ public:
 		}
 
 		template<class F> static void bitpixToType(const QString& bitpix, F fun);
-		static AbstractDataUnit* createFromBitpix(const QString& bitpix, AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 height, quint64 width);
+		static AbstractDataUnit* createFromBitpix(const QString& bitpix, AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 height, quint64 width, quint64 depth = 1);
+		static AbstractDataUnit* createFromBitpix(const QString& bitpix, std::unique_ptr<const DeferredData> data, quint64 height, quint64 width, quint64 depth = 1);
 
 		inline       ImageDataUnit* imageDataUnit()       { return dynamic_cast<ImageDataUnit*>(this); }
 		inline const ImageDataUnit* imageDataUnit() const { return dynamic_cast<const ImageDataUnit*>(this); }
 	};
 
+	/* Image or NAXIS=3 cube of depth planes. data() and length() of a cube
+	 * refer to its first plane, so it is shown and scanned as the image of
+	 * the first plane, the other planes are accessed through plane() views
+	 * sharing the same mapping. */
 	class ImageDataUnit: public AbstractDataUnit {
 	private:
 		quint64 height_;
 		quint64 width_;
+		quint64 depth_;
+	protected:
+		ImageDataUnit(const quint8* data, quint32 element_size, quint64 height, quint64 width);
+		ImageDataUnit(std::unique_ptr<const DeferredData> data, quint32 element_size, quint64 height, quint64 width, quint64 depth);
 	public:
-		ImageDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint32 element_size, quint64 height, quint64 width);
+		ImageDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint32 element_size, quint64 height, quint64 width, quint64 depth = 1);
 		virtual ~ImageDataUnit() = 0;
 
 		inline quint64 height() const { return height_; }
 		inline quint64 width()  const { return width_; }
+		inline quint64 depth()  const { return depth_; }
 		inline QSize size() const { return QSize(width_, height_); }
+
+		// Data of the plane, the plane has length() bytes
+		inline const quint8* planeData(quint64 index) const {
+			Q_ASSERT(index < depth_);
+			return data() + index * length();
+		}
+		// Image of the single plane, valid while this data unit is alive
+		virtual ImageDataUnit* plane(quint64 index) const = 0;
 	};
 
 	class EmptyDataUnit: public AbstractDataUnit {
@@ -152,32 +206,133 @@ public:
 		virtual ~EmptyDataUnit();
 	};
 
+	/* Binary table extension, XTENSION = 'BINTABLE'. The rows stay in the
+	 * storage: view() gives the field of a column in every row, decode()
+	 * converts the fields of a range of rows into native values, text()
+	 * formats a single cell. */
+	class TableDataUnit: public AbstractDataUnit {
+	public:
+		struct Column {
+			QString name;    // TTYPEn
+			QString unit;    // TUNITn
+			QString format;  // TFORMn
+			char type;       // Data type of TFORMn
+			char element;    // Element type of P and Q arrays
+			quint64 repeat;
+			quint64 offset;  // Bytes from the beginning of the row
+			quint64 width;   // Bytes of the field
+			std::vector<quint64> dimensions;  // TDIMn, or the repeat
+			double scale;    // TSCALn
+			double zero;     // TZEROn
+			bool has_null;
+			qint64 null;     // TNULLn of integer columns
+		};
+
+		// Fields of a column, stride bytes apart
+		struct ColumnView {
+			const quint8* data;
+			quint64 stride;
+			quint64 rows;
+			quint64 width;
+
+			inline const quint8* field(quint64 row) const { return data + row * stride; }
+		};
+	private:
+		quint64 rows_;
+		quint64 row_length_;
+		const quint8* heap_;
+		quint64 heap_size_;
+		std::vector<Column> columns_;
+
+		void decodeValues(std::size_t index, quint64 first, quint64 count, quint8* dst, int size) const;
+	protected:
+		virtual void do_apply(VisitorBase* visitor) const override {
+			visitor->visit(*this);
+		}
+	public:
+		TableDataUnit(const HeaderUnit& header, AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end);
+		virtual ~TableDataUnit();
+
+		inline quint64 rows() const { return rows_; }
+		inline quint64 rowLength() const { return row_length_; }
+		inline const std::vector<Column>& columns() const { return columns_; }
+
+		ColumnView view(std::size_t index) const;
+		/* Variable-length array of P or Q column, Q_NULLPTR when the
+		 * descriptor points out of the heap. count is set to the number
+		 * of the elements. */
+		const quint8* array(std::size_t index, quint64 row, quint64* count) const;
+		/* Stores the values of count rows starting at first into dst,
+		 * repeat values per row, two per element for complex numbers and
+		 * descriptors. T has to be the native type of the column. */
+		template<class T> void decode(std::size_t index, quint64 first, quint64 count, T* dst) const;
+		// Physical value of the cell, arrays longer than max_elements are cut
+		QString text(std::size_t index, quint64 row, int max_elements = 16) const;
+
+		// Bytes of the element of the data type, X is counted in bytes of 8 bits
+		static int elementSize(char type);
+		// Unsigned integer stored big-endian in bytes bytes, as the fields are
+		static quint64 readBigEndian(const quint8* data, int bytes);
+
+		static inline bool isNativeType(char type, const quint8*) { return type == 'L' || type == 'X' || type == 'B' || type == 'A'; }
+		static inline bool isNativeType(char type, const qint16*) { return type == 'I'; }
+		static inline bool isNativeType(char type, const qint32*) { return type == 'J' || type == 'P'; }
+		static inline bool isNativeType(char type, const qint64*) { return type == 'K' || type == 'Q'; }
+		static inline bool isNativeType(char type, const float*)  { return type == 'E' || type == 'C'; }
+		static inline bool isNativeType(char type, const double*) { return type == 'D' || type == 'M'; }
+	};
+
 	template<class T> class DataUnit: public ImageDataUnit {
 	protected:
 		virtual void do_apply(VisitorBase* visitor) const override {
 			visitor->visit(*this);
 		}
 	public:
-		inline DataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 height, quint64 width):
-			ImageDataUnit(begin, end, sizeof(T), height, width) {}
+		inline DataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 height, quint64 width, quint64 depth = 1):
+			ImageDataUnit(begin, end, sizeof(T), height, width, depth) {}
+		inline DataUnit(const quint8* data, quint64 height, quint64 width):
+			ImageDataUnit(data, sizeof(T), height, width) {}
+		inline DataUnit(std::unique_ptr<const DeferredData> data, quint64 height, quint64 width, quint64 depth = 1):
+			ImageDataUnit(std::move(data), sizeof(T), height, width, depth) {}
 		inline const T* data() const {
 			return reinterpret_cast<const T*>(AbstractDataUnit::data());
 		}
 		inline quint64 length() const { return AbstractDataUnit::length() / sizeof(T); }
+
+		virtual ImageDataUnit* plane(quint64 index) const override {
+			return new DataUnit<T>(planeData(index), height(), width());
+		}
 	};
 
 	class HeaderDataUnit {
 	private:
+		// Beginning of the HDU in the storage
+		const quint8* raw_;
 		std::unique_ptr<HeaderUnit>       header_;
 		std::unique_ptr<AbstractDataUnit> data_;
+		quint64 header_extent_;
+		quint64 data_extent_;
+
+		void parseData(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end);
 	public:
 		HeaderDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end);
+		// Plane of the cube having the same header, valid while the cube is alive
+		HeaderDataUnit(const HeaderDataUnit& cube, quint64 plane);
 
 		HeaderDataUnit(HeaderDataUnit&&) = default;
 		HeaderDataUnit& operator=(HeaderDataUnit&&) = default;
 
 		inline const HeaderUnit&       header() const { return *header_; }
 		inline const AbstractDataUnit& data()   const { return *data_; }
+
+		/* Bytes of the header and of the data as they are stored, padded to
+		 * 2880 bytes unless the file ends earlier. The data of tile-compressed
+		 * image is its table with the heap, the plane of a cube refers to the
+		 * whole cube. */
+		inline const quint8* rawHeader()   const { return raw_; }
+		inline quint64       headerExtent() const { return header_extent_; }
+		inline const quint8* rawData()     const { return raw_ + header_extent_; }
+		inline quint64       dataExtent()   const { return data_extent_; }
 	};
 private:
 	std::unique_ptr<AbstractFITSStorage> fits_storage_;
@@ -185,12 +340,15 @@ private:
 
 	std::list<HeaderDataUnit> extensions_;
 
-	FITS(AbstractFITSStorage* fits_storage, AbstractFITSStorage::Page begin, const AbstractFITSStorage::Page& end);
+	FITS(AbstractFITSStorage* fits_storage, AbstractFITSStorage::Page begin, const AbstractFITSStorage::Page& end, bool extensions);
 public:
 	typedef std::list<HeaderDataUnit>::const_iterator const_iterator;
 
 	FITS(AbstractFITSStorage* fits_storage);
 	FITS(QFileDevice* file_device);
+	/* The HDU starting at offset bytes, e.g. known from KeywordIndex, as the
+	 * primary one. Neither the preceding HDUs nor the following are parsed. */
+	FITS(AbstractFITSStorage* fits_storage, quint64 offset);
 
 	inline const HeaderDataUnit&   primary_hdu() const { return primary_hdu_; }
 	inline const HeaderUnit&       header_unit() const { return primary_hdu_.header(); }
@@ -198,8 +356,19 @@ public:
 
 	const_iterator begin() const { return extensions_.begin(); }
 	const_iterator end()   const { return extensions_.end(); }
+
+	// Patterns of FITS file names, the viewer and the tools find files by them
+	static QStringList nameFilters();
 };
 
+template<class T> void FITS::TableDataUnit::decode(std::size_t index, quint64 first, quint64 count, T* dst) const {
+	const auto& column = columns_.at(index);
+	if (!isNativeType(column.type, static_cast<const T*>(0)))
+		throw FITS::WrongHeaderValue("TFORM" + QString::number(static_cast<int>(index) + 1), column.format);
+
+	decodeValues(index, first, count, reinterpret_cast<quint8*>(dst), sizeof(T));
+}
+
 template<class F> void FITS::AbstractDataUnit::bitpixToType(const QString& bitpix, F fun) {
 	if (bitpix == "8") {
 		fun(static_cast<quint8*>(0));
@@ -0,0 +1,94 @@
+#ifndef _FITSCACHE_H
+#define _FITSCACHE_H
+
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+#include <list>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <opengltexture.h>
+#include <sequence.h>
+
+/* LRU cache of opened FITS files and statistics of their first image HDU.
+ *
+ * Files stay mapped while they are in the cache, so moving back and forth
+ * between neighbouring files costs neither the header parsing nor, for the
+ * prefetched files, the data scans. The budget limits the total size of
+ * the cached files. Entries which are in use are never evicted, so the
+ * usage may exceed the budget when they alone do. Files are opened by
+ * open() in the calling thread, or by prefetch() in
+ * QThreadPool::globalInstance().
+ *
+ * Entries are keyed on the path, size and modification time of the file,
+ * so a file rewritten in place is opened again. The stale entry is evicted
+ * as the least recently used one.
+ */
+class FITSCache {
+public:
+	struct Entry {
+		QString filename;
+		QString key;
+		Sequence::OpenedFrame frame;
+		// Scanned by prefetch() only, so open() never waits for the scans
+		std::shared_ptr<const OpenGLTexture::Statistics> statistics;
+		qint64 size;  // Bytes of the mapped file
+	};
+
+	static const qint64 default_budget = Q_INT64_C(512) << 20;
+private:
+	// Shared with the prefetch jobs, which may outlive the cache
+	struct State {
+		QMutex mutex;
+		bool cancelled;
+		qint64 budget;
+		qint64 usage;
+		std::list<std::shared_ptr<Entry>> entries;  // Most recently used first
+		std::map<QString, std::list<std::shared_ptr<Entry>>::iterator> index;  // By key
+		std::set<QString> pending;  // Keys
+		quint64 hits;
+		quint64 misses;
+
+		// Requires the mutex to be locked
+		std::shared_ptr<Entry> find(const QString& key);
+		std::shared_ptr<Entry> insert(std::shared_ptr<Entry> entry);
+		void evict();
+	};
+
+	class Job;
+
+	std::shared_ptr<State> state_;
+public:
+	explicit FITSCache(qint64 budget = default_budget);
+	~FITSCache();
+
+	/* Returns the cached file or opens it. Throws Sequence::Exception when
+	 * the file can not be opened or has no image. */
+	std::shared_ptr<const Entry> open(const QString& filename);
+	/* Opens the files in background, the most wanted first. Files which do
+	 * not fit the budget left by the entries in use are skipped. */
+	void prefetch(const QStringList& filenames);
+
+	void setBudget(qint64 budget);
+	qint64 budget() const;
+	qint64 usage() const;
+	int size() const;
+	bool contains(const QString& filename) const;
+	quint64 hits() const;
+	quint64 misses() const;
+
+	// Opens the file and optionally scans its first image HDU
+	static std::shared_ptr<Entry> load(const QString& filename, bool scan);
+	// Path of the file with its current size and modification time
+	static QString key(const QString& filename);
+
+	/* Indices of count files to prefetch after moving to index in the
+	 * direction, which is 1 or -1: depth files ahead, then one behind. */
+	static std::vector<int> prefetchOrder(int index, int direction, int count, int depth);
+};
+
+#endif //_FITSCACHE_H
@@ -0,0 +1,44 @@
+#ifndef _FITSUNITSCANNER_H_
+#define _FITSUNITSCANNER_H_
+
+#include <QString>
+
+#include <map>
+#include <vector>
+
+/* Finds the HDUs of FITS data as its blocks arrive, the same way FITS
+ * parses them, so the headers are parsed before the data is at hand. Only
+ * the header blocks are read, the data units in between may be missed. */
+class FITSUnitScanner {
+public:
+	struct Unit {
+		quint64 begin;  // Offset of the header
+		quint64 data;
+		quint64 end;  // End of the padded data
+		bool image;  // NAXIS is 2 or 3
+	};
+private:
+	std::vector<Unit>* units_;
+	Unit unit_;
+	quint64 next_;  // Offset of the next header block
+	bool done_;
+
+	void finishHeader(const std::map<QString, QString>& cards);
+public:
+	explicit FITSUnitScanner(std::vector<Unit>* units);
+
+	// Length of the data unit described by the cards of the header, without the padding
+	static quint64 dataLength(const std::map<QString, QString>& cards);
+	// The 2880-byte header block holds END card
+	static bool hasEnd(const quint8* block);
+
+	// The bytes from next() up to size of the data are available
+	void advance(const quint8* data, quint64 size);
+
+	// Offset of the header block to be scanned next
+	inline quint64 next() const { return next_; }
+	// There are no extensions after the last found unit
+	inline bool isDone() const { return done_; }
+};
+
+#endif // _FITSUNITSCANNER_H_
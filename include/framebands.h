@@ -0,0 +1,54 @@
+#ifndef _FRAMEBANDS_H_
+#define _FRAMEBANDS_H_
+
+#include <QtGlobal>
+
+#include <utility>
+#include <vector>
+
+#include <fits.h>
+
+/* Row bands of the successive frames of a single image, e.g. a file
+ * rewritten by the acquisition software. Every band keeps the fingerprint
+ * of its bytes and the min/max of its values, so a new frame is compared,
+ * scanned and uploaded band by band, and the unchanged bands are skipped.
+ */
+class FrameBands {
+public:
+	// Consecutive rows of the image
+	struct Band {
+		quint64 first_row;
+		quint64 rows;
+	};
+
+	static const quint64 default_band_rows = 32;
+private:
+	quint64 band_rows_;
+	// Shape of the last frame, the bands are reset when it changes
+	quint64 width_;
+	quint64 height_;
+	int bitpix_;
+	double bscale_;
+	double bzero_;
+	std::vector<quint64> fingerprints_;
+	// Raw values, (+inf, -inf) for a band of NaN only
+	std::vector<std::pair<double, double>> minmax_;
+public:
+	explicit FrameBands(quint64 band_rows = default_band_rows);
+
+	inline quint64 bandRows() const { return band_rows_; }
+	inline std::size_t size() const { return fingerprints_.size(); }
+
+	/* Compares the first plane of the image HDU to the previous frame and
+	 * rescans the changed bands. Returns the changed rows, adjacent bands
+	 * are merged. All the rows are changed for the first frame and for a
+	 * frame of another shape or BITPIX. */
+	std::vector<Band> update(const FITS::HeaderDataUnit& hdu);
+	// Physical min/max of the last frame, NaN are skipped
+	std::pair<double, double> minmax() const;
+
+	// Fingerprint of the bytes, not a cryptographic hash
+	static quint64 fingerprint(const quint8* data, quint64 size);
+};
+
+#endif // _FRAMEBANDS_H_
@@ -0,0 +1,119 @@
+#ifndef _FRAMEPROFILER_H
+#define _FRAMEPROFILER_H
+
+#include <QOpenGLContext>
+#include <QString>
+#include <QtGlobal>
+
+#if !defined(QT_OPENGL_ES_2)
+#include <QOpenGLTimeMonitor>
+#include <QOpenGLTimerQuery>
+#endif
+
+#include <array>
+#include <memory>
+
+/* Collects timing of rendered frames.
+ *
+ * Every frame is split into phases, each phase is timed on CPU and, when
+ * timer queries are supported, on GPU. GPU results are read back
+ * asynchronously a few frames later, so profiling never stalls the pipeline.
+ * Frame time is measured from the beginning of the frame to frameSwapped(),
+ * which OpenGLRenderWorker calls when the frame is finished. Timings are also
+ * reported to Tracer.
+ */
+class FrameProfiler {
+public:
+	enum Phase {
+		UniformsPhase = 0,
+		BindPhase,
+		DrawPhase,
+		PhaseCount
+	};
+
+	struct Percentiles {
+		double p50, p95, p99;  // Milliseconds
+	};
+
+	class History {
+	public:
+		static const std::size_t capacity = 256;
+	private:
+		std::array<double, capacity> values_;
+		std::size_t size_;
+		std::size_t next_;
+	public:
+		History();
+
+		void push(double value);
+		inline std::size_t size() const { return size_; }
+		Percentiles percentiles() const;
+	};
+private:
+	static const char* const phase_names_[PhaseCount];
+
+	History frame_time_;
+	History cpu_time_;
+	History gpu_time_;
+
+	qint64 frame_begin_;
+	qint64 phase_begin_;
+	bool swap_pending_;
+	quint64 frames_;
+
+#if !defined(QT_OPENGL_ES_2)
+	static const std::size_t monitor_count_ = 3;
+
+	struct Monitor {
+		std::unique_ptr<QOpenGLTimeMonitor> monitor;
+		qint64 frame_begin;
+		bool pending;
+	};
+
+	std::array<Monitor, monitor_count_> monitors_;
+	std::size_t monitor_index_;
+	bool monitor_recording_;
+
+	void collectMonitors();
+#endif
+	bool gpu_timing_;
+public:
+	FrameProfiler();
+	~FrameProfiler();
+
+	// Both require current context
+	void initialize();
+	void destroy();
+
+	void beginFrame();
+	void endPhase(Phase phase);
+	void endFrame();
+	void frameSwapped();
+
+	inline bool hasGPUTiming() const { return gpu_timing_; }
+	inline quint64 frames() const { return frames_; }
+	inline const History& frameTime() const { return frame_time_; }
+	inline const History& cpuTime() const { return cpu_time_; }
+	inline const History& gpuTime() const { return gpu_time_; }
+
+	QString summary() const;
+};
+
+/* Reports GPU time of the enclosed commands to Tracer.
+ *
+ * The result is waited for in the destructor, so the scope is active only
+ * when tracing is enabled. Requires current context. */
+class GPUTraceScope {
+private:
+	const char* name_;
+	const char* category_;
+	qint64 begin_;
+#if !defined(QT_OPENGL_ES_2)
+	std::unique_ptr<QOpenGLTimerQuery> query_;
+#endif
+public:
+	GPUTraceScope(const char* name, const char* category);
+	~GPUTraceScope();
+};
+
+#endif //_FRAMEPROFILER_H
@@ -0,0 +1,68 @@
+#ifndef _FRAMESCHEDULER_H
+#define _FRAMESCHEDULER_H
+
+#include <QString>
+#include <QtGlobal>
+
+/* Render-on-demand scheduling of frames.
+ *
+ * State changes are accumulated into the dirty set. Only the first change
+ * after a rendered frame requests a new frame, the following ones are
+ * coalesced into it. Frames with an empty dirty set are skipped, since the
+ * framebuffer still holds the previous image. A frame presented later than
+ * the next refresh after its request counts missed refreshes as dropped
+ * frames.
+ */
+class FrameScheduler {
+public:
+	enum DirtyFlag {
+		ViewDirty     = 1 << 0,  // MVP uniform
+		LevelsDirty   = 1 << 1,  // c and z uniforms
+		ColorMapDirty = 1 << 2,  // Colormap selection
+		SurfaceDirty  = 1 << 3,  // Framebuffer has been recreated or overpainted
+		StretchDirty  = 1 << 4,  // Stretch uniforms
+		SequenceDirty = 1 << 5,  // Sequence frame texture
+		PlaneDirty    = 1 << 6,  // Cube plane uniform
+		FrameDirty    = 1 << 7,  // Watched frame texture
+		AllDirty      = ViewDirty | LevelsDirty | ColorMapDirty | SurfaceDirty | StretchDirty | SequenceDirty | PlaneDirty | FrameDirty
+	};
+private:
+	int dirty_;
+	bool pending_;
+	qint64 request_time_;
+	// Requested frame which is rendered but not presented yet
+	bool in_flight_;
+	qint64 in_flight_request_time_;
+	qint64 frame_interval_;
+
+	quint64 requested_;
+	quint64 coalesced_;
+	quint64 rendered_;
+	quint64 skipped_;
+	quint64 dropped_;
+public:
+	FrameScheduler();
+
+	void setRefreshRate(double refresh_rate);
+
+	// Adds flags to the dirty set without requesting a frame
+	inline void markDirty(int dirty) { dirty_ |= dirty; }
+	/* Adds flags to the dirty set. Returns true when the caller has to
+	 * schedule a frame, false when the request is merged into the pending
+	 * one. */
+	bool request(int dirty, qint64 now);
+	/* Takes the dirty set at the beginning of the frame. Empty set means
+	 * the frame has to be skipped. */
+	int beginFrame();
+	void frameSwapped(qint64 now);
+
+	inline quint64 requested() const { return requested_; }
+	inline quint64 coalesced() const { return coalesced_; }
+	inline quint64 rendered()  const { return rendered_; }
+	inline quint64 skipped()   const { return skipped_; }
+	inline quint64 dropped()   const { return dropped_; }
+
+	QString summary() const;
+};
+
+#endif //_FRAMESCHEDULER_H
@@ -0,0 +1,55 @@
+#ifndef _FRAMEWATCHER_H_
+#define _FRAMEWATCHER_H_
+
+#include <QDateTime>
+#include <QFileSystemWatcher>
+#include <QObject>
+#include <QString>
+#include <QTimer>
+
+/* Watches a file, or the newest FITS file of a directory, for the frames
+ * written by the acquisition software, either in place or by replacing the
+ * file. A frame is reported once the file has not changed for the settle
+ * interval and its size is a whole number of FITS blocks, so the file is
+ * not opened in the middle of writing.
+ */
+class FrameWatcher: public QObject {
+	Q_OBJECT
+public:
+	static const int settle_interval = 50;  // ms
+private:
+	struct Snapshot {
+		QString filename;
+		qint64 size;
+		QDateTime modified;
+
+		bool operator== (const Snapshot& other) const;
+		bool operator!= (const Snapshot& other) const { return !(*this == other); }
+	};
+
+	QString path_;
+	bool directory_;
+	QFileSystemWatcher watcher_;
+	QTimer settle_timer_;
+	// File state seen by the previous check and the last reported one
+	Snapshot candidate_;
+	Snapshot reported_;
+
+	QString newestFile() const;
+	Snapshot snapshot(const QString& filename) const;
+	// Watches the file too, directory watch misses changes of the content
+	void watchFile(const QString& filename);
+private slots:
+	void notifyChanged();
+	void settle();
+public:
+	explicit FrameWatcher(const QString& path, QObject* parent = Q_NULLPTR);
+
+	// File of the latest frame, empty if a directory has no FITS files yet
+	QString current() const;
+	inline const QString& path() const { return path_; }
+signals:
+	void frameChanged(const QString& filename);
+};
+
+#endif // _FRAMEWATCHER_H_
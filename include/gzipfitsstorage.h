@@ -0,0 +1,86 @@
+#ifndef _GZIPFITSSTORAGE_H_
+#define _GZIPFITSSTORAGE_H_
+
+#include <QByteArray>
+#include <QFileDevice>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+#include <abstractfitsstorage.h>
+#include <exception.h>
+#include <fitsunitscanner.h>
+
+/* Storage of gzip-compressed FITS file, e.g. .fits.gz, inflated into memory.
+ *
+ * The first open inflates the whole stream, parsing the headers as the data
+ * arrive, and saves the index of the file: the offsets of the HDUs and the
+ * seek points taken every span bytes of the output, which hold the inflate
+ * state needed to resume there. Later opens of a single HDU, e.g. a frame
+ * of a sequence, inflate from the nearest seek points only the headers up
+ * to the HDU and its data, in parallel; data of the preceding HDUs read as
+ * zeros and the following HDUs are not included. Opens of the whole file
+ * inflate it all, in parallel as well.
+ *
+ * Every member of a multi-member stream starts a seek point. Members of
+ * BGZF files are found from their headers without inflating, so even the
+ * first open inflates them in parallel.
+ *
+ * The buffer is page-aligned, its pages are committed when written only.
+ */
+class GzipFITSStorage: public AbstractFITSStorage {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	struct Index {
+		struct Point {
+			quint64 in;  // Offset of the compressed stream
+			quint64 out;  // Offset of the inflated data
+			int bits;  // Bits of the byte before in which belong to the point
+			bool member;  // Beginning of gzip member, needs no window
+			QByteArray window;  // Up to 32 KiB of the data before the point
+		};
+		typedef FITSUnitScanner::Unit Unit;
+
+		quint64 size;  // Inflated size
+		std::vector<Point> points;
+		std::vector<Unit> units;  // HDUs as FITS parses them
+	};
+
+	// Distance between the seek points in the inflated data
+	static const quint64 span = Q_UINT64_C(4) << 20;
+	// hdu_index of the opens which need every HDU of the file
+	static const int whole_file = -2;
+private:
+	struct Inflated;
+
+	void* block_;  // Allocation holding the aligned buffer
+	Index index_;
+	bool partial_;
+
+	GzipFITSStorage(Inflated&& inflated);
+	static Inflated inflate(std::unique_ptr<QFileDevice> file_device, int hdu_index, const QString& index_directory);
+public:
+	/* hdu_index is the HDU to be inflated by the later opens, -1 for the
+	 * first image HDU as Sequence opens it, whole_file for all of them.
+	 * Empty index_directory disables the index. */
+	explicit GzipFITSStorage(QFileDevice* file_device, int hdu_index = whole_file, const QString& index_directory = defaultIndexDirectory());
+	virtual ~GzipFITSStorage() override;
+
+	inline const Index& index() const { return index_; }
+	// Only the requested HDU has been inflated from the saved index
+	inline bool isPartial() const { return partial_; }
+
+	// The device starts with gzip magic bytes
+	static bool isGzip(QFileDevice* file_device);
+	static QString defaultIndexDirectory();
+};
+
+#endif // _GZIPFITSSTORAGE_H_
@@ -0,0 +1,57 @@
+#ifndef _HEADERMODEL_H
+#define _HEADERMODEL_H
+
+#include <QAbstractTableModel>
+#include <QByteArray>
+#include <QModelIndex>
+#include <QVariant>
+
+#include <memory>
+
+#include <fits.h>
+
+/* Model of the header cards of an HDU, a row per card. The cards are read
+ * from the storage when the views ask for them, so only the visible rows of
+ * a header of any length are ever converted to strings. The HDU is kept
+ * alive by the model. */
+class HeaderModel: public QAbstractTableModel {
+	Q_OBJECT
+public:
+	enum Column {
+		KeywordColumn,
+		ValueColumn,
+		CommentColumn,
+		ColumnCount
+	};
+
+	struct Card {
+		QString keyword;
+		QString value;  // The text of commentary cards, e.g. HISTORY
+		QString comment;
+	};
+private:
+	std::shared_ptr<const FITS::HeaderDataUnit> hdu_;
+	// Made of the keywords when the header has no stored cards
+	QByteArray made_cards_;
+	const char* cards_;
+	int card_count_;
+public:
+	HeaderModel(std::shared_ptr<const FITS::HeaderDataUnit> hdu, QObject* parent = Q_NULLPTR);
+
+	virtual int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	virtual int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+	virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+	// 80 bytes of the card
+	inline const char* card(int row) const { return cards_ + 80 * static_cast<qint64>(row); }
+
+	/* Row of the first card containing text, ignoring the case, starting
+	 * from the row and moving in the direction, which is 1 or -1, around the
+	 * header. Returns -1 when there is none. */
+	int find(const QByteArray& text, int from, int direction = 1) const;
+
+	static Card parseCard(const char* card);
+};
+
+#endif //_HEADERMODEL_H
@@ -0,0 +1,61 @@
+#ifndef _HEADERQUERY_H_
+#define _HEADERQUERY_H_
+
+#include <QString>
+#include <QStringList>
+
+#include <map>
+#include <vector>
+
+#include <exception.h>
+
+/* Conditions on the header keywords, e.g. FILTER=R or EXPTIME>60, all of
+ * which have to hold. The values are compared as numbers when both of them
+ * are numbers, otherwise as strings without the quotes, ignoring the case.
+ * A condition on a missing keyword does not hold.
+ */
+class HeaderQuery {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	enum Operator {
+		Equal,
+		NotEqual,
+		Less,
+		LessOrEqual,
+		Greater,
+		GreaterOrEqual
+	};
+
+	struct Condition {
+		QString key;
+		Operator op;
+		QString value;
+	};
+private:
+	std::vector<Condition> conditions_;
+public:
+	HeaderQuery() = default;
+	// Throws Exception for the conditions which cannot be parsed
+	explicit HeaderQuery(const QStringList& conditions);
+
+	inline const std::vector<Condition>& conditions() const { return conditions_; }
+	inline bool isEmpty() const { return conditions_.empty(); }
+
+	// Cards of the header as FITS::HeaderUnit keeps them
+	bool matches(const std::map<QString, QString>& cards) const;
+
+	static Condition parseCondition(const QString& text);
+	// The raw value of the card satisfies the condition
+	static bool holds(const Condition& condition, const QString& value);
+	// Raw value which is not a quoted string, D exponent is allowed
+	static bool toNumber(const QString& value, double* number);
+};
+
+#endif // _HEADERQUERY_H_
@@ -0,0 +1,32 @@
+#ifndef _HEADERREADER_H_
+#define _HEADERREADER_H_
+
+#include <QString>
+
+#include <vector>
+
+#include <fits.h>
+
+/* Reads the headers of FITS file without its data.
+ *
+ * The header blocks are read by unbuffered reads and the data units are
+ * skipped by seeking, so a file costs a few system calls whatever its size
+ * and its data pages never get into the page cache. The HDUs are found the
+ * same way FITS parses them. Gzip-compressed files have to be inflated, see
+ * GzipFITSStorage, their offsets are of the inflated data.
+ */
+class HeaderReader {
+public:
+	struct HDU {
+		quint64 offset;  // Offset of the header
+		quint64 data_offset;
+		quint64 data_length;  // Length of the data unit without the padding
+		FITS::HeaderUnit header;
+	};
+
+	/* Reads the HDUs up to max_count of them, at least the primary one, all
+	 * of them when max_count is negative */
+	static std::vector<HDU> read(const QString& filename, int max_count = -1);
+};
+
+#endif // _HEADERREADER_H_
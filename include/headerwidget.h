@@ -0,0 +1,40 @@
+#ifndef _HEADERWIDGET_H
+#define _HEADERWIDGET_H
+
+#include <QLabel>
+#include <QLineEdit>
+#include <QTableView>
+#include <QWidget>
+
+#include <memory>
+
+#include <fits.h>
+#include <headermodel.h>
+
+/* Cards of the header of the shown HDU with incremental search. Typing
+ * finds the text starting from the current card, Return and F3 move to the
+ * next match, Shift+Return and Shift+F3 to the previous one. */
+class HeaderWidget: public QWidget {
+	Q_OBJECT
+private:
+	std::unique_ptr<QLineEdit> search_;
+	std::unique_ptr<QLabel> status_;
+	std::unique_ptr<QTableView> view_;
+	std::unique_ptr<HeaderModel> model_;
+
+	// Selects the found card, from is the row the search starts at
+	void find(int from, int direction);
+	void showCardCount();
+public:
+	explicit HeaderWidget(QWidget* parent);
+
+	// Empty HDU clears the widget
+	void setHDU(std::shared_ptr<const FITS::HeaderDataUnit> hdu);
+
+private slots:
+	void notifySearchChanged();
+	void findNext();
+	void findPrevious();
+};
+
+#endif //_HEADERWIDGET_H
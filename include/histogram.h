@@ -0,0 +1,46 @@
+#ifndef _HISTOGRAM_H
+#define _HISTOGRAM_H
+
+#include <QtGlobal>
+
+#include <cmath>
+#include <vector>
+
+#include <fits.h>
+
+/* Cumulative histogram of physical values of an image HDU.
+ *
+ * Bins split the range evenly, every bin holds the fraction of the pixels
+ * which are not greater than the end of the bin, scaled to [0, 65535] to be
+ * uploaded as a 16-bit texture. NaN values are not counted. Used as the
+ * lookup table of the histogram equalization stretch.
+ */
+class Histogram {
+public:
+	static const int default_size = 2048;
+private:
+	std::pair<double, double> range_;
+	std::vector<quint16> cdf_;
+public:
+	inline Histogram(): range_(0, 0) {}
+	inline Histogram(const std::pair<double, double>& range, const std::vector<quint16>& cdf): range_(range), cdf_(cdf) {}
+	// Scans the data unit, values out of the range are put into the edge bins
+	Histogram(const FITS::HeaderDataUnit& hdu, const std::pair<double, double>& range, int size = default_size);
+
+	inline bool isEmpty() const { return cdf_.empty(); }
+	inline const std::pair<double, double>& range() const { return range_; }
+	inline int size() const { return static_cast<int>(cdf_.size()); }
+	inline const std::vector<quint16>& cdf() const { return cdf_; }
+
+	/* Cumulative fraction at u, which is the position in the range scaled to
+	 * [0, 1]. The nearest bin is taken and u is clamped to the edges, the
+	 * same way as a texture is sampled. */
+	inline double at(double u) const {
+		Q_ASSERT(!isEmpty());
+		const auto position = u * size();
+		const auto i = (position > 0 ? (position < size() - 1.0 ? std::floor(position) : size() - 1.0) : 0.0);
+		return cdf_[static_cast<std::size_t>(i)] / 65535.0;
+	}
+};
+
+#endif //_HISTOGRAM_H
@@ -0,0 +1,73 @@
+#ifndef _HTTPFITSSTORAGE_H_
+#define _HTTPFITSSTORAGE_H_
+
+#include <QString>
+#include <QUrl>
+
+#include <vector>
+
+#include <abstractfitsstorage.h>
+#include <exception.h>
+#include <fitsunitscanner.h>
+
+/* Storage of FITS file served over HTTP, fetched by Range requests.
+ *
+ * For a single HDU, e.g. a frame of a sequence, the headers are fetched
+ * first, up to the requested HDU, then its data unit is fetched by
+ * parallel requests. As for partial GzipFITSStorage, data of the preceding
+ * HDUs read as zeros and the following HDUs are not included. The whole
+ * file is fetched by parallel requests when it is asked for, when there is
+ * no such HDU, or when the server ignores Range and sends it anyway.
+ *
+ * The file is fetched by blocks of block_size bytes, which are kept in the
+ * on-disk cache. The cached blocks are dropped when the size, ETag or
+ * Last-Modified of the file change.
+ *
+ * The buffer pages are committed when written only.
+ */
+class HttpFITSStorage: public AbstractFITSStorage {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	// Unit of the requests and the cache, a multiple of FITS block
+	static const quint64 block_size = 2880 * 364;
+	// Consecutive blocks fetched by a single request
+	static const quint64 blocks_per_request = 4;
+	// hdu_index of the opens which need every HDU of the file
+	static const int whole_file = -2;
+private:
+	struct Fetched;
+
+	void* block_;
+	std::vector<FITSUnitScanner::Unit> units_;
+	bool partial_;
+	quint64 downloaded_;
+
+	HttpFITSStorage(Fetched&& fetched);
+	static Fetched fetch(const QUrl& url, int hdu_index, const QString& cache_directory);
+public:
+	/* hdu_index is the HDU to be fetched, -1 for the first image HDU as
+	 * Sequence opens it, whole_file for all of them. Empty cache_directory
+	 * disables the cache. */
+	explicit HttpFITSStorage(const QUrl& url, int hdu_index = whole_file, const QString& cache_directory = defaultCacheDirectory());
+	virtual ~HttpFITSStorage() override;
+
+	// HDUs up to the fetched one, all of them for the whole file
+	inline const std::vector<FITSUnitScanner::Unit>& units() const { return units_; }
+	// Only the requested HDU has been fetched
+	inline bool isPartial() const { return partial_; }
+	// Bytes received from the server, the rest has come from the cache
+	inline quint64 downloaded() const { return downloaded_; }
+
+	// The name is http or https URL rather than a local file
+	static bool isUrl(const QString& filename);
+	static QString defaultCacheDirectory();
+};
+
+#endif // _HTTPFITSSTORAGE_H_
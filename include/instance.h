@@ -4,6 +4,7 @@
 #include <memory.h>
 
 #include <QString>
+#include <QStringList>
 
 #include <application.h>
 #include <mainwindow.h>
@@ -18,6 +19,11 @@ private slots:
 	void mainWindowClosed(MainWindow& mainwindow);
 public:
 	Instance(QObject* parent, const QString& filename);
+	Instance(QObject* parent, const QStringList& filenames, double frame_rate);
+	Instance(QObject* parent, std::shared_ptr<const Sequence> sequence, double frame_rate);
+	Instance(QObject* parent, std::shared_ptr<const FITS> fits, const QString& title);
+	Instance(QObject* parent, std::unique_ptr<FrameWatcher> watcher);
+	Instance(QObject* parent, std::shared_ptr<SharedMemoryRing> ring);
 	virtual ~Instance() override;
 };
 
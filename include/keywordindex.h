@@ -0,0 +1,96 @@
+#ifndef _KEYWORDINDEX_H_
+#define _KEYWORDINDEX_H_
+
+#include <QFileInfo>
+#include <QString>
+#include <QStringList>
+
+#include <map>
+#include <vector>
+
+#include <exception.h>
+#include <headerquery.h>
+
+/* Persistent index of the header keywords of the FITS files of a directory
+ * tree.
+ *
+ * Every HDU is recorded with its cards, offset, shape and BITPIX, so queries
+ * need neither the files nor their headers, and a found HDU is opened at its
+ * offset without parsing the preceding ones, see Sequence::Frame. The
+ * headers are read by HeaderReader in parallel. Updates read only the files
+ * which are new or have changed size or modification time since.
+ *
+ * The index is saved compressed into a file of the index directory named
+ * after the root, the keywords are stored once for the whole index.
+ */
+class KeywordIndex {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	struct HDU {
+		quint64 offset;  // Of the header
+		int bitpix;  // Of the image, ZBITPIX for tile-compressed one
+		std::vector<quint64> shape;  // NAXISn, the first axis first
+		bool image;  // The viewer can show it
+		std::map<QString, QString> cards;  // Raw values as FITS::HeaderUnit keeps them
+	};
+
+	struct File {
+		qint64 size;
+		qint64 modified;  // Milliseconds since the epoch
+		std::vector<HDU> hdus;  // Empty when the file cannot be read
+
+		// The offsets are still valid
+		bool isUnchanged(const QFileInfo& info) const;
+	};
+
+	struct Match {
+		QString filename;  // Absolute
+		int hdu_index;
+		const File* file;
+		const HDU* hdu;
+	};
+
+	struct Statistics {
+		int added;
+		int updated;
+		int removed;
+		int unchanged;
+		QStringList errors;  // Of the files which cannot be read
+	};
+private:
+	QString root_;
+	QString path_;
+	std::map<QString, File> files_;  // By the path relative to the root
+
+	bool load();
+public:
+	/* Loads the saved index of the directory tree, the index is empty when
+	 * there is none. Empty index_directory keeps the index in memory only.
+	 * Throws Exception when the root is not a directory. */
+	explicit KeywordIndex(const QString& root, const QString& index_directory = defaultIndexDirectory());
+
+	inline const QString& root() const { return root_; }
+	inline const std::map<QString, File>& files() const { return files_; }
+
+	/* Reads the headers of the new and the changed files matching the
+	 * patterns, forgets the removed files and saves the index if any of
+	 * them has changed. Files are compared by size and modification time,
+	 * as FITSCache keys them. */
+	Statistics update(const QStringList& name_filters);
+	// Throws Exception when the index cannot be written
+	void save() const;
+
+	// HDUs satisfying the query, ordered by the paths and the HDU indices
+	std::vector<Match> query(const HeaderQuery& query) const;
+
+	static QString defaultIndexDirectory();
+};
+
+#endif // _KEYWORDINDEX_H_
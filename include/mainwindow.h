@@ -1,17 +1,30 @@
 #ifndef _MAINWINDOW_H_
 #define _MAINWINDOW_H_
 
+#include <QAction>
 #include <QDockWidget>
 #include <QMainWindow>
+#include <QMenu>
 #include <QMenuBar>
 #include <QString>
+#include <QStringList>
+#include <QTimer>
 
+#include <map>
 #include <memory>
 
+#include <checksumlabel.h>
+#include <cubecollapser.h>
 #include <exception.h>
+#include <fitscache.h>
+#include <framewatcher.h>
+#include <headerwidget.h>
 #include <levelswidget.h>
 #include <colormapwidget.h>
+#include <stretchwidget.h>
 #include <scrollzoomarea.h>
+#include <sequence.h>
+#include <sharedmemoryring.h>
 
 class MainWindow:
 	public QMainWindow {
@@ -25,32 +38,79 @@ public:
 		virtual QException* clone() const override;
 	};
 
-	class FileOpenError: public Exception {
-	public:
-		explicit FileOpenError(const QString& reason);
-
-		virtual void raise() const override;
-		virtual QException* clone() const override;
-	};
-
-	class NoImageInFITS: public Exception {
-	public:
-		NoImageInFITS();
-
-		virtual void raise() const override;
-		virtual QException* clone() const override;
-	};
 private:
 	static constexpr double zoomIn_factor_  = 1.25;
 	static constexpr double zoomOut_factor_ = 0.8;
 	static constexpr const char homepage_url_[] = "http://fips.space";
 
-	std::unique_ptr<FITS> fits_;
+	// Files ahead in the browsing direction to be opened in background
+	static const int prefetch_depth_ = 3;
+	// Polling period of the shared-memory ring, ms
+	static const int ring_poll_interval_ = 5;
+
+	// Either file, sequence, in-memory image or watched frames are shown
+	std::shared_ptr<const FITSCache::Entry> entry_;
+	std::shared_ptr<const Sequence> sequence_;
+	std::shared_ptr<const FITS> fits_;
+	std::unique_ptr<FrameWatcher> watcher_;
+	std::shared_ptr<SharedMemoryRing> ring_;
+	QTimer ring_timer_;
+	// Sequence number of the shown frame of the ring
+	quint64 ring_sequence_;
+	/* Watched frame the viewport was created from, the later frames of the
+	 * same shape are kept by the viewport */
+	std::shared_ptr<const Sequence::OpenedFrame> watched_frame_;
+	// Listed when the neighbours are needed for the first time
+	QStringList directory_files_;
+	int browse_direction_;
+	// Plane of the shown cube, it is switched by the viewport without reloading
+	quint64 plane_index_;
+	QString title_;
+
+	QAction* frame_statistics_action_;
+	LevelsWidget* levels_widget_;
+	ColorMapWidget* colormap_widget_;
+	StretchWidget* stretch_widget_;
+	HeaderWidget* header_widget_;
+	ChecksumLabel* checksum_label_;
+	QMenu* cube_menu_;
+	QMenu* tables_menu_;
+	// Docks of the opened tables of the file by HDU index
+	std::map<quint64, QDockWidget*> table_docks_;
+
+	void initialize(const FITS::HeaderDataUnit& hdu, const QString& title, const QString& texture_key);
+	void setTitle(const QString& title);
+	// Connects the controls to the current viewport
+	void connectViewport();
+	// Shows the HDU in the new viewport keeping the view settings
+	void replaceViewport(const FITS::HeaderDataUnit& hdu, const QString& texture_key, std::shared_ptr<const OpenGLTexture::Statistics> statistics);
+	void browse(int delta);
+	// File or in-memory image HDU, which may be a cube
+	const FITS::HeaderDataUnit* cubeHDU() const;
+	/* Shown HDU sharing the ownership of its file, the first frame of the
+	 * sequence */
+	std::shared_ptr<const FITS::HeaderDataUnit> shownHDU() const;
+	// Verifies the checksums of the shown HDU in background
+	void verifyChecksum();
+	void showPlane(quint64 index);
+	// Lists the binary tables of the file, and closes the docks of the previous one
+	void updateTablesMenu();
+	void showTable(quint64 hdu_index);
+	// Shows the next watched file or ring frame
+	void showWatchedFrame(std::shared_ptr<const Sequence::OpenedFrame> frame, const QString& title);
 protected:
 	virtual void resizeEvent(QResizeEvent* event) override;
 	virtual void closeEvent(QCloseEvent *event) override;
 public:
 	MainWindow(const QString& fits_filename, QWidget *parent = Q_NULLPTR);
+	// Plays the frames of the sequence back
+	MainWindow(std::shared_ptr<const Sequence> sequence, double frame_rate, QWidget *parent = Q_NULLPTR);
+	// Shows the primary HDU of in-memory FITS, e.g. a processing result
+	MainWindow(std::shared_ptr<const FITS> fits, const QString& title, QWidget *parent = Q_NULLPTR);
+	// Shows the frames of the watched file or directory as they are written
+	MainWindow(std::unique_ptr<FrameWatcher> watcher, QWidget *parent = Q_NULLPTR);
+	// Shows the latest frames of the shared-memory ring filled by camera software
+	MainWindow(std::shared_ptr<SharedMemoryRing> ring, QWidget *parent = Q_NULLPTR);
 
 	inline ScrollZoomArea* scrollZoomArea() const {
 		return static_cast<ScrollZoomArea*>(centralWidget());
@@ -62,6 +122,18 @@ public slots:
 	void fitToWindow();
 	void about();
 	void homepage();
+	// Neighbouring files of the directory, sorted by name
+	void nextFile();
+	void previousFile();
+	// Planes of the cube
+	void nextPlane();
+	void previousPlane();
+	// Shows the collapsed range of the planes in a new window
+	void collapse();
+private slots:
+	void prefetchNeighbours();
+	void updateWatchedFrame(const QString& filename);
+	void pollRing();
 signals:
 	void closed(MainWindow& mainwindow);
 };
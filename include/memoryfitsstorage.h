@@ -0,0 +1,33 @@
+#ifndef _MEMORYFITSSTORAGE_H_
+#define _MEMORYFITSSTORAGE_H_
+
+#include <QByteArray>
+#include <QSize>
+#include <QString>
+
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include <abstractfitsstorage.h>
+#include <fits.h>
+
+/* Storage of FITS data produced in memory, e.g. by processing of images, so
+ * the results are shown the same way as files are. */
+class MemoryFITSStorage: public AbstractFITSStorage {
+public:
+	// Header cards besides the mandatory ones, values are formatted already
+	typedef std::vector<std::pair<QString, QString>> cards_type;
+
+	// Takes ownership of data allocated by new[]
+	MemoryFITSStorage(quint8* data, qint64 size);
+	virtual ~MemoryFITSStorage() override;
+
+	/* FITS having the single BITPIX=-32 image of physical values, data is
+	 * row by row starting from the first FITS row */
+	static std::unique_ptr<FITS> createFloatImage(const QSize& size, const float* data, const cards_type& cards = cards_type());
+	// Quoted string value of a card
+	static QString stringValue(const QString& value);
+};
+
+#endif // _MEMORYFITSSTORAGE_H_
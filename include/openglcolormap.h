@@ -17,7 +17,7 @@ public:
 	inline bool isInitialized() { return initialized; }
 
 	virtual const char* name() const = 0;
-protected:
+	// Colormap as RGBA bytes, size is in bytes
 	virtual int size() const = 0;
 	virtual const quint8* data() const = 0;
 };
@@ -30,7 +30,6 @@ public:
 	GrayscaleColorMap();
 	virtual ~GrayscaleColorMap() override;
 	virtual const char* name() const override;
-protected:
 	virtual int size() const override;
 	virtual const quint8* data() const override;
 };
@@ -42,7 +41,6 @@ public:
 	PurpleBlueColorMap();
 	virtual ~PurpleBlueColorMap() override;
 	virtual const char* name() const override;
-protected:
 	virtual int size() const override;
 	virtual const quint8* data() const override;
 };
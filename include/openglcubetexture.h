@@ -0,0 +1,66 @@
+#ifndef _OPENGLCUBETEXTURE_H
+#define _OPENGLCUBETEXTURE_H
+
+#include <QOpenGLTexture>
+#include <QSize>
+
+#include <vector>
+
+#include <fits.h>
+#include <opengltexture.h>
+
+/* Planes of NAXIS=3 cube resident in 3D texture.
+ *
+ * The texture has a layer for every plane when the cube fits the budget,
+ * otherwise it holds a window of planes around the current one, plane p
+ * is kept in layer p % layers(). Planes are uploaded one by one, nearest
+ * to the current plane first, so switching to a resident plane costs only
+ * the plane uniform of the cube shader program. All the methods besides
+ * the constructor require a context to be current.
+ */
+class OpenGLCubeTexture: public QOpenGLTexture {
+private:
+	const FITS::HeaderDataUnit* hdu_;
+	QOpenGLTexture::TextureFormat texture_format_;
+	QOpenGLTexture::PixelFormat pixel_format_;
+	QOpenGLTexture::PixelType pixel_type_;
+	bool swap_bytes_enabled_;
+	quint64 layers_;
+	std::vector<qint64> resident_;  // Plane held by the layer, -1 for none
+	quint64 current_;
+
+	quint64 windowBegin() const;
+	void upload(quint64 plane);
+public:
+	static const qint64 default_budget = Q_INT64_C(512) << 20;
+
+	/* texture is the prepared texture of the first plane, which gives the
+	 * formats of the upload */
+	OpenGLCubeTexture(const FITS::HeaderDataUnit& hdu, const OpenGLTexture& texture);
+
+	/* Allocates as many layers as fit the budget in bytes, at least one.
+	 * Returns false when the texture can not be allocated. */
+	bool allocate(qint64 budget);
+
+	inline quint64 depth() const { return hdu_->data().imageDataUnit()->depth(); }
+	inline quint64 layers() const { return layers_; }
+
+	void setCurrentPlane(quint64 plane);
+	inline quint64 currentPlane() const { return current_; }
+	bool isResident(quint64 plane) const;
+	// Some planes of the window around the current one are not uploaded yet
+	bool hasPendingPlanes() const;
+	// Uploads the nearest pending plane, returns false when there is none
+	bool uploadNextPlane();
+	// Third texture coordinate of the layer holding the plane
+	float planeCoordinate(quint64 plane) const;
+
+	// 3D textures of the size are available in the current context
+	static bool isSupported(const QSize& size);
+	/* Bytes of the video memory to be taken by a cube texture, a half of
+	 * the available memory when the driver reports it, but not more than
+	 * default_budget */
+	static qint64 budget();
+};
+
+#endif //_OPENGLCUBETEXTURE_H
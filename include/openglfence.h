@@ -0,0 +1,39 @@
+#ifndef _OPENGLFENCE_H
+#define _OPENGLFENCE_H
+
+#include <QOpenGLFunctions>
+
+/* Fence of the commands issued so far in the current context, which another
+ * context of the share group waits for, e.g. before it overwrites a texture
+ * still being sampled.
+ *
+ * Sync objects are GL_ARB_sync (core since OpenGL 3.2 and OpenGL ES 3.0).
+ * Without it insert() finishes the commands and returns null, which wait()
+ * and remove() accept. All the methods require a current context.
+ */
+class OpenGLFence {
+public:
+	// GLsync, which Qt headers do not declare for every platform
+	typedef struct __GLsync* Sync;
+private:
+	typedef Sync (QOPENGLF_APIENTRYP fence_sync_type)(GLenum condition, GLbitfield flags);
+	typedef void (QOPENGLF_APIENTRYP wait_sync_type)(Sync sync, GLbitfield flags, quint64 timeout);
+	typedef void (QOPENGLF_APIENTRYP delete_sync_type)(Sync sync);
+
+	struct Functions {
+		fence_sync_type fence_sync;
+		wait_sync_type wait_sync;
+		delete_sync_type delete_sync;
+	};
+
+	static bool resolve(Functions* functions);
+public:
+	// The fence is flushed, so a wait in another context never stalls
+	static Sync insert();
+	// Makes the following commands of the current context wait for the fence, and deletes it
+	static void wait(Sync sync);
+	// Deletes the fence nobody is going to wait for
+	static void remove(Sync sync);
+};
+
+#endif //_OPENGLFENCE_H
@@ -0,0 +1,56 @@
+#ifndef _OPENGLPROGRAMBINARYCACHE_H
+#define _OPENGLPROGRAMBINARYCACHE_H
+
+#include <QByteArray>
+#include <QOpenGLFunctions>
+#include <QOpenGLShaderProgram>
+#include <QString>
+
+/* Persistent on-disk cache of linked program binaries.
+ *
+ * Binaries are stored using GL_ARB_get_program_binary (core since OpenGL 4.1
+ * and OpenGL ES 3.0). Entries are keyed by the sources and by the vendor,
+ * renderer and version strings of the current context, so a driver update
+ * leads to cache misses rather than to loading incompatible binaries. All the
+ * methods require a current context.
+ */
+class OpenGLProgramBinaryCache {
+private:
+	typedef void (QOPENGLF_APIENTRYP get_program_binary_type)(GLuint program, GLsizei buf_size, GLsizei* length, GLenum* binary_format, void* binary);
+	typedef void (QOPENGLF_APIENTRYP program_binary_type)(GLuint program, GLenum binary_format, const void* binary, GLsizei length);
+	typedef void (QOPENGLF_APIENTRYP program_parameteri_type)(GLuint program, GLenum pname, GLint value);
+
+	struct Functions {
+		get_program_binary_type get_program_binary;
+		program_binary_type program_binary;
+		program_parameteri_type program_parameteri;
+	};
+
+	QString directory_;
+
+	static bool resolve(Functions* functions);
+	static QByteArray renderer();
+	QString path(const QByteArray& key) const;
+public:
+	explicit OpenGLProgramBinaryCache(const QString& directory = defaultDirectory());
+
+	// Empty directory disables the cache
+	inline const QString& directory() const { return directory_; }
+
+	/* Key of the program built from the sources for the current renderer */
+	static QByteArray key(const QByteArray& vertex_source, const QByteArray& fragment_source);
+
+	/* Asks the driver to keep the program binary retrievable, has to be
+	 * called before linking. */
+	void prepare(QOpenGLShaderProgram* program) const;
+	/* Loads the binary into the created program without shaders. Returns
+	 * false when there is no entry, or when the driver rejected it; the
+	 * rejected entry is removed. */
+	bool load(QOpenGLShaderProgram* program, const QByteArray& key) const;
+	/* Stores the binary of the linked program */
+	bool store(QOpenGLShaderProgram* program, const QByteArray& key) const;
+
+	static QString defaultDirectory();
+};
+
+#endif //_OPENGLPROGRAMBINARYCACHE_H
@@ -0,0 +1,173 @@
+#ifndef _OPENGLRENDERER_H
+#define _OPENGLRENDERER_H
+
+#include <QOpenGLBuffer>
+#include <QOpenGLFunctions>
+#include <QMatrix4x4>
+#include <QRectF>
+#include <QSize>
+
+#include <memory>
+
+#include <exception.h>
+#include <fits.h>
+#include <framebands.h>
+#include <frameprofiler.h>
+#include <openglcubetexture.h>
+#include <openglresourceregistry.h>
+#include <openglshaderprogram.h>
+#include <openglshaderunifroms.h>
+#include <opengltexture.h>
+
+/* Renders image HDU into the currently bound framebuffer.
+ *
+ * The renderer does not own a context. All the methods, including the
+ * destructor, require a context from the share group of the registry to be
+ * current, and it has to be the same context for the lifetime of the
+ * renderer since the vertex buffer is not shared.
+ */
+class OpenGLRenderer: protected QOpenGLFunctions {
+public:
+	class Exception: public ::Exception {
+	public:
+		Exception(const QString &reason, GLenum gl_error_code);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+		static QString glErrorString(GLenum gl_error_code);
+	};
+
+	class ShaderLoadError: public Exception {
+	public:
+		ShaderLoadError(GLenum gl_error_code);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	class ShaderBindError: public Exception {
+	public:
+		ShaderBindError(GLenum gl_error_code);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	class ShaderCompileError: public Exception {
+	public:
+		ShaderCompileError(GLenum gl_error_code);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	class TextureCreateError: public Exception {
+	public:
+		TextureCreateError(GLenum gl_error_code);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	// Everything needed to render a frame
+	struct State {
+		QRectF viewrect;
+		// Levels are taken from the texture until they are set
+		bool has_levels;
+		std::pair<double, double> levels;
+		int colormap_index;
+		OpenGLShaderUniforms::Stretch stretch;
+		double stretch_parameter;
+		QSize size;  // Framebuffer size in pixels
+		quint64 plane;  // Plane of NAXIS=3 cube
+
+		State();
+	};
+
+	typedef OpenGLResourceRegistry::colormaps_type colormaps_type;
+
+	// Square which is made from two triangles. Each line is xyz coordinates of triangle vertex (0-2 - first triangle,
+	// 3-5 - second triangle). First and seconds columns are used as corresponding UV-coordinates.
+	static constexpr const GLfloat vbo_data[] = {
+			0.0f, 0.0f, 0.0f,
+			1.0f, 0.0f, 0.0f,
+			0.0f, 1.0f, 0.0f,
+			0.0f, 1.0f, 0.0f,
+			1.0f, 0.0f, 0.0f,
+			1.0f, 1.0f, 0.0f,
+	};
+private:
+	OpenGLResourceRegistry* registry_;
+	const FITS::HeaderDataUnit* hdu_;
+	QString texture_key_;
+	std::shared_ptr<const OpenGLTexture::Statistics> statistics_;
+
+	std::shared_ptr<OpenGLTexture> texture_;
+	/* Cube planes are sampled from the cube texture when it is available,
+	 * otherwise the plane other than the first one is uploaded into its
+	 * own texture on every switch. */
+	bool cube_texture_enabled_;
+	std::unique_ptr<OpenGLCubeTexture> cube_texture_;
+	std::unique_ptr<FITS::HeaderDataUnit> plane_hdu_;
+	std::unique_ptr<OpenGLTexture> plane_texture_;
+	quint64 shown_plane_;
+	// Fingerprints of the shown frame, created by the first updateFrame()
+	std::unique_ptr<FrameBands> frame_bands_;
+	std::shared_ptr<OpenGLShaderProgram> program_;
+	colormaps_type colormaps_;
+	QOpenGLBuffer vbo_;
+	QMatrix4x4 base_mvp_;
+	std::unique_ptr<OpenGLShaderUniforms> shader_uniforms_;
+	FrameProfiler profiler_;
+
+	// Values uploaded to the program by the last frame
+	QRectF uploaded_viewrect_;
+	std::pair<double, double> uploaded_levels_;
+	int uploaded_colormap_index_;
+	OpenGLShaderUniforms::Stretch uploaded_stretch_;
+	double uploaded_stretch_parameter_;
+	float uploaded_plane_coordinate_;
+
+	static const int program_texture_uniform_      = 0;
+	static const int program_colormap_uniform_     = 1;
+	static const int program_equalization_uniform_ = 2;
+
+	void showPlane(quint64 plane);
+public:
+	/* texture_key identifies the HDU content to share the texture, see
+	 * OpenGLResourceRegistry::textureKey(). Statistics scanned in advance
+	 * save the scans when the texture is uploaded. */
+	OpenGLRenderer(OpenGLResourceRegistry& registry, const FITS::HeaderDataUnit& hdu, const QString& texture_key = QString(), std::shared_ptr<const OpenGLTexture::Statistics> statistics = std::shared_ptr<const OpenGLTexture::Statistics>());
+	~OpenGLRenderer();
+
+	/* Cube texture is used for NAXIS=3 cubes unless it is disabled before
+	 * initialize() */
+	inline void setCubeTextureEnabled(bool enabled) { cube_texture_enabled_ = enabled; }
+
+	// Uploads the texture and prepares the program, may take a while
+	void initialize();
+	inline bool isInitialized() const { return static_cast<bool>(program_); }
+	/* Replaces the texture by the uploaded one of another HDU having the
+	 * same BITPIX, e.g. the next frame of a sequence. The HDU is the one
+	 * of the texture and must be kept alive while it is shown. */
+	void setTexture(std::shared_ptr<OpenGLTexture> texture, const FITS::HeaderDataUnit& hdu);
+	/* Replaces the content of the texture by the frame of the same shape
+	 * and BITPIX, e.g. the file rewritten by the acquisition software. Only
+	 * the rows changed since the previous update are uploaded and scanned,
+	 * the first update has no previous frame to compare to. The texture
+	 * must not be shared. */
+	void updateFrame(const FITS::HeaderDataUnit& hdu);
+
+	void render(const State& state);
+
+	// Some planes around the shown one are not in the cube texture yet
+	bool hasPendingPlanes() const;
+	// Uploads the nearest pending plane into the cube texture
+	void uploadNextPlane();
+
+	inline const OpenGLTexture* texture() const { return texture_.get(); }
+	inline const colormaps_type& colormaps() const { return colormaps_; }
+	inline FrameProfiler& profiler() { return profiler_; }
+};
+
+#endif //_OPENGLRENDERER_H
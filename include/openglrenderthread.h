@@ -0,0 +1,148 @@
+#ifndef _OPENGLRENDERTHREAD_H
+#define _OPENGLRENDERTHREAD_H
+
+#include <QMutex>
+#include <QObject>
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QThread>
+
+#include <atomic>
+#include <memory>
+
+#include <exception.h>
+#include <fits.h>
+#include <openglfence.h>
+#include <openglrenderer.h>
+#include <openglresourceregistry.h>
+#include <sequence.h>
+#include <texturering.h>
+#include <triplebuffer.h>
+
+/* Thread rendering images of all OpenGL widgets.
+ *
+ * The thread owns a context from the share group of the global share
+ * context, so the framebuffer textures it renders are available to the
+ * widget contexts. The context lives as long as the thread does, so the
+ * resources created by the registry within the thread stay valid.
+ */
+class OpenGLRenderThread {
+public:
+	class ContextError: public ::Exception {
+	public:
+		ContextError();
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+private:
+	QThread thread_;
+	QOffscreenSurface surface_;
+	std::unique_ptr<QOpenGLContext> context_;
+public:
+	OpenGLRenderThread();
+	~OpenGLRenderThread();
+
+	inline QThread* thread() { return &thread_; }
+	// Must be called from the render thread
+	void makeCurrent();
+};
+
+/* Renders a single image in the render thread on behalf of OpenGLWidget.
+ *
+ * GUI thread posts complete render states, render thread publishes rendered
+ * frames back. Both directions are lock-free mailboxes holding the latest
+ * value only, so a slow frame never blocks the GUI and the render thread
+ * never renders outdated states.
+ */
+class OpenGLRenderWorker: public QObject {
+	Q_OBJECT
+public:
+	struct Frame {
+		// Framebuffer is created and deleted in the render thread, the GUI
+		// thread only samples its texture
+		std::unique_ptr<QOpenGLFramebufferObject> fbo;
+		// Set by the GUI thread after drawing the framebuffer, the render
+		// thread waits for it before rendering into the slot again
+		OpenGLFence::Sync drawn;
+		QString statistics;
+		int sequence_index;  // Sequence frame shown, -1 without sequence
+
+		Frame();
+	};
+
+	struct State: public OpenGLRenderer::State {
+		bool statistics_visible;
+		/* Sequence frame to show. The last shown frame is rendered until the
+		 * requested one is prefetched. */
+		int sequence_index;
+
+		State();
+	};
+private:
+	OpenGLRenderThread* render_thread_;
+	std::unique_ptr<OpenGLRenderer> renderer_;
+	TripleBuffer<State> states_;
+	TripleBuffer<Frame> frames_;
+	std::atomic<bool> render_scheduled_;
+	bool released_;
+	bool failed_;  // Errors are reported once, further frames are not rendered
+	bool upload_scheduled_;
+
+	std::shared_ptr<const Sequence> sequence_;
+	std::unique_ptr<TextureRing> ring_;
+	std::shared_ptr<const TextureRing::Entry> shown_;  // Null for the first frame
+	int shown_index_;
+	int requested_index_;
+	int direction_;
+
+	// Frame posted by updateFrame() and the one the renderer shows
+	QMutex frame_mutex_;
+	std::shared_ptr<const Sequence::OpenedFrame> pending_frame_;
+	std::shared_ptr<const Sequence::OpenedFrame> updated_frame_;
+
+	void renderState(const State& state);
+	// Uploads the pending frame, if any, returns true if it was uploaded
+	bool applyPendingFrame();
+	void showSequenceFrame(int index);
+	// Queues upload of the next cube plane unless it is queued already
+	void scheduleUpload();
+public:
+	static const int ring_capacity = 8;
+
+	/* The worker is moved to the render thread. It must be released via
+	 * release() instead of being deleted. The first frame of the sequence,
+	 * if any, is the hdu. */
+	OpenGLRenderWorker(OpenGLRenderThread& render_thread, OpenGLResourceRegistry& registry, const FITS::HeaderDataUnit& hdu, const QString& texture_key, std::shared_ptr<const OpenGLTexture::Statistics> statistics = std::shared_ptr<const OpenGLTexture::Statistics>(), std::shared_ptr<const Sequence> sequence = std::shared_ptr<const Sequence>());
+	virtual ~OpenGLRenderWorker() override;
+
+	// GUI thread side
+	void post(const State& state);
+	// Returns true when a new frame has been fetched into frame()
+	inline bool fetchFrame() { return frames_.fetch(); }
+	inline const Frame& frame() const { return frames_.readSlot(); }
+	// Fences the drawing of frame(), requires the widget context to be current
+	void frameDrawn();
+	/* Replaces the shown image by the frame of the same shape and BITPIX.
+	 * Only the latest frame is uploaded when they come faster than the
+	 * uploads, the worker keeps it mapped while it is shown. */
+	void updateFrame(std::shared_ptr<const Sequence::OpenedFrame> frame);
+	// Deletes the GL objects and then the worker itself, blocks until done
+	void release();
+
+signals:
+	void textureInitialized(const OpenGLTexture* texture);
+	void frameReady();
+	void renderFailed(const QString& reason);
+
+private slots:
+	void render();
+	void stage();
+	void stageFrame();
+	// Uploads a single cube plane, so the states posted meanwhile are not delayed
+	void uploadPlane();
+	void releaseInThread();
+};
+
+#endif //_OPENGLRENDERTHREAD_H
@@ -0,0 +1,96 @@
+#ifndef _OPENGLRESOURCEREGISTRY_H
+#define _OPENGLRESOURCEREGISTRY_H
+
+#include <QOffscreenSurface>
+#include <QMutex>
+#include <QOpenGLContext>
+#include <QString>
+
+#include <array>
+#include <map>
+#include <memory>
+
+#include <exception.h>
+#include <fits.h>
+#include <openglcolormap.h>
+#include <openglprogrambinarycache.h>
+#include <openglshaderprogram.h>
+#include <opengltexture.h>
+
+/* Registry of OpenGL resources shared between OpenGL widgets.
+ *
+ * Qt::AA_ShareOpenGLContexts is set before the application is created, so
+ * all widget contexts are in the share group of
+ * QOpenGLContext::globalShareContext(). The registry creates and uploads
+ * resources with the global share context current: QOpenGLTexture keeps
+ * pointers to the functions of the context it was created in, and only the
+ * global share context lives as long as the application does.
+ *
+ * The global share context belongs to the GUI thread. Other threads, see
+ * OpenGLRenderThread, create resources with their own context from the share
+ * group current, that context has to live as long as the resources do.
+ *
+ * The registry holds weak references only. Resources are owned by their users
+ * through std::shared_ptr and are destroyed when the last user drops the
+ * reference. The user must have a context from the share group current at
+ * that moment.
+ */
+class OpenGLResourceRegistry {
+public:
+	class ContextError: public ::Exception {
+	public:
+		ContextError();
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	typedef std::array<std::shared_ptr<OpenGLColorMap>, 2> colormaps_type;
+private:
+	// Does nothing outside of the GUI thread
+	class ShareContextScope {
+	private:
+		QOpenGLContext* context_;
+		QOpenGLContext* previous_context_;
+		QSurface* previous_surface_;
+	public:
+		explicit ShareContextScope(QOffscreenSurface* surface);
+		~ShareContextScope();
+	};
+
+	// Protects the maps, resources are created outside of the lock
+	QMutex mutex_;
+	std::unique_ptr<QOffscreenSurface> surface_;
+	OpenGLProgramBinaryCache program_binary_cache_;
+	std::map<QString, std::weak_ptr<OpenGLTexture>> textures_;
+	std::map<QString, std::weak_ptr<OpenGLShaderProgram>> programs_;
+	std::array<std::weak_ptr<OpenGLColorMap>, std::tuple_size<colormaps_type>::value> colormaps_;
+
+	QOffscreenSurface* surface();
+public:
+	/* Colormap number index of colormaps_type, not initialized. */
+	static OpenGLColorMap* createColorMap(std::size_t index);
+
+	OpenGLResourceRegistry();
+	~OpenGLResourceRegistry();
+
+	inline OpenGLProgramBinaryCache& programBinaryCache() { return program_binary_cache_; }
+
+	/* Returns initialized texture for the HDU identified by key. Textures with
+	 * the same key are assumed to have the same content, so the data unit is
+	 * neither scanned nor uploaded again while the texture is alive. An empty
+	 * key disables sharing. The texture does not refer to the HDU after it
+	 * is returned. */
+	std::shared_ptr<OpenGLTexture> texture(const QString& key, const FITS::HeaderDataUnit& hdu, std::shared_ptr<const OpenGLTexture::Statistics> statistics = std::shared_ptr<const OpenGLTexture::Statistics>());
+	/* Returns linked program for the BITPIX variant, sampling 3D texture
+	 * for cubes. New programs are restored from the program binary cache
+	 * when possible. */
+	std::shared_ptr<OpenGLShaderProgram> program(const QString& bitpix, bool cube = false);
+	colormaps_type colormaps();
+
+	/* Key of the texture for HDU number hdu_index of the file. Size and
+	 * modification time of the file are a part of the key. */
+	static QString textureKey(const QString& filename, quint64 hdu_index);
+};
+
+#endif //_OPENGLRESOURCEREGISTRY_H
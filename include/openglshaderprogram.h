@@ -0,0 +1,48 @@
+#ifndef _OPENGLSHADERPROGRAM_H
+#define _OPENGLSHADERPROGRAM_H
+
+#include <QOpenGLShaderProgram>
+#include <QString>
+
+#include <openglprogrambinarycache.h>
+
+/* Shader program rendering image data unit of given BITPIX.
+ *
+ * Fragment shader sources for all the BITPIX values are generated from the
+ * single template and the table of variants, see openglshaderprogram.cpp.
+ * The cube variant samples a plane of 3D texture chosen by the plane
+ * uniform, see OpenGLCubeTexture.
+ */
+class OpenGLShaderProgram: public QOpenGLShaderProgram {
+public:
+	static const int vertex_coord_attribute = 0;
+	static const int vertex_uv_attribute    = 1;
+private:
+	QString bitpix_;
+	bool cube_;
+	const void* uniforms_owner_;
+public:
+	explicit OpenGLShaderProgram(const QString& bitpix, bool cube = false, QObject* parent = Q_NULLPTR);
+	virtual ~OpenGLShaderProgram() override;
+
+	inline const QString& bitpix() const { return bitpix_; }
+	inline bool cube() const { return cube_; }
+
+	/* Uniform values are the state of the program, which is shared between
+	 * widgets. Returns true when the uniforms have been set by another owner
+	 * since the previous claim, so they have to be set again. */
+	inline bool claimUniforms(const void* owner) {
+		const bool changed = (owner != uniforms_owner_);
+		uniforms_owner_ = owner;
+		return changed;
+	}
+
+	/* Restores the program from the cache or compiles and links it from the
+	 * sources storing the result into the cache. Cache may be null. */
+	void build(OpenGLProgramBinaryCache* cache);
+
+	static const char* vertexShaderSource();
+	static QString fragmentShaderSource(const QString& bitpix, bool cube = false);
+};
+
+#endif //_OPENGLSHADERPROGRAM_H
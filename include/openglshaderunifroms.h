@@ -8,14 +8,35 @@
 #include <array>
 #include <cmath>
 
+#include <histogram.h>
+
 class OpenGLShaderUniforms {
 public:
+	typedef std::array<GLfloat, 2> vec2_type;
 	typedef std::array<GLfloat, 4> vec4_type;
+
+	/* Transfer functions applied to the levels normalized into [0, 1], the
+	 * values are the ones of the stretch uniform of the fragment shader. */
+	enum Stretch {
+		LinearStretch = 0,
+		SqrtStretch,
+		LogStretch,           // log(a x + 1) / log(a + 1), parameter is a
+		AsinhStretch,         // asinh(x / b) / asinh(1 / b), parameter is b
+		PowerStretch,         // x^p, parameter is p
+		EqualizationStretch,  // Cumulative histogram, see setHistogram()
+		StretchCount
+	};
 private:
 	vec4_type a_;
 	vec4_type c_, z_;
 	std::pair<double, double> minmax_;
 	int colormap_size_;
+
+	Stretch stretch_;
+	double stretch_parameter_;
+	const Histogram* histogram_;
+	vec2_type colormap_range_;
+	vec4_type stretch_parameters_;
 public:
 	const quint8 channels, channel_size;
 	const double bzero, bscale;
@@ -25,11 +46,22 @@ public:
 
 	void setMinMax(const std::pair<double, double>& minmax);
 	void setColorMapSize(int colormap_size);
+	void setStretch(Stretch stretch, double parameter);
+	// The histogram is not owned and has to outlive the uniforms
+	void setHistogram(const Histogram* histogram);
 	inline const vec4_type& get_a() const { return a_; }
 	inline const vec4_type& get_c() const { return c_; }
 	inline const vec4_type& get_z() const { return z_; }
+	inline Stretch get_stretch() const { return stretch_; }
+	// Colormap coordinates of the levels: minimum and the distance to maximum
+	inline const vec2_type& get_colormap_range() const { return colormap_range_; }
+	inline const vec4_type& get_stretch_parameters() const { return stretch_parameters_; }
+
+	static double defaultStretchParameter(Stretch stretch);
+	static const char* stretchName(Stretch stretch);
 private:
 	void update_cz();
+	void update_stretch();
 };
 
 
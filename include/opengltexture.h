@@ -2,15 +2,28 @@
 #define _OPENGLTEXTURE_H
 
 #include <QOpenGLTexture>
-#include <QOpenGLWidget>
+#include <QSize>
 
 #include <algorithm>
+#include <memory>
+#include <vector>
 
 #include <fits.h>
+#include <framebands.h>
+#include <histogram.h>
 
 class OpenGLTexture: public QOpenGLTexture {
+public:
+	// Results of the data scans, which do not depend on the context
+	struct Statistics {
+		std::pair<double, double> minmax;
+		Histogram histogram;
+	};
 private:
+	// Needed until upload(), the shared texture may outlive the HDU
 	const FITS::HeaderDataUnit* hdu_;
+	QSize size_;
+	std::shared_ptr<const Statistics> statistics_;
 	quint8 channels_;  // Number of color channels
 	quint8 channel_size_;  // Bytes per channel for integral texture, 0 for float one
 	std::pair<double, double> minmax_;
@@ -19,15 +32,45 @@ private:
 	QOpenGLTexture::PixelFormat pixel_format_;
 	QOpenGLTexture::PixelType pixel_type_;
 	bool swap_bytes_enabled_;
+	Histogram histogram_;
+	QOpenGLTexture equalization_;  // Cumulative histogram for the equalization stretch
+
+	void uploadEqualization();
 
 public:
-	explicit OpenGLTexture(const FITS::HeaderDataUnit* hdu);
+	// Statistics computed in advance, if any, are used instead of the scans
+	explicit OpenGLTexture(const FITS::HeaderDataUnit* hdu, std::shared_ptr<const Statistics> statistics = std::shared_ptr<const Statistics>());
 
+	inline const QSize& size() const { return size_; }
+
+	// Prepares and uploads the texture
 	void initialize();
+	// Scans the data, does not need a context, so may run in any thread
+	void prepare();
+	// Uploads the prepared data and forgets the HDU, requires a current context
+	void upload();
+	/* Replaces the content by the frame of the same shape and BITPIX,
+	 * uploading the changed rows only, requires a current context. The
+	 * min/max is the one of the frame, the histogram is dropped. */
+	void update(const FITS::HeaderDataUnit* hdu, const std::vector<FrameBands::Band>& bands, const std::pair<double, double>& minmax);
 	inline const std::pair<double, double>& hdu_minmax() const { return minmax_; }
 	inline const std::pair<double, double>& instrumental_minmax() const { return instrumental_minmax_; }
 	inline quint8 channels() const { return channels_; }
 	inline quint8 channel_size() const { return channel_size_; };
+	// Empty until the equalization is used, unless given by the statistics
+	inline const Histogram& histogram() const { return histogram_; }
+	/* Scans the HDU of the texture on the first call and uploads the
+	 * equalization, requires a current context */
+	const Histogram& histogram(const FITS::HeaderDataUnit& hdu);
+	// Upload formats, valid after prepare()
+	inline QOpenGLTexture::TextureFormat texture_format() const { return texture_format_; }
+	inline QOpenGLTexture::PixelFormat pixel_format() const { return pixel_format_; }
+	inline QOpenGLTexture::PixelType pixel_type() const { return pixel_type_; }
+	inline bool swap_bytes_enabled() const { return swap_bytes_enabled_; }
+	inline QOpenGLTexture& equalization() { return equalization_; }
+
+	// Scans the data as prepare() does, may run in any thread
+	static Statistics scan(const FITS::HeaderDataUnit& hdu);
 };
 
 #endif //_OPENGLTEXTURE_H
@@ -4,86 +4,43 @@
 #include <QOpenGLBuffer>
 #include <QOpenGLContext>
 #include <QOpenGLFunctions>
-#include <QOpenGLPixelTransferOptions>
-#include <QOpenGLShader>
 #include <QOpenGLShaderProgram>
-#include <QOpenGLTexture>
-#include <QOpenGLVertexArrayObject>
 #include <QOpenGLWidget>
-#include <QMatrix4x4>
 #include <QResizeEvent>
+#include <QTimer>
 
 #include <cmath>
+#include <memory>
 
-#include <exception.h>
 #include <fits.h>
+#include <framescheduler.h>
 #include <openglcolormap.h>
+#include <openglrenderthread.h>
+#include <openglresourceregistry.h>
 #include <openglshaderunifroms.h>
 #include <opengltexture.h>
-
+#include <sequence.h>
+#include <sequenceplayback.h>
+
+/* Widget showing an image HDU.
+ *
+ * The image is rendered by OpenGLRenderWorker in the render thread, the
+ * widget only posts view and level changes to it and composites the latest
+ * rendered frame, so the GUI is never blocked by the uploads or rendering.
+ *
+ * With a sequence the widget plays its frames back. The frame to show is
+ * taken from the playback clock, the render thread shows the latest
+ * prefetched frame until the requested one is ready.
+ */
 class OpenGLWidget: public QOpenGLWidget, protected QOpenGLFunctions {
 	Q_OBJECT
 public:
-	class Exception: public ::Exception {
-	public:
-		Exception(const QString &reason, GLenum gl_error_code);
-
-		virtual void raise() const override;
-		virtual QException* clone() const override;
-		static QString glErrorString(GLenum gl_error_code);
-	};
-
-	class ShaderLoadError: public Exception {
-	public:
-		ShaderLoadError(GLenum gl_error_code);
-
-		virtual void raise() const override;
-		virtual QException* clone() const override;
-	};
-
-	class ShaderBindError: public Exception {
-	public:
-		ShaderBindError(GLenum gl_error_code);
-
-		virtual void raise() const override;
-		virtual QException* clone() const override;
-	};
-
-	class ShaderCompileError: public Exception {
-	public:
-		ShaderCompileError(GLenum gl_error_code);
-
-		virtual void raise() const override;
-		virtual QException* clone() const override;
-	};
-
-	class TextureCreateError: public Exception {
-	public:
-		TextureCreateError(GLenum gl_error_code);
-
-		virtual void raise() const override;
-		virtual QException* clone() const override;
-	};
-
-	template<class T> class OpenGLDeleter {
-	private:
-		QOpenGLWidget *openGL_widget_;
-	public:
-		OpenGLDeleter(QOpenGLWidget *openGL_widget):
-				openGL_widget_(openGL_widget){}
-		void operator() (T* ptr) {
-			openGL_widget_->makeCurrent();
-			delete ptr;
-			openGL_widget_->doneCurrent();
-		};
-	};
-
-	template<class T> using openGL_unique_ptr = std::unique_ptr<T, OpenGLDeleter<T>>;
-	typedef std::array<openGL_unique_ptr<OpenGLColorMap>, 2> colormaps_type;
-	typedef OpenGLDeleter<OpenGLColorMap> colormap_deleter_type;
+	typedef OpenGLResourceRegistry::colormaps_type colormaps_type;
 
-public:
-	OpenGLWidget(QWidget *parent, const FITS::HeaderDataUnit& hdu);
+	/* texture_key identifies the HDU content to share the texture between
+	 * widgets, see OpenGLResourceRegistry::textureKey(). The hdu is the
+	 * first frame of the sequence if any. */
+	OpenGLWidget(QWidget *parent, const FITS::HeaderDataUnit& hdu, const QString& texture_key = QString(), std::shared_ptr<const OpenGLTexture::Statistics> statistics = std::shared_ptr<const OpenGLTexture::Statistics>(), std::shared_ptr<const Sequence> sequence = std::shared_ptr<const Sequence>());
 	~OpenGLWidget() override;
 
 	void setViewrect(const QRectF &viewrect);
@@ -94,6 +51,13 @@ public:
 	QRect viewrectToPixelViewrect (const QRectF& viewrect) const;
 	inline const colormaps_type& colormaps() const { return colormaps_; }
 	inline int colorMapIndex() const {return colormap_index_; }
+	inline OpenGLShaderUniforms::Stretch stretch() const { return stretch_; }
+	inline double stretchParameter() const { return stretch_parameter_; }
+	inline const FrameScheduler& frameScheduler() const { return frame_scheduler_; }
+	// Null without a sequence
+	inline const SequencePlayback* playback() const { return playback_.get(); }
+	// Shown plane of NAXIS=3 cube
+	inline quint64 plane() const { return plane_; }
 
 signals:
 	void pixelViewrectChanged(const QRect& pixel_viewrect);
@@ -102,38 +66,42 @@ signals:
 public slots:
 	void changeLevels(const std::pair<double, double>& minmax);
 	void changeColorMap(int colormap_index);
+	// Stretch is OpenGLShaderUniforms::Stretch
+	void changeStretch(int stretch, double parameter);
+	void setFrameStatisticsVisible(bool visible);
+	// Playback controls, do nothing without a sequence
+	void togglePlayback();
+	void nextSequenceFrame();
+	void previousSequenceFrame();
+	void setSequenceFrameRate(double frame_rate);
+	// Index must be less than the depth of the cube
+	void setPlane(quint64 plane);
+	/* Shows the image of the same shape and BITPIX instead of the current
+	 * one, e.g. the next frame of the watched file */
+	void updateFrame(std::shared_ptr<const Sequence::OpenedFrame> frame);
+
+private slots:
+	void advancePlayback();
+	void notifyFrameSwapped();
+	void notifyFrameReady();
+	void notifyRenderFailed(const QString& reason);
 
 protected:
 	void initializeGL() override;
+	void resizeGL(int w, int h) override;
 	void paintGL() override;
 	QSize sizeHint() const override;
 	void resizeEvent(QResizeEvent* event) override;
 
 private:
 	const FITS::HeaderDataUnit* hdu_;
-	OpenGLDeleter<OpenGLTexture> texture_deleter_;
-	openGL_unique_ptr<OpenGLTexture> texture_;
-	OpenGLDeleter<QOpenGLPixelTransferOptions> pixel_transfer_options_deleter_;
-	openGL_unique_ptr<QOpenGLPixelTransferOptions> pixel_transfer_options_;
-	OpenGLDeleter<QOpenGLShaderProgram> program_deleter_;
-	openGL_unique_ptr<QOpenGLShaderProgram> program_;
+	// Keeps hdu_ mapped after updateFrame()
+	std::shared_ptr<const Sequence::OpenedFrame> frame_;
+	// Owned by the render thread, released in the destructor
+	OpenGLRenderWorker* worker_;
+	// Composites the rendered frame onto the widget
+	std::unique_ptr<QOpenGLShaderProgram> composite_program_;
 	QOpenGLBuffer vbo_;
-	QMatrix4x4 base_mvp_;
-
-	static const int program_vertex_coord_attribute_ = 0;
-	static const int program_vertex_uv_attribute_    = 1;
-	static const int program_texture_uniform_  = 0;
-	static const int program_colormap_uniform_ = 1;
-	// Square which is made from two triangles. Each line is xyz coordinates of triangle vertex (0-2 - first triangle,
-	// 3-5 - second triangle). First and seconds columns are used as corresponding UV-coordinates.
-	static constexpr const GLfloat vbo_data[] = {
-			0.0f, 0.0f, 0.0f,
-			1.0f, 0.0f, 0.0f,
-			0.0f, 1.0f, 0.0f,
-			0.0f, 1.0f, 0.0f,
-			1.0f, 0.0f, 0.0f,
-			1.0f, 1.0f, 0.0f,
-	};
 
 	QRectF viewrect_;
 	QRect pixel_viewrect_;
@@ -141,17 +109,27 @@ private:
 	// Returns true if viewrect has been corrected
 	bool correct_viewrect();
 
-	template<class T> void throwIfGLError() throw(T) {
-		const auto gl_error_code = glGetError();
-		if (gl_error_code) {
-			throw T(gl_error_code);
-		}
-	}
-
-	std::unique_ptr<OpenGLShaderUniforms> shader_uniforms_;
-
+	// Used for colormap names, rendering uses its own references
 	colormaps_type colormaps_;
 	int colormap_index_;
+	bool has_levels_;
+	std::pair<double, double> levels_;
+	OpenGLShaderUniforms::Stretch stretch_;
+	double stretch_parameter_;
+
+	FrameScheduler frame_scheduler_;
+	bool frame_statistics_visible_;
+	bool first_frame_presented_;
+
+	std::unique_ptr<SequencePlayback> playback_;
+	QTimer playback_timer_;
+	int requested_sequence_index_;
+	quint64 plane_;
+
+	OpenGLRenderWorker::State renderState() const;
+	// Posts the current state to the render thread
+	void requestFrame(int dirty);
+	void paintFrameStatistics();
 };
 
 
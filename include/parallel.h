@@ -0,0 +1,65 @@
+#ifndef _PARALLEL_H
+#define _PARALLEL_H
+
+#include <QRunnable>
+#include <QSemaphore>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <atomic>
+
+/* Calls fun(begin, end) for consecutive bands of [0, count) in parallel.
+ *
+ * Bands are taken by the threads of QThreadPool::globalInstance() as well as
+ * by the calling thread, so the call makes progress even when the pool is
+ * busy. Returns when all the bands are done. fun must not throw.
+ */
+template<class F> void parallelFor(int count, int band, F fun) {
+	struct Work {
+		std::atomic<int> next;
+		int count, band;
+		F* fun;
+		QSemaphore done;
+
+		void operator() () {
+			for (int begin = next.fetch_add(band); begin < count; begin = next.fetch_add(band)) {
+				(*fun)(begin, std::min(begin + band, count));
+			}
+		}
+	};
+
+	class Runnable: public QRunnable {
+	private:
+		Work* work_;
+	public:
+		explicit Runnable(Work* work): work_(work) {}
+		virtual void run() override {
+			(*work_)();
+			work_->done.release();
+		}
+	};
+
+	band = std::max(band, 1);
+	Work work;
+	work.next = 0;
+	work.count = count;
+	work.band = band;
+	work.fun = &fun;
+
+	auto pool = QThreadPool::globalInstance();
+	const int helpers = std::min(pool->maxThreadCount(), (count + band - 1) / band - 1);
+	int started = 0;
+	for (int i = 0; i < helpers; ++i) {
+		auto runnable = new Runnable(&work);
+		if (!pool->tryStart(runnable)) {
+			delete runnable;
+			break;
+		}
+		++started;
+	}
+
+	work();
+	work.done.acquire(started);
+}
+
+#endif //_PARALLEL_H
@@ -0,0 +1,13 @@
+#ifndef _PHYSICALVALUES_H
+#define _PHYSICALVALUES_H
+
+#include <fits.h>
+
+/* Converts count raw values of the image HDU starting from offset into
+ * physical ones, honouring BSCALE and BZERO. Offset of a cube may address
+ * any of its planes. 16-bit integer and float images are converted with
+ * SSE2 when it is available, others are computed in double, so 32 and
+ * 64-bit integers keep their precision until the result is rounded. */
+void convertToPhysical(const FITS::HeaderDataUnit& hdu, quint64 offset, quint64 count, float* dst);
+
+#endif //_PHYSICALVALUES_H
@@ -17,7 +17,7 @@ struct ZoomParam {
 class ScrollZoomArea: public QAbstractScrollArea {
 	Q_OBJECT
 public:
-	ScrollZoomArea(QWidget *parent, const FITS::HeaderDataUnit& hdu);
+	ScrollZoomArea(QWidget *parent, const FITS::HeaderDataUnit& hdu, const QString& texture_key = QString(), std::shared_ptr<const OpenGLTexture::Statistics> statistics = std::shared_ptr<const OpenGLTexture::Statistics>(), std::shared_ptr<const Sequence> sequence = std::shared_ptr<const Sequence>());
 
 	void zoomViewport(double zoom_factor);
 	void zoomViewport(const ZoomParam& zoom);
@@ -0,0 +1,85 @@
+#ifndef _SEQUENCE_H
+#define _SEQUENCE_H
+
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+#include <memory>
+#include <vector>
+
+#include <exception.h>
+#include <fits.h>
+
+/* Image sequence, e.g. a time series of frames of the same shape and BITPIX.
+ *
+ * Frames are either the first image HDUs of the files, all the image HDUs
+ * of a single file, or the given HDUs. Files besides the first one are not opened until
+ * their frames are requested, so a sequence of thousands of files is
+ * created instantly.
+ */
+class Sequence {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	class FrameMismatch: public Exception {
+	public:
+		explicit FrameMismatch(const QString& filename);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	struct Frame {
+		QString filename;
+		int hdu_index;  // -1 for the first HDU having image
+		// Of the HDU header when known, e.g. from KeywordIndex, 0 otherwise
+		quint64 offset;
+	};
+
+	/* Compressed and remote files opened for the frame only hold the HDUs
+	 * up to the frame, the viewer needs the whole file */
+	enum Extent {
+		WholeFile,
+		FrameOnly
+	};
+
+	// FITS keeps the file mapped while the frame is in use
+	struct OpenedFrame {
+		std::unique_ptr<FITS> fits;
+		const FITS::HeaderDataUnit* hdu;
+		quint64 hdu_index;
+	};
+private:
+	std::vector<Frame> frames_;
+	OpenedFrame first_;
+	QSize size_;
+	QString bitpix_;
+public:
+	explicit Sequence(const QStringList& filenames);
+	// The frames as given, e.g. HDUs found by KeywordIndex
+	explicit Sequence(const std::vector<Frame>& frames);
+
+	inline int size() const { return static_cast<int>(frames_.size()); }
+	inline const Frame& frame(int index) const { return frames_[index]; }
+	// The first frame is kept opened
+	inline const OpenedFrame& first() const { return first_; }
+
+	/* Opens the frame only, may be called from any thread. Throws
+	 * FrameMismatch when the frame differs from the first one by shape or
+	 * BITPIX. */
+	OpenedFrame open(int index) const;
+
+	static OpenedFrame open(const Frame& frame, Extent extent = WholeFile);
+	/* Finds the HDU of the already opened FITS, e.g. a frame of the
+	 * shared-memory ring, source names it in the errors */
+	static OpenedFrame open(std::unique_ptr<FITS> fits, int hdu_index, const QString& source);
+};
+
+#endif //_SEQUENCE_H
@@ -0,0 +1,58 @@
+#ifndef _SEQUENCEPLAYBACK_H
+#define _SEQUENCEPLAYBACK_H
+
+#include <QString>
+#include <QtGlobal>
+
+/* Clock of image sequence playback.
+ *
+ * The frame to show is derived from the time elapsed since the playback has
+ * been started, so a slow pipeline skips frames instead of slowing the
+ * playback down. Frames which should have been presented between two
+ * presented ones are counted as dropped. The sequence is looped. Time is in
+ * nanoseconds, as Tracer::now() is.
+ */
+class SequencePlayback {
+private:
+	int count_;
+	qint64 frame_interval_;
+	bool playing_;
+	qint64 start_time_;
+	int start_index_;
+	int index_;  // Current frame while paused
+
+	int last_presented_;
+	qint64 first_presented_time_;
+	qint64 last_presented_time_;
+	quint64 session_presented_;  // Frames presented since play()
+	quint64 presented_;
+	quint64 dropped_;
+public:
+	SequencePlayback(int count, double frame_rate);
+
+	inline int count() const { return count_; }
+	inline bool isPlaying() const { return playing_; }
+	inline double targetFrameRate() const { return 1e9 / frame_interval_; }
+	void setFrameRate(double frame_rate, qint64 now);
+
+	void play(qint64 now);
+	void pause(qint64 now);
+	// Moves by delta frames and pauses
+	void step(int delta, qint64 now);
+	// Frame to be shown at the time
+	int index(qint64 now) const;
+	// Nanoseconds until the frame following the one shown at the time
+	qint64 timeToNextFrame(qint64 now) const;
+
+	// Called when the frame is on the screen
+	void presented(int index, qint64 now);
+
+	inline quint64 presented() const { return presented_; }
+	inline quint64 dropped() const { return dropped_; }
+	// Presented frames per second since play()
+	double sustainedFrameRate() const;
+
+	QString summary(qint64 now) const;
+};
+
+#endif //_SEQUENCEPLAYBACK_H
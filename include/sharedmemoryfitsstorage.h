@@ -0,0 +1,23 @@
+#ifndef _SHAREDMEMORYFITSSTORAGE_H_
+#define _SHAREDMEMORYFITSSTORAGE_H_
+
+#include <memory>
+
+#include <abstractfitsstorage.h>
+#include <sharedmemoryring.h>
+
+/* Storage of the frame pinned in a slot of the shared-memory ring, the
+ * frame is read in place and the slot is unpinned by the destructor. */
+class SharedMemoryFITSStorage: public AbstractFITSStorage {
+private:
+	std::shared_ptr<SharedMemoryRing> ring_;
+	int hold_;
+	quint64 sequence_;
+public:
+	SharedMemoryFITSStorage(std::shared_ptr<SharedMemoryRing> ring, int hold, quint64 sequence, quint8* data, qint64 size);
+	virtual ~SharedMemoryFITSStorage() override;
+
+	inline quint64 sequence() const { return sequence_; }
+};
+
+#endif // _SHAREDMEMORYFITSSTORAGE_H_
@@ -0,0 +1,107 @@
+#ifndef _SHAREDMEMORYRING_H_
+#define _SHAREDMEMORYRING_H_
+
+#include <QString>
+
+#include <atomic>
+#include <memory>
+
+#include <exception.h>
+
+class SharedMemoryFITSStorage;
+
+/* Ring buffer of FITS frames in POSIX shared memory, filled by a producer
+ * process, e.g. camera software, and shown by the viewer without copying.
+ *
+ * The segment starts with a control page followed by slot_count slots of
+ * slot_size bytes, every slot holds a single FITS file. Handoff is lock-free:
+ * the producer marks the slot being written by odd state, publishes the
+ * complete frame by even state and then by the latest counter, which packs
+ * the sequence number of the frame and its slot. The viewer pins the slot of
+ * the latest frame in one of the hold registers, and the producer never
+ * writes into the pinned slots, so the frames in between are skipped rather
+ * than waited for.
+ */
+class SharedMemoryRing: public std::enable_shared_from_this<SharedMemoryRing> {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	static const quint32 version = 1;
+	static const quint32 max_slot_count = 64;
+	// Frames pinned by the viewers at the same time
+	static const int hold_count = 4;
+	static const quint64 control_size = 4096;
+private:
+	struct Slot {
+		// 2 * sequence of the complete frame, odd while it is written, 0 if empty
+		std::atomic<quint64> state;
+		quint64 size;
+	};
+
+	struct Control {
+		char magic[8];
+		quint32 version;
+		quint32 slot_count;
+		quint64 slot_size;
+		// (sequence << 8) | slot of the latest complete frame, 0 before the first one
+		std::atomic<quint64> latest;
+		// Pinned slot, free_hold or reserved_hold
+		std::atomic<quint32> holds[hold_count];
+		Slot slots[max_slot_count];
+	};
+
+	static const quint32 free_hold = 0xffffffff;
+	static const quint32 reserved_hold = 0xfffffffe;
+
+	QString name_;
+	bool producer_;
+	quint8* data_;
+	quint64 size_;
+	Control* control_;
+
+	// Producer state
+	quint64 next_sequence_;
+	quint32 next_slot_;
+	quint32 writing_slot_;
+
+	SharedMemoryRing(const QString& name, bool producer);
+	void map(int fd, quint64 size);
+	bool isHeld(quint32 slot) const;
+public:
+	~SharedMemoryRing();
+
+	/* Creates the segment for the producer, replacing the existing one.
+	 * There must be more slots than hold registers plus one for the latest
+	 * frame. */
+	static std::shared_ptr<SharedMemoryRing> create(const QString& name, quint32 slot_count, quint64 slot_size);
+	// Opens the segment created by the producer
+	static std::shared_ptr<SharedMemoryRing> open(const QString& name);
+	// Removes the name of the segment, mappings stay valid
+	static void unlink(const QString& name);
+
+	inline const QString& name() const { return name_; }
+	inline quint32 slotCount() const { return control_->slot_count; }
+	inline quint64 slotSize() const { return control_->slot_size; }
+
+	// Producer side: slot to write the next frame into, slotSize() bytes
+	quint8* beginFrame();
+	// Publishes the frame written into the slot returned by beginFrame()
+	quint64 publishFrame(quint64 size);
+
+	// Sequence number of the latest complete frame, 0 if there is none
+	quint64 latestSequence() const;
+	/* Pins the latest complete frame, its sequence number is stored into
+	 * sequence. Returns null if there is no frame yet or all the hold
+	 * registers are taken. */
+	std::unique_ptr<SharedMemoryFITSStorage> acquireLatest(quint64* sequence = Q_NULLPTR);
+	// Unpins the frame, called by the storage
+	void release(int hold);
+};
+
+#endif // _SHAREDMEMORYRING_H_
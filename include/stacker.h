@@ -0,0 +1,77 @@
+#ifndef _STACKER_H
+#define _STACKER_H
+
+#include <QSize>
+#include <QString>
+
+#include <memory>
+#include <vector>
+
+#include <exception.h>
+#include <fits.h>
+
+/* Combines image HDUs of the same shape pixel by pixel.
+ *
+ * The frames are streamed in bands of rows straight from their data units,
+ * every band is converted into physical values, honouring BSCALE and
+ * BZERO, and combined in parallel with the other bands, so the memory use
+ * does not depend on the number of rows. NaN values are ignored, pixels
+ * having no values left are NaN.
+ */
+class Stacker {
+public:
+	class Exception: public ::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	class ShapeMismatch: public Exception {
+	public:
+		explicit ShapeMismatch(int index);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	enum Method {
+		MeanMethod,
+		MedianMethod,
+		SigmaClipMethod,  // Mean of the values within sigma deviations from the mean
+		MethodCount
+	};
+
+	struct Options {
+		Method method;
+		double sigma;
+		int iterations;  // Maximum number of the clipping iterations
+
+		Options();
+	};
+
+	// Bytes of the converted values of a single band
+	static const int band_budget = 4 << 20;
+private:
+	std::vector<const FITS::HeaderDataUnit*> hdus_;
+	int width_;
+	int height_;
+public:
+	// Throws ShapeMismatch when the images differ by shape
+	explicit Stacker(const std::vector<const FITS::HeaderDataUnit*>& hdus);
+
+	inline int count() const { return static_cast<int>(hdus_.size()); }
+	inline QSize size() const { return QSize(width_, height_); }
+
+	// Physical values row by row starting from the first FITS row
+	std::vector<float> stack(const Options& options) const;
+	// Stacked image as in-memory FITS
+	std::unique_ptr<FITS> stackToFITS(const Options& options) const;
+
+	static const char* methodName(Method method);
+	// Returns MethodCount for unknown name
+	static Method methodFromName(const QString& name);
+};
+
+#endif //_STACKER_H
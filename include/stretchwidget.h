@@ -0,0 +1,34 @@
+#ifndef _STRETCHWIDGET_H
+#define _STRETCHWIDGET_H
+
+#include <QButtonGroup>
+#include <QDoubleSpinBox>
+#include <QRadioButton>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include <memory>
+
+#include <openglshaderunifroms.h>
+#include <openglwidget.h>
+
+/* Selection of the stretch and its parameter. Changing the stretch resets
+ * the parameter to its default value. */
+class StretchWidget: public QWidget {
+	Q_OBJECT
+private:
+	std::unique_ptr<QButtonGroup> button_group_;
+	std::unique_ptr<QDoubleSpinBox> parameter_;
+
+public:
+	StretchWidget(QWidget* parent, const OpenGLWidget& open_gl_widget);
+
+signals:
+	void stretchChanged(int stretch, double parameter);
+
+private slots:
+	void notifyButtonClicked(int stretch);
+	void notifyParameterChanged(double parameter);
+};
+
+#endif //_STRETCHWIDGET_H
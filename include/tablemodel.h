@@ -0,0 +1,29 @@
+#ifndef _TABLEMODEL_H
+#define _TABLEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QModelIndex>
+#include <QVariant>
+
+#include <memory>
+
+#include <fits.h>
+
+/* Model of a binary table HDU. Nothing is decoded in advance: the views ask
+ * for the cells they show, so only the visible rows of a table of millions
+ * of rows are ever formatted. The HDU is kept alive by the model. */
+class TableModel: public QAbstractTableModel {
+	Q_OBJECT
+private:
+	std::shared_ptr<const FITS::HeaderDataUnit> hdu_;
+	const FITS::TableDataUnit* table_;
+public:
+	TableModel(std::shared_ptr<const FITS::HeaderDataUnit> hdu, QObject* parent = Q_NULLPTR);
+
+	virtual int rowCount(const QModelIndex& parent = QModelIndex()) const override;
+	virtual int columnCount(const QModelIndex& parent = QModelIndex()) const override;
+	virtual QVariant data(const QModelIndex& index, int role = Qt::DisplayRole) const override;
+	virtual QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+};
+
+#endif //_TABLEMODEL_H
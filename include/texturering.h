@@ -0,0 +1,65 @@
+#ifndef _TEXTURERING_H
+#define _TEXTURERING_H
+
+#include <QMutex>
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <set>
+#include <vector>
+
+#include <opengltexture.h>
+#include <sequence.h>
+
+/* Textures of the sequence frames following the shown one.
+ *
+ * Frames are opened and scanned on QThreadPool::globalInstance(), and then
+ * uploaded in the render thread by stage(), so the render thread never
+ * waits for the disk or the scans. At most capacity frames around the
+ * requested one are kept uploaded or being prepared. The ring must be used
+ * and deleted with a context of the share group current.
+ */
+class TextureRing {
+public:
+	struct Entry {
+		Sequence::OpenedFrame frame;
+		std::shared_ptr<OpenGLTexture> texture;
+	};
+private:
+	// Shared with the jobs, which may outlive the ring
+	struct Shared {
+		QMutex mutex;
+		bool cancelled;
+		std::function<void()> notify;
+		std::vector<std::pair<int, std::shared_ptr<Entry>>> prepared;
+		std::vector<int> failed;
+	};
+
+	class Job;
+
+	std::shared_ptr<const Sequence> sequence_;
+	int capacity_;
+	std::shared_ptr<Shared> shared_;
+	std::map<int, std::shared_ptr<Entry>> entries_;
+	std::set<int> window_;
+	std::set<int> pending_;
+	std::set<int> failed_;
+public:
+	/* notify is called from a pool thread when a prepared frame is ready to
+	 * be staged */
+	TextureRing(std::shared_ptr<const Sequence> sequence, int capacity, std::function<void()> notify);
+	~TextureRing();
+
+	/* Makes the window of the frames starting from index in the direction,
+	 * which is 1 or -1. Frames out of the window are released and the
+	 * missed ones are scheduled for preparation. */
+	void prefetch(int index, int direction);
+	// Uploads the prepared frames, returns the number of uploaded ones
+	int stage();
+	/* Uploaded frame or null. The entry may be kept after it is released by
+	 * the ring, it holds the file opened. */
+	std::shared_ptr<const Entry> frame(int index) const;
+};
+
+#endif //_TEXTURERING_H
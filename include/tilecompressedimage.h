@@ -0,0 +1,104 @@
+#ifndef _TILECOMPRESSEDIMAGE_H_
+#define _TILECOMPRESSEDIMAGE_H_
+
+#include <QString>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <exception.h>
+#include <fits.h>
+
+/* Image stored in a binary table extension with ZIMAGE = T by the tiled
+ * image compression convention, as fpack and CFITSIO write it. Every row of
+ * the table holds one tile compressed by RICE_1, GZIP_1, GZIP_2, HCOMPRESS_1
+ * or NOCOMPRESS, floating point images are quantized to integers with
+ * optional subtractive dithering.
+ *
+ * The table is only validated at construction. The tiles are decoded on the
+ * first access of data(), in parallel, into big-endian pixels of ZBITPIX as
+ * they would be stored in an image HDU. A tile which fails to decode is
+ * left zeroed with a warning.
+ */
+class TileCompressedImage: public FITS::DeferredData {
+public:
+	class Exception: public FITS::Exception {
+	public:
+		explicit Exception(const QString& what);
+
+		virtual void raise() const override;
+		virtual QException* clone() const override;
+	};
+
+	enum class Compression { Rice, Gzip1, Gzip2, Hcompress, None };
+	enum class Quantization { None, NoDither, SubtractiveDither1, SubtractiveDither2 };
+private:
+	struct Column {
+		int offset;  // Offset in the row, -1 if absent
+		char type;  // TFORM data type
+		char element;  // Element type of variable-length array
+	};
+
+	const quint8* table_;
+	const quint8* heap_;
+	quint64 heap_size_;
+	quint64 row_length_;
+
+	Compression compression_;
+	Quantization quantization_;
+	int bitpix_;
+	// ZNAXISn and ZTILEn, of three axes for both images and cubes
+	quint64 axes_[3];
+	quint64 tile_[3];
+	quint64 tiles_[3];  // Number of the tiles along the axes
+
+	Column compressed_data_;
+	Column gzip_compressed_data_;
+	Column uncompressed_data_;
+	Column zscale_;
+	Column zzero_;
+	Column zblank_;
+	double scale_;
+	double zero_;
+	bool has_blank_;
+	qint64 blank_;
+	qint64 dither_seed_;
+	int block_size_;
+	int bytepix_;
+
+	mutable std::once_flag decoded_;
+	mutable std::unique_ptr<quint8[]> data_;
+
+	const quint8* heapData(const Column& column, quint64 row, quint64* size) const;
+	double doubleValue(const Column& column, quint64 row, double def) const;
+	std::vector<qint64> decompress(const quint8* data, quint64 size, quint64 pixels) const;
+	quint64 tileSize(quint64 row, quint64* origin, quint64* extent) const;
+	void store(quint64 row, const std::vector<qint64>& values, quint8* tile) const;
+public:
+	// table points to the data of the extension, which has extent bytes
+	TileCompressedImage(const FITS::HeaderUnit& header, const quint8* table, quint64 extent);
+	virtual ~TileCompressedImage() override;
+
+	inline int bitpix() const { return bitpix_; }
+	inline quint64 width()  const { return axes_[0]; }
+	inline quint64 height() const { return axes_[1]; }
+	inline quint64 depth()  const { return axes_[2]; }
+	inline Compression compression() const { return compression_; }
+	inline Quantization quantization() const { return quantization_; }
+	inline quint64 tileCount() const { return tiles_[0] * tiles_[1] * tiles_[2]; }
+	// Bytes of the decoded image
+	quint64 length() const;
+
+	// Decodes the tile, the row of the table, into its place in image
+	void decodeTile(quint64 row, quint8* image) const;
+	virtual const quint8* data() const override;
+
+	// The header describes a tile-compressed image
+	static bool isTileCompressed(const FITS::HeaderUnit& header);
+	/* Header of the image as if it was not compressed: ZBITPIX, ZNAXIS etc.
+	 * replace the keywords of the table. */
+	static std::map<QString, QString> imageHeaders(const FITS::HeaderUnit& header);
+};
+
+#endif // _TILECOMPRESSEDIMAGE_H_
@@ -0,0 +1,80 @@
+#ifndef _TRACER_H
+#define _TRACER_H
+
+#include <QElapsedTimer>
+#include <QIODevice>
+#include <QMutex>
+
+#include <atomic>
+#include <vector>
+
+/* Process-wide recorder of timed events.
+ *
+ * Tracer records from the very first call to instance() so startup is
+ * covered before command line is parsed. Application disables it when no
+ * trace has been requested, that also drops the events recorded so far.
+ * Names and categories must be string literals, only pointers are stored.
+ */
+class Tracer {
+public:
+	struct Event {
+		const char* name;
+		const char* category;
+		qint64 begin;     // Nanoseconds since Tracer creation
+		qint64 duration;  // Nanoseconds
+		quint64 thread_id;
+	};
+
+	class Scope {
+	private:
+		const char* name_;
+		const char* category_;
+		qint64 begin_;
+	public:
+		Scope(const char* name, const char* category);
+		~Scope();
+	};
+
+	// Pseudo thread id of the events measured on GPU
+	static const quint64 gpu_thread_id = 0;
+private:
+	// Protection against unbounded growth in long sessions
+	static const std::size_t max_events = 1 << 20;
+
+	QElapsedTimer timer_;
+	std::atomic<bool> enabled_;
+	mutable QMutex mutex_;
+	std::vector<Event> events_;
+	quint64 dropped_events_;
+
+	Tracer();
+
+	struct Span {
+		Event event;
+		int depth;
+	};
+	std::vector<Span> spans(qint64 until) const;
+public:
+	static Tracer& instance();
+
+	inline bool isEnabled() const { return enabled_.load(std::memory_order_relaxed); }
+	// Disabling drops all the recorded events
+	void setEnabled(bool enabled);
+
+	inline qint64 now() const { return timer_.nsecsElapsed(); }
+	static quint64 currentThreadId();
+
+	void addEvent(const char* name, const char* category, qint64 begin, qint64 duration, quint64 thread_id = currentThreadId());
+	std::vector<Event> events() const;
+
+	/* Writes the events in Chrome trace event format, see
+	 * https://docs.google.com/document/d/1CvAClvFfyA5R-PhYUmn5OOQtYMH4h6I0nSsKchNAySU */
+	bool writeChromeTrace(QIODevice* device) const;
+	/* Write the events started before the moment as a table or as JSON.
+	 * Nested spans of the same thread are indented in the table and have
+	 * greater depth in JSON. */
+	bool writeSummary(QIODevice* device, qint64 until) const;
+	bool writeJSON(QIODevice* device, qint64 until) const;
+};
+
+#endif //_TRACER_H
@@ -0,0 +1,55 @@
+#ifndef _TRIPLEBUFFER_H
+#define _TRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+
+/* Lock-free single-producer single-consumer mailbox holding the latest value.
+ *
+ * Producer fills writeSlot() and publishes it, consumer fetches the latest
+ * published slot and reads it through readSlot(). Three slots are rotated,
+ * so the producer and the consumer never touch the same slot and neither of
+ * them ever waits. Values published in between two fetches are overwritten,
+ * only the latest one is seen by the consumer. Slots are reused, so the
+ * producer has to fill the write slot completely every time.
+ */
+template<class T> class TripleBuffer {
+private:
+	// Set in middle_ when the middle slot holds a value not fetched yet
+	static const int fresh_flag = 4;
+
+	std::array<T, 3> slots_;
+	std::atomic<int> middle_;
+	int write_;  // Owned by the producer
+	int read_;   // Owned by the consumer
+public:
+	TripleBuffer():
+		middle_(1),
+		write_(0),
+		read_(2) {
+	}
+	TripleBuffer(const TripleBuffer&) = delete;
+	TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+	// Producer side
+	inline T& writeSlot() { return slots_[write_]; }
+	void publish() {
+		write_ = middle_.exchange(write_ | fresh_flag, std::memory_order_acq_rel) & ~fresh_flag;
+	}
+
+	// Consumer side, returns false when nothing new has been published
+	bool fetch() {
+		if (!(middle_.load(std::memory_order_relaxed) & fresh_flag))
+			return false;
+
+		read_ = middle_.exchange(read_, std::memory_order_acq_rel) & ~fresh_flag;
+		return true;
+	}
+	inline T& readSlot() { return slots_[read_]; }
+	inline const T& readSlot() const { return slots_[read_]; }
+
+	// Requires both sides to be idle, e.g. to release the slots
+	inline std::array<T, 3>& allSlots() { return slots_; }
+};
+
+#endif //_TRIPLEBUFFER_H
@@ -1,38 +1,309 @@
 #include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
 #include <QFileDialog>
+#include <QInputDialog>
 #include <QMessageBox>
 #include <QTimer>
 #include <QWindow>
 
+#include <map>
+#include <utility>
+#include <vector>
+
 #include <application.h>
+#include <fits.h>
+#include <httpfitsstorage.h>
 #include <instance.h>
+#include <keywordindex.h>
 #include <mainwindow.h>
+#include <tracer.h>
 
 Application::Application(int &argc, char **argv):
-	QApplication(argc, argv) {
+	QApplication(argc, argv),
+	first_frame_swapped_(false) {
+
+	// Tracer has been started at the beginning of main()
+	Tracer::instance().addEvent("Qt init", "startup", 0, Tracer::instance().now());
 
 	QCommandLineParser parser;
 	parser.addHelpOption();
-	parser.addPositionalArgument("file", QCoreApplication::translate("main", "The file to open."));
+	parser.addPositionalArgument("file", QCoreApplication::translate("main", "The file or http(s) URL to open."));
+	QCommandLineOption trace_option("trace",
+		QCoreApplication::translate("main", "Write Chrome trace of startup and rendered frames to <file>."),
+		QCoreApplication::translate("main", "file"));
+	parser.addOption(trace_option);
+	QCommandLineOption startup_profile_option("startup-profile",
+		QCoreApplication::translate("main", "Print time spent in startup stages until the first frame, <format> is table or json."),
+		QCoreApplication::translate("main", "format"));
+	parser.addOption(startup_profile_option);
+	QCommandLineOption sequence_option("sequence",
+		QCoreApplication::translate("main", "Play the files back as frames of a single sequence, or the image HDUs of a single file."));
+	parser.addOption(sequence_option);
+	QCommandLineOption fps_option("fps",
+		QCoreApplication::translate("main", "Sequence playback frame rate, 25 by default."),
+		QCoreApplication::translate("main", "rate"),
+		"25");
+	parser.addOption(fps_option);
+	QCommandLineOption watch_option("watch",
+		QCoreApplication::translate("main", "Watch the file, or the newest FITS file of the directory, and show the frames as they are written."));
+	parser.addOption(watch_option);
+	QCommandLineOption shm_option("shm",
+		QCoreApplication::translate("main", "Show the latest frames of the shared-memory ring <name> filled by camera software, see fips-shm-producer."),
+		QCoreApplication::translate("main", "name"));
+	parser.addOption(shm_option);
+	QCommandLineOption index_option("index",
+		QCoreApplication::translate("main", "Play back the image HDUs of the directory tree satisfying the --where conditions, found by its keyword index, see fips-index."),
+		QCoreApplication::translate("main", "directory"));
+	parser.addOption(index_option);
+	QCommandLineOption where_option("where",
+		QCoreApplication::translate("main", "Condition on the header keywords for --index, e.g. FILTER=R or EXPTIME>60, may be given many times."),
+		QCoreApplication::translate("main", "condition"));
+	parser.addOption(where_option);
+	QCommandLineOption cache_size_option("cache-size",
+		QCoreApplication::translate("main", "Total size in MiB of the files kept opened for the next/previous file browsing, 512 by default."),
+		QCoreApplication::translate("main", "size"),
+		QString::number(FITSCache::default_budget >> 20));
+	parser.addOption(cache_size_option);
+	QCommandLineOption stack_option("stack",
+		QCoreApplication::translate("main", "Stack the files and show the result, <method> is mean, median or sigma-clip."),
+		QCoreApplication::translate("main", "method"));
+	parser.addOption(stack_option);
+	QCommandLineOption bias_option("bias",
+		QCoreApplication::translate("main", "Calibrate the files by master bias <file>."),
+		QCoreApplication::translate("main", "file"));
+	parser.addOption(bias_option);
+	QCommandLineOption dark_option("dark",
+		QCoreApplication::translate("main", "Calibrate the files by master dark <file>, scaled by the exposures."),
+		QCoreApplication::translate("main", "file"));
+	parser.addOption(dark_option);
+	QCommandLineOption flat_option("flat",
+		QCoreApplication::translate("main", "Calibrate the files by master flat <file>."),
+		QCoreApplication::translate("main", "file"));
+	parser.addOption(flat_option);
 	parser.process(*this);
 
+	bool cache_size_ok = false;
+	const qint64 cache_size = parser.value(cache_size_option).toLongLong(&cache_size_ok);
+	if (!cache_size_ok || cache_size < 0)
+		parser.showHelp(1);
+	fits_cache_.setBudget(cache_size << 20);
+
+	trace_filename_ = parser.value(trace_option);
+	startup_profile_format_ = parser.value(startup_profile_option);
+	if (!startup_profile_format_.isEmpty() && startup_profile_format_ != "table" && startup_profile_format_ != "json") {
+		qWarning() << "Unknown startup profile format" << startup_profile_format_ << ", using table";
+		startup_profile_format_ = "table";
+	}
+	Tracer::instance().setEnabled(!trace_filename_.isEmpty() || !startup_profile_format_.isEmpty());
+
+	Calibrator::Masters masters;
+	masters.bias = parser.value(bias_option);
+	masters.dark = parser.value(dark_option);
+	masters.flat = parser.value(flat_option);
+	if (!masters.isEmpty()) {
+		try {
+			calibrator_.reset(new Calibrator(masters));
+		} catch (const std::exception& e) {
+			// Raw frames shown as calibrated would mislead, so nothing is opened
+			QMessageBox::critical(Q_NULLPTR, "An error occured", QString("%1\n\nNo files are opened.").arg(e.what()));
+			throw;
+		}
+	}
+
 	const QStringList args = parser.positionalArguments();
 
-	if (args.length() == 0) {
+	if (parser.isSet(shm_option)) {
+		addRingInstance(parser.value(shm_option));
+	} else if (parser.isSet(index_option)) {
+		bool ok = false;
+		const double frame_rate = parser.value(fps_option).toDouble(&ok);
+		if (!ok || frame_rate <= 0)
+			parser.showHelp(1);
+		addQueryInstances(parser.value(index_option), parser.values(where_option), frame_rate);
+	} else if (args.length() == 0) {
 #ifdef Q_OS_MAC
 		QTimer::singleShot(0, this, [this] () { if (root_.children().length() == 0) openFile(); });
 #else
 		openFile();
 #endif // Q_OS_MAC
+	} else if (parser.isSet(stack_option)) {
+		Stacker::Options options;
+		options.method = Stacker::methodFromName(parser.value(stack_option));
+		if (options.method == Stacker::MethodCount)
+			parser.showHelp(1);
+		addStackInstance(args, options);
+	} else if (parser.isSet(sequence_option)) {
+		bool ok = false;
+		const double frame_rate = parser.value(fps_option).toDouble(&ok);
+		if (!ok || frame_rate <= 0)
+			parser.showHelp(1);
+		addSequenceInstance(args, frame_rate);
+	} else if (parser.isSet(watch_option)) {
+		for (const auto& x: args) addWatchInstance(x);
 	} else {
 		for (const auto& x: args) addInstance(x);
 	}
 
 }
-Application::~Application() = default;
+Application::~Application() {
+	if (trace_filename_.isEmpty())
+		return;
+
+	QFile file(trace_filename_);
+	if (!file.open(QIODevice::WriteOnly) || !Tracer::instance().writeChromeTrace(&file)) {
+		qWarning() << "Cannot write trace to" << trace_filename_;
+	}
+}
+
+OpenGLRenderThread& Application::renderThread() {
+	if (!render_thread_)
+		render_thread_.reset(new OpenGLRenderThread);
+
+	return *render_thread_;
+}
+
+void Application::notifyFirstFrameSwapped() {
+	if (first_frame_swapped_)
+		return;
+	first_frame_swapped_ = true;
+
+	auto& tracer = Tracer::instance();
+	const auto now = tracer.now();
+	tracer.addEvent("open to first frame", "startup", 0, now);
+
+	if (startup_profile_format_.isEmpty())
+		return;
+
+	QFile output;
+	output.open(stdout, QIODevice::WriteOnly);
+	if (startup_profile_format_ == "json") {
+		tracer.writeJSON(&output, now + 1);
+	} else {
+		tracer.writeSummary(&output, now + 1);
+	}
+
+	// Stop collecting per-frame events when they are not going to be written
+	if (trace_filename_.isEmpty())
+		tracer.setEnabled(false);
+}
+
+QStringList Application::directoryFiles(const QString& filename) {
+	// Remote files have no neighbours to browse
+	if (HttpFITSStorage::isUrl(filename))
+		return QStringList();
+
+	const QFileInfo info(filename);
+	const auto entries = info.absoluteDir().entryInfoList(FITS::nameFilters(), QDir::Files | QDir::Readable, QDir::Name | QDir::IgnoreCase);
+
+	QStringList files;
+	for (const auto& x: entries) {
+		files << x.absoluteFilePath();
+	}
+	return files;
+}
 
 void Application::addInstance(const QString& filename) {
-	new Instance(&root_, filename);
+	if (!calibrator_) {
+		new Instance(&root_, filename);
+		return;
+	}
+
+	const QFileInfo info(filename);
+	addImageInstance(calibrator_->calibrated(info.absoluteFilePath()), info.fileName() + tr(" (calibrated)"));
+}
+
+void Application::addSequenceInstance(const QStringList& filenames, double frame_rate) {
+	new Instance(&root_, filenames, frame_rate);
+}
+
+void Application::addQueryInstances(const QString& directory, const QStringList& conditions, double frame_rate) {
+	Tracer::Scope trace_scope("index query", "startup");
+
+	// Only the files added or changed since the last run are read
+	KeywordIndex index(directory);
+	const auto statistics = index.update(FITS::nameFilters());
+	for (const auto& error: statistics.errors) {
+		qWarning().noquote() << error;
+	}
+
+	// Frames of the same shape and BITPIX in the order of the index
+	std::vector<std::vector<Sequence::Frame>> sequences;
+	std::map<std::pair<int, std::vector<quint64>>, std::size_t> sequence_indices;
+	for (const auto& match: index.query(HeaderQuery(conditions))) {
+		if (!match.hdu->image)
+			continue;
+
+		// The offset of the file changed since the indexing may be wrong
+		const bool unchanged = match.file->isUnchanged(QFileInfo(match.filename));
+		const auto key = std::make_pair(match.hdu->bitpix, std::vector<quint64>(match.hdu->shape.begin(), match.hdu->shape.begin() + 2));
+		auto it = sequence_indices.find(key);
+		if (it == sequence_indices.end()) {
+			it = sequence_indices.emplace(key, sequences.size()).first;
+			sequences.emplace_back();
+		}
+		sequences[it->second].push_back(Sequence::Frame{match.filename, match.hdu_index, (unchanged ? match.hdu->offset : 0)});
+	}
+
+	if (sequences.empty())
+		throw KeywordIndex::Exception(directory + ": no image HDUs satisfy the conditions");
+
+	for (const auto& frames: sequences) {
+		new Instance(&root_, std::make_shared<const Sequence>(frames), frame_rate);
+	}
+}
+
+void Application::addWatchInstance(const QString& path) {
+	new Instance(&root_, std::unique_ptr<FrameWatcher>(new FrameWatcher(path)));
+}
+
+void Application::addRingInstance(const QString& name) {
+	new Instance(&root_, SharedMemoryRing::open(name));
+}
+
+void Application::addImageInstance(std::shared_ptr<const FITS> fits, const QString& title) {
+	new Instance(&root_, std::move(fits), title);
+}
+
+void Application::addStackInstance(const QStringList& filenames, const Stacker::Options& options) {
+	Tracer::Scope trace_scope("stack files", "processing");
+
+	std::vector<Sequence::OpenedFrame> frames;
+	std::vector<const FITS::HeaderDataUnit*> hdus;
+	for (const auto& x: filenames) {
+		frames.push_back(Sequence::open(Sequence::Frame{x, -1}));
+		hdus.push_back(frames.back().hdu);
+	}
+
+	auto fits = Stacker(hdus).stackToFITS(options);
+	const auto title = tr("%1 of %2 frames").arg(Stacker::methodName(options.method)).arg(filenames.size());
+	addImageInstance(std::move(fits), title);
+}
+
+void Application::stackFiles() {
+	const auto filenames = QFileDialog::getOpenFileNames(Q_NULLPTR, tr("Stack FITS files"));
+	if (filenames.isEmpty()) return;
+
+	QStringList methods;
+	for (int i = 0; i < Stacker::MethodCount; ++i) {
+		methods << Stacker::methodName(static_cast<Stacker::Method>(i));
+	}
+	bool ok = false;
+	const auto method = QInputDialog::getItem(Q_NULLPTR, tr("Stack FITS files"), tr("Method:"), methods, 0, false, &ok);
+	if (!ok) return;
+
+	Stacker::Options options;
+	options.method = Stacker::methodFromName(method);
+
+	QApplication::setOverrideCursor(Qt::WaitCursor);
+	try {
+		Application::instance()->addStackInstance(filenames, options);
+	} catch (const std::exception& e) {
+		QMessageBox::critical(Q_NULLPTR, "An error occured", e.what());
+	}
+	QApplication::restoreOverrideCursor();
 }
 
 void Application::openFile() {
@@ -0,0 +1,240 @@
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QOpenGLContext>
+
+#include <batchrenderer.h>
+#include <cpurenderer.h>
+#include <gzipfitsstorage.h>
+#include <openglrenderer.h>
+#include <tracer.h>
+
+BatchRenderer::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void BatchRenderer::Exception::raise() const {
+	throw *this;
+}
+QException* BatchRenderer::Exception::clone() const {
+	return new BatchRenderer::Exception(*this);
+}
+
+BatchRenderer::NoImageInFITS::NoImageInFITS():
+	BatchRenderer::Exception("The file has no image content") {
+}
+void BatchRenderer::NoImageInFITS::raise() const {
+	throw *this;
+}
+QException* BatchRenderer::NoImageInFITS::clone() const {
+	return new BatchRenderer::NoImageInFITS(*this);
+}
+
+BatchRenderer::Options::Options():
+	hdu_index(-1),
+	has_levels(false),
+	levels(0, 0),
+	colormap_index(0),
+	stretch(OpenGLShaderUniforms::LinearStretch),
+	stretch_parameter(0),
+	output_directory("."),
+	format("png"),
+	jobs(1),
+	software(false) {
+}
+
+BatchRenderer::Job::Job(BatchRenderer* batch_renderer, QOffscreenSurface* surface):
+	batch_renderer_(batch_renderer),
+	surface_(surface) {
+}
+
+void BatchRenderer::Job::renderFiles(JobResources* resources) {
+	for (int index = batch_renderer_->next_file_++; index < batch_renderer_->filenames_.size(); index = batch_renderer_->next_file_++) {
+		const auto& filename = batch_renderer_->filenames_[index];
+		try {
+			batch_renderer_->renderFile(filename, resources);
+			++batch_renderer_->rendered_;
+		} catch (const std::exception& e) {
+			qWarning() << filename << ":" << e.what();
+			++batch_renderer_->failed_;
+		}
+	}
+}
+
+void BatchRenderer::Job::run() {
+	if (!surface_) {
+		renderFiles(Q_NULLPTR);
+		return;
+	}
+
+	QOpenGLContext context;
+	context.setFormat(surface_->format());
+	context.setShareContext(QOpenGLContext::globalShareContext());
+	if (!context.create() || !context.makeCurrent(surface_)) {
+		qWarning() << "Cannot create OpenGL context";
+		return;
+	}
+
+	{
+		// Resources are released before the context
+		JobResources resources;
+		renderFiles(&resources);
+	}
+
+	context.doneCurrent();
+}
+
+BatchRenderer::BatchRenderer(const Options& options):
+	options_(options),
+	next_file_(0),
+	rendered_(0),
+	failed_(0) {
+}
+
+const FITS::HeaderDataUnit& BatchRenderer::selectHDU(const FITS& fits, int hdu_index) {
+	const FITS::HeaderDataUnit* hdu = &fits.primary_hdu();
+	int index = 0;
+
+	for (auto it = fits.begin(); it != fits.end(); ++it, ++index) {
+		if (hdu_index < 0 ? hdu->data().imageDataUnit() : index == hdu_index)
+			break;
+		hdu = &(*it);
+	}
+
+	if ((hdu_index >= 0 && index != hdu_index) || !hdu->data().imageDataUnit())
+		throw NoImageInFITS();
+
+	return *hdu;
+}
+
+QString BatchRenderer::outputFilename(const QString& filename) const {
+	// Compressed x.fits.gz and x.fits.fz give x too
+	auto name = QFileInfo(filename).fileName();
+	if (name.endsWith(".gz", Qt::CaseInsensitive) || name.endsWith(".fz", Qt::CaseInsensitive))
+		name.chop(3);
+	return QDir(options_.output_directory).filePath(QFileInfo(name).completeBaseName() + "." + options_.format);
+}
+
+QSize BatchRenderer::outputSize(const QSize& requested_size, const QSize& image_size) {
+	const int width  = requested_size.width();
+	const int height = requested_size.height();
+
+	if (width > 0 && height > 0)
+		return requested_size;
+	if (width > 0)
+		return QSize(width, qMax(1, qRound(static_cast<double>(width) * image_size.height() / image_size.width())));
+	if (height > 0)
+		return QSize(qMax(1, qRound(static_cast<double>(height) * image_size.width() / image_size.height())), height);
+
+	return image_size;
+}
+
+void BatchRenderer::renderFile(const QString& filename, JobResources* resources) {
+	Tracer::Scope trace_scope("render file", "batch");
+
+	std::unique_ptr<QFile> file{new QFile(filename)};
+	if (!file->open(QIODevice::ReadOnly))
+		throw Exception(file->errorString());
+
+	std::unique_ptr<FITS> fits;
+	if (GzipFITSStorage::isGzip(file.get())) {
+		fits.reset(new FITS(new GzipFITSStorage(file.release(), options_.hdu_index)));
+	} else {
+		fits.reset(new FITS(file.release()));
+	}
+	const auto& hdu = selectHDU(*fits, options_.hdu_index);
+	const auto size = outputSize(options_.size, hdu.data().imageDataUnit()->size());
+
+	const auto image = (resources ? renderImage(hdu, size, *resources) : renderSoftware(hdu, size));
+
+	if (!image.save(outputFilename(filename), options_.format.toLatin1().constData()))
+		throw Exception("Cannot write " + outputFilename(filename));
+}
+
+QImage BatchRenderer::renderImage(const FITS::HeaderDataUnit& hdu, const QSize& size, JobResources& resources) const {
+	OpenGLRenderer::State state;
+	state.has_levels = options_.has_levels;
+	state.levels = options_.levels;
+	state.colormap_index = options_.colormap_index;
+	state.stretch = options_.stretch;
+	state.stretch_parameter = options_.stretch_parameter;
+	state.size = size;
+
+	// The texture is not shared, the file is never rendered again
+	OpenGLRenderer renderer(resources.registry, hdu);
+	// Only the first plane of a cube is rendered
+	renderer.setCubeTextureEnabled(false);
+	renderer.initialize();
+	// The registry holds weak references only, keep the program and the
+	// colormaps for the next files
+	const auto bitpix = hdu.header().header("BITPIX");
+	if (!resources.programs.count(bitpix))
+		resources.programs.emplace(bitpix, resources.registry.program(bitpix));
+	if (!resources.colormaps[0])
+		resources.colormaps = renderer.colormaps();
+
+	auto& fbo = resources.fbo;
+	if (!fbo || fbo->size() != state.size)
+		fbo.reset(new QOpenGLFramebufferObject(state.size));
+
+	fbo->bind();
+	renderer.render(state);
+	const auto image = fbo->toImage();
+	fbo->release();
+
+	return image;
+}
+
+QImage BatchRenderer::renderSoftware(const FITS::HeaderDataUnit& hdu, const QSize& size) const {
+	CPURenderer renderer(hdu);
+	if (options_.has_levels)
+		renderer.setLevels(options_.levels);
+	// The colormap texture is never created without a context
+	std::unique_ptr<OpenGLColorMap> colormap{OpenGLResourceRegistry::createColorMap(options_.colormap_index)};
+	renderer.setColorMap(*colormap);
+	renderer.setStretch(options_.stretch, options_.stretch_parameter);
+
+	return renderer.render(size);
+}
+
+BatchRenderer::Result BatchRenderer::run(const QStringList& filenames) {
+	filenames_ = filenames;
+	next_file_ = 0;
+	rendered_ = 0;
+	failed_ = 0;
+
+	if (!options_.software && !QOpenGLContext::globalShareContext())
+		throw Exception("No global share OpenGL context, Qt::AA_ShareOpenGLContexts has to be set");
+
+	// Files of the same name from different directories would overwrite
+	// each other's image
+	std::map<QString, QString> outputs;
+	for (const auto& filename: filenames) {
+		const auto inserted = outputs.emplace(outputFilename(filename), filename);
+		if (!inserted.second)
+			throw Exception(filename + " and " + inserted.first->second + " are both rendered into " + inserted.first->first);
+	}
+
+	QElapsedTimer timer;
+	timer.start();
+
+	const int jobs = qBound(1, options_.jobs, qMax(1, filenames.size()));
+	// Offscreen surfaces can only be created in the GUI thread
+	std::vector<std::unique_ptr<QOffscreenSurface>> surfaces;
+	std::vector<std::unique_ptr<Job>> threads;
+	for (int i = 0; i < jobs; ++i) {
+		if (!options_.software) {
+			surfaces.emplace_back(new QOffscreenSurface);
+			surfaces.back()->setFormat(QOpenGLContext::globalShareContext()->format());
+			surfaces.back()->create();
+		}
+		threads.emplace_back(new Job(this, options_.software ? Q_NULLPTR : surfaces.back().get()));
+		threads.back()->start();
+	}
+	for (auto& thread: threads) {
+		thread->wait();
+	}
+
+	return Result{rendered_, failed_, timer.nsecsElapsed() / 1e9};
+}
@@ -0,0 +1,249 @@
+#include <QFileInfo>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <calibrator.h>
+#include <fitscache.h>
+#include <memoryfitsstorage.h>
+#include <parallel.h>
+#include <physicalvalues.h>
+#include <sequence.h>
+#include <tracer.h>
+
+namespace {
+	// v -= a
+	void subtract(float* v, const float* a, quint64 count) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(v + i, _mm_sub_ps(_mm_loadu_ps(v + i), _mm_loadu_ps(a + i)));
+		}
+#endif
+		for (; i < count; ++i) {
+			v[i] -= a[i];
+		}
+	}
+
+	// v -= scale * a
+	void subtractScaled(float* v, const float* a, float scale, quint64 count) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		const __m128 s = _mm_set1_ps(scale);
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(v + i, _mm_sub_ps(_mm_loadu_ps(v + i), _mm_mul_ps(_mm_loadu_ps(a + i), s)));
+		}
+#endif
+		for (; i < count; ++i) {
+			v[i] -= a[i] * scale;
+		}
+	}
+
+	// v *= a
+	void multiply(float* v, const float* a, quint64 count) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		for (; i + 4 <= count; i += 4) {
+			_mm_storeu_ps(v + i, _mm_mul_ps(_mm_loadu_ps(v + i), _mm_loadu_ps(a + i)));
+		}
+#endif
+		for (; i < count; ++i) {
+			v[i] *= a[i];
+		}
+	}
+
+	QString masterName(const QString& filename) {
+		// Long names would not fit the card
+		return MemoryFITSStorage::stringValue(QFileInfo(filename).fileName().left(60));
+	}
+}
+
+Calibrator::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void Calibrator::Exception::raise() const {
+	throw *this;
+}
+QException* Calibrator::Exception::clone() const {
+	return new Calibrator::Exception(*this);
+}
+
+Calibrator::ShapeMismatch::ShapeMismatch(const QString& filename):
+	Calibrator::Exception((filename.isEmpty() ? QString("The frame") : filename + ": the frame") + " differs from the calibration frames by shape") {
+}
+void Calibrator::ShapeMismatch::raise() const {
+	throw *this;
+}
+QException* Calibrator::ShapeMismatch::clone() const {
+	return new Calibrator::ShapeMismatch(*this);
+}
+
+Calibrator::Calibrator(const Masters& masters):
+	masters_(masters),
+	budget_(default_budget),
+	usage_(0),
+	hits_(0),
+	misses_(0) {
+
+	Tracer::Scope trace_scope("calibration masters", "processing");
+
+	double exposure = 0;
+	if (!masters_.bias.isEmpty())
+		bias_ = load(masters_.bias, &exposure);
+
+	if (!masters_.dark.isEmpty()) {
+		dark_current_ = load(masters_.dark, &exposure);
+		if (!(exposure > 0))
+			throw Exception(masters_.dark + ": the exposure of the dark frame is unknown");
+		if (!bias_.empty())
+			subtract(dark_current_.data(), bias_.data(), dark_current_.size());
+		for (auto& x: dark_current_) {
+			x /= static_cast<float>(exposure);
+		}
+	}
+
+	if (!masters_.flat.isEmpty()) {
+		flat_ = load(masters_.flat, &exposure);
+		if (!bias_.empty())
+			subtract(flat_.data(), bias_.data(), flat_.size());
+
+		double sum = 0;
+		quint64 count = 0;
+		for (auto x: flat_) {
+			if (std::isfinite(x)) {
+				sum += x;
+				++count;
+			}
+		}
+		if (!(count > 0 && sum > 0))
+			throw Exception(masters_.flat + ": the flat frame has no positive mean");
+
+		const float mean = static_cast<float>(sum / count);
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		for (auto& x: flat_) {
+			x = (x > 0 ? mean / x : nan);
+		}
+	}
+}
+
+std::vector<float> Calibrator::load(const QString& filename, double* exposure) {
+	const auto opened = Sequence::open(Sequence::Frame{filename, -1}, Sequence::FrameOnly);
+	const auto size = opened.hdu->data().imageDataUnit()->size();
+	if (size_.isEmpty()) {
+		size_ = size;
+	} else if (size != size_) {
+		throw ShapeMismatch(filename);
+	}
+
+	const quint64 length = static_cast<quint64>(size_.width()) * size_.height();
+	std::vector<float> values(length);
+	convertToPhysical(*opened.hdu, 0, length, values.data());
+	*exposure = Calibrator::exposure(opened.hdu->header());
+
+	return values;
+}
+
+std::vector<float> Calibrator::calibrate(const FITS::HeaderDataUnit& raw) const {
+	Tracer::Scope trace_scope("calibrate", "processing");
+
+	auto image = raw.data().imageDataUnit();
+	if (!image || (!size_.isEmpty() && image->size() != size_))
+		throw ShapeMismatch();
+
+	const quint64 width = image->width();
+	const int height = image->height();
+
+	float scale = 0;
+	if (!dark_current_.empty()) {
+		const double raw_exposure = exposure(raw.header());
+		if (!(raw_exposure >= 0))
+			throw Exception("The exposure of the frame is unknown, the dark frame can not be scaled");
+		scale = static_cast<float>(raw_exposure);
+	}
+
+	std::vector<float> result(width * height);
+	const int band = static_cast<int>(std::max<quint64>(1, band_budget / (width * sizeof(float))));
+
+	parallelFor(height, band, [&] (int begin, int end) {
+		const quint64 offset = begin * width;
+		const quint64 count = (end - begin) * width;
+		float* v = result.data() + offset;
+
+		convertToPhysical(raw, offset, count, v);
+		if (!bias_.empty())
+			subtract(v, bias_.data() + offset, count);
+		if (!dark_current_.empty())
+			subtractScaled(v, dark_current_.data() + offset, scale, count);
+		if (!flat_.empty())
+			multiply(v, flat_.data() + offset, count);
+	});
+
+	return result;
+}
+
+std::unique_ptr<FITS> Calibrator::calibrateToFITS(const FITS::HeaderDataUnit& raw) const {
+	const auto result = calibrate(raw);
+
+	// Keywords of IRAF ccdproc
+	MemoryFITSStorage::cards_type cards;
+	const double raw_exposure = exposure(raw.header());
+	if (!std::isnan(raw_exposure))
+		cards.emplace_back("EXPTIME", QString::number(raw_exposure));
+	if (!masters_.bias.isEmpty())
+		cards.emplace_back("ZEROCOR", masterName(masters_.bias));
+	if (!masters_.dark.isEmpty())
+		cards.emplace_back("DARKCOR", masterName(masters_.dark));
+	if (!masters_.flat.isEmpty())
+		cards.emplace_back("FLATCOR", masterName(masters_.flat));
+
+	return MemoryFITSStorage::createFloatImage(raw.data().imageDataUnit()->size(), result.data(), cards);
+}
+
+std::shared_ptr<const FITS> Calibrator::calibrated(const QString& filename) {
+	// The file rewritten in place is calibrated again
+	const auto key = FITSCache::key(filename);
+	auto it = index_.find(key);
+	if (it != index_.end()) {
+		++hits_;
+		entries_.splice(entries_.begin(), entries_, it->second);
+		return it->second->second;
+	}
+
+	++misses_;
+	const auto opened = Sequence::open(Sequence::Frame{filename, -1}, Sequence::FrameOnly);
+	if (!size_.isEmpty() && opened.hdu->data().imageDataUnit()->size() != size_)
+		throw ShapeMismatch(filename);
+	std::shared_ptr<const FITS> fits{calibrateToFITS(*opened.hdu)};
+
+	entries_.emplace_front(key, fits);
+	index_[key] = entries_.begin();
+	usage_ += fits->primary_hdu().data().imageDataUnit()->length();
+	evict();
+
+	return fits;
+}
+
+void Calibrator::setBudget(qint64 budget) {
+	budget_ = budget;
+	evict();
+}
+
+void Calibrator::evict() {
+	// The most recent entry is kept even when it alone exceeds the budget
+	while (usage_ > budget_ && entries_.size() > 1) {
+		const auto& last = entries_.back();
+		usage_ -= last.second->primary_hdu().data().imageDataUnit()->length();
+		index_.erase(last.first);
+		entries_.pop_back();
+	}
+}
+
+double Calibrator::exposure(const FITS::HeaderUnit& header) {
+	const double nan = std::numeric_limits<double>::quiet_NaN();
+	return header.header_as<double>("EXPTIME", header.header_as<double>("EXPOSURE", nan));
+}
@@ -0,0 +1,130 @@
+#include <QString>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <checksum.h>
+#include <parallel.h>
+#include <tracer.h>
+
+namespace {
+	// Bytes summed by a single job, a multiple of the word
+	const quint64 band_size = Q_UINT64_C(4) << 20;
+
+	// Carries of the wide sum are added back until none is left
+	inline quint32 fold(quint64 x) {
+		while (x >> 32) {
+			x = (x & 0xFFFFFFFF) + (x >> 32);
+		}
+		return static_cast<quint32>(x);
+	}
+
+	quint32 sumWords(const quint8* data, quint64 count) {
+		quint64 i = 0;
+		quint32 sum = 0;
+#ifdef __SSE2__
+		/* Swapping the bytes of the 16-bit halves only gives the big-endian
+		 * word rotated by 16 bits, which is the word times 2^16 modulo
+		 * 2^32 - 1. Such words are summed in 64-bit lanes, and the folded
+		 * sum is rotated back. */
+		const __m128i zero = _mm_setzero_si128();
+		__m128i lo = zero;
+		__m128i hi = zero;
+		for (; i + 4 <= count; i += 4) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 4 * i));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			lo = _mm_add_epi64(lo, _mm_unpacklo_epi32(v, zero));
+			hi = _mm_add_epi64(hi, _mm_unpackhi_epi32(v, zero));
+		}
+		quint64 lanes[4];
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes), lo);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(lanes + 2), hi);
+		quint32 rotated = 0;
+		for (const auto x: lanes) {
+			rotated = Checksum::add(rotated, fold(x));
+		}
+		sum = (rotated << 16) | (rotated >> 16);
+#endif
+		quint64 rest = 0;
+		for (; i < count; ++i) {
+			rest += qFromBigEndian<quint32>(data + 4 * i);
+		}
+		return Checksum::add(sum, fold(rest));
+	}
+
+	Checksum::Status datasumStatus(const QString& value, quint32 sum) {
+		bool ok = false;
+		const quint64 expected = FITS::HeaderUnit::unquoted(value).toULongLong(&ok);
+		return (ok && expected == sum ? Checksum::Valid : Checksum::Invalid);
+	}
+}
+
+Checksum::Checksum(const FITS::HeaderDataUnit& hdu):
+	checksum_(Missing),
+	datasum_(Missing),
+	data_sum_(0),
+	hdu_sum_(0) {
+
+	const auto& header = hdu.header();
+	const auto& headers = header.headers();
+	const auto datasum = headers.find("DATASUM");
+	const bool has_checksum = headers.count("CHECKSUM");
+	// The data are not read in vain
+	if (!has_checksum && datasum == headers.end())
+		return;
+
+	Tracer::Scope trace_scope("HDU checksum", "checksum");
+
+	data_sum_ = sum(hdu.rawData(), hdu.dataExtent());
+	hdu_sum_ = sum(hdu.rawHeader(), hdu.headerExtent(), data_sum_);
+
+	if (datasum != headers.end())
+		datasum_ = datasumStatus(datasum->second, data_sum_);
+	// The sum of the HDU is -0
+	if (has_checksum)
+		checksum_ = (hdu_sum_ == 0xFFFFFFFF ? Valid : Invalid);
+}
+
+quint32 Checksum::sum(const quint8* data, quint64 length, quint32 sum) {
+	const quint64 whole = length / 4 * 4;
+	const int bands = static_cast<int>((whole + band_size - 1) / band_size);
+
+	std::vector<quint32> sums(bands, 0);
+	parallelFor(bands, 1, [data, whole, &sums] (int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			const quint64 first = static_cast<quint64>(i) * band_size;
+			sums[i] = sumWords(data + first, std::min(band_size, whole - first) / 4);
+		}
+	});
+	for (const auto x: sums) {
+		sum = add(sum, x);
+	}
+
+	if (whole != length) {
+		quint8 last[4] = {0, 0, 0, 0};
+		std::memcpy(last, data + whole, length - whole);
+		sum = add(sum, qFromBigEndian<quint32>(last));
+	}
+	return sum;
+}
+
+quint32 Checksum::add(quint32 x, quint32 y) {
+	return fold(static_cast<quint64>(x) + y);
+}
+
+const char* Checksum::statusText(Status status) {
+	switch (status) {
+		case Valid:
+			return "valid";
+		case Invalid:
+			return "invalid";
+		default:
+			return "missing";
+	}
+}
@@ -0,0 +1,78 @@
+#include <QMetaObject>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <checksumlabel.h>
+
+class ChecksumLabel::Job: public QRunnable {
+private:
+	std::shared_ptr<Shared> shared_;
+	// Keeps the file mapped while it is summed
+	std::shared_ptr<const FITS::HeaderDataUnit> hdu_;
+	int generation_;
+public:
+	Job(std::shared_ptr<Shared> shared, std::shared_ptr<const FITS::HeaderDataUnit> hdu, int generation):
+		shared_(std::move(shared)),
+		hdu_(std::move(hdu)),
+		generation_(generation) {
+	}
+
+	virtual void run() override {
+		{
+			QMutexLocker locker(&shared_->mutex);
+			if (!shared_->label)
+				return;
+		}
+
+		const Checksum checksum(*hdu_);
+
+		QMutexLocker locker(&shared_->mutex);
+		if (shared_->label) {
+			QMetaObject::invokeMethod(shared_->label, "showResult", Qt::QueuedConnection,
+				Q_ARG(int, generation_), Q_ARG(int, checksum.checksum()), Q_ARG(int, checksum.datasum()));
+		}
+	}
+};
+
+ChecksumLabel::ChecksumLabel(QWidget* parent):
+	QLabel(parent),
+	shared_(std::make_shared<Shared>()),
+	generation_(0) {
+
+	shared_->label = this;
+	hide();
+}
+
+ChecksumLabel::~ChecksumLabel() {
+	QMutexLocker locker(&shared_->mutex);
+	shared_->label = Q_NULLPTR;
+}
+
+void ChecksumLabel::verify(std::shared_ptr<const FITS::HeaderDataUnit> hdu) {
+	++generation_;
+
+	if (!hdu || (!hdu->header().headers().count("CHECKSUM") && !hdu->header().headers().count("DATASUM"))) {
+		hide();
+		return;
+	}
+
+	setText(tr("Verifying checksum…"));
+	setToolTip(QString());
+	setStyleSheet(QString());
+	show();
+
+	QThreadPool::globalInstance()->start(new Job(shared_, std::move(hdu), generation_));
+}
+
+void ChecksumLabel::showResult(int generation, int checksum, int datasum) {
+	if (generation != generation_)
+		return;
+
+	const bool valid = (checksum != Checksum::Invalid && datasum != Checksum::Invalid);
+	setText(valid ? tr("Checksum OK") : tr("Checksum mismatch"));
+	setStyleSheet(valid ? QString() : QString("color: red"));
+	setToolTip(tr("CHECKSUM: %1\nDATASUM: %2")
+		.arg(Checksum::statusText(static_cast<Checksum::Status>(checksum)))
+		.arg(Checksum::statusText(static_cast<Checksum::Status>(datasum))));
+}
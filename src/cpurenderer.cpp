@@ -0,0 +1,377 @@
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <cpurenderer.h>
+#include <parallel.h>
+#include <tracer.h>
+
+namespace {
+	typedef OpenGLShaderUniforms::vec4_type vec4_type;
+	typedef void (*kernel_type)(const quint8* src, int count, const vec4_type& c, const vec4_type& z, float* dst);
+
+	// base / (base - 1), see openglshaderprogram.cpp
+	const float sign_correction_8  = 1.003921568627451f;
+	const float sign_correction_16 = 1.0000152590218967f;
+
+	/* Kernels decode count big-endian elements from src the way they are
+	 * stored in the texture and compute dot(c, raw - z) into dst. SSE2 and
+	 * scalar paths make the same single precision operations in the same
+	 * order, so their results are identical. */
+	void kernel8(const quint8* src, int count, const vec4_type& c, const vec4_type& z, float* dst) {
+		int i = 0;
+#ifdef __SSE2__
+		const __m128 c0 = _mm_set1_ps(c[0]), z0 = _mm_set1_ps(z[0]);
+		const __m128 scale = _mm_set1_ps(255.0f);
+		const __m128i zero = _mm_setzero_si128();
+		for (; i + 16 <= count; i += 16) {
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const __m128i lo = _mm_unpacklo_epi8(bytes, zero);
+			const __m128i hi = _mm_unpackhi_epi8(bytes, zero);
+			const __m128i words[4] = {
+				_mm_unpacklo_epi16(lo, zero), _mm_unpackhi_epi16(lo, zero),
+				_mm_unpacklo_epi16(hi, zero), _mm_unpackhi_epi16(hi, zero)};
+			for (int k = 0; k < 4; ++k) {
+				const __m128 raw = _mm_div_ps(_mm_cvtepi32_ps(words[k]), scale);
+				_mm_storeu_ps(dst + i + 4 * k, _mm_mul_ps(_mm_sub_ps(raw, z0), c0));
+			}
+		}
+#endif
+		for (; i < count; ++i) {
+			const float raw = src[i] / 255.0f;
+			dst[i] = (raw - z[0]) * c[0];
+		}
+	}
+
+	void kernel16(const quint8* src, int count, const vec4_type& c, const vec4_type& z, float* dst) {
+		int i = 0;
+#ifdef __SSE2__
+		const __m128 c0 = _mm_set1_ps(c[0]), z0 = _mm_set1_ps(z[0]);
+		const __m128 c1 = _mm_set1_ps(c[1]), z1 = _mm_set1_ps(z[1]);
+		const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+		const __m128 correction = _mm_set1_ps(sign_correction_8);
+		const __m128i zero = _mm_setzero_si128();
+		const __m128i low_byte = _mm_set1_epi16(0x00FF);
+		for (; i + 8 <= count; i += 8) {
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 2 * i));
+			// Big-endian: the most significant byte goes first
+			const __m128i msb = _mm_and_si128(bytes, low_byte);
+			const __m128i lsb = _mm_srli_epi16(bytes, 8);
+			for (int k = 0; k < 2; ++k) {
+				__m128 x = _mm_div_ps(_mm_cvtepi32_ps(k ? _mm_unpackhi_epi16(msb, zero) : _mm_unpacklo_epi16(msb, zero)), scale);
+				x = _mm_sub_ps(x, _mm_and_ps(_mm_cmpgt_ps(x, half), correction));
+				const __m128 y = _mm_div_ps(_mm_cvtepi32_ps(k ? _mm_unpackhi_epi16(lsb, zero) : _mm_unpacklo_epi16(lsb, zero)), scale);
+				const __m128 value = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, z0), c0), _mm_mul_ps(_mm_sub_ps(y, z1), c1));
+				_mm_storeu_ps(dst + i + 4 * k, value);
+			}
+		}
+#endif
+		for (; i < count; ++i) {
+			float x = src[2 * i] / 255.0f;
+			x -= (x > 0.5f ? sign_correction_8 : 0.0f);
+			const float y = src[2 * i + 1] / 255.0f;
+			dst[i] = (x - z[0]) * c[0] + (y - z[1]) * c[1];
+		}
+	}
+
+	void kernel32(const quint8* src, int count, const vec4_type& c, const vec4_type& z, float* dst) {
+		int i = 0;
+#ifdef __SSE2__
+		const __m128 scale = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+		const __m128 correction = _mm_set1_ps(sign_correction_8);
+		const __m128i low_byte = _mm_set1_epi32(0xFF);
+		__m128 cv[4], zv[4];
+		for (int k = 0; k < 4; ++k) {
+			cv[k] = _mm_set1_ps(c[k]);
+			zv[k] = _mm_set1_ps(z[k]);
+		}
+		for (; i + 4 <= count; i += 4) {
+			const __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+			__m128 x = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(bytes, low_byte)), scale);
+			x = _mm_sub_ps(x, _mm_and_ps(_mm_cmpgt_ps(x, half), correction));
+			__m128 value = _mm_mul_ps(_mm_sub_ps(x, zv[0]), cv[0]);
+			for (int k = 1; k < 4; ++k) {
+				const __m128 y = _mm_div_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(bytes, 8 * k), low_byte)), scale);
+				value = _mm_add_ps(value, _mm_mul_ps(_mm_sub_ps(y, zv[k]), cv[k]));
+			}
+			_mm_storeu_ps(dst + i, value);
+		}
+#endif
+		for (; i < count; ++i) {
+			const quint8* texel = src + 4 * i;
+			float x = texel[0] / 255.0f;
+			x -= (x > 0.5f ? sign_correction_8 : 0.0f);
+			float value = (x - z[0]) * c[0];
+			for (int k = 1; k < 4; ++k) {
+				value += (texel[k] / 255.0f - z[k]) * c[k];
+			}
+			dst[i] = value;
+		}
+	}
+
+	// No SSE2 path: there is no unsigned 16-bit to float conversion in SSE2
+	// and 64-bit images are rare
+	void kernel64(const quint8* src, int count, const vec4_type& c, const vec4_type& z, float* dst) {
+		for (int i = 0; i < count; ++i) {
+			const quint8* texel = src + 8 * i;
+			float x = qFromBigEndian<quint16>(texel) / 65535.0f;
+			x -= (x > 0.5f ? sign_correction_16 : 0.0f);
+			float value = (x - z[0]) * c[0];
+			for (int k = 1; k < 4; ++k) {
+				value += (qFromBigEndian<quint16>(texel + 2 * k) / 65535.0f - z[k]) * c[k];
+			}
+			dst[i] = value;
+		}
+	}
+
+	void kernelFloat(const quint8* src, int count, const vec4_type& c, const vec4_type& z, float* dst) {
+		int i = 0;
+#ifdef __SSE2__
+		const __m128 c0 = _mm_set1_ps(c[0]), z0 = _mm_set1_ps(z[0]);
+		const __m128i byte_mask = _mm_set1_epi32(0xFF00);
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 4 * i));
+			const __m128i swapped = _mm_or_si128(
+				_mm_or_si128(_mm_slli_epi32(v, 24), _mm_srli_epi32(v, 24)),
+				_mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 8), byte_mask), _mm_slli_epi32(_mm_and_si128(v, byte_mask), 8)));
+			const __m128 raw = _mm_castsi128_ps(swapped);
+			_mm_storeu_ps(dst + i, _mm_mul_ps(_mm_sub_ps(raw, z0), c0));
+		}
+#endif
+		for (; i < count; ++i) {
+			const quint32 bits = qFromBigEndian<quint32>(src + 4 * i);
+			float raw;
+			std::memcpy(&raw, &bits, sizeof(raw));
+			dst[i] = (raw - z[0]) * c[0];
+		}
+	}
+
+	// Linear sampling of the colormap texture, mirrored repeat wrap equals to clamp here
+	inline QRgb sampleColorMap(const quint8* colormap, int texels, float value) {
+		// NaN is mapped to zero
+		const float t = (value > 0.0f ? (value < 1.0f ? value : 1.0f) : 0.0f);
+		const float position = std::min(std::max(t * texels - 0.5f, 0.0f), static_cast<float>(texels - 1));
+		const int i0 = static_cast<int>(position);
+		const int i1 = std::min(i0 + 1, texels - 1);
+		const float f = position - i0;
+
+		int rgba[4];
+		for (int k = 0; k < 4; ++k) {
+			const float x0 = colormap[4 * i0 + k], x1 = colormap[4 * i1 + k];
+			rgba[k] = static_cast<int>(x0 + (x1 - x0) * f + 0.5f);
+		}
+
+		return qRgba(rgba[0], rgba[1], rgba[2], rgba[3]);
+	}
+
+	// Mirrors stretched() of the fragment shader
+	inline float stretched(const OpenGLShaderUniforms& uniforms, const Histogram& histogram, float x) {
+		const auto& p = uniforms.get_stretch_parameters();
+		switch (uniforms.get_stretch()) {
+		case OpenGLShaderUniforms::SqrtStretch:
+			return std::sqrt(x);
+		case OpenGLShaderUniforms::LogStretch:
+			return std::log(p[0] * x + 1.0f) * p[1];
+		case OpenGLShaderUniforms::AsinhStretch: {
+			const float y = p[0] * x;
+			return std::log(y + std::sqrt(y * y + 1.0f)) * p[1];
+		}
+		case OpenGLShaderUniforms::PowerStretch:
+			return std::pow(x, p[0]);
+		case OpenGLShaderUniforms::EqualizationStretch:
+			return (histogram.isEmpty() ? 0.0f : (static_cast<float>(histogram.at(x * p[0] + p[1])) - p[2]) * p[3]);
+		default:
+			return x;
+		}
+	}
+
+	void applyStretch(const OpenGLShaderUniforms& uniforms, const Histogram& histogram, int count, float* values) {
+		const auto& range = uniforms.get_colormap_range();
+		for (int i = 0; i < count; ++i) {
+			// NaN is mapped to zero
+			const float t = (values[i] - range[0]) / range[1];
+			const float x = (t > 0.0f ? (t < 1.0f ? t : 1.0f) : 0.0f);
+			const float y = stretched(uniforms, histogram, x);
+			values[i] = range[0] + (y > 0.0f ? (y < 1.0f ? y : 1.0f) : 0.0f) * range[1];
+		}
+	}
+
+	template<class T> inline T fromBigEndian(const quint8* src) {
+		return qFromBigEndian<T>(src);
+	}
+	template<> inline float fromBigEndian<float>(const quint8* src) {
+		const quint32 bits = qFromBigEndian<quint32>(src);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	template<class T> std::pair<double, double> dataMinMax(const FITS::DataUnit<T>& data) {
+		const auto bytes = reinterpret_cast<const quint8*>(data.data());
+		double min = std::numeric_limits<double>::max();
+		double max = std::numeric_limits<double>::lowest();
+
+		for (quint64 i = 0; i < data.length(); ++i) {
+			const double value = fromBigEndian<T>(bytes + i * sizeof(T));
+			// Comparisons are false for NaN
+			if (value < min) min = value;
+			if (value > max) max = value;
+		}
+
+		return std::make_pair(min, max);
+	}
+
+	struct KernelSelector {
+		kernel_type* kernel;
+		int* element_size;
+		std::pair<double, double>* minmax;  // Raw data range, scanned when not null
+
+		template<class T> void select(const FITS::DataUnit<T>& data, kernel_type fun) const {
+			*kernel = fun;
+			*element_size = sizeof(T);
+			if (minmax)
+				*minmax = dataMinMax(data);
+		}
+
+		void operator() (const FITS::DataUnit<quint8>& data) const { select(data, kernel8); }
+		void operator() (const FITS::DataUnit<qint16>& data) const { select(data, kernel16); }
+		void operator() (const FITS::DataUnit<qint32>& data) const { select(data, kernel32); }
+		void operator() (const FITS::DataUnit<qint64>& data) const { select(data, kernel64); }
+		void operator() (const FITS::DataUnit<float>&  data) const { select(data, kernelFloat); }
+		void operator() (const FITS::DataUnit<double>&) const {
+			throw FITS::UnsupportedBitpix("-64");
+		}
+		void operator() (const FITS::EmptyDataUnit&) const {
+			Q_ASSERT(0);
+		}
+		void operator() (const FITS::TableDataUnit&) const {
+			Q_ASSERT(0);
+		}
+	};
+
+	kernel_type selectKernel(const FITS::HeaderDataUnit& hdu, int* element_size, std::pair<double, double>* minmax) {
+		kernel_type kernel = Q_NULLPTR;
+
+		hdu.data().apply(KernelSelector{&kernel, element_size, minmax});
+
+		return kernel;
+	}
+}
+
+quint8 CPURenderer::channels(const QString& bitpix) {
+	if (bitpix == "16") return 2;
+	if (bitpix == "32" || bitpix == "64") return 4;
+	return 1;
+}
+
+quint8 CPURenderer::channelSize(const QString& bitpix) {
+	if (bitpix == "-32") return 0;
+	if (bitpix == "64") return 2;
+	return 1;
+}
+
+CPURenderer::CPURenderer(const FITS::HeaderDataUnit& hdu):
+	hdu_(&hdu),
+	channels_(channels(hdu.header().header("BITPIX"))),
+	channel_size_(channelSize(hdu.header().header("BITPIX"))),
+	uniforms_(channels_, channel_size_, hdu.header().bzero(), hdu.header().bscale()) {
+
+	Tracer::Scope trace_scope("CPU min/max scan", "cpu");
+
+	int element_size = 0;
+	selectKernel(hdu, &element_size, &minmax_);
+	minmax_.first  = minmax_.first  * hdu.header().bscale() + hdu.header().bzero();
+	minmax_.second = minmax_.second * hdu.header().bscale() + hdu.header().bzero();
+
+	setColorMap(GrayscaleColorMap());
+	setLevels(minmax_);
+}
+
+void CPURenderer::setLevels(const std::pair<double, double>& levels) {
+	uniforms_.setMinMax(levels);
+}
+
+void CPURenderer::setColorMap(const OpenGLColorMap& colormap) {
+	colormap_.assign(colormap.data(), colormap.data() + colormap.size());
+	uniforms_.setColorMapSize(colormap.size() / 4);
+}
+
+void CPURenderer::setStretch(OpenGLShaderUniforms::Stretch stretch, double parameter) {
+	if (stretch == OpenGLShaderUniforms::EqualizationStretch && histogram_.isEmpty()) {
+		histogram_ = Histogram(*hdu_, minmax_);
+		uniforms_.setHistogram(&histogram_);
+	}
+	uniforms_.setStretch(stretch, parameter);
+}
+
+QImage CPURenderer::render(const QSize& size, const QRectF& viewrect) const {
+	Tracer::Scope trace_scope("CPU render", "cpu");
+
+	QImage image(size, QImage::Format_ARGB32);
+	image.fill(0);
+
+	const auto image_data = hdu_->data().imageDataUnit();
+	const int width  = static_cast<int>(image_data->width());
+	const int height = static_cast<int>(image_data->height());
+	int element_size = 0;
+	const auto kernel = selectKernel(*hdu_, &element_size, Q_NULLPTR);
+
+	// Texel column of every pixel column, fragment centers are sampled
+	std::vector<int> columns(size.width());
+	int first_column = width, last_column = -1;
+	for (int x = 0; x < size.width(); ++x) {
+		const double u = viewrect.left() + (x + 0.5) / size.width() * viewrect.width();
+		columns[x] = (u >= 0 && u < 1 ? std::min(static_cast<int>(u * width), width - 1) : -1);
+		if (columns[x] >= 0) {
+			first_column = std::min(first_column, columns[x]);
+			last_column  = std::max(last_column,  columns[x]);
+		}
+	}
+	if (last_column < 0)
+		return image;
+
+	const int span = last_column - first_column + 1;
+	const auto c = uniforms_.get_c();
+	const auto z = uniforms_.get_z();
+	const auto colormap = colormap_.data();
+	const int texels = static_cast<int>(colormap_.size() / 4);
+	const auto data = image_data->data();
+	// Detach before the bands write into it
+	const auto bits = image.bits();
+	const auto bytes_per_line = image.bytesPerLine();
+
+	parallelFor(size.height(), 16, [&] (int begin, int end) {
+		std::vector<float> values(span);
+		int decoded_row = -1;
+
+		for (int y = begin; y < end; ++y) {
+			// OpenGL rows go from bottom to top
+			const double v = 1.0 - viewrect.top() - (y + 0.5) / size.height() * viewrect.height();
+			if (v < 0 || v >= 1)
+				continue;
+
+			const int row = std::min(static_cast<int>(v * height), height - 1);
+			if (row != decoded_row) {
+				kernel(data + (static_cast<quint64>(row) * width + first_column) * element_size, span, c, z, values.data());
+				if (uniforms_.get_stretch() != OpenGLShaderUniforms::LinearStretch)
+					applyStretch(uniforms_, histogram_, span, values.data());
+				decoded_row = row;
+			}
+
+			auto line = reinterpret_cast<QRgb*>(bits + y * bytes_per_line);
+			for (int x = 0; x < size.width(); ++x) {
+				if (columns[x] >= 0)
+					line[x] = sampleColorMap(colormap, texels, values[columns[x] - first_column]);
+			}
+		}
+	});
+
+	return image;
+}
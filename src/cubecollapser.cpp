@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <cubecollapser.h>
+#include <memoryfitsstorage.h>
+#include <parallel.h>
+#include <physicalvalues.h>
+#include <tracer.h>
+
+namespace {
+	// sum += v, weight += 1 for the values which are not NaN
+	void accumulate(const float* v, float* sum, float* weight, quint64 count) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		const __m128 one = _mm_set1_ps(1.0f);
+		for (; i + 4 <= count; i += 4) {
+			const __m128 x = _mm_loadu_ps(v + i);
+			const __m128 ordered = _mm_cmpord_ps(x, x);
+			_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_and_ps(x, ordered)));
+			_mm_storeu_ps(weight + i, _mm_add_ps(_mm_loadu_ps(weight + i), _mm_and_ps(one, ordered)));
+		}
+#endif
+		for (; i < count; ++i) {
+			if (v[i] == v[i]) {
+				sum[i] += v[i];
+				weight[i] += 1.0f;
+			}
+		}
+	}
+
+	// m = max(m, v) for the values which are not NaN, m is NaN initially
+	void maximum(const float* v, float* m, quint64 count) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		for (; i + 4 <= count; i += 4) {
+			const __m128 x = _mm_loadu_ps(v + i);
+			const __m128 y = _mm_loadu_ps(m + i);
+			// maxps returns the second operand when either is NaN
+			const __m128 r = _mm_max_ps(x, y);
+			const __m128 y_ordered = _mm_cmpord_ps(y, y);
+			_mm_storeu_ps(m + i, _mm_or_ps(_mm_and_ps(y_ordered, r), _mm_andnot_ps(y_ordered, x)));
+		}
+#endif
+		for (; i < count; ++i) {
+			if (v[i] == v[i] && !(m[i] >= v[i]))
+				m[i] = v[i];
+		}
+	}
+
+	// dst = scale * sum, or scale * sum / weight for the mean
+	void finish(float* sum, const float* weight, double scale, bool mean, quint64 count) {
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		const float s = static_cast<float>(scale);
+		for (quint64 i = 0; i < count; ++i) {
+			sum[i] = (weight[i] > 0.0f ? (mean ? sum[i] / weight[i] : sum[i] * s) : nan);
+		}
+	}
+}
+
+CubeCollapser::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void CubeCollapser::Exception::raise() const {
+	throw *this;
+}
+QException* CubeCollapser::Exception::clone() const {
+	return new CubeCollapser::Exception(*this);
+}
+
+CubeCollapser::Options::Options():
+	operation(SumOperation),
+	first(0),
+	last(std::numeric_limits<quint64>::max()) {
+}
+
+CubeCollapser::CubeCollapser(const FITS::HeaderDataUnit& hdu):
+	hdu_(hdu) {
+
+	if (!hdu_.data().imageDataUnit())
+		throw Exception("There is no image to collapse");
+}
+
+std::vector<float> CubeCollapser::collapse(const Options& options) const {
+	Tracer::Scope trace_scope("collapse", "processing");
+
+	const auto image = hdu_.data().imageDataUnit();
+	const quint64 last = std::min(options.last, depth() - 1);
+	if (options.first > last)
+		throw Exception("The range of planes is empty");
+
+	const quint64 width = image->width();
+	const int height = image->height();
+	const quint64 plane_length = width * height;
+	const double scale = (options.operation == Moment0Operation ? channelWidth(hdu_.header()) : 1.0);
+
+	std::vector<float> result(plane_length);
+	const int band = static_cast<int>(std::max<quint64>(1, band_budget / std::max<quint64>(width * sizeof(float), 1)));
+
+	parallelFor(height, band, [&] (int begin, int end) {
+		const quint64 offset = begin * width;
+		const quint64 count = (end - begin) * width;
+		std::vector<float> values(count);
+		float* dst = result.data() + offset;
+
+		if (options.operation == MaxOperation) {
+			std::fill(dst, dst + count, std::numeric_limits<float>::quiet_NaN());
+			for (quint64 plane = options.first; plane <= last; ++plane) {
+				convertToPhysical(hdu_, plane * plane_length + offset, count, values.data());
+				maximum(values.data(), dst, count);
+			}
+			return;
+		}
+
+		std::vector<float> weight(count, 0.0f);
+		std::fill(dst, dst + count, 0.0f);
+		for (quint64 plane = options.first; plane <= last; ++plane) {
+			convertToPhysical(hdu_, plane * plane_length + offset, count, values.data());
+			accumulate(values.data(), dst, weight.data(), count);
+		}
+		finish(dst, weight.data(), scale, options.operation == MeanOperation, count);
+	});
+
+	return result;
+}
+
+std::unique_ptr<FITS> CubeCollapser::collapseToFITS(const Options& options) const {
+	const auto result = collapse(options);
+
+	// Planes are one-based in FITS
+	MemoryFITSStorage::cards_type cards;
+	cards.emplace_back("COLLAPSE", MemoryFITSStorage::stringValue(QString(operationName(options.operation)).toUpper()));
+	cards.emplace_back("PLANE1", QString::number(options.first + 1));
+	cards.emplace_back("PLANE2", QString::number(std::min(options.last, depth() - 1) + 1));
+
+	return MemoryFITSStorage::createFloatImage(hdu_.data().imageDataUnit()->size(), result.data(), cards);
+}
+
+const char* CubeCollapser::operationName(Operation operation) {
+	switch (operation) {
+	case SumOperation:
+		return "sum";
+	case MeanOperation:
+		return "mean";
+	case MaxOperation:
+		return "max";
+	case Moment0Operation:
+		return "moment-0";
+	default:
+		Q_ASSERT(0);
+		return "";
+	}
+}
+
+CubeCollapser::Operation CubeCollapser::operationFromName(const QString& name) {
+	for (int i = 0; i < OperationCount; ++i) {
+		if (name == operationName(static_cast<Operation>(i)))
+			return static_cast<Operation>(i);
+	}
+	return OperationCount;
+}
+
+double CubeCollapser::channelWidth(const FITS::HeaderUnit& header) {
+	return std::abs(header.header_as<double>("CDELT3", 1.0));
+}
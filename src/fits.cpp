@@ -1,7 +1,17 @@
+#include <QRegExp>
 #include <QString>
+#include <QStringList>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
 
 #include <mmapfitsstorage.h>
 #include <fits.h>
+#include <tilecompressedimage.h>
+#include <tracer.h>
 
 namespace {
 
@@ -11,19 +21,116 @@ struct DataUnitCreateHelper {
 	const AbstractFITSStorage::Page& end_;
 	quint64 height_;
 	quint64 width_;
+	quint64 depth_;
 
 	template<class T> void operator() (T*) {
-		*data_unit_ref_ = new FITS::DataUnit<T>(begin_, end_, height_, width_);
+		*data_unit_ref_ = new FITS::DataUnit<T>(begin_, end_, height_, width_, depth_);
 	}
 };
 
+struct DeferredDataUnitCreateHelper {
+	FITS::AbstractDataUnit** data_unit_ref_;
+	std::unique_ptr<const FITS::DeferredData>& data_;
+	quint64 height_;
+	quint64 width_;
+	quint64 depth_;
+
+	template<class T> void operator() (T*) {
+		*data_unit_ref_ = new FITS::DataUnit<T>(std::move(data_), height_, width_, depth_);
+	}
+};
+
+/* Swaps the bytes of count values of T stored in place, the loop is simple
+ * enough to be vectorized by the compiler */
+template<class T> void swapBytes(quint8* data, quint64 count) {
+	for (quint64 i = 0; i < count; ++i) {
+		T value;
+		std::memcpy(&value, data + i * sizeof(T), sizeof(T));
+		value = qFromBigEndian(value);
+		std::memcpy(data + i * sizeof(T), &value, sizeof(T));
+	}
+}
+
+QString numberText(const quint8* data, char type, const FITS::TableDataUnit::Column& column) {
+	const bool integer = (type == 'B' || type == 'I' || type == 'J' || type == 'K');
+	if (integer) {
+		const int size = FITS::TableDataUnit::elementSize(type);
+		const quint64 bits = FITS::TableDataUnit::readBigEndian(data, size);
+		// Sign extension, B is unsigned
+		const qint64 value = (type == 'B' ? static_cast<qint64>(bits) :
+			static_cast<qint64>(bits << (64 - 8 * size)) >> (64 - 8 * size));
+		if (column.has_null && value == column.null)
+			return QString();
+		if (column.scale == 1.0 && column.zero == 9223372036854775808.0 && type == 'K')
+			return QString::number(bits ^ (Q_UINT64_C(1) << 63));
+		if (column.scale == 1.0 && column.zero == std::floor(column.zero) && std::abs(column.zero) < 4294967296.0)
+			return QString::number(value + static_cast<qint64>(column.zero));
+		return QString::number(value * column.scale + column.zero, 'g', 15);
+	}
+
+	double value;
+	if (type == 'E') {
+		const quint32 bits = qFromBigEndian<quint32>(data);
+		float x;
+		std::memcpy(&x, &bits, sizeof(x));
+		value = x;
+	} else {
+		const quint64 bits = qFromBigEndian<quint64>(data);
+		std::memcpy(&value, &bits, sizeof(value));
+	}
+	return QString::number(value * column.scale + column.zero, 'g', (type == 'E' ? 7 : 16));
+}
+
+QString bitsText(const quint8* data, quint64 count) {
+	QString bits;
+	for (quint64 i = 0; i < std::min<quint64>(count, 256); ++i) {
+		bits += ((data[i / 8] >> (7 - i % 8)) & 1 ? '1' : '0');
+	}
+	return (count > 256 ? bits + "..." : bits);
+}
+
+// Text of count elements of the type, complex numbers are pairs
+QString elementsText(const quint8* data, quint64 count, char type, const FITS::TableDataUnit::Column& column, int max_elements) {
+	// Strings end at NUL or at the end of the field
+	if (type == 'A') {
+		const char* text = reinterpret_cast<const char*>(data);
+		const int size = static_cast<int>(std::min<quint64>(count, std::numeric_limits<int>::max()));
+		return QString::fromLatin1(text, static_cast<int>(std::find(text, text + size, '\0') - text)).trimmed();
+	}
+
+	QStringList values;
+	const int size = FITS::TableDataUnit::elementSize(type);
+	const quint64 shown = std::min<quint64>(count, max_elements);
+	for (quint64 i = 0; i < shown; ++i) {
+		const quint8* element = data + i * size;
+		switch (type) {
+			case 'L':
+				values << (*element == 'T' ? "T" : (*element == 'F' ? "F" : ""));
+				break;
+			case 'C':
+				values << QString("(%1, %2)").arg(numberText(element, 'E', column), numberText(element + 4, 'E', column));
+				break;
+			case 'M':
+				values << QString("(%1, %2)").arg(numberText(element, 'D', column), numberText(element + 8, 'D', column));
+				break;
+			default:
+				values << numberText(element, type, column);
+		}
+	}
+	if (count > shown)
+		values << "...";
+
+	const QString text = values.join(", ");
+	return (count == 1 ? text : "[" + text + "]");
+}
+
 }
 
-FITS::FITS(AbstractFITSStorage* fits_storage, AbstractFITSStorage::Page begin, const AbstractFITSStorage::Page& end):
+FITS::FITS(AbstractFITSStorage* fits_storage, AbstractFITSStorage::Page begin, const AbstractFITSStorage::Page& end, bool extensions):
 	fits_storage_(fits_storage),
 	primary_hdu_(begin, end) {
 
-	const bool has_extension = (primary_hdu_.header().header("EXTEND","F") == "T");
+	const bool has_extension = extensions && (primary_hdu_.header().header("EXTEND","F") == "T");
 
 	if (has_extension) {
 		while (begin != end) {
@@ -31,10 +138,17 @@ FITS::FITS(AbstractFITSStorage* fits_storage, AbstractFITSStorage::Page begin, c
 		}
 	}
 }
-FITS::FITS(AbstractFITSStorage* fits_storage): FITS(fits_storage, fits_storage->begin(), fits_storage->end()) {
+FITS::FITS(AbstractFITSStorage* fits_storage): FITS(fits_storage, fits_storage->begin(), fits_storage->end(), true) {
 }
 FITS::FITS(QFileDevice* file_device): FITS(new MMapFITSStorage(file_device)) {
 }
+// The offset past the end leaves no header to parse, so UnexpectedEnd is thrown
+FITS::FITS(AbstractFITSStorage* fits_storage, quint64 offset):
+	FITS(fits_storage, AbstractFITSStorage::Page(fits_storage->data() + std::min(offset / 2880 * 2880, static_cast<quint64>(fits_storage->size()) / 2880 * 2880)), fits_storage->end(), false) {
+}
+QStringList FITS::nameFilters() {
+	return QStringList() << "*.fits" << "*.fit" << "*.fts" << "*.fits.gz" << "*.fit.gz" << "*.fts.gz" << "*.fits.fz" << "*.fit.fz" << "*.fts.fz";
+}
 FITS::Exception::Exception(const QString& what): ::Exception(what) {
 }
 void FITS::Exception::raise() const {
@@ -69,7 +183,11 @@ void FITS::UnsupportedBitpix::raise() const {
 QException* FITS::UnsupportedBitpix::clone() const {
 	return new FITS::UnsupportedBitpix(*this);
 }
-FITS::HeaderUnit::HeaderUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end) {
+FITS::HeaderUnit::HeaderUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end):
+	cards_(reinterpret_cast<const char*>(begin.data())),
+	card_count_(0) {
+
+	Tracer::Scope trace_scope("FITS header parsing", "startup");
 	bool foundEnd = false;
 
 	for (; begin != end && !foundEnd; ++begin) {
@@ -79,6 +197,7 @@ FITS::HeaderUnit::HeaderUnit(AbstractFITSStorage::Page& begin, const AbstractFIT
 				foundEnd = true;
 				continue;
 			}
+			++card_count_;
 			QString value = QString::fromLatin1(reinterpret_cast<const char*>(record) + 10, 70);
 			int comment = value.indexOf(QChar('/'));
 			if (comment != -1) {
@@ -91,42 +210,264 @@ FITS::HeaderUnit::HeaderUnit(AbstractFITSStorage::Page& begin, const AbstractFIT
 	if (!foundEnd)
 		throw FITS::UnexpectedEnd();
 }
+FITS::HeaderUnit::HeaderUnit(std::map<QString, QString> headers, const char* cards, quint64 card_count):
+	headers_(std::move(headers)),
+	cards_(cards),
+	card_count_(card_count) {
+}
+QString FITS::HeaderUnit::unquoted(const QString& value) {
+	if (!value.startsWith('\''))
+		return value;
+	return value.mid(1, value.lastIndexOf('\'') - 1).replace("''", "'").trimmed();
+}
+FITS::DeferredData::~DeferredData() = default;
+
 FITS::AbstractDataUnit::AbstractDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 length):
+	AbstractDataUnit(begin, end, length, length) {
+}
+FITS::AbstractDataUnit::AbstractDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 length, quint64 extent):
 	data_(begin.data()), length_(length) {
 
-	if (begin.distanceInBytes(end) < length)
+	Q_ASSERT(length <= extent);
+	if (begin.distanceInBytes(end) < extent)
 		throw FITS::UnexpectedEnd();
-	begin.advanceInBytes(length);
+	begin.advanceInBytes(extent);
+}
+FITS::AbstractDataUnit::AbstractDataUnit(const quint8* data, quint64 length):
+	data_(data), length_(length) {
+}
+FITS::AbstractDataUnit::AbstractDataUnit(std::unique_ptr<const DeferredData> data, quint64 length):
+	data_(nullptr), length_(length), deferred_(std::move(data)) {
 }
 FITS::AbstractDataUnit::~AbstractDataUnit() = default;
 
 FITS::AbstractDataUnit::VisitorBase::~VisitorBase() = default;
 
-FITS::AbstractDataUnit* FITS::AbstractDataUnit::createFromBitpix(const QString& bitpix, AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 height, quint64 width) {
+FITS::AbstractDataUnit* FITS::AbstractDataUnit::createFromBitpix(const QString& bitpix, AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint64 height, quint64 width, quint64 depth) {
 	FITS::AbstractDataUnit* data_unit;
-	DataUnitCreateHelper c {&data_unit, begin, end, height, width};
+	DataUnitCreateHelper c {&data_unit, begin, end, height, width, depth};
 	bitpixToType(bitpix, c);
 	return data_unit;
 }
-FITS::ImageDataUnit::ImageDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint32 element_size, quint64 height, quint64 width):
-	AbstractDataUnit(begin, end, element_size * height * width),
+FITS::AbstractDataUnit* FITS::AbstractDataUnit::createFromBitpix(const QString& bitpix, std::unique_ptr<const DeferredData> data, quint64 height, quint64 width, quint64 depth) {
+	FITS::AbstractDataUnit* data_unit;
+	DeferredDataUnitCreateHelper c {&data_unit, data, height, width, depth};
+	bitpixToType(bitpix, c);
+	return data_unit;
+}
+FITS::ImageDataUnit::ImageDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end, quint32 element_size, quint64 height, quint64 width, quint64 depth):
+	AbstractDataUnit(begin, end, element_size * height * width, element_size * height * width * depth),
+	height_(height),
+	width_(width),
+	depth_(depth) {
+}
+FITS::ImageDataUnit::ImageDataUnit(const quint8* data, quint32 element_size, quint64 height, quint64 width):
+	AbstractDataUnit(data, element_size * height * width),
+	height_(height),
+	width_(width),
+	depth_(1) {
+}
+FITS::ImageDataUnit::ImageDataUnit(std::unique_ptr<const DeferredData> data, quint32 element_size, quint64 height, quint64 width, quint64 depth):
+	AbstractDataUnit(std::move(data), element_size * height * width),
 	height_(height),
-	width_(width) {
+	width_(width),
+	depth_(depth) {
 }
 FITS::ImageDataUnit::~ImageDataUnit() = default;
 FITS::EmptyDataUnit::EmptyDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end):
 	AbstractDataUnit(begin, end, 0) {
 }
 FITS::EmptyDataUnit::~EmptyDataUnit() = default;
+FITS::TableDataUnit::TableDataUnit(const HeaderUnit& header, AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end):
+	AbstractDataUnit(begin, end,
+		header.header_as<quint64>("NAXIS1") * header.header_as<quint64>("NAXIS2"),
+		header.header_as<quint64>("NAXIS1") * header.header_as<quint64>("NAXIS2") + header.header_as<quint64>("PCOUNT", 0)),
+	rows_(header.header_as<quint64>("NAXIS2")),
+	row_length_(header.header_as<quint64>("NAXIS1")) {
+
+	const quint64 extent = length() + header.header_as<quint64>("PCOUNT", 0);
+	const quint64 theap = header.header_as<quint64>("THEAP", length());
+	if (theap < length() || theap > extent)
+		throw WrongHeaderValue("THEAP", header.header("THEAP"));
+	heap_ = AbstractDataUnit::data() + theap;
+	heap_size_ = extent - theap;
+
+	bool ok = false;
+	const int fields = header.header("TFIELDS").toInt(&ok);
+	if (!ok || fields < 0 || fields > 999)
+		throw WrongHeaderValue("TFIELDS", header.header("TFIELDS"));
+
+	const QRegExp form_regexp("^(\\d*)([LXBIJKAEDCMPQ])([LXBIJKAEDCM]?).*");
+	quint64 offset = 0;
+	for (int i = 1; i <= fields; ++i) {
+		const QString n = QString::number(i);
+		Column column;
+		column.format = HeaderUnit::unquoted(header.header("TFORM" + n));
+		if (!form_regexp.exactMatch(column.format))
+			throw WrongHeaderValue("TFORM" + n, column.format);
+
+		column.name = HeaderUnit::unquoted(header.header("TTYPE" + n, QString()));
+		column.unit = HeaderUnit::unquoted(header.header("TUNIT" + n, QString()));
+		column.type = form_regexp.cap(2).at(0).toLatin1();
+		column.element = (form_regexp.cap(3).isEmpty() ? '\0' : form_regexp.cap(3).at(0).toLatin1());
+		column.repeat = (form_regexp.cap(1).isEmpty() ? 1 : form_regexp.cap(1).toULongLong());
+		column.offset = offset;
+		column.width = (column.type == 'X' ? (column.repeat + 7) / 8 : column.repeat * elementSize(column.type));
+		column.scale = header.header_as<double>("TSCAL" + n, 1.0);
+		column.zero = header.header_as<double>("TZERO" + n, 0.0);
+		column.has_null = (header.headers().count("TNULL" + n) != 0);
+		column.null = header.header_as<qint64>("TNULL" + n, 0);
+		if ((column.type == 'P' || column.type == 'Q') && (column.repeat > 1 || !column.element))
+			throw WrongHeaderValue("TFORM" + n, column.format);
+
+		// TDIMn = '(a,b,...)' is kept when it fits the field
+		QString dimensions = HeaderUnit::unquoted(header.header("TDIM" + n, QString())).remove(' ');
+		quint64 product = 1;
+		if (dimensions.startsWith('(') && dimensions.endsWith(')')) {
+			for (const auto& x: dimensions.mid(1, dimensions.size() - 2).split(',')) {
+				const quint64 dimension = x.toULongLong(&ok);
+				if (!ok) {
+					column.dimensions.clear();
+					break;
+				}
+				column.dimensions.push_back(dimension);
+				product *= dimension;
+			}
+		}
+		if (column.dimensions.empty() || product > column.repeat)
+			column.dimensions.assign(1, column.repeat);
+
+		offset += column.width;
+		columns_.push_back(column);
+	}
+	if (offset != row_length_)
+		throw WrongHeaderValue("NAXIS1", header.header("NAXIS1"));
+}
+FITS::TableDataUnit::~TableDataUnit() = default;
+int FITS::TableDataUnit::elementSize(char type) {
+	switch (type) {
+		case 'L': case 'X': case 'B': case 'A': return 1;
+		case 'I': return 2;
+		case 'J': case 'E': return 4;
+		case 'K': case 'D': case 'C': case 'P': return 8;
+		case 'M': case 'Q': return 16;
+		default: return 0;
+	}
+}
+quint64 FITS::TableDataUnit::readBigEndian(const quint8* data, int bytes) {
+	quint64 value = 0;
+	for (int i = 0; i < bytes; ++i) {
+		value = (value << 8) | data[i];
+	}
+	return value;
+}
+FITS::TableDataUnit::ColumnView FITS::TableDataUnit::view(std::size_t index) const {
+	const auto& column = columns_.at(index);
+	return ColumnView{data() + column.offset, row_length_, rows_, column.width};
+}
+const quint8* FITS::TableDataUnit::array(std::size_t index, quint64 row, quint64* count) const {
+	const auto& column = columns_.at(index);
+	Q_ASSERT(column.type == 'P' || column.type == 'Q');
+	Q_ASSERT(row < rows_);
+
+	*count = 0;
+	if (!column.repeat)
+		return heap_;
+
+	const int size = elementSize(column.type) / 2;
+	const quint8* descriptor = view(index).field(row);
+	const quint64 elements = readBigEndian(descriptor, size);
+	const quint64 offset = readBigEndian(descriptor + size, size);
+	const quint64 element_size = (column.element == 'X' ? 1 : elementSize(column.element));
+	const quint64 bytes = (column.element == 'X' ? (elements + 7) / 8 : elements * element_size);
+	if ((element_size && elements > std::numeric_limits<quint64>::max() / element_size) || offset > heap_size_ || bytes > heap_size_ - offset)
+		return Q_NULLPTR;
+
+	*count = elements;
+	return heap_ + offset;
+}
+void FITS::TableDataUnit::decodeValues(std::size_t index, quint64 first, quint64 count, quint8* dst, int size) const {
+	Q_ASSERT(first <= rows_ && count <= rows_ - first);
+
+	// Gather the fields, then swap the bytes of the contiguous values
+	const auto column = view(index);
+	if (column.width == column.stride) {
+		std::memcpy(dst, column.field(first), count * column.width);
+	} else {
+		for (quint64 row = 0; row < count; ++row) {
+			std::memcpy(dst + row * column.width, column.field(first + row), column.width);
+		}
+	}
+
+	const quint64 values = count * column.width / size;
+	switch (size) {
+		case 2: swapBytes<quint16>(dst, values); break;
+		case 4: swapBytes<quint32>(dst, values); break;
+		case 8: swapBytes<quint64>(dst, values); break;
+	}
+}
+QString FITS::TableDataUnit::text(std::size_t index, quint64 row, int max_elements) const {
+	const auto& column = columns_.at(index);
+	const quint8* field = view(index).field(row);
+
+	switch (column.type) {
+		case 'X':
+			return bitsText(field, column.repeat);
+		case 'P':
+		case 'Q': {
+			quint64 count;
+			const quint8* data = array(index, row, &count);
+			if (!data)
+				return "?";
+			if (column.element == 'X')
+				return bitsText(data, count);
+			const QString text = elementsText(data, count, column.element, column, max_elements);
+			return (count == 1 && column.element != 'A' ? "[" + text + "]" : text);
+		}
+		default:
+			return elementsText(field, column.repeat, column.type, column, max_elements);
+	}
+}
 
 FITS::HeaderDataUnit::HeaderDataUnit(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end):
-	header_(new HeaderUnit(begin, end)) {
+	raw_(begin.data()),
+	header_(new HeaderUnit(begin, end)),
+	header_extent_(static_cast<quint64>(begin.data() - raw_)),
+	data_extent_(0) {
+
+	const quint8* data = begin.data();
+	parseData(begin, end);
+	// The padding of the last HDU may be missing
+	data_extent_ = static_cast<quint64>(std::min(begin.data(), end.data()) - data);
+}
+void FITS::HeaderDataUnit::parseData(AbstractFITSStorage::Page& begin, const AbstractFITSStorage::Page& end) {
 	bool ok = false;
 
+	if (TileCompressedImage::isTileCompressed(*header_)) {
+		// The table with its heap
+		const quint64 extent = header_->header_as<quint64>("NAXIS1") * header_->header_as<quint64>("NAXIS2") + header_->header_as<quint64>("PCOUNT", 0);
+		if (begin.distanceInBytes(end) < extent)
+			throw FITS::UnexpectedEnd();
+
+		std::unique_ptr<TileCompressedImage> image(new TileCompressedImage(*header_, begin.data(), extent));
+		begin.advanceInBytes(extent);
+		header_.reset(new HeaderUnit(TileCompressedImage::imageHeaders(*header_), header_->cards(), header_->cardCount()));
+
+		const quint64 height = (image->depth() ? image->height() : 0);
+		const quint64 width = image->width(), depth = std::max<quint64>(image->depth(), 1);
+		data_.reset(AbstractDataUnit::createFromBitpix(header_->header("BITPIX"), std::unique_ptr<const DeferredData>(image.release()), height, width, depth));
+		return;
+	}
+
+	if (HeaderUnit::unquoted(header_->header("XTENSION", QString())) == "BINTABLE") {
+		data_.reset(new TableDataUnit(*header_, begin, end));
+		return;
+	}
+
 	auto bitpix = header_->header("BITPIX");
 
 	auto naxis = header_->header("NAXIS").toInt(&ok);
-	if (!ok || (naxis != 0 && naxis != 2)) {
+	if (!ok || (naxis != 0 && naxis != 2 && naxis != 3)) {
 		throw FITS::WrongHeaderValue("NAXIS", header_->header("NAXIS"));
 	}
 
@@ -143,8 +484,25 @@ FITS::HeaderDataUnit::HeaderDataUnit(AbstractFITSStorage::Page& begin, const Abs
 			throw FITS::WrongHeaderValue("NAXIS2", header_->header("NAXIS2"));
 		}
 
-		data_.reset(AbstractDataUnit::createFromBitpix(bitpix, begin, end, naxis2, naxis1));
+		// planes
+		quint64 naxis3 = 1;
+		if (naxis == 3) {
+			naxis3 = header_->header("NAXIS3").toULongLong(&ok);
+			if (!ok) {
+				throw FITS::WrongHeaderValue("NAXIS3", header_->header("NAXIS3"));
+			}
+		}
+
+		// Cube without planes is empty image
+		data_.reset(AbstractDataUnit::createFromBitpix(bitpix, begin, end, (naxis3 ? naxis2 : 0), naxis1, std::max<quint64>(naxis3, 1)));
 	} else {
 		data_.reset(new EmptyDataUnit(begin, end));
 	}
 }
+FITS::HeaderDataUnit::HeaderDataUnit(const HeaderDataUnit& cube, quint64 plane):
+	raw_(cube.raw_),
+	header_(new HeaderUnit(cube.header())),
+	data_(cube.data().imageDataUnit()->plane(plane)),
+	header_extent_(cube.header_extent_),
+	data_extent_(cube.data_extent_) {
+}
@@ -0,0 +1,225 @@
+#include <QDateTime>
+#include <QDebug>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <fitscache.h>
+#include <tracer.h>
+
+class FITSCache::Job: public QRunnable {
+private:
+	std::shared_ptr<State> state_;
+	QString filename_;
+	QString key_;
+public:
+	Job(std::shared_ptr<State> state, const QString& filename, const QString& key):
+		state_(std::move(state)),
+		filename_(filename),
+		key_(key) {
+	}
+
+	virtual void run() override {
+		{
+			QMutexLocker locker(&state_->mutex);
+			if (state_->cancelled || state_->find(key_)) {
+				state_->pending.erase(key_);
+				return;
+			}
+		}
+
+		Tracer::Scope trace_scope("FITS prefetch", "cache");
+
+		std::shared_ptr<Entry> entry;
+		try {
+			entry = load(filename_, true);
+		} catch (const std::exception& e) {
+			qWarning() << "Cannot prefetch" << filename_ << ":" << e.what();
+		}
+
+		QMutexLocker locker(&state_->mutex);
+		state_->pending.erase(key_);
+		if (entry && !state_->cancelled)
+			state_->insert(std::move(entry));
+	}
+};
+
+std::shared_ptr<FITSCache::Entry> FITSCache::State::find(const QString& key) {
+	auto it = index.find(key);
+	if (it == index.end())
+		return std::shared_ptr<Entry>();
+
+	// Move to the front
+	entries.splice(entries.begin(), entries, it->second);
+	return *it->second;
+}
+
+std::shared_ptr<FITSCache::Entry> FITSCache::State::insert(std::shared_ptr<Entry> entry) {
+	// Opened concurrently by another thread
+	if (auto existing = find(entry->key))
+		return existing;
+
+	entries.push_front(entry);
+	index[entry->key] = entries.begin();
+	usage += entry->size;
+	evict();
+
+	return entry;
+}
+
+void FITSCache::State::evict() {
+	for (auto it = entries.end(); usage > budget && it != entries.begin(); ) {
+		--it;
+		// Entries in use would stay mapped anyway
+		if (it->use_count() > 1)
+			continue;
+
+		usage -= (*it)->size;
+		index.erase((*it)->key);
+		it = entries.erase(it);
+	}
+}
+
+FITSCache::FITSCache(qint64 budget):
+	state_(std::make_shared<State>()) {
+
+	state_->cancelled = false;
+	state_->budget = budget;
+	state_->usage = 0;
+	state_->hits = 0;
+	state_->misses = 0;
+}
+
+FITSCache::~FITSCache() {
+	QMutexLocker locker(&state_->mutex);
+	state_->cancelled = true;
+}
+
+std::shared_ptr<const FITSCache::Entry> FITSCache::open(const QString& filename) {
+	{
+		QMutexLocker locker(&state_->mutex);
+		if (auto entry = state_->find(key(filename))) {
+			++state_->hits;
+			return entry;
+		}
+		++state_->misses;
+	}
+
+	// The prefetch of the same file, if any, is not waited for, since its
+	// job may not even be started yet
+	auto entry = load(filename, false);
+
+	QMutexLocker locker(&state_->mutex);
+	return state_->insert(std::move(entry));
+}
+
+void FITSCache::prefetch(const QStringList& filenames) {
+	QMutexLocker locker(&state_->mutex);
+
+	qint64 planned = 0;
+	for (const auto& x: state_->entries) {
+		if (x.use_count() > 1)
+			planned += x->size;
+	}
+
+	QStringList keys;
+	for (const auto& filename: filenames) {
+		keys << key(filename);
+	}
+
+	for (int i = 0; i < filenames.size(); ++i) {
+		auto it = state_->index.find(keys[i]);
+		if (it != state_->index.end()) {
+			planned += (*it->second)->size;
+			continue;
+		}
+
+		planned += QFileInfo(filenames[i]).size();
+		if (planned > state_->budget)
+			break;
+
+		if (state_->pending.insert(keys[i]).second)
+			QThreadPool::globalInstance()->start(new Job(state_, filenames[i], keys[i]));
+	}
+
+	// The wanted files are fresher than the rest
+	for (int i = keys.size() - 1; i >= 0; --i) {
+		state_->find(keys[i]);
+	}
+}
+
+void FITSCache::setBudget(qint64 budget) {
+	QMutexLocker locker(&state_->mutex);
+	state_->budget = budget;
+	state_->evict();
+}
+
+qint64 FITSCache::budget() const {
+	QMutexLocker locker(&state_->mutex);
+	return state_->budget;
+}
+
+qint64 FITSCache::usage() const {
+	QMutexLocker locker(&state_->mutex);
+	return state_->usage;
+}
+
+int FITSCache::size() const {
+	QMutexLocker locker(&state_->mutex);
+	return static_cast<int>(state_->entries.size());
+}
+
+bool FITSCache::contains(const QString& filename) const {
+	QMutexLocker locker(&state_->mutex);
+	return state_->index.count(key(filename)) > 0;
+}
+
+quint64 FITSCache::hits() const {
+	QMutexLocker locker(&state_->mutex);
+	return state_->hits;
+}
+
+quint64 FITSCache::misses() const {
+	QMutexLocker locker(&state_->mutex);
+	return state_->misses;
+}
+
+std::shared_ptr<FITSCache::Entry> FITSCache::load(const QString& filename, bool scan) {
+	Tracer::Scope trace_scope("FITS open", "cache");
+
+	auto entry = std::make_shared<Entry>();
+	entry->filename = filename;
+	// Taken before the file is read, so a rewrite meanwhile is not missed
+	entry->key = key(filename);
+	entry->frame = Sequence::open(Sequence::Frame{filename, -1});
+	if (scan)
+		entry->statistics = std::make_shared<OpenGLTexture::Statistics>(OpenGLTexture::scan(*entry->frame.hdu));
+	entry->size = QFileInfo(filename).size();
+
+	return entry;
+}
+
+QString FITSCache::key(const QString& filename) {
+	const QFileInfo file_info(filename);
+
+	return filename + QString("@") + QString::number(file_info.size())
+		+ QString(":") + QString::number(file_info.lastModified().toMSecsSinceEpoch());
+}
+
+std::vector<int> FITSCache::prefetchOrder(int index, int direction, int count, int depth) {
+	std::vector<int> order;
+
+	for (int i = 1; i <= depth; ++i) {
+		const int x = index + i * direction;
+		if (x < 0 || x >= count)
+			break;
+		order.push_back(x);
+	}
+
+	const int behind = index - direction;
+	if (behind >= 0 && behind < count)
+		order.push_back(behind);
+
+	return order;
+}
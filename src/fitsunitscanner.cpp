@@ -0,0 +1,72 @@
+#include <cstdlib>
+#include <cstring>
+
+#include <abstractfitsstorage.h>
+#include <fits.h>
+#include <fitsunitscanner.h>
+
+FITSUnitScanner::FITSUnitScanner(std::vector<Unit>* units):
+	units_(units),
+	next_(0),
+	done_(false) {
+
+	unit_.begin = 0;
+}
+
+namespace {
+	QString card(const std::map<QString, QString>& cards, const QString& key, const QString& def) {
+		auto it = cards.find(key);
+		return (it != cards.end() ? it->second : def);
+	}
+}
+
+quint64 FITSUnitScanner::dataLength(const std::map<QString, QString>& cards) {
+	const int naxis = card(cards, "NAXIS", "0").toInt();
+	const int bitpix = card(cards, "BITPIX", "0").toInt();
+	quint64 elements = (naxis > 0 ? 1 : 0);
+	for (int i = 1; i <= naxis; ++i) {
+		elements *= card(cards, QString("NAXIS%1").arg(i), "0").toULongLong();
+	}
+	const quint64 pcount = card(cards, "PCOUNT", "0").toULongLong();
+	const quint64 gcount = card(cards, "GCOUNT", "1").toULongLong();
+	return static_cast<quint64>(std::abs(bitpix) / 8) * gcount * (pcount + elements);
+}
+
+void FITSUnitScanner::finishHeader(const std::map<QString, QString>& cards) {
+	const int naxis = card(cards, "NAXIS", "0").toInt();
+	const quint64 length = dataLength(cards);
+
+	unit_.data = next_;
+	unit_.end = next_ + (length + 2879) / 2880 * 2880;
+	unit_.image = (naxis == 2 || naxis == 3);
+	units_->push_back(unit_);
+
+	// FITS parses the extensions only when the primary header allows them
+	if (units_->size() == 1 && card(cards, "EXTEND", "F") != "T")
+		done_ = true;
+
+	next_ = unit_.end;
+	unit_.begin = next_;
+}
+
+bool FITSUnitScanner::hasEnd(const quint8* block) {
+	for (const quint8* record = block; record != block + 2880; record += 80) {
+		if (std::memcmp(record, "END     ", 8) == 0)
+			return true;
+	}
+	return false;
+}
+
+void FITSUnitScanner::advance(const quint8* data, quint64 size) {
+	while (!done_ && next_ + 2880 <= size) {
+		const bool found_end = hasEnd(data + next_);
+		next_ += 2880;
+
+		// The cards are parsed by FITS once the whole header is at hand
+		if (found_end) {
+			AbstractFITSStorage::Page begin(const_cast<quint8*>(data + unit_.begin));
+			const AbstractFITSStorage::Page end(const_cast<quint8*>(data + next_));
+			finishHeader(FITS::HeaderUnit(begin, end).headers());
+		}
+	}
+}
@@ -0,0 +1,164 @@
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <framebands.h>
+#include <parallel.h>
+#include <tracer.h>
+
+namespace {
+	template<class T> struct BigEndian {
+		static inline T value(const quint8* data) { return qFromBigEndian<T>(data); }
+	};
+	template<> struct BigEndian<float> {
+		static inline float value(const quint8* data) {
+			const quint32 bits = qFromBigEndian<quint32>(data);
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+	};
+	template<> struct BigEndian<double> {
+		static inline double value(const quint8* data) {
+			const quint64 bits = qFromBigEndian<quint64>(data);
+			double value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+	};
+
+	const std::pair<double, double> empty_minmax(std::numeric_limits<double>::infinity(), -std::numeric_limits<double>::infinity());
+
+	// Rows of the band, the last one may be shorter
+	inline quint64 rowsOfBand(quint64 band, quint64 band_rows, quint64 height) {
+		return std::min(band_rows, height - band * band_rows);
+	}
+
+	struct Scanner {
+		quint64 band_rows;
+		quint64 width;
+		quint64 height;
+		bool full;  // The shape has changed, every band is changed
+		std::vector<quint64>* fingerprints;
+		std::vector<std::pair<double, double>>* minmax;
+		std::vector<char>* changed;
+
+		template<class T> void operator() (const FITS::DataUnit<T>& data) const {
+			const auto bytes = reinterpret_cast<const quint8*>(data.data());
+			const quint64 row_bytes = width * sizeof(T);
+			const int count = static_cast<int>(fingerprints->size());
+
+			// Bands are independent, so they are both hashed and scanned by the same thread
+			parallelFor(count, 1, [this, bytes, row_bytes] (int begin, int end) {
+				for (int band = begin; band < end; ++band) {
+					const auto first = bytes + band * band_rows * row_bytes;
+					const quint64 size = rowsOfBand(band, band_rows, height) * row_bytes;
+
+					const quint64 fingerprint = FrameBands::fingerprint(first, size);
+					if (!full && fingerprint == (*fingerprints)[band])
+						continue;
+					(*fingerprints)[band] = fingerprint;
+					(*changed)[band] = 1;
+
+					auto band_minmax = empty_minmax;
+					for (auto p = first; p < first + size; p += sizeof(T)) {
+						const double value = BigEndian<T>::value(p);
+						// NaN fails both comparisons
+						if (value < band_minmax.first)
+							band_minmax.first = value;
+						if (value > band_minmax.second)
+							band_minmax.second = value;
+					}
+					(*minmax)[band] = band_minmax;
+				}
+			});
+		}
+
+		void operator() (const FITS::EmptyDataUnit&) const {
+			Q_ASSERT(0);
+		}
+		void operator() (const FITS::TableDataUnit&) const {
+			Q_ASSERT(0);
+		}
+	};
+}
+
+FrameBands::FrameBands(quint64 band_rows):
+	band_rows_(std::max<quint64>(band_rows, 1)),
+	width_(0),
+	height_(0),
+	bitpix_(0),
+	bscale_(1),
+	bzero_(0) {
+}
+
+quint64 FrameBands::fingerprint(const quint8* data, quint64 size) {
+	static const quint64 multiplier = Q_UINT64_C(0x9e3779b97f4a7c15);
+
+	quint64 hash = size * multiplier;
+	quint64 offset = 0;
+	for (; offset + sizeof(quint64) <= size; offset += sizeof(quint64)) {
+		quint64 word;
+		std::memcpy(&word, data + offset, sizeof(word));
+		hash = (hash ^ word) * multiplier;
+		hash ^= hash >> 29;
+	}
+	quint64 tail = 0;
+	std::memcpy(&tail, data + offset, size - offset);
+	hash = (hash ^ tail) * multiplier;
+	return hash ^ (hash >> 32);
+}
+
+std::vector<FrameBands::Band> FrameBands::update(const FITS::HeaderDataUnit& hdu) {
+	Tracer::Scope trace_scope("frame bands update", "watch");
+
+	const auto image = hdu.data().imageDataUnit();
+	Q_ASSERT(image);
+
+	const int bitpix = hdu.header().header_as<int>("BITPIX");
+	const bool full = (image->width() != width_ || image->height() != height_ || bitpix != bitpix_);
+	if (full) {
+		width_ = image->width();
+		height_ = image->height();
+		bitpix_ = bitpix;
+		const quint64 count = (height_ + band_rows_ - 1) / band_rows_;
+		fingerprints_.assign(count, 0);
+		minmax_.assign(count, empty_minmax);
+	}
+	bscale_ = hdu.header().bscale();
+	bzero_ = hdu.header().bzero();
+
+	std::vector<char> changed(fingerprints_.size(), 0);
+	hdu.data().apply(Scanner{band_rows_, width_, height_, full, &fingerprints_, &minmax_, &changed});
+
+	std::vector<Band> bands;
+	for (quint64 band = 0; band < changed.size(); ++band) {
+		if (!changed[band])
+			continue;
+		const quint64 rows = rowsOfBand(band, band_rows_, height_);
+		if (!bands.empty() && bands.back().first_row + bands.back().rows == band * band_rows_) {
+			bands.back().rows += rows;
+		} else {
+			bands.push_back(Band{band * band_rows_, rows});
+		}
+	}
+	return bands;
+}
+
+std::pair<double, double> FrameBands::minmax() const {
+	auto raw = empty_minmax;
+	for (const auto& band: minmax_) {
+		raw.first = std::min(raw.first, band.first);
+		raw.second = std::max(raw.second, band.second);
+	}
+	// Image of NaN only
+	if (raw.first > raw.second)
+		return std::make_pair(0.0, 0.0);
+
+	auto minmax = std::make_pair(raw.first * bscale_ + bzero_, raw.second * bscale_ + bzero_);
+	if (minmax.first > minmax.second)
+		std::swap(minmax.first, minmax.second);
+	return minmax;
+}
@@ -0,0 +1,242 @@
+#include <QTextStream>
+
+#include <algorithm>
+
+#include <frameprofiler.h>
+#include <tracer.h>
+
+namespace {
+	bool timerQueriesSupported() {
+#if !defined(QT_OPENGL_ES_2)
+		auto context = QOpenGLContext::currentContext();
+
+		return context && !context->isOpenGLES() && (
+			context->format().version() >= qMakePair(3, 3) ||
+			context->hasExtension("GL_ARB_timer_query") ||
+			context->hasExtension("GL_EXT_timer_query"));
+#else
+		return false;
+#endif
+	}
+
+	inline double toMilliseconds(qint64 nsecs) {
+		return nsecs / 1e6;
+	}
+}
+
+const std::size_t FrameProfiler::History::capacity;
+
+FrameProfiler::History::History():
+	size_(0),
+	next_(0) {
+}
+
+void FrameProfiler::History::push(double value) {
+	values_[next_] = value;
+	next_ = (next_ + 1) % capacity;
+	size_ = std::min(size_ + 1, capacity);
+}
+
+FrameProfiler::Percentiles FrameProfiler::History::percentiles() const {
+	if (size_ == 0)
+		return Percentiles{0, 0, 0};
+
+	std::array<double, capacity> sorted;
+	std::copy(values_.begin(), values_.begin() + size_, sorted.begin());
+	std::sort(sorted.begin(), sorted.begin() + size_);
+
+	auto at = [&sorted, this] (double p) {
+		return sorted[std::min(static_cast<std::size_t>(p * size_), size_ - 1)];
+	};
+
+	return Percentiles{at(0.50), at(0.95), at(0.99)};
+}
+
+const char* const FrameProfiler::phase_names_[FrameProfiler::PhaseCount] = {
+	"uniforms",
+	"bind",
+	"draw",
+};
+
+FrameProfiler::FrameProfiler():
+	frame_begin_(0),
+	phase_begin_(0),
+	swap_pending_(false),
+	frames_(0),
+#if !defined(QT_OPENGL_ES_2)
+	monitor_index_(0),
+	monitor_recording_(false),
+#endif
+	gpu_timing_(false) {
+}
+
+FrameProfiler::~FrameProfiler() = default;
+
+void FrameProfiler::initialize() {
+	gpu_timing_ = false;
+
+#if !defined(QT_OPENGL_ES_2)
+	if (!timerQueriesSupported())
+		return;
+
+	for (auto& x: monitors_) {
+		x.monitor.reset(new QOpenGLTimeMonitor);
+		x.monitor->setSampleCount(PhaseCount + 1);
+		x.pending = false;
+		if (!x.monitor->create()) {
+			destroy();
+			return;
+		}
+	}
+
+	gpu_timing_ = true;
+#endif
+}
+
+void FrameProfiler::destroy() {
+#if !defined(QT_OPENGL_ES_2)
+	for (auto& x: monitors_) {
+		x.monitor.reset();
+		x.pending = false;
+	}
+	monitor_recording_ = false;
+#endif
+	gpu_timing_ = false;
+}
+
+#if !defined(QT_OPENGL_ES_2)
+void FrameProfiler::collectMonitors() {
+	auto& tracer = Tracer::instance();
+
+	for (auto& x: monitors_) {
+		if (!x.pending || !x.monitor->isResultAvailable())
+			continue;
+
+		const auto intervals = x.monitor->waitForIntervals();
+		qint64 begin = x.frame_begin;
+		qint64 total = 0;
+		for (int i = 0; i < intervals.size() && i < PhaseCount; ++i) {
+			const auto duration = static_cast<qint64>(intervals[i]);
+			// GPU clock is not synchronized with CPU one, events are aligned to the CPU frame begin
+			tracer.addEvent(phase_names_[i], "gpu", begin, duration, Tracer::gpu_thread_id);
+			begin += duration;
+			total += duration;
+		}
+		gpu_time_.push(toMilliseconds(total));
+
+		x.monitor->reset();
+		x.pending = false;
+	}
+}
+#endif
+
+void FrameProfiler::beginFrame() {
+	frame_begin_ = Tracer::instance().now();
+	phase_begin_ = frame_begin_;
+
+#if !defined(QT_OPENGL_ES_2)
+	if (gpu_timing_) {
+		collectMonitors();
+
+		// Skip GPU timing of the frame when all the monitors are still in flight
+		auto& x = monitors_[monitor_index_];
+		monitor_recording_ = !x.pending;
+		if (monitor_recording_) {
+			x.frame_begin = frame_begin_;
+			x.monitor->recordSample();
+		}
+	}
+#endif
+}
+
+void FrameProfiler::endPhase(Phase phase) {
+	const auto now = Tracer::instance().now();
+
+	Tracer::instance().addEvent(phase_names_[phase], "frame", phase_begin_, now - phase_begin_);
+	phase_begin_ = now;
+
+#if !defined(QT_OPENGL_ES_2)
+	if (monitor_recording_)
+		monitors_[monitor_index_].monitor->recordSample();
+#endif
+}
+
+void FrameProfiler::endFrame() {
+	const auto now = Tracer::instance().now();
+
+	cpu_time_.push(toMilliseconds(now - frame_begin_));
+	swap_pending_ = true;
+	++frames_;
+
+#if !defined(QT_OPENGL_ES_2)
+	if (monitor_recording_) {
+		monitors_[monitor_index_].pending = true;
+		monitor_index_ = (monitor_index_ + 1) % monitor_count_;
+		monitor_recording_ = false;
+	}
+#endif
+}
+
+void FrameProfiler::frameSwapped() {
+	if (!swap_pending_)
+		return;
+
+	const auto now = Tracer::instance().now();
+
+	Tracer::instance().addEvent("frame", "frame", frame_begin_, now - frame_begin_);
+	frame_time_.push(toMilliseconds(now - frame_begin_));
+	swap_pending_ = false;
+}
+
+QString FrameProfiler::summary() const {
+	QString summary;
+	QTextStream stream(&summary);
+	stream.setRealNumberNotation(QTextStream::FixedNotation);
+	stream.setRealNumberPrecision(2);
+
+	auto print = [&stream] (const char* title, const History& history) {
+		const auto p = history.percentiles();
+		stream << title << "  p50 " << p.p50 << "  p95 " << p.p95 << "  p99 " << p.p99 << " ms\n";
+	};
+
+	stream << "Frames: " << frames_ << "\n";
+	print("Frame", frame_time_);
+	print("CPU  ", cpu_time_);
+	if (gpu_timing_) {
+		print("GPU  ", gpu_time_);
+	} else {
+		stream << "GPU   timer queries are not supported\n";
+	}
+	stream.flush();
+
+	return summary;
+}
+
+GPUTraceScope::GPUTraceScope(const char* name, const char* category):
+	name_(name),
+	category_(category),
+	begin_(Tracer::instance().now()) {
+
+#if !defined(QT_OPENGL_ES_2)
+	if (!Tracer::instance().isEnabled() || !timerQueriesSupported())
+		return;
+
+	query_.reset(new QOpenGLTimerQuery);
+	if (!query_->create()) {
+		query_.reset();
+		return;
+	}
+	query_->begin();
+#endif
+}
+
+GPUTraceScope::~GPUTraceScope() {
+#if !defined(QT_OPENGL_ES_2)
+	if (!query_)
+		return;
+
+	query_->end();
+	const auto duration = static_cast<qint64>(query_->waitForResult());
+	Tracer::instance().addEvent(name_, category_, begin_, duration, Tracer::gpu_thread_id);
+#endif
+}
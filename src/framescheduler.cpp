@@ -0,0 +1,70 @@
+#include <framescheduler.h>
+
+FrameScheduler::FrameScheduler():
+	dirty_(0),
+	pending_(false),
+	request_time_(0),
+	in_flight_(false),
+	in_flight_request_time_(0),
+	frame_interval_(0),
+	requested_(0),
+	coalesced_(0),
+	rendered_(0),
+	skipped_(0),
+	dropped_(0) {
+
+	setRefreshRate(60.0);
+}
+
+void FrameScheduler::setRefreshRate(double refresh_rate) {
+	if (refresh_rate > 0)
+		frame_interval_ = static_cast<qint64>(1e9 / refresh_rate);
+}
+
+bool FrameScheduler::request(int dirty, qint64 now) {
+	dirty_ |= dirty;
+	++requested_;
+
+	if (pending_) {
+		++coalesced_;
+		return false;
+	}
+
+	pending_ = true;
+	request_time_ = now;
+	return true;
+}
+
+int FrameScheduler::beginFrame() {
+	const int dirty = dirty_;
+
+	// Frames may also be painted on Qt demand, e.g. after resize, those are not timed
+	in_flight_ = (dirty && pending_);
+	in_flight_request_time_ = request_time_;
+	pending_ = false;
+	dirty_ = 0;
+
+	if (dirty) {
+		++rendered_;
+	} else {
+		++skipped_;
+	}
+
+	return dirty;
+}
+
+void FrameScheduler::frameSwapped(qint64 now) {
+	if (!in_flight_)
+		return;
+	in_flight_ = false;
+
+	// Ideally the frame is presented at the first refresh after the request
+	const auto latency = now - in_flight_request_time_;
+	if (latency > frame_interval_)
+		dropped_ += static_cast<quint64>((latency - 1) / frame_interval_);
+}
+
+QString FrameScheduler::summary() const {
+	return QString("Requests: %1, coalesced %2\nFrames: rendered %3, skipped %4, dropped %5\n")
+		.arg(requested_).arg(coalesced_).arg(rendered_).arg(skipped_).arg(dropped_);
+}
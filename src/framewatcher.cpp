@@ -0,0 +1,91 @@
+#include <QDir>
+#include <QFileInfo>
+
+#include <fits.h>
+#include <framewatcher.h>
+
+bool FrameWatcher::Snapshot::operator== (const Snapshot& other) const {
+	return filename == other.filename && size == other.size && modified == other.modified;
+}
+
+FrameWatcher::FrameWatcher(const QString& path, QObject* parent):
+	QObject(parent),
+	path_(QFileInfo(path).absoluteFilePath()),
+	directory_(QFileInfo(path).isDir()),
+	candidate_{QString(), -1, QDateTime()},
+	reported_{QString(), -1, QDateTime()} {
+
+	settle_timer_.setSingleShot(true);
+	settle_timer_.setInterval(settle_interval);
+	connect(&settle_timer_, SIGNAL(timeout()), this, SLOT(settle()));
+	connect(&watcher_, SIGNAL(fileChanged(const QString&)), this, SLOT(notifyChanged()));
+	connect(&watcher_, SIGNAL(directoryChanged(const QString&)), this, SLOT(notifyChanged()));
+
+	// Replacement of the file is seen by the watch of its directory only
+	watcher_.addPath(directory_ ? path_ : QFileInfo(path_).absolutePath());
+
+	const auto filename = current();
+	if (!filename.isEmpty()) {
+		watchFile(filename);
+		reported_ = snapshot(filename);
+	}
+}
+
+QString FrameWatcher::current() const {
+	return (directory_ ? newestFile() : path_);
+}
+
+QString FrameWatcher::newestFile() const {
+	const auto entries = QDir(path_).entryInfoList(FITS::nameFilters(), QDir::Files | QDir::Readable, QDir::Time);
+	return (entries.isEmpty() ? QString() : entries.first().absoluteFilePath());
+}
+
+FrameWatcher::Snapshot FrameWatcher::snapshot(const QString& filename) const {
+	const QFileInfo info(filename);
+	if (!info.exists())
+		return Snapshot{filename, -1, QDateTime()};
+	return Snapshot{filename, info.size(), info.lastModified()};
+}
+
+void FrameWatcher::watchFile(const QString& filename) {
+	// The watch is dropped when the file is replaced, so it is added again
+	if (watcher_.files().contains(filename))
+		return;
+
+	if (!watcher_.files().isEmpty())
+		watcher_.removePaths(watcher_.files());
+	if (QFileInfo(filename).exists())
+		watcher_.addPath(filename);
+}
+
+void FrameWatcher::notifyChanged() {
+	const auto filename = current();
+	if (!filename.isEmpty())
+		candidate_ = snapshot(filename);
+
+	// Restarted by every write, so it fires when the writing is over
+	settle_timer_.start();
+}
+
+void FrameWatcher::settle() {
+	const auto filename = current();
+	if (filename.isEmpty())
+		return;
+	watchFile(filename);
+
+	// The file has changed since the last notification
+	const auto state = snapshot(filename);
+	if (state != candidate_) {
+		candidate_ = state;
+		settle_timer_.start();
+		return;
+	}
+	// Incomplete file, the rest of it comes with the next notification
+	if (state.size <= 0 || state.size % 2880 != 0)
+		return;
+
+	if (state == reported_)
+		return;
+	reported_ = state;
+	emit frameChanged(filename);
+}
@@ -0,0 +1,466 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#include <zlib.h>
+
+#include <cachefile.h>
+#include <fitsunitscanner.h>
+#include <gzipfitsstorage.h>
+#include <parallel.h>
+#include <tracer.h>
+
+namespace {
+	typedef GzipFITSStorage::Index Index;
+
+	const quint64 page_size = 4096;
+	const quint64 window_size = 32768;
+	// Input and output handed to zlib at once, avail_in and avail_out are 32-bit
+	const quint64 max_chunk = Q_UINT64_C(1) << 30;
+
+	const quint32 file_magic = 0x46475a49;  // "FGZI"
+	const quint32 file_version = 1;
+
+	bool isMember(const quint8* in, quint64 size, quint64 offset) {
+		return offset + 2 <= size && in[offset] == 0x1f && in[offset + 1] == 0x8b;
+	}
+
+	/* Page-aligned buffer. Pages of large calloc() blocks are mapped on
+	 * demand, so the ranges which are never written take no memory. */
+	class Buffer {
+	private:
+		void* block_;
+		quint8* data_;
+		quint64 capacity_;
+
+		static quint8* align(void* block) {
+			return reinterpret_cast<quint8*>((reinterpret_cast<quintptr>(block) + page_size - 1) & ~static_cast<quintptr>(page_size - 1));
+		}
+	public:
+		explicit Buffer(quint64 capacity):
+			block_(std::calloc(capacity + page_size, 1)),
+			data_(align(block_)),
+			capacity_(capacity) {
+
+			if (!block_)
+				throw GzipFITSStorage::Exception("Not enough memory to inflate the file");
+		}
+		~Buffer() {
+			std::free(block_);
+		}
+		Buffer(const Buffer&) = delete;
+		Buffer& operator=(const Buffer&) = delete;
+
+		inline quint8* data() const { return data_; }
+		inline quint64 capacity() const { return capacity_; }
+
+		// Keeps the first used bytes
+		void grow(quint64 capacity, quint64 used) {
+			Buffer other(capacity);
+			std::memcpy(other.data_, data_, used);
+			std::swap(block_, other.block_);
+			std::swap(data_, other.data_);
+			std::swap(capacity_, other.capacity_);
+		}
+
+		void* release() {
+			void* block = block_;
+			block_ = Q_NULLPTR;
+			return block;
+		}
+	};
+
+	/* Member points of BGZF stream, the members carry their compressed size
+	 * in BC subfield of the header and the inflated size in the trailer.
+	 * Returns false for other streams. */
+	bool bgzfPoints(const quint8* in, quint64 size, std::vector<Index::Point>* points, quint64* inflated_size) {
+		quint64 offset = 0, out = 0;
+
+		while (offset < size) {
+			const quint8* header = in + offset;
+			if (size - offset < 12 || !isMember(in, size, offset) || header[2] != 8 || !(header[3] & 4))
+				return false;
+
+			const quint64 xlen = header[10] | (header[11] << 8);
+			if (size - offset < 12 + xlen)
+				return false;
+
+			quint64 member_size = 0;
+			for (quint64 x = 12; x + 4 <= 12 + xlen; ) {
+				const quint64 slen = header[x + 2] | (header[x + 3] << 8);
+				if (header[x] == 'B' && header[x + 1] == 'C' && slen == 2 && x + 6 <= 12 + xlen)
+					member_size = (header[x + 4] | (header[x + 5] << 8)) + 1;
+				x += 4 + slen;
+			}
+			if (member_size < 12 + xlen + 8 || member_size > size - offset)
+				return false;
+
+			const quint8* trailer = header + member_size - 4;
+			const quint64 isize = trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (static_cast<quint64>(trailer[3]) << 24);
+
+			points->push_back(Index::Point{offset, out, 0, true, QByteArray()});
+			offset += member_size;
+			out += isize;
+		}
+
+		*inflated_size = out;
+		return !points->empty();
+	}
+
+	void feed(z_stream* strm, const quint8* in, quint64 size) {
+		if (strm->avail_in == 0) {
+			const quint64 offset = strm->next_in - in;
+			strm->avail_in = static_cast<uInt>(std::min(size - offset, max_chunk));
+		}
+	}
+
+	/* Inflates [begin, end) of the data starting at the point, which is
+	 * not after begin. Returns false for corrupted stream. */
+	bool inflateRange(const quint8* in, quint64 size, const Index::Point& point, quint64 begin, quint64 end, quint8* out) {
+		z_stream strm;
+		std::memset(&strm, 0, sizeof(strm));
+		bool raw = !point.member;
+		if (inflateInit2(&strm, raw ? -15 : 31) != Z_OK)
+			return false;
+
+		bool ok = true;
+		if (raw && point.bits)
+			ok = (point.in > 0 && inflatePrime(&strm, point.bits, in[point.in - 1] >> (8 - point.bits)) == Z_OK);
+		if (ok && raw && !point.window.isEmpty())
+			ok = (inflateSetDictionary(&strm, reinterpret_cast<const Bytef*>(point.window.constData()), point.window.size()) == Z_OK);
+
+		// The data before begin is inflated into the scratch and discarded
+		std::vector<quint8> scratch(begin > point.out ? window_size : 0);
+		strm.next_in = const_cast<Bytef*>(in + point.in);
+		quint64 position = point.out;
+
+		while (ok && position < end) {
+			feed(&strm, in, size);
+
+			const bool skip = (position < begin);
+			const quint64 available = std::min((skip ? begin : end) - position, skip ? window_size : max_chunk);
+			strm.next_out = (skip ? scratch.data() : out + position);
+			strm.avail_out = static_cast<uInt>(available);
+
+			const int ret = ::inflate(&strm, Z_NO_FLUSH);
+			const quint64 produced = available - strm.avail_out;
+			position += produced;
+
+			if (ret == Z_STREAM_END) {
+				if (position >= end)
+					break;
+
+				// Raw inflate leaves the trailer of the member
+				const quint64 offset = (strm.next_in - in) + (raw ? 8 : 0);
+				ok = (isMember(in, size, offset) && inflateReset2(&strm, 31) == Z_OK);
+				strm.next_in = const_cast<Bytef*>(in + offset);
+				strm.avail_in = 0;
+				raw = false;
+			} else if (ret != Z_OK && !(ret == Z_BUF_ERROR && produced > 0)) {
+				ok = false;
+			}
+		}
+
+		inflateEnd(&strm);
+		return ok;
+	}
+
+	struct Range {
+		quint64 begin;
+		quint64 end;
+	};
+
+	// Inflates the ranges of the data in parallel, starting from the nearest points
+	void inflateRanges(const quint8* in, quint64 size, const std::vector<Index::Point>& points, const std::vector<Range>& ranges, quint8* out) {
+		Tracer::Scope trace_scope("gzip inflate ranges", "startup");
+
+		struct Chunk {
+			const Index::Point* point;
+			Range range;
+		};
+		std::vector<Chunk> chunks;
+
+		for (const auto& range: ranges) {
+			auto it = std::upper_bound(points.begin(), points.end(), range.begin, [] (quint64 x, const Index::Point& point) {
+				return x < point.out;
+			});
+			Q_ASSERT(it != points.begin());
+
+			for (--it; it != points.end() && it->out < range.end; ++it) {
+				const auto next = it + 1;
+				const Range chunk{std::max(range.begin, it->out), std::min(range.end, next != points.end() ? next->out : range.end)};
+				if (chunk.begin < chunk.end)
+					chunks.push_back(Chunk{&(*it), chunk});
+			}
+		}
+
+		std::atomic<bool> failed(false);
+		parallelFor(static_cast<int>(chunks.size()), 1, [&] (int begin, int end) {
+			for (int i = begin; i < end; ++i) {
+				if (!inflateRange(in, size, *chunks[i].point, chunks[i].range.begin, chunks[i].range.end, out))
+					failed.store(true);
+			}
+		});
+
+		if (failed.load())
+			throw GzipFITSStorage::Exception("The gzip stream is corrupted");
+	}
+
+	/* Inflates the whole stream, taking seek points every span bytes of the
+	 * data and at every member. Returns the size of the data. */
+	quint64 inflateIndexed(const quint8* in, quint64 size, Buffer* buffer, Index* index, FITSUnitScanner* scanner) {
+		Tracer::Scope trace_scope("gzip inflate indexed", "startup");
+
+		z_stream strm;
+		std::memset(&strm, 0, sizeof(strm));
+		if (inflateInit2(&strm, 31) != Z_OK)
+			throw GzipFITSStorage::Exception("Cannot initialize zlib");
+
+		index->points.push_back(Index::Point{0, 0, 0, true, QByteArray()});
+		strm.next_in = const_cast<Bytef*>(in);
+		quint64 position = 0, last = 0;
+		QString error;
+
+		for (;;) {
+			feed(&strm, in, size);
+
+			if (position == buffer->capacity())
+				buffer->grow(2 * buffer->capacity(), position);
+			const quint64 available = std::min(buffer->capacity() - position, max_chunk);
+			strm.next_out = buffer->data() + position;
+			strm.avail_out = static_cast<uInt>(available);
+
+			const int ret = ::inflate(&strm, Z_BLOCK);
+			const quint64 produced = available - strm.avail_out;
+			position += produced;
+			scanner->advance(buffer->data(), position);
+
+			if (ret == Z_STREAM_END) {
+				// Trailing garbage is ignored as gzip does
+				const quint64 offset = strm.next_in - in;
+				if (!isMember(in, size, offset))
+					break;
+
+				inflateReset(&strm);
+				index->points.push_back(Index::Point{offset, position, 0, true, QByteArray()});
+				last = position;
+				continue;
+			}
+			if (ret == Z_BUF_ERROR && produced == 0) {
+				error = "Unexpected end of the gzip stream";
+				break;
+			}
+			if (ret != Z_OK && ret != Z_BUF_ERROR) {
+				error = QString("The gzip stream is corrupted: ") + (strm.msg ? strm.msg : "");
+				break;
+			}
+
+			// Block boundary which is not the end of the member
+			if ((strm.data_type & 128) && !(strm.data_type & 64) && position - last >= GzipFITSStorage::span) {
+				const quint64 window = std::min(position, window_size);
+				const auto window_data = reinterpret_cast<const char*>(buffer->data() + position - window);
+				index->points.push_back(Index::Point{static_cast<quint64>(strm.next_in - in), position, strm.data_type & 7, false, QByteArray(window_data, static_cast<int>(window))});
+				last = position;
+			}
+		}
+
+		inflateEnd(&strm);
+		if (!error.isEmpty())
+			throw GzipFITSStorage::Exception(error);
+
+		return position;
+	}
+
+	QString indexPath(const QString& directory, const QFileInfo& file_info) {
+		const auto key = QCryptographicHash::hash(file_info.canonicalFilePath().toUtf8(), QCryptographicHash::Sha1).toHex();
+		return directory + QString("/") + QString::fromLatin1(key) + QString(".idx");
+	}
+
+	// Index of the file which has been modified since is stale
+	bool loadIndex(const QString& path, const QFileInfo& file_info, Index* index) {
+		QFile file(path);
+		if (!file.open(QIODevice::ReadOnly))
+			return false;
+
+		QDataStream stream(&file);
+		quint32 magic = 0, version = 0;
+		quint64 file_size = 0, point_count = 0, unit_count = 0;
+		qint64 modified = 0;
+		stream >> magic >> version >> file_size >> modified >> index->size >> point_count;
+		if (stream.status() != QDataStream::Ok || magic != file_magic || version != file_version) {
+			file.remove();
+			return false;
+		}
+		if (file_size != static_cast<quint64>(file_info.size()) || modified != file_info.lastModified().toMSecsSinceEpoch())
+			return false;
+
+		for (quint64 i = 0; i < point_count && stream.status() == QDataStream::Ok; ++i) {
+			Index::Point point;
+			qint32 bits = 0;
+			QByteArray window;
+			stream >> point.in >> point.out >> bits >> point.member >> window;
+			point.bits = bits;
+			point.window = (window.isEmpty() ? window : qUncompress(window));
+			index->points.push_back(point);
+		}
+		stream >> unit_count;
+		for (quint64 i = 0; i < unit_count && stream.status() == QDataStream::Ok; ++i) {
+			Index::Unit unit;
+			stream >> unit.begin >> unit.data >> unit.end >> unit.image;
+			index->units.push_back(unit);
+		}
+
+		if (stream.status() != QDataStream::Ok || index->points.empty() || index->points.front().out != 0) {
+			file.remove();
+			*index = Index();
+			return false;
+		}
+		return true;
+	}
+
+	bool saveIndex(const QString& path, const QFileInfo& file_info, const Index& index) {
+		return writeCacheFile(path, [&] (QDataStream& stream) {
+			stream << file_magic << file_version << static_cast<quint64>(file_info.size()) << file_info.lastModified().toMSecsSinceEpoch();
+			stream << index.size << static_cast<quint64>(index.points.size());
+			for (const auto& point: index.points) {
+				stream << point.in << point.out << static_cast<qint32>(point.bits) << point.member << (point.window.isEmpty() ? point.window : qCompress(point.window));
+			}
+			stream << static_cast<quint64>(index.units.size());
+			for (const auto& unit: index.units) {
+				stream << unit.begin << unit.data << unit.end << unit.image;
+			}
+		});
+	}
+
+	// Unit to be inflated by later opens, -1 when there is none
+	int targetUnit(const std::vector<Index::Unit>& units, int hdu_index) {
+		if (hdu_index == GzipFITSStorage::whole_file)
+			return -1;
+		if (hdu_index >= 0)
+			return (hdu_index < static_cast<int>(units.size()) ? hdu_index : -1);
+
+		for (std::size_t i = 0; i < units.size(); ++i) {
+			if (units[i].image)
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+}
+
+struct GzipFITSStorage::Inflated {
+	void* block;
+	quint8* data;
+	quint64 size;
+	Index index;
+	bool partial;
+};
+
+GzipFITSStorage::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void GzipFITSStorage::Exception::raise() const {
+	throw *this;
+}
+QException* GzipFITSStorage::Exception::clone() const {
+	return new GzipFITSStorage::Exception(*this);
+}
+
+GzipFITSStorage::GzipFITSStorage(QFileDevice* file_device, int hdu_index, const QString& index_directory):
+	GzipFITSStorage(inflate(std::unique_ptr<QFileDevice>(file_device), hdu_index, index_directory)) {
+}
+
+GzipFITSStorage::GzipFITSStorage(Inflated&& inflated):
+	AbstractFITSStorage(inflated.data, inflated.size),
+	block_(inflated.block),
+	index_(std::move(inflated.index)),
+	partial_(inflated.partial) {
+}
+
+GzipFITSStorage::~GzipFITSStorage() {
+	std::free(block_);
+}
+
+GzipFITSStorage::Inflated GzipFITSStorage::inflate(std::unique_ptr<QFileDevice> file_device, int hdu_index, const QString& index_directory) {
+	Tracer::Scope trace_scope("GzipFITSStorage inflate", "startup");
+
+	const quint64 size = file_device->size();
+	// The mapping is released when the device is closed
+	const quint8* in = file_device->map(0, size);
+	if (!in)
+		throw Exception(file_device->fileName() + ": " + file_device->errorString());
+
+	const QFileInfo file_info(file_device->fileName());
+	const QString path = (index_directory.isEmpty() || file_device->fileName().isEmpty() ? QString() : indexPath(index_directory, file_info));
+
+	Inflated inflated;
+	inflated.partial = false;
+
+	if (!path.isEmpty() && loadIndex(path, file_info, &inflated.index)) {
+		const auto& units = inflated.index.units;
+		const int target = targetUnit(units, hdu_index);
+
+		std::vector<Range> ranges;
+		if (target >= 0) {
+			// Headers up to the target, then its data
+			for (int i = 0; i <= target; ++i) {
+				ranges.push_back(Range{units[i].begin, units[i].data});
+			}
+			ranges.back().end = std::min(units[target].end, inflated.index.size);
+			inflated.partial = true;
+		} else {
+			ranges.push_back(Range{0, inflated.index.size});
+		}
+		inflated.size = ranges.back().end;
+
+		Buffer buffer(inflated.size);
+		inflateRanges(in, size, inflated.index.points, ranges, buffer.data());
+		inflated.data = buffer.data();
+		inflated.block = buffer.release();
+		return inflated;
+	}
+
+	auto& index = inflated.index;
+	FITSUnitScanner scanner(&index.units);
+
+	if (bgzfPoints(in, size, &index.points, &index.size)) {
+		Buffer buffer(index.size);
+		inflateRanges(in, size, index.points, std::vector<Range>{Range{0, index.size}}, buffer.data());
+		scanner.advance(buffer.data(), index.size);
+		inflated.data = buffer.data();
+		inflated.block = buffer.release();
+	} else {
+		index.points.clear();
+
+		// Trailer of the last member holds its size modulo 2^32
+		const quint8* trailer = in + size - std::min<quint64>(size, 4);
+		const quint64 isize = (size >= 4 ? trailer[0] | (trailer[1] << 8) | (trailer[2] << 16) | (static_cast<quint64>(trailer[3]) << 24) : 0);
+		// Unused pages of the capacity are never mapped
+		Buffer buffer(std::max(isize, 2 * size) + page_size);
+		index.size = inflateIndexed(in, size, &buffer, &index, &scanner);
+		inflated.data = buffer.data();
+		inflated.block = buffer.release();
+	}
+	inflated.size = index.size;
+
+	if (!path.isEmpty())
+		saveIndex(path, file_info, index);
+
+	return inflated;
+}
+
+bool GzipFITSStorage::isGzip(QFileDevice* file_device) {
+	return file_device->peek(2) == QByteArray("\x1f\x8b");
+}
+
+QString GzipFITSStorage::defaultIndexDirectory() {
+	const auto location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+	return (location.isEmpty() ? QString() : location + QString("/gzip-index"));
+}
@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include <headermodel.h>
+
+namespace {
+	// The cards are ASCII, so the case is folded bytewise
+	struct FoldTable {
+		quint8 lower[256];
+
+		FoldTable() {
+			for (int i = 0; i < 256; ++i) {
+				lower[i] = static_cast<quint8>(i >= 'A' && i <= 'Z' ? i - 'A' + 'a' : i);
+			}
+		}
+	};
+	const FoldTable fold_table;
+
+	// Matches never span two cards
+	bool contains(const char* card, const QByteArray& lower_text) {
+		const auto bytes = reinterpret_cast<const quint8*>(card);
+		const auto text = reinterpret_cast<const quint8*>(lower_text.constData());
+		const int length = lower_text.size();
+
+		for (int i = 0; i + length <= 80; ++i) {
+			if (fold_table.lower[bytes[i]] != text[0])
+				continue;
+			int j = 1;
+			while (j < length && fold_table.lower[bytes[i + j]] == text[j]) {
+				++j;
+			}
+			if (j == length)
+				return true;
+		}
+		return false;
+	}
+
+	// Cards of the header which has only the keywords, e.g. processing result
+	QByteArray makeCards(const std::map<QString, QString>& headers) {
+		QByteArray cards;
+		for (const auto& x: headers) {
+			if (x.first.isEmpty())
+				continue;
+			const QString value = (x.second.startsWith('\'') ? x.second : x.second.rightJustified(20));
+			cards += (x.first.leftJustified(8, ' ', true) + "= " + value).leftJustified(80, ' ', true).toLatin1();
+		}
+		return cards;
+	}
+}
+
+HeaderModel::HeaderModel(std::shared_ptr<const FITS::HeaderDataUnit> hdu, QObject* parent):
+	QAbstractTableModel(parent),
+	hdu_(std::move(hdu)),
+	cards_(hdu_->header().cards()),
+	card_count_(static_cast<int>(std::min<quint64>(hdu_->header().cardCount(), std::numeric_limits<int>::max()))) {
+
+	if (!cards_) {
+		made_cards_ = makeCards(hdu_->header().headers());
+		cards_ = made_cards_.constData();
+		card_count_ = made_cards_.size() / 80;
+	}
+}
+
+int HeaderModel::rowCount(const QModelIndex& parent) const {
+	if (parent.isValid())
+		return 0;
+	return card_count_;
+}
+
+int HeaderModel::columnCount(const QModelIndex& parent) const {
+	if (parent.isValid())
+		return 0;
+	return ColumnCount;
+}
+
+QVariant HeaderModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid())
+		return QVariant();
+
+	switch (role) {
+		case Qt::DisplayRole: {
+			const auto parsed = parseCard(card(index.row()));
+			switch (index.column()) {
+				case KeywordColumn:
+					return parsed.keyword;
+				case ValueColumn:
+					return parsed.value;
+				case CommentColumn:
+					return parsed.comment;
+				default:
+					return QVariant();
+			}
+		}
+		case Qt::ToolTipRole:
+			// The card as it is stored
+			return QString::fromLatin1(card(index.row()), 80);
+		default:
+			return QVariant();
+	}
+}
+
+QVariant HeaderModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (role != Qt::DisplayRole)
+		return QVariant();
+
+	// Cards are numbered from 1
+	if (orientation == Qt::Vertical)
+		return section + 1;
+
+	switch (section) {
+		case KeywordColumn:
+			return tr("Keyword");
+		case ValueColumn:
+			return tr("Value");
+		case CommentColumn:
+			return tr("Comment");
+		default:
+			return QVariant();
+	}
+}
+
+int HeaderModel::find(const QByteArray& text, int from, int direction) const {
+	Q_ASSERT(direction == 1 || direction == -1);
+
+	if (text.isEmpty() || text.size() > 80 || card_count_ == 0)
+		return -1;
+
+	QByteArray lower_text(text);
+	for (auto& x: lower_text) {
+		x = static_cast<char>(fold_table.lower[static_cast<quint8>(x)]);
+	}
+
+	int row = (from % card_count_ + card_count_) % card_count_;
+	for (int i = 0; i < card_count_; ++i, row = (row + direction + card_count_) % card_count_) {
+		if (contains(card(row), lower_text))
+			return row;
+	}
+	return -1;
+}
+
+HeaderModel::Card HeaderModel::parseCard(const char* card) {
+	Card parsed;
+	parsed.keyword = QString::fromLatin1(card, 8).trimmed();
+
+	// Commentary cards, e.g. HISTORY, have no value indicator
+	if (std::memcmp(card + 8, "= ", 2) != 0) {
+		parsed.value = QString::fromLatin1(card + 8, 72).trimmed();
+		return parsed;
+	}
+
+	const char* value = card + 10;
+	const char* end = card + 80;
+	const char* it = value;
+	while (it != end && *it == ' ') {
+		++it;
+	}
+	// Slash of a string is not a comment, doubled quote is the quote itself
+	if (it != end && *it == '\'') {
+		for (++it; it != end; ++it) {
+			if (*it != '\'')
+				continue;
+			if (it + 1 != end && it[1] == '\'') {
+				++it;
+			} else {
+				++it;
+				break;
+			}
+		}
+	}
+
+	const char* slash = std::find(it, end, '/');
+	parsed.value = QString::fromLatin1(value, static_cast<int>(slash - value)).trimmed();
+	if (slash != end)
+		parsed.comment = QString::fromLatin1(slash + 1, static_cast<int>(end - slash - 1)).trimmed();
+	return parsed;
+}
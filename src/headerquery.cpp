@@ -0,0 +1,78 @@
+#include <QRegExp>
+
+#include <fits.h>
+#include <headerquery.h>
+
+HeaderQuery::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void HeaderQuery::Exception::raise() const {
+	throw *this;
+}
+QException* HeaderQuery::Exception::clone() const {
+	return new HeaderQuery::Exception(*this);
+}
+
+HeaderQuery::HeaderQuery(const QStringList& conditions) {
+	for (const auto& x: conditions) {
+		conditions_.push_back(parseCondition(x));
+	}
+}
+
+HeaderQuery::Condition HeaderQuery::parseCondition(const QString& text) {
+	// Two-character operators go first, so that <= is not taken for <
+	QRegExp regexp("^\\s*([^=!<>\\s]+)\\s*(!=|<=|>=|=|<|>)\\s*(.*)$");
+	if (!regexp.exactMatch(text))
+		throw Exception("Wrong condition " + text + ", <keyword><operator><value> expected");
+
+	static const std::map<QString, Operator> operators = {
+		{"=", Equal}, {"!=", NotEqual}, {"<", Less}, {"<=", LessOrEqual}, {">", Greater}, {">=", GreaterOrEqual}};
+	return Condition{regexp.cap(1).toUpper(), operators.at(regexp.cap(2)), FITS::HeaderUnit::unquoted(regexp.cap(3).trimmed())};
+}
+
+bool HeaderQuery::toNumber(const QString& value, double* number) {
+	if (value.startsWith('\''))
+		return false;
+
+	bool ok = false;
+	// Fortran exponent is allowed by the standard
+	QString normalized(value);
+	normalized.replace(QChar('D'), QChar('E'));
+	*number = normalized.toDouble(&ok);
+	return ok;
+}
+
+bool HeaderQuery::holds(const Condition& condition, const QString& value) {
+	int order = 0;
+	double left = 0, right = 0;
+	if (toNumber(value, &left) && toNumber(condition.value, &right)) {
+		order = (left < right ? -1 : (left > right ? 1 : 0));
+	} else {
+		order = QString::compare(FITS::HeaderUnit::unquoted(value), condition.value, Qt::CaseInsensitive);
+	}
+
+	switch (condition.op) {
+		case Equal:
+			return order == 0;
+		case NotEqual:
+			return order != 0;
+		case Less:
+			return order < 0;
+		case LessOrEqual:
+			return order <= 0;
+		case Greater:
+			return order > 0;
+		case GreaterOrEqual:
+			return order >= 0;
+	}
+	return false;
+}
+
+bool HeaderQuery::matches(const std::map<QString, QString>& cards) const {
+	for (const auto& condition: conditions_) {
+		auto it = cards.find(condition.key);
+		if (it == cards.end() || !holds(condition, it->second))
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,85 @@
+#include <QFile>
+
+#include <memory>
+
+#include <fitsunitscanner.h>
+#include <gzipfitsstorage.h>
+#include <headerreader.h>
+
+namespace {
+	// The buffer is not kept, so neither are the cards of the header
+	FITS::HeaderUnit parseHeader(char* data, quint64 size) {
+		AbstractFITSStorage::Page begin(reinterpret_cast<quint8*>(data));
+		const AbstractFITSStorage::Page end(reinterpret_cast<quint8*>(data + size));
+		return FITS::HeaderUnit(FITS::HeaderUnit(begin, end).headers());
+	}
+
+	inline bool isLast(const std::vector<HeaderReader::HDU>& hdus, int max_count) {
+		// FITS parses the extensions only when the primary header allows them
+		if (hdus.size() == 1 && hdus.front().header.header("EXTEND", "F") != "T")
+			return true;
+		return max_count >= 0 && hdus.size() >= static_cast<std::size_t>(max_count);
+	}
+
+	std::vector<HeaderReader::HDU> readInflated(QFile* file, int max_count) {
+		// Every HDU is inflated, so the index lets the later reads find all of them
+		GzipFITSStorage storage(file, GzipFITSStorage::whole_file);
+
+		std::vector<HeaderReader::HDU> hdus;
+		for (const auto& unit: storage.index().units) {
+			auto data = reinterpret_cast<char*>(storage.data());
+			auto header = parseHeader(data + unit.begin, unit.data - unit.begin);
+			const quint64 length = FITSUnitScanner::dataLength(header.headers());
+			hdus.push_back(HeaderReader::HDU{unit.begin, unit.data, length, std::move(header)});
+			if (isLast(hdus, max_count))
+				break;
+		}
+		return hdus;
+	}
+}
+
+std::vector<HeaderReader::HDU> HeaderReader::read(const QString& filename, int max_count) {
+	std::unique_ptr<QFile> file{new QFile(filename)};
+	if (!file->open(QIODevice::ReadOnly | QIODevice::Unbuffered))
+		throw FITS::Exception(filename + ": " + file->errorString());
+
+	if (GzipFITSStorage::isGzip(file.get())) {
+		auto hdus = readInflated(file.release(), max_count);
+		if (hdus.empty())
+			throw FITS::UnexpectedEnd();
+		return hdus;
+	}
+
+	std::vector<HDU> hdus;
+	const quint64 size = file->size();
+	QByteArray blocks;
+	quint64 offset = 0;
+
+	while (offset + 2880 <= size) {
+		if (!file->seek(offset))
+			throw FITS::Exception(filename + ": " + file->errorString());
+
+		blocks.resize(0);
+		for (;;) {
+			blocks.resize(blocks.size() + 2880);
+			char* block = blocks.data() + blocks.size() - 2880;
+			if (file->read(block, 2880) != 2880)
+				throw FITS::UnexpectedEnd();
+			if (FITSUnitScanner::hasEnd(reinterpret_cast<const quint8*>(block)))
+				break;
+		}
+
+		const quint64 data_offset = offset + blocks.size();
+		auto header = parseHeader(blocks.data(), blocks.size());
+		const quint64 length = FITSUnitScanner::dataLength(header.headers());
+		hdus.push_back(HDU{offset, data_offset, length, std::move(header)});
+		if (isLast(hdus, max_count))
+			break;
+
+		offset = data_offset + (length + 2879) / 2880 * 2880;
+	}
+
+	if (hdus.empty())
+		throw FITS::UnexpectedEnd();
+	return hdus;
+}
@@ -0,0 +1,107 @@
+#include <QFontDatabase>
+#include <QHBoxLayout>
+#include <QHeaderView>
+#include <QItemSelectionModel>
+#include <QKeySequence>
+#include <QShortcut>
+#include <QVBoxLayout>
+
+#include <headerwidget.h>
+
+HeaderWidget::HeaderWidget(QWidget* parent):
+	QWidget(parent),
+	search_(new QLineEdit(this)),
+	status_(new QLabel(this)),
+	view_(new QTableView(this)) {
+
+	search_->setPlaceholderText(tr("Find"));
+	search_->setClearButtonEnabled(true);
+
+	view_->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+	view_->setSelectionBehavior(QAbstractItemView::SelectRows);
+	view_->setSelectionMode(QAbstractItemView::SingleSelection);
+	view_->setWordWrap(false);
+	view_->horizontalHeader()->setStretchLastSection(true);
+	// Rows of fixed height are laid out without asking the model
+	view_->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+	view_->verticalHeader()->setDefaultSectionSize(view_->fontMetrics().height() + 4);
+
+	connect(search_.get(), SIGNAL(textChanged(const QString&)), this, SLOT(notifySearchChanged()));
+	connect(search_.get(), SIGNAL(returnPressed()), this, SLOT(findNext()));
+	new QShortcut(QKeySequence(Qt::SHIFT + Qt::Key_Return), search_.get(), SLOT(findPrevious()), Q_NULLPTR, Qt::WidgetShortcut);
+	new QShortcut(QKeySequence::FindNext, this, SLOT(findNext()), Q_NULLPTR, Qt::WidgetWithChildrenShortcut);
+	new QShortcut(QKeySequence::FindPrevious, this, SLOT(findPrevious()), Q_NULLPTR, Qt::WidgetWithChildrenShortcut);
+
+	std::unique_ptr<QHBoxLayout> search_layout{new QHBoxLayout};
+	search_layout->addWidget(search_.get(), 1);
+	search_layout->addWidget(status_.get());
+	std::unique_ptr<QVBoxLayout> widget_layout{new QVBoxLayout(this)};
+	widget_layout->addLayout(search_layout.release());
+	widget_layout->addWidget(view_.get(), 1);
+	setLayout(widget_layout.release());
+}
+
+void HeaderWidget::setHDU(std::shared_ptr<const FITS::HeaderDataUnit> hdu) {
+	std::unique_ptr<HeaderModel> model{hdu ? new HeaderModel(std::move(hdu)) : Q_NULLPTR};
+	// The view does not delete the selection model of the previous model
+	std::unique_ptr<QItemSelectionModel> selection_model{view_->selectionModel()};
+	view_->setModel(model.get());
+	// The previous model is deleted after the view has left it
+	model_.swap(model);
+
+	if (model_) {
+		// The widths are not computed from the contents, which would read all the cards
+		const int character_width = view_->fontMetrics().width(QLatin1Char('M'));
+		view_->setColumnWidth(HeaderModel::KeywordColumn, 10 * character_width);
+		view_->setColumnWidth(HeaderModel::ValueColumn, 24 * character_width);
+	}
+
+	if (search_->text().isEmpty()) {
+		showCardCount();
+	} else {
+		find(0, 1);
+	}
+}
+
+void HeaderWidget::find(int from, int direction) {
+	if (!model_)
+		return;
+
+	const int row = model_->find(search_->text().toLatin1(), from, direction);
+	if (row < 0) {
+		view_->clearSelection();
+		status_->setText(tr("Not found"));
+		return;
+	}
+
+	const auto index = model_->index(row, HeaderModel::KeywordColumn);
+	view_->setCurrentIndex(index);
+	view_->scrollTo(index);
+	status_->setText(tr("Card %1 of %2").arg(row + 1).arg(model_->rowCount()));
+}
+
+void HeaderWidget::showCardCount() {
+	status_->setText(model_ ? tr("%1 cards").arg(model_->rowCount()) : QString());
+}
+
+void HeaderWidget::notifySearchChanged() {
+	if (search_->text().isEmpty()) {
+		view_->clearSelection();
+		showCardCount();
+		return;
+	}
+
+	// Typing refines the match at the current card
+	const auto current = view_->currentIndex();
+	find(current.isValid() ? current.row() : 0, 1);
+}
+
+void HeaderWidget::findNext() {
+	const auto current = view_->currentIndex();
+	find(current.isValid() ? current.row() + 1 : 0, 1);
+}
+
+void HeaderWidget::findPrevious() {
+	const auto current = view_->currentIndex();
+	find(current.isValid() ? current.row() - 1 : -1, -1);
+}
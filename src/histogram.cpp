@@ -0,0 +1,79 @@
+#include <QtEndian>
+
+#include <cstring>
+
+#include <histogram.h>
+#include <tracer.h>
+
+namespace {
+	template<class T> inline double rawValue(const quint8* src) {
+		return qFromBigEndian<T>(src);
+	}
+	template<> inline double rawValue<float>(const quint8* src) {
+		const quint32 bits = qFromBigEndian<quint32>(src);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+	template<> inline double rawValue<double>(const quint8* src) {
+		const quint64 bits = qFromBigEndian<quint64>(src);
+		double value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	struct Counter {
+		double bzero, bscale;
+		std::pair<double, double> range;
+		std::vector<quint64>* counts;
+
+		template<class T> void operator() (const FITS::DataUnit<T>& data) const {
+			const auto bytes = reinterpret_cast<const quint8*>(data.data());
+			const auto size = static_cast<double>(counts->size());
+			const auto width = range.second - range.first;
+			// Degenerated range puts everything into the last bin
+			const auto scale = (width > 0 ? size / width : 0.0);
+			const auto offset = (width > 0 ? range.first : range.first - 1.0);
+
+			for (quint64 i = 0; i < data.length(); ++i) {
+				const double value = rawValue<T>(bytes + i * sizeof(T)) * bscale + bzero;
+				if (std::isnan(value))
+					continue;
+				const auto position = (value - offset) * scale;
+				// Comparisons are false for NaN
+				const auto bin = (position > 0 ? (position < size - 1.0 ? std::floor(position) : size - 1.0) : 0.0);
+				++(*counts)[static_cast<std::size_t>(bin)];
+			}
+		}
+		void operator() (const FITS::EmptyDataUnit&) const {
+			Q_ASSERT(0);
+		}
+		void operator() (const FITS::TableDataUnit&) const {
+			Q_ASSERT(0);
+		}
+	};
+}
+
+Histogram::Histogram(const FITS::HeaderDataUnit& hdu, const std::pair<double, double>& range, int size):
+	range_(range),
+	cdf_(static_cast<std::size_t>(size), 0) {
+
+	Q_ASSERT(size > 0);
+	Tracer::Scope trace_scope("histogram scan", "startup");
+
+	std::vector<quint64> counts(cdf_.size(), 0);
+	hdu.data().apply(Counter{hdu.header().bzero(), hdu.header().bscale(), range, &counts});
+
+	quint64 total = 0;
+	for (auto count: counts) {
+		total += count;
+	}
+	if (total == 0)
+		return;
+
+	quint64 accumulated = 0;
+	for (std::size_t i = 0; i < counts.size(); ++i) {
+		accumulated += counts[i];
+		cdf_[i] = static_cast<quint16>((accumulated * 65535.0) / total + 0.5);
+	}
+}
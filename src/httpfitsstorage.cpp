@@ -0,0 +1,382 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QNetworkAccessManager>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QStandardPaths>
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+#include <cachefile.h>
+#include <httpfitsstorage.h>
+#include <tracer.h>
+
+namespace {
+	const quint32 cache_magic = 0x46485443;  // "FHTC"
+	const quint32 cache_version = 1;
+
+	const quint64 block_size = HttpFITSStorage::block_size;
+
+	// Identity of the served file, blocks cached for another one are stale
+	struct Validator {
+		quint64 size;
+		QByteArray etag;
+		QByteArray modified;
+
+		bool operator== (const Validator& other) const {
+			return size == other.size && etag == other.etag && modified == other.modified;
+		}
+	};
+
+	// Unit to be fetched, -1 when there is none yet
+	int targetUnit(const std::vector<FITSUnitScanner::Unit>& units, int hdu_index) {
+		if (hdu_index == HttpFITSStorage::whole_file)
+			return -1;
+		if (hdu_index >= 0)
+			return (hdu_index < static_cast<int>(units.size()) ? hdu_index : -1);
+
+		for (std::size_t i = 0; i < units.size(); ++i) {
+			if (units[i].image)
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+
+	/* Fetches the blocks of the file into the buffer, from the cache when
+	 * they are there. The requests are run by the local event loop, so the
+	 * storage may be opened from any thread. */
+	class Fetcher {
+	private:
+		struct Transfer {
+			QNetworkReply* reply;
+			quint64 begin;
+			quint64 end;
+			quint64 position;  // End of the received data
+			bool started;
+		};
+
+		QUrl url_;
+		QNetworkAccessManager manager_;
+		Validator validator_;
+		QString cache_path_;
+		void* block_;
+		std::vector<bool> present_;
+		quint64 downloaded_;
+		QString error_;
+
+		QNetworkRequest request() const {
+			QNetworkRequest request(url_);
+			// The ranges are of the file itself rather than of its compressed transfer
+			request.setRawHeader("Accept-Encoding", "identity");
+#if QT_VERSION >= QT_VERSION_CHECK(5, 6, 0)
+			request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+#endif
+			return request;
+		}
+
+		inline quint8* data() const { return static_cast<quint8*>(block_); }
+		inline quint64 blockCount() const { return present_.size(); }
+		inline quint64 blockEnd(quint64 block) const { return std::min((block + 1) * block_size, validator_.size); }
+
+		void fail(const QString& error) {
+			if (error_.isEmpty())
+				error_ = url_.toDisplayString() + ": " + error;
+		}
+
+		// Reads the received data into the buffer
+		void receive(Transfer* transfer) {
+			if (!transfer->started) {
+				const int status = transfer->reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+				if (status == 206) {
+					const auto range = QString::fromLatin1(transfer->reply->rawHeader("Content-Range"));
+					if (!range.startsWith(QString("bytes %1-").arg(transfer->begin))) {
+						fail("unexpected Content-Range " + range);
+						transfer->reply->abort();
+						return;
+					}
+				} else if (status == 200) {
+					// Range is ignored by the server, so the whole file comes
+					transfer->begin = 0;
+					transfer->end = validator_.size;
+				} else {
+					return;
+				}
+				transfer->position = transfer->begin;
+				transfer->started = true;
+			}
+
+			while (transfer->reply->bytesAvailable() > 0 && transfer->position < transfer->end) {
+				const qint64 read = transfer->reply->read(reinterpret_cast<char*>(data() + transfer->position), transfer->end - transfer->position);
+				if (read <= 0)
+					break;
+				transfer->position += read;
+				downloaded_ += read;
+			}
+		}
+
+		void finish(Transfer* transfer) {
+			receive(transfer);
+
+			const auto reply = transfer->reply;
+			if (reply->error() != QNetworkReply::NoError) {
+				fail(reply->errorString());
+			} else if (!transfer->started) {
+				fail(QString("unexpected HTTP status %1").arg(reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt()));
+			} else if (transfer->position < transfer->end) {
+				fail("the response is truncated");
+			}
+		}
+
+		// Runs the requests in parallel
+		void run(std::vector<Transfer>* transfers) {
+			QEventLoop loop;
+			std::size_t pending = transfers->size();
+
+			for (auto& transfer: *transfers) {
+				Transfer* x = &transfer;
+				QObject::connect(x->reply, &QNetworkReply::readyRead, &loop, [this, x] () { receive(x); });
+				QObject::connect(x->reply, &QNetworkReply::finished, &loop, [this, x, &pending, &loop] () {
+					finish(x);
+					if (--pending == 0)
+						loop.quit();
+				});
+			}
+			// The replies are deleted with the manager
+			loop.exec();
+
+			if (!error_.isEmpty())
+				throw HttpFITSStorage::Exception(error_);
+		}
+
+		void openCache(const QString& directory) {
+			if (directory.isEmpty())
+				return;
+
+			const auto key = QCryptographicHash::hash(url_.toString(QUrl::FullyEncoded).toUtf8(), QCryptographicHash::Sha1).toHex();
+			const auto path = directory + QString("/") + QString::fromLatin1(key);
+
+			QFile file(path + "/validator");
+			if (file.open(QIODevice::ReadOnly)) {
+				QDataStream stream(&file);
+				quint32 magic = 0, version = 0;
+				Validator cached{0, QByteArray(), QByteArray()};
+				stream >> magic >> version >> cached.size >> cached.etag >> cached.modified;
+				if (stream.status() == QDataStream::Ok && magic == cache_magic && version == cache_version && cached == validator_) {
+					cache_path_ = path;
+					return;
+				}
+				file.close();
+			}
+
+			// The blocks of the previous version of the file are dropped
+			QDir(path).removeRecursively();
+			const bool written = writeCacheFile(path + "/validator", [&] (QDataStream& stream) {
+				stream << cache_magic << cache_version << validator_.size << validator_.etag << validator_.modified;
+			});
+			if (written)
+				cache_path_ = path;
+		}
+
+		bool load(quint64 block) {
+			if (cache_path_.isEmpty())
+				return false;
+
+			QFile file(cache_path_ + "/" + QString::number(block));
+			const qint64 length = blockEnd(block) - block * block_size;
+			if (!file.open(QIODevice::ReadOnly) || file.size() != length)
+				return false;
+			return file.read(reinterpret_cast<char*>(data() + block * block_size), length) == length;
+		}
+
+		void save(quint64 block) const {
+			if (cache_path_.isEmpty())
+				return;
+
+			const qint64 length = blockEnd(block) - block * block_size;
+			writeCacheFile(cache_path_ + "/" + QString::number(block), [&] (QDataStream& stream) {
+				stream.writeRawData(reinterpret_cast<const char*>(data() + block * block_size), static_cast<int>(length));
+			});
+		}
+	public:
+		Fetcher(const QUrl& url, const QString& cache_directory):
+			url_(url),
+			validator_{0, QByteArray(), QByteArray()},
+			block_(Q_NULLPTR),
+			downloaded_(0) {
+
+			std::vector<Transfer> head{Transfer{manager_.head(request()), 0, 0, 0, false}};
+			run(&head);
+
+			const auto reply = head.front().reply;
+			bool size_ok = false;
+			validator_.size = reply->header(QNetworkRequest::ContentLengthHeader).toULongLong(&size_ok);
+			validator_.etag = reply->rawHeader("ETag");
+			validator_.modified = reply->rawHeader("Last-Modified");
+			if (!size_ok || validator_.size == 0)
+				throw HttpFITSStorage::Exception(url_.toDisplayString() + ": the server does not report the size of the file");
+
+			// Pages of large calloc() blocks are mapped on demand
+			block_ = std::calloc(validator_.size, 1);
+			if (!block_)
+				throw HttpFITSStorage::Exception(url_.toDisplayString() + ": not enough memory to fetch the file");
+			present_.assign((validator_.size + block_size - 1) / block_size, false);
+
+			openCache(cache_directory);
+		}
+		~Fetcher() {
+			std::free(block_);
+		}
+		Fetcher(const Fetcher&) = delete;
+		Fetcher& operator=(const Fetcher&) = delete;
+
+		inline quint64 size() const { return validator_.size; }
+		inline quint64 downloaded() const { return downloaded_; }
+		inline const quint8* buffer() const { return data(); }
+
+		void* release() {
+			void* block = block_;
+			block_ = Q_NULLPTR;
+			return block;
+		}
+
+		// End of the fetched data starting at offset
+		quint64 presentEnd(quint64 offset) const {
+			quint64 block = offset / block_size;
+			while (block < blockCount() && present_[block])
+				++block;
+			return std::min(block * block_size, validator_.size);
+		}
+
+		// Fetches the blocks covering [begin, end) which are not cached
+		void ensure(quint64 begin, quint64 end) {
+			end = std::min(end, validator_.size);
+			if (begin >= end)
+				return;
+
+			std::vector<Transfer> transfers;
+			for (quint64 block = begin / block_size; block <= (end - 1) / block_size; ++block) {
+				if (present_[block])
+					continue;
+				if (load(block)) {
+					present_[block] = true;
+					continue;
+				}
+
+				// Adjacent missing blocks are merged into the requests up to blocks_per_request
+				if (!transfers.empty() && transfers.back().end == block * block_size &&
+						transfers.back().end - transfers.back().begin < HttpFITSStorage::blocks_per_request * block_size) {
+					transfers.back().end = blockEnd(block);
+				} else {
+					transfers.push_back(Transfer{Q_NULLPTR, block * block_size, blockEnd(block), 0, false});
+				}
+			}
+			if (transfers.empty())
+				return;
+
+			for (auto& transfer: transfers) {
+				auto range = request();
+				range.setRawHeader("Range", QString("bytes=%1-%2").arg(transfer.begin).arg(transfer.end - 1).toLatin1());
+				transfer.reply = manager_.get(range);
+			}
+			run(&transfers);
+
+			for (const auto& transfer: transfers) {
+				for (quint64 block = transfer.begin / block_size; block < blockCount() && blockEnd(block) <= transfer.position; ++block) {
+					if (present_[block])
+						continue;
+					present_[block] = true;
+					save(block);
+				}
+			}
+		}
+	};
+}
+
+struct HttpFITSStorage::Fetched {
+	void* block;
+	quint64 size;
+	std::vector<FITSUnitScanner::Unit> units;
+	bool partial;
+	quint64 downloaded;
+};
+
+HttpFITSStorage::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void HttpFITSStorage::Exception::raise() const {
+	throw *this;
+}
+QException* HttpFITSStorage::Exception::clone() const {
+	return new HttpFITSStorage::Exception(*this);
+}
+
+HttpFITSStorage::HttpFITSStorage(const QUrl& url, int hdu_index, const QString& cache_directory):
+	HttpFITSStorage(fetch(url, hdu_index, cache_directory)) {
+}
+
+HttpFITSStorage::HttpFITSStorage(Fetched&& fetched):
+	AbstractFITSStorage(static_cast<quint8*>(fetched.block), fetched.size),
+	block_(fetched.block),
+	units_(std::move(fetched.units)),
+	partial_(fetched.partial),
+	downloaded_(fetched.downloaded) {
+}
+
+HttpFITSStorage::~HttpFITSStorage() {
+	std::free(block_);
+}
+
+HttpFITSStorage::Fetched HttpFITSStorage::fetch(const QUrl& url, int hdu_index, const QString& cache_directory) {
+	Tracer::Scope trace_scope("HttpFITSStorage fetch", "startup");
+
+	Fetcher fetcher(url, cache_directory);
+
+	Fetched fetched;
+	FITSUnitScanner scanner(&fetched.units);
+	int target = -1;
+
+	// Headers block by block, skipping the data units in between
+	while (hdu_index != whole_file && !scanner.isDone() && (target = targetUnit(fetched.units, hdu_index)) < 0) {
+		const quint64 next = scanner.next();
+		if (next + 2880 > fetcher.size())
+			break;
+		fetcher.ensure(next, next + 2880);
+		scanner.advance(fetcher.buffer(), fetcher.presentEnd(next));
+	}
+	target = targetUnit(fetched.units, hdu_index);
+
+	if (target >= 0) {
+		const auto& unit = fetched.units[target];
+		fetched.size = std::min(unit.end, fetcher.size());
+		fetcher.ensure(unit.data, fetched.size);
+		fetched.partial = true;
+		// The headers which came with the fetched blocks are past the storage
+		fetched.units.resize(target + 1);
+	} else {
+		fetched.size = fetcher.size();
+		fetcher.ensure(0, fetched.size);
+		fetched.partial = false;
+		// The headers not scanned yet are at hand now
+		scanner.advance(fetcher.buffer(), fetched.size);
+	}
+
+	fetched.downloaded = fetcher.downloaded();
+	fetched.block = fetcher.release();
+	return fetched;
+}
+
+bool HttpFITSStorage::isUrl(const QString& filename) {
+	const QUrl url(filename);
+	return url.scheme() == "http" || url.scheme() == "https";
+}
+
+QString HttpFITSStorage::defaultCacheDirectory() {
+	const auto location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+	return (location.isEmpty() ? QString() : location + QString("/http-blocks"));
+}
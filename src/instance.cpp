@@ -20,4 +20,39 @@ Instance::Instance(QObject* parent, const QString& filename):
 
 	connect(mainwindow_.get(), SIGNAL(closed(MainWindow&)), this, SLOT(mainWindowClosed(MainWindow&)));
 }
+Instance::Instance(QObject* parent, const QStringList& filenames, double frame_rate):
+	QObject(parent), mainwindow_(new MainWindow(std::make_shared<const Sequence>(filenames), frame_rate)) {
+
+	mainwindow_->show();
+
+	connect(mainwindow_.get(), SIGNAL(closed(MainWindow&)), this, SLOT(mainWindowClosed(MainWindow&)));
+}
+Instance::Instance(QObject* parent, std::shared_ptr<const Sequence> sequence, double frame_rate):
+	QObject(parent), mainwindow_(new MainWindow(std::move(sequence), frame_rate)) {
+
+	mainwindow_->show();
+
+	connect(mainwindow_.get(), SIGNAL(closed(MainWindow&)), this, SLOT(mainWindowClosed(MainWindow&)));
+}
+Instance::Instance(QObject* parent, std::shared_ptr<const FITS> fits, const QString& title):
+	QObject(parent), mainwindow_(new MainWindow(std::move(fits), title)) {
+
+	mainwindow_->show();
+
+	connect(mainwindow_.get(), SIGNAL(closed(MainWindow&)), this, SLOT(mainWindowClosed(MainWindow&)));
+}
+Instance::Instance(QObject* parent, std::unique_ptr<FrameWatcher> watcher):
+	QObject(parent), mainwindow_(new MainWindow(std::move(watcher))) {
+
+	mainwindow_->show();
+
+	connect(mainwindow_.get(), SIGNAL(closed(MainWindow&)), this, SLOT(mainWindowClosed(MainWindow&)));
+}
+Instance::Instance(QObject* parent, std::shared_ptr<SharedMemoryRing> ring):
+	QObject(parent), mainwindow_(new MainWindow(std::move(ring))) {
+
+	mainwindow_->show();
+
+	connect(mainwindow_.get(), SIGNAL(closed(MainWindow&)), this, SLOT(mainWindowClosed(MainWindow&)));
+}
 Instance::~Instance() = default;
@@ -0,0 +1,282 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QStandardPaths>
+
+#include <algorithm>
+
+#include <cachefile.h>
+#include <headerreader.h>
+#include <keywordindex.h>
+#include <parallel.h>
+#include <tracer.h>
+
+namespace {
+	const quint32 file_magic = 0x4649504b;  // FIPK
+	const quint32 file_version = 1;
+
+	QString indexPath(const QString& directory, const QString& root) {
+		const auto key = QCryptographicHash::hash(root.toUtf8(), QCryptographicHash::Sha1).toHex();
+		return directory + QString("/") + QString::fromLatin1(key) + QString(".idx");
+	}
+
+	KeywordIndex::HDU describe(const HeaderReader::HDU& hdu) {
+		const auto& header = hdu.header;
+		// Tile-compressed image keeps its own keywords prefixed by Z
+		const bool compressed = (header.header("ZIMAGE", "F") == "T");
+		const QString prefix(compressed ? "Z" : "");
+
+		KeywordIndex::HDU described;
+		described.offset = hdu.offset;
+		described.bitpix = header.header(prefix + "BITPIX", "0").toInt();
+		const int naxis = header.header(prefix + "NAXIS", "0").toInt();
+		for (int i = 1; i <= naxis; ++i) {
+			described.shape.push_back(header.header(prefix + "NAXIS" + QString::number(i), "0").toULongLong());
+		}
+
+		// The same images FITS shows, see FITS::HeaderDataUnit
+		const auto xtension = FITS::HeaderUnit::unquoted(header.header("XTENSION", QString()));
+		described.image = (compressed || xtension.isEmpty() || xtension == "IMAGE") && (naxis == 2 || naxis == 3) &&
+			std::find(described.shape.begin(), described.shape.end(), 0) == described.shape.end();
+
+		described.cards = header.headers();
+		described.cards.erase(QString());
+		return described;
+	}
+}
+
+KeywordIndex::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void KeywordIndex::Exception::raise() const {
+	throw *this;
+}
+QException* KeywordIndex::Exception::clone() const {
+	return new KeywordIndex::Exception(*this);
+}
+
+bool KeywordIndex::File::isUnchanged(const QFileInfo& info) const {
+	return size == info.size() && modified == info.lastModified().toMSecsSinceEpoch();
+}
+
+KeywordIndex::KeywordIndex(const QString& root, const QString& index_directory) {
+	const QFileInfo info(root);
+	if (!info.isDir())
+		throw Exception(root + ": not a directory");
+
+	root_ = info.canonicalFilePath();
+	if (!index_directory.isEmpty()) {
+		path_ = indexPath(index_directory, root_);
+		load();
+	}
+}
+
+// Broken index or index of another version is removed
+bool KeywordIndex::load() {
+	Tracer::Scope trace_scope("KeywordIndex load", "index");
+
+	QFile file(path_);
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+	quint32 magic = 0, version = 0;
+	QString root;
+	QByteArray compressed;
+	stream >> magic >> version >> root;
+	if (stream.status() != QDataStream::Ok || magic != file_magic || version != file_version) {
+		file.remove();
+		return false;
+	}
+	// Different root of the same hash
+	if (root != root_)
+		return false;
+	stream >> compressed;
+
+	const QByteArray payload = qUncompress(compressed);
+	QDataStream payload_stream(payload);
+	quint32 keyword_count = 0, file_count = 0;
+	payload_stream >> keyword_count;
+
+	// The cards share the keywords
+	QStringList keywords;
+	for (quint32 i = 0; i < keyword_count && payload_stream.status() == QDataStream::Ok; ++i) {
+		QString keyword;
+		payload_stream >> keyword;
+		keywords << keyword;
+	}
+
+	bool ok = true;
+	payload_stream >> file_count;
+	for (quint32 i = 0; i < file_count && payload_stream.status() == QDataStream::Ok && ok; ++i) {
+		QString path;
+		File indexed;
+		quint32 hdu_count = 0;
+		payload_stream >> path >> indexed.size >> indexed.modified >> hdu_count;
+		for (quint32 j = 0; j < hdu_count && payload_stream.status() == QDataStream::Ok && ok; ++j) {
+			HDU hdu;
+			qint32 bitpix = 0;
+			quint32 naxis = 0, card_count = 0;
+			payload_stream >> hdu.offset >> bitpix >> hdu.image >> naxis;
+			hdu.bitpix = bitpix;
+			for (quint32 k = 0; k < naxis && payload_stream.status() == QDataStream::Ok; ++k) {
+				quint64 axis = 0;
+				payload_stream >> axis;
+				hdu.shape.push_back(axis);
+			}
+			payload_stream >> card_count;
+			for (quint32 k = 0; k < card_count && payload_stream.status() == QDataStream::Ok; ++k) {
+				quint32 keyword = 0;
+				QByteArray value;
+				payload_stream >> keyword >> value;
+				if (keyword >= static_cast<quint32>(keywords.size())) {
+					ok = false;
+					break;
+				}
+				hdu.cards.emplace(keywords[keyword], QString::fromLatin1(value));
+			}
+			indexed.hdus.push_back(std::move(hdu));
+		}
+		files_.emplace(path, std::move(indexed));
+	}
+
+	if (!ok || payload.isEmpty() || payload_stream.status() != QDataStream::Ok) {
+		file.remove();
+		files_.clear();
+		return false;
+	}
+	return true;
+}
+
+void KeywordIndex::save() const {
+	Tracer::Scope trace_scope("KeywordIndex save", "index");
+
+	if (path_.isEmpty())
+		return;
+
+	std::map<QString, quint32> keyword_ids;
+	QStringList keywords;
+	QByteArray cards;
+	QByteArray payload;
+	{
+		QDataStream payload_stream(&payload, QIODevice::WriteOnly);
+		QDataStream files_stream(&cards, QIODevice::WriteOnly);
+
+		// The keywords are collected while the files are written
+		files_stream << static_cast<quint32>(files_.size());
+		for (const auto& x: files_) {
+			files_stream << x.first << x.second.size << x.second.modified << static_cast<quint32>(x.second.hdus.size());
+			for (const auto& hdu: x.second.hdus) {
+				files_stream << hdu.offset << static_cast<qint32>(hdu.bitpix) << hdu.image << static_cast<quint32>(hdu.shape.size());
+				for (const auto axis: hdu.shape) {
+					files_stream << axis;
+				}
+				files_stream << static_cast<quint32>(hdu.cards.size());
+				for (const auto& card: hdu.cards) {
+					auto it = keyword_ids.find(card.first);
+					if (it == keyword_ids.end()) {
+						it = keyword_ids.emplace(card.first, static_cast<quint32>(keywords.size())).first;
+						keywords << card.first;
+					}
+					files_stream << it->second << card.second.toLatin1();
+				}
+			}
+		}
+
+		payload_stream << static_cast<quint32>(keywords.size());
+		for (const auto& keyword: keywords) {
+			payload_stream << keyword;
+		}
+	}
+	payload += cards;
+
+	QString error;
+	const bool written = writeCacheFile(path_, [&] (QDataStream& stream) {
+		stream << file_magic << file_version << root_ << qCompress(payload);
+	}, &error);
+	if (!written)
+		throw Exception(error);
+}
+
+KeywordIndex::Statistics KeywordIndex::update(const QStringList& name_filters) {
+	Tracer::Scope trace_scope("KeywordIndex update", "index");
+
+	Statistics statistics{0, 0, 0, 0, QStringList()};
+	const QDir root(root_);
+
+	std::map<QString, File> files;
+	std::vector<QString> stale;
+	QStringList filenames;
+	QDirIterator it(root_, name_filters, QDir::Files | QDir::Readable, QDirIterator::Subdirectories);
+	while (it.hasNext()) {
+		it.next();
+		const auto info = it.fileInfo();
+		const auto path = root.relativeFilePath(info.filePath());
+
+		auto found = files_.find(path);
+		if (found != files_.end() && found->second.isUnchanged(info)) {
+			files.emplace(path, std::move(found->second));
+			++statistics.unchanged;
+			continue;
+		}
+
+		++(found == files_.end() ? statistics.added : statistics.updated);
+		// Modifications while the headers are read are found by the next update
+		files.emplace(path, File{info.size(), info.lastModified().toMSecsSinceEpoch(), std::vector<HDU>()});
+		stale.push_back(path);
+		filenames << info.absoluteFilePath();
+	}
+	statistics.removed = static_cast<int>(files_.size()) - statistics.unchanged - statistics.updated;
+
+	const int count = static_cast<int>(stale.size());
+	std::vector<std::vector<HDU>> hdus(count);
+	std::vector<QString> errors(count);
+	parallelFor(count, 1, [&] (int begin, int end) {
+		for (int i = begin; i < end; ++i) {
+			try {
+				for (const auto& hdu: HeaderReader::read(filenames.at(i))) {
+					hdus[i].push_back(describe(hdu));
+				}
+			} catch (const std::exception& e) {
+				hdus[i].clear();
+				errors[i] = stale[i] + ": " + e.what();
+			}
+		}
+	});
+
+	for (int i = 0; i < count; ++i) {
+		files[stale[i]].hdus = std::move(hdus[i]);
+		if (!errors[i].isEmpty())
+			statistics.errors << errors[i];
+	}
+	files_.swap(files);
+
+	// Repeated updates of an unchanged tree cost the directory walk only
+	if (statistics.added || statistics.updated || statistics.removed)
+		save();
+	return statistics;
+}
+
+std::vector<KeywordIndex::Match> KeywordIndex::query(const HeaderQuery& query) const {
+	Tracer::Scope trace_scope("KeywordIndex query", "index");
+
+	const QDir root(root_);
+	std::vector<Match> matches;
+	for (const auto& x: files_) {
+		const auto& hdus = x.second.hdus;
+		for (std::size_t i = 0; i < hdus.size(); ++i) {
+			if (query.matches(hdus[i].cards))
+				matches.push_back(Match{root.filePath(x.first), static_cast<int>(i), &x.second, &hdus[i]});
+		}
+	}
+	return matches;
+}
+
+QString KeywordIndex::defaultIndexDirectory() {
+	const auto location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+	return (location.isEmpty() ? QString() : location + QString("/keyword-index"));
+}
@@ -3,12 +3,18 @@
 #include <QSurfaceFormat>
 
 #include <application.h>
+#include <tracer.h>
 
 int main(int argc, char** argv) {
+	// Start the clock of the startup trace
+	Tracer::instance();
+
 	// See related note on http://doc.qt.io/qt-5/qopenglwidget.html
 	QSurfaceFormat surface_format;
 	surface_format.setVersion(2, 1);
 	QSurfaceFormat::setDefaultFormat(surface_format);
+	// Share textures and shader programs between windows, see OpenGLResourceRegistry
+	QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
 
 	try {
 		Application app(argc, argv);
@@ -1,16 +1,29 @@
+#include <algorithm>
+#include <iterator>
+#include <limits>
 #include <memory>
 
 #include <QApplication>
+#include <QDebug>
 #include <QDesktopServices>
 #include <QDesktopWidget>
 #include <QFile>
 #include <QFileDialog>
 #include <QFileInfo>
+#include <QHeaderView>
+#include <QInputDialog>
 #include <QListWidget>
 #include <QMessageBox>
+#include <QStatusBar>
+#include <QTableView>
+#include <QTimer>
 
 #include <application.h>
+#include <httpfitsstorage.h>
 #include <mainwindow.h>
+#include <sharedmemoryfitsstorage.h>
+#include <tablemodel.h>
+#include <tracer.h>
 
 MainWindow::Exception::Exception(const QString& what):
 	::Exception(what) {
@@ -22,60 +35,100 @@ QException* MainWindow::Exception::clone() const {
 	return new MainWindow::Exception(*this);
 }
 
-MainWindow::FileOpenError::FileOpenError(const QString& reason):
-	MainWindow::Exception(reason) {
-}
-void MainWindow::FileOpenError::raise() const {
-	throw *this;
-}
-QException* MainWindow::FileOpenError::clone() const {
-	return new MainWindow::FileOpenError(*this);
+MainWindow::MainWindow(const QString& fits_filename, QWidget *parent):
+	QMainWindow(parent),
+	ring_sequence_(0),
+	browse_direction_(1),
+	plane_index_(0) {
+
+	Tracer::Scope trace_scope("MainWindow", "startup");
+
+	const auto filename = (HttpFITSStorage::isUrl(fits_filename) ? fits_filename : QFileInfo(fits_filename).absoluteFilePath());
+	entry_ = Application::instance()->fitsCache().open(filename);
+	initialize(*entry_->frame.hdu, QFileInfo(entry_->filename).fileName(), OpenGLResourceRegistry::textureKey(entry_->filename, entry_->frame.hdu_index));
+
+	// Directory is listed when the window is shown
+	QTimer::singleShot(0, this, SLOT(prefetchNeighbours()));
 }
-MainWindow::NoImageInFITS::NoImageInFITS():
-	MainWindow::Exception("The file has no image content") {
+
+MainWindow::MainWindow(std::shared_ptr<const Sequence> sequence, double frame_rate, QWidget *parent):
+	QMainWindow(parent),
+	sequence_(std::move(sequence)),
+	ring_sequence_(0),
+	browse_direction_(1),
+	plane_index_(0) {
+
+	Tracer::Scope trace_scope("MainWindow", "startup");
+
+	const auto& first = sequence_->first();
+	const auto& filename = sequence_->frame(0).filename;
+	initialize(*first.hdu, QFileInfo(filename).fileName(), OpenGLResourceRegistry::textureKey(filename, first.hdu_index));
+	scrollZoomArea()->viewport()->setSequenceFrameRate(frame_rate);
 }
-void MainWindow::NoImageInFITS::raise() const {
-	throw *this;
+
+MainWindow::MainWindow(std::shared_ptr<const FITS> fits, const QString& title, QWidget *parent):
+	QMainWindow(parent),
+	fits_(std::move(fits)),
+	ring_sequence_(0),
+	browse_direction_(1),
+	plane_index_(0) {
+
+	// There is no file to identify the content, so the texture is not shared
+	initialize(fits_->primary_hdu(), title, QString());
 }
-QException* MainWindow::NoImageInFITS::clone() const {
-	return new MainWindow::NoImageInFITS(*this);
+
+MainWindow::MainWindow(std::unique_ptr<FrameWatcher> watcher, QWidget *parent):
+	QMainWindow(parent),
+	watcher_(std::move(watcher)),
+	ring_sequence_(0),
+	browse_direction_(1),
+	plane_index_(0) {
+
+	Tracer::Scope trace_scope("MainWindow", "startup");
+
+	const auto filename = watcher_->current();
+	if (filename.isEmpty())
+		throw Exception(tr("There are no FITS files in %1").arg(watcher_->path()));
+
+	watched_frame_ = std::make_shared<const Sequence::OpenedFrame>(Sequence::open(Sequence::Frame{filename, -1}));
+	// Content of the texture is replaced by the frames, so it is not shared
+	initialize(*watched_frame_->hdu, QFileInfo(filename).fileName(), QString());
+
+	connect(watcher_.get(), SIGNAL(frameChanged(const QString&)), this, SLOT(updateWatchedFrame(const QString&)));
 }
 
-MainWindow::MainWindow(const QString& fits_filename, QWidget *parent): QMainWindow(parent) {
-	// Open FITS file
-	std::unique_ptr<QFile> file{new QFile(fits_filename)};
-	if (!file->open(QIODevice::ReadOnly)) {
-		throw FileOpenError(file->errorString());
-	}
+MainWindow::MainWindow(std::shared_ptr<SharedMemoryRing> ring, QWidget *parent):
+	QMainWindow(parent),
+	ring_(std::move(ring)),
+	ring_sequence_(0),
+	browse_direction_(1),
+	plane_index_(0) {
 
-	// Read FITS from file
-	fits_.reset(new FITS(file.release()));
-	const FITS::HeaderDataUnit* hdu = &fits_->primary_hdu();
+	Tracer::Scope trace_scope("MainWindow", "startup");
 
-	for (auto it = fits_->begin();
-		it != fits_->end() && !hdu->data().imageDataUnit();
-		++it) {
+	std::unique_ptr<SharedMemoryFITSStorage> storage = ring_->acquireLatest(&ring_sequence_);
+	if (!storage)
+		throw Exception(tr("There are no frames in %1").arg(ring_->name()));
 
-		hdu = &(*it);
-	}
+	// The frame is read from the slot in place, which stays pinned while it is shown
+	watched_frame_ = std::make_shared<const Sequence::OpenedFrame>(Sequence::open(std::unique_ptr<FITS>(new FITS(storage.release())), -1, ring_->name()));
+	initialize(*watched_frame_->hdu, ring_->name() + " #" + QString::number(ring_sequence_), QString());
 
-	if (!hdu->data().imageDataUnit()) {
-		throw NoImageInFITS();
-	}
+	connect(&ring_timer_, SIGNAL(timeout()), this, SLOT(pollRing()));
+	ring_timer_.start(ring_poll_interval_);
+}
 
+void MainWindow::initialize(const FITS::HeaderDataUnit& hdu, const QString& title, const QString& texture_key) {
 	// Resize window to fit FITS image
 	const auto desktop_size = QApplication::desktop()->screenGeometry();
 	const QSize maximum_initial_window_size(desktop_size.width() * 2 / 3, desktop_size.height() * 2 / 3);
-	resize(hdu->data().imageDataUnit()->size().boundedTo(maximum_initial_window_size));
+	resize(hdu.data().imageDataUnit()->size().boundedTo(maximum_initial_window_size));
 
-	#ifdef Q_OS_MAC
-		setWindowTitle(QFileInfo(fits_filename).fileName());
-	#else
-		setWindowTitle(QFileInfo(fits_filename).fileName() + " — FIPS");
-	#endif
+	setTitle(title);
 
 	// Create scroll area and put there open_gl_widget
-	std::unique_ptr<ScrollZoomArea> scroll_zoom_area{new ScrollZoomArea(this, *hdu)};
+	std::unique_ptr<ScrollZoomArea> scroll_zoom_area{new ScrollZoomArea(this, hdu, texture_key,
+		(entry_ ? entry_->statistics : std::shared_ptr<const OpenGLTexture::Statistics>()), sequence_)};
 	/* setCentralWidget promises to take ownership */
 	setCentralWidget(scroll_zoom_area.release());
 
@@ -84,8 +137,16 @@ MainWindow::MainWindow(const QString& fits_filename, QWidget *parent): QMainWind
 	auto file_menu = menu_bar->addMenu(tr("&File"));
 	auto file_open_action = file_menu->addAction(tr("&Open"), Application::instance(), SLOT(openFile(void)));
 	file_open_action->setShortcut(QKeySequence::Open);
+	file_menu->addAction(tr("&Stack Files..."), Application::instance(), SLOT(stackFiles(void)));
 	auto file_close_action = file_menu->addAction(tr("&Close"), this, SLOT(close()));
 	file_close_action->setShortcut(QKeySequence::Close);
+	if (entry_) {
+		file_menu->addSeparator();
+		auto next_file_action = file_menu->addAction(tr("&Next File"), this, SLOT(nextFile()));
+		next_file_action->setShortcut(QKeySequence::Forward);
+		auto previous_file_action = file_menu->addAction(tr("&Previous File"), this, SLOT(previousFile()));
+		previous_file_action->setShortcut(QKeySequence::Back);
+	}
 	// View menu
 	auto view_menu = menu_bar->addMenu(tr("&View"));
 	auto zoomIn_action = view_menu->addAction(tr("Zoom &In"), this, SLOT(zoomIn(void)));
@@ -94,8 +155,31 @@ MainWindow::MainWindow(const QString& fits_filename, QWidget *parent): QMainWind
 	zoomOut_action->setShortcut(QKeySequence::ZoomOut);
 	auto fit_to_window_action = view_menu->addAction(tr("&Fit to Window"), this, SLOT(fitToWindow(void)));
 	fit_to_window_action->setShortcut(tr("Ctrl+F"));
+	frame_statistics_action_ = view_menu->addAction(tr("Frame &Statistics"));
+	frame_statistics_action_->setCheckable(true);
 	view_menu->addSeparator();
 	// To be continued in docks block
+	// Playback menu
+	if (sequence_) {
+		auto playback_menu = menu_bar->addMenu(tr("&Playback"));
+		auto play_action = playback_menu->addAction(tr("&Play/Pause"), scrollZoomArea()->viewport(), SLOT(togglePlayback()));
+		play_action->setShortcut(Qt::Key_Space);
+		auto next_action = playback_menu->addAction(tr("&Next Frame"), scrollZoomArea()->viewport(), SLOT(nextSequenceFrame()));
+		next_action->setShortcut(Qt::Key_Period);
+		auto previous_action = playback_menu->addAction(tr("P&revious Frame"), scrollZoomArea()->viewport(), SLOT(previousSequenceFrame()));
+		previous_action->setShortcut(Qt::Key_Comma);
+	}
+	// Cube menu, shown for cubes only
+	cube_menu_ = menu_bar->addMenu(tr("&Cube"));
+	auto next_plane_action = cube_menu_->addAction(tr("&Next Plane"), this, SLOT(nextPlane()));
+	next_plane_action->setShortcut(tr("Ctrl+]"));
+	auto previous_plane_action = cube_menu_->addAction(tr("&Previous Plane"), this, SLOT(previousPlane()));
+	previous_plane_action->setShortcut(tr("Ctrl+["));
+	cube_menu_->addAction(tr("&Collapse..."), this, SLOT(collapse()));
+	cube_menu_->menuAction()->setVisible(cubeHDU() && hdu.data().imageDataUnit()->depth() > 1);
+	// Tables menu, shown for files having binary tables
+	tables_menu_ = menu_bar->addMenu(tr("&Tables"));
+	updateTablesMenu();
 	// Help menu
 	auto help_menu = menu_bar->addMenu(tr("&Help"));
 	help_menu->addAction(tr("&About"), this, SLOT(about()));
@@ -107,29 +191,356 @@ MainWindow::MainWindow(const QString& fits_filename, QWidget *parent): QMainWind
 	levels_dock->setAllowedAreas(Qt::AllDockWidgetAreas);
 	view_menu->addAction(levels_dock->toggleViewAction());
 	levels_dock->toggleViewAction()->setShortcut(tr("Ctrl+L"));
-	std::unique_ptr<LevelsWidget> levels_widget{new LevelsWidget(levels_dock.get())};
-	connect(
-			scrollZoomArea()->viewport(), SIGNAL(textureInitialized(const OpenGLTexture*)),
-			levels_widget.get(), SLOT(notifyTextureInitialized(const OpenGLTexture*))
-	);
-	connect(
-			levels_widget.get(), SIGNAL(valuesChanged(const std::pair<double, double>&)),
-			scrollZoomArea()->viewport(), SLOT(changeLevels(const std::pair<double, double>&))
-	);
-	levels_dock->setWidget(levels_widget.release());
+	levels_widget_ = new LevelsWidget(levels_dock.get());
+	levels_dock->setWidget(levels_widget_);
 	addDockWidget(Qt::RightDockWidgetArea, levels_dock.release());
 
 	std::unique_ptr<QDockWidget> colormap_dock{new QDockWidget(tr("Color map"), this)};
 	colormap_dock->setAllowedAreas(Qt::AllDockWidgetAreas);
 	view_menu->addAction(colormap_dock->toggleViewAction());
 	colormap_dock->toggleViewAction()->setShortcut(tr("Ctrl+E"));
-	std::unique_ptr<ColorMapWidget> colormap_widget{new ColorMapWidget(colormap_dock.get(), *scrollZoomArea()->viewport())};
+	colormap_widget_ = new ColorMapWidget(colormap_dock.get(), *scrollZoomArea()->viewport());
+	colormap_dock->setWidget(colormap_widget_);
+	addDockWidget(Qt::RightDockWidgetArea, colormap_dock.release());
+
+	std::unique_ptr<QDockWidget> stretch_dock{new QDockWidget(tr("Stretch"), this)};
+	stretch_dock->setAllowedAreas(Qt::AllDockWidgetAreas);
+	view_menu->addAction(stretch_dock->toggleViewAction());
+	stretch_dock->toggleViewAction()->setShortcut(tr("Ctrl+T"));
+	stretch_widget_ = new StretchWidget(stretch_dock.get(), *scrollZoomArea()->viewport());
+	stretch_dock->setWidget(stretch_widget_);
+	addDockWidget(Qt::RightDockWidgetArea, stretch_dock.release());
+
+	std::unique_ptr<QDockWidget> header_dock{new QDockWidget(tr("Header"), this)};
+	header_dock->setAllowedAreas(Qt::AllDockWidgetAreas);
+	view_menu->addAction(header_dock->toggleViewAction());
+	header_dock->toggleViewAction()->setShortcut(tr("Ctrl+H"));
+	header_widget_ = new HeaderWidget(header_dock.get());
+	header_widget_->setHDU(shownHDU());
+	header_dock->setWidget(header_widget_);
+	header_dock->hide();
+	addDockWidget(Qt::BottomDockWidgetArea, header_dock.release());
+
+	checksum_label_ = new ChecksumLabel(this);
+	statusBar()->addPermanentWidget(checksum_label_);
+	verifyChecksum();
+
+	connectViewport();
+}
+
+void MainWindow::setTitle(const QString& title) {
+	title_ = title;
+
+	auto text = title;
+	const auto cube = cubeHDU();
+	if (cube && cube->data().imageDataUnit()->depth() > 1)
+		text += QString(" [%1/%2]").arg(plane_index_ + 1).arg(cube->data().imageDataUnit()->depth());
+
+	#ifdef Q_OS_MAC
+		setWindowTitle(text);
+	#else
+		setWindowTitle(text + " — FIPS");
+	#endif
+}
+
+void MainWindow::connectViewport() {
+	auto viewport = scrollZoomArea()->viewport();
+
+	connect(frame_statistics_action_, SIGNAL(toggled(bool)), viewport, SLOT(setFrameStatisticsVisible(bool)));
 	connect(
-			colormap_widget->buttonGroup(), SIGNAL(buttonClicked(int)),
-			scrollZoomArea()->viewport(), SLOT(changeColorMap(int))
+			viewport, SIGNAL(textureInitialized(const OpenGLTexture*)),
+			levels_widget_, SLOT(notifyTextureInitialized(const OpenGLTexture*))
 	);
-	colormap_dock->setWidget(colormap_widget.release());
-	addDockWidget(Qt::RightDockWidgetArea, colormap_dock.release());
+	connect(
+			levels_widget_, SIGNAL(valuesChanged(const std::pair<double, double>&)),
+			viewport, SLOT(changeLevels(const std::pair<double, double>&))
+	);
+	connect(
+			colormap_widget_->buttonGroup(), SIGNAL(buttonClicked(int)),
+			viewport, SLOT(changeColorMap(int))
+	);
+	connect(
+			stretch_widget_, SIGNAL(stretchChanged(int, double)),
+			viewport, SLOT(changeStretch(int, double))
+	);
+}
+
+void MainWindow::nextFile() {
+	browse(1);
+}
+
+void MainWindow::previousFile() {
+	browse(-1);
+}
+
+void MainWindow::browse(int delta) {
+	Q_ASSERT(entry_);
+
+	if (directory_files_.isEmpty())
+		directory_files_ = Application::directoryFiles(entry_->filename);
+
+	const int current = directory_files_.indexOf(entry_->filename);
+	const int index = current + delta;
+	if (current < 0 || index < 0 || index >= directory_files_.size())
+		return;
+
+	browse_direction_ = (delta > 0 ? 1 : -1);
+
+	std::shared_ptr<const FITSCache::Entry> entry;
+	try {
+		entry = Application::instance()->fitsCache().open(directory_files_[index]);
+	} catch (const std::exception& e) {
+		QMessageBox::critical(this, tr("An error occured"), e.what());
+		return;
+	}
+
+	// The old viewport has to be deleted before its file is released
+	replaceViewport(*entry->frame.hdu, OpenGLResourceRegistry::textureKey(entry->filename, entry->frame.hdu_index), entry->statistics);
+	plane_index_ = 0;
+	entry_ = std::move(entry);
+
+	cube_menu_->menuAction()->setVisible(entry_->frame.hdu->data().imageDataUnit()->depth() > 1);
+	updateTablesMenu();
+	header_widget_->setHDU(shownHDU());
+	verifyChecksum();
+	setTitle(QFileInfo(entry_->filename).fileName());
+
+	prefetchNeighbours();
+}
+
+void MainWindow::replaceViewport(const FITS::HeaderDataUnit& hdu, const QString& texture_key, std::shared_ptr<const OpenGLTexture::Statistics> statistics) {
+	// The view settings are kept, the levels are reset by the new texture
+	const auto old_viewport = scrollZoomArea()->viewport();
+	const int colormap_index = old_viewport->colorMapIndex();
+	const auto stretch = old_viewport->stretch();
+	const double stretch_parameter = old_viewport->stretchParameter();
+
+	{
+		std::unique_ptr<QWidget> old_scroll_zoom_area{takeCentralWidget()};
+		std::unique_ptr<ScrollZoomArea> scroll_zoom_area{new ScrollZoomArea(this, hdu, texture_key, std::move(statistics))};
+		/* setCentralWidget promises to take ownership */
+		setCentralWidget(scroll_zoom_area.release());
+	}
+
+	auto viewport = scrollZoomArea()->viewport();
+	viewport->changeColorMap(colormap_index);
+	viewport->changeStretch(stretch, stretch_parameter);
+	viewport->setFrameStatisticsVisible(frame_statistics_action_->isChecked());
+	connectViewport();
+}
+
+void MainWindow::updateWatchedFrame(const QString& filename) {
+	Tracer::Scope trace_scope("watched frame", "watch");
+
+	std::shared_ptr<const Sequence::OpenedFrame> frame;
+	try {
+		frame = std::make_shared<const Sequence::OpenedFrame>(Sequence::open(Sequence::Frame{filename, -1}));
+	} catch (const std::exception& e) {
+		// The file may be rewritten again meanwhile, the next frame is waited for
+		qWarning() << "Cannot open watched frame" << filename << ":" << e.what();
+		return;
+	}
+
+	showWatchedFrame(std::move(frame), QFileInfo(filename).fileName());
+}
+
+void MainWindow::pollRing() {
+	// The sequence is checked first not to take a hold register in vain
+	if (ring_->latestSequence() == ring_sequence_)
+		return;
+
+	Tracer::Scope trace_scope("ring frame", "watch");
+
+	quint64 sequence = 0;
+	std::unique_ptr<SharedMemoryFITSStorage> storage = ring_->acquireLatest(&sequence);
+	// All the hold registers are taken, the frame is tried again by the next poll
+	if (!storage)
+		return;
+	ring_sequence_ = sequence;
+
+	std::shared_ptr<const Sequence::OpenedFrame> frame;
+	try {
+		frame = std::make_shared<const Sequence::OpenedFrame>(Sequence::open(std::unique_ptr<FITS>(new FITS(storage.release())), -1, ring_->name()));
+	} catch (const std::exception& e) {
+		qWarning() << "Cannot open frame" << sequence << "of" << ring_->name() << ":" << e.what();
+		return;
+	}
+
+	showWatchedFrame(std::move(frame), ring_->name() + " #" + QString::number(sequence));
+}
+
+void MainWindow::showWatchedFrame(std::shared_ptr<const Sequence::OpenedFrame> frame, const QString& title) {
+	header_widget_->setHDU(std::shared_ptr<const FITS::HeaderDataUnit>(frame, frame->hdu));
+
+	const auto image = frame->hdu->data().imageDataUnit();
+	const auto shown = watched_frame_->hdu->data().imageDataUnit();
+	if (image->size() == shown->size() && image->depth() == 1 && shown->depth() == 1 &&
+			frame->hdu->header().header("BITPIX") == watched_frame_->hdu->header().header("BITPIX")) {
+		// Only the changed rows are uploaded into the texture of the viewport.
+		// The viewport keeps the previous frame until the upload.
+		watched_frame_ = frame;
+		scrollZoomArea()->viewport()->updateFrame(std::move(frame));
+	} else {
+		// The old viewport has to be deleted before its file is released
+		replaceViewport(*frame->hdu, QString(), std::shared_ptr<const OpenGLTexture::Statistics>());
+		plane_index_ = 0;
+		watched_frame_ = std::move(frame);
+		cube_menu_->menuAction()->setVisible(image->depth() > 1);
+	}
+
+	setTitle(title);
+}
+
+std::shared_ptr<const FITS::HeaderDataUnit> MainWindow::shownHDU() const {
+	// The pointers keep the files mapped while the header is shown
+	if (entry_)
+		return std::shared_ptr<const FITS::HeaderDataUnit>(entry_, entry_->frame.hdu);
+	if (sequence_)
+		return std::shared_ptr<const FITS::HeaderDataUnit>(sequence_, sequence_->first().hdu);
+	if (watched_frame_)
+		return std::shared_ptr<const FITS::HeaderDataUnit>(watched_frame_, watched_frame_->hdu);
+	if (fits_)
+		return std::shared_ptr<const FITS::HeaderDataUnit>(fits_, &fits_->primary_hdu());
+	return std::shared_ptr<const FITS::HeaderDataUnit>();
+}
+
+void MainWindow::verifyChecksum() {
+	// Frames replaced as they are written are not summed
+	checksum_label_->verify(watched_frame_ ? std::shared_ptr<const FITS::HeaderDataUnit>() : shownHDU());
+	// The bar holds the indicator only
+	statusBar()->setVisible(!checksum_label_->isHidden());
+}
+
+const FITS::HeaderDataUnit* MainWindow::cubeHDU() const {
+	if (entry_)
+		return entry_->frame.hdu;
+	if (watched_frame_)
+		return watched_frame_->hdu;
+	if (fits_)
+		return &fits_->primary_hdu();
+	return Q_NULLPTR;
+}
+
+void MainWindow::nextPlane() {
+	showPlane(plane_index_ + 1);
+}
+
+void MainWindow::previousPlane() {
+	if (plane_index_ > 0)
+		showPlane(plane_index_ - 1);
+}
+
+void MainWindow::showPlane(quint64 index) {
+	const auto cube = cubeHDU();
+	if (!cube || index >= cube->data().imageDataUnit()->depth() || index == plane_index_)
+		return;
+
+	// Levels of the first plane are kept, so the planes are comparable
+	scrollZoomArea()->viewport()->setPlane(index);
+	plane_index_ = index;
+
+	setTitle(title_);
+}
+
+void MainWindow::collapse() {
+	const auto cube = cubeHDU();
+	if (!cube)
+		return;
+	const int depth = static_cast<int>(std::min<quint64>(cube->data().imageDataUnit()->depth(), std::numeric_limits<int>::max()));
+
+	QStringList operations;
+	for (int i = 0; i < CubeCollapser::OperationCount; ++i) {
+		operations << CubeCollapser::operationName(static_cast<CubeCollapser::Operation>(i));
+	}
+	bool ok = false;
+	const auto operation = QInputDialog::getItem(this, tr("Collapse"), tr("Operation:"), operations, 0, false, &ok);
+	if (!ok) return;
+	const int first = QInputDialog::getInt(this, tr("Collapse"), tr("First plane:"), 1, 1, depth, 1, &ok);
+	if (!ok) return;
+	const int last = QInputDialog::getInt(this, tr("Collapse"), tr("Last plane:"), depth, first, depth, 1, &ok);
+	if (!ok) return;
+
+	CubeCollapser::Options options;
+	options.operation = CubeCollapser::operationFromName(operation);
+	options.first = first - 1;
+	options.last = last - 1;
+
+	QApplication::setOverrideCursor(Qt::WaitCursor);
+	try {
+		auto fits = CubeCollapser(*cube).collapseToFITS(options);
+		Application::instance()->addImageInstance(std::move(fits), QString("%1 of %2 [%3-%4]").arg(operation, title_).arg(first).arg(last));
+	} catch (const std::exception& e) {
+		QMessageBox::critical(this, tr("An error occured"), e.what());
+	}
+	QApplication::restoreOverrideCursor();
+}
+
+void MainWindow::updateTablesMenu() {
+	for (const auto& x: table_docks_) {
+		delete x.second;
+	}
+	table_docks_.clear();
+	tables_menu_->clear();
+
+	if (entry_) {
+		quint64 index = 1;
+		for (auto it = entry_->frame.fits->begin(); it != entry_->frame.fits->end(); ++it, ++index) {
+			const auto table = dynamic_cast<const FITS::TableDataUnit*>(&it->data());
+			if (!table)
+				continue;
+
+			const auto extname = FITS::HeaderUnit::unquoted(it->header().header("EXTNAME", QString()));
+			const auto text = tr("HDU %1%2 (%3 rows)").arg(index).arg(extname.isEmpty() ? QString() : ": " + extname).arg(table->rows());
+			auto action = tables_menu_->addAction(text);
+			connect(action, &QAction::triggered, this, [this, index] () { showTable(index); });
+		}
+	}
+	tables_menu_->menuAction()->setVisible(!tables_menu_->isEmpty());
+}
+
+void MainWindow::showTable(quint64 hdu_index) {
+	Q_ASSERT(entry_);
+
+	auto it = table_docks_.find(hdu_index);
+	if (it != table_docks_.end()) {
+		it->second->show();
+		it->second->raise();
+		return;
+	}
+
+	const auto& hdu = *std::next(entry_->frame.fits->begin(), hdu_index - 1);
+	const auto extname = FITS::HeaderUnit::unquoted(hdu.header().header("EXTNAME", QString()));
+	// The model keeps the cache entry, so the file stays mapped
+	std::shared_ptr<const FITS::HeaderDataUnit> table(entry_, &hdu);
+
+	std::unique_ptr<QDockWidget> table_dock{new QDockWidget(extname.isEmpty() ? tr("HDU %1").arg(hdu_index) : extname, this)};
+	table_dock->setAllowedAreas(Qt::AllDockWidgetAreas);
+	std::unique_ptr<QTableView> table_view{new QTableView(table_dock.get())};
+	table_view->setModel(new TableModel(std::move(table), table_view.get()));
+	// Rows of fixed height are laid out without asking the model
+	table_view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+	table_view->verticalHeader()->setDefaultSectionSize(table_view->fontMetrics().height() + 4);
+	table_dock->setWidget(table_view.release());
+	table_docks_[hdu_index] = table_dock.get();
+	addDockWidget(Qt::BottomDockWidgetArea, table_dock.release());
+}
+
+void MainWindow::prefetchNeighbours() {
+	if (!entry_)
+		return;
+
+	if (directory_files_.isEmpty())
+		directory_files_ = Application::directoryFiles(entry_->filename);
+
+	const int index = directory_files_.indexOf(entry_->filename);
+	if (index < 0)
+		return;
+
+	QStringList filenames;
+	for (auto x: FITSCache::prefetchOrder(index, browse_direction_, directory_files_.size(), prefetch_depth_)) {
+		filenames << directory_files_[x];
+	}
+	Application::instance()->fitsCache().prefetch(filenames);
 }
 
 void MainWindow::zoomIn() {
@@ -0,0 +1,63 @@
+#include <QtEndian>
+
+#include <cstring>
+
+#include <memoryfitsstorage.h>
+
+namespace {
+	void appendCard(QByteArray& header, const QString& key, const QString& value) {
+		auto card = key.leftJustified(8, ' ', true).toLatin1();
+		// Strings start right after the indicator, other values end at 30
+		if (!value.isNull())
+			card += "= " + (value.startsWith('\'') ? value : value.rightJustified(20)).toLatin1();
+		header += card.leftJustified(80, ' ', true);
+	}
+
+	inline qint64 padded(qint64 size) {
+		return (size + 2879) / 2880 * 2880;
+	}
+}
+
+MemoryFITSStorage::MemoryFITSStorage(quint8* data, qint64 size):
+	AbstractFITSStorage(data, size) {
+}
+MemoryFITSStorage::~MemoryFITSStorage() {
+	delete[] data();
+}
+
+std::unique_ptr<FITS> MemoryFITSStorage::createFloatImage(const QSize& size, const float* data, const cards_type& cards) {
+	QByteArray header;
+	appendCard(header, "SIMPLE", "T");
+	appendCard(header, "BITPIX", "-32");
+	appendCard(header, "NAXIS", "2");
+	appendCard(header, "NAXIS1", QString::number(size.width()));
+	appendCard(header, "NAXIS2", QString::number(size.height()));
+	for (const auto& x: cards) {
+		appendCard(header, x.first, x.second);
+	}
+	appendCard(header, "END", QString());
+
+	const qint64 header_size = padded(header.size());
+	const qint64 length = static_cast<qint64>(size.width()) * size.height();
+	const qint64 total_size = header_size + padded(length * static_cast<qint64>(sizeof(float)));
+
+	std::unique_ptr<quint8[]> bytes{new quint8[total_size]};
+	std::memset(bytes.get(), ' ', header_size);
+	std::memcpy(bytes.get(), header.constData(), header.size());
+	std::memset(bytes.get() + header_size, 0, total_size - header_size);
+
+	auto dst = bytes.get() + header_size;
+	for (qint64 i = 0; i < length; ++i) {
+		quint32 bits;
+		std::memcpy(&bits, data + i, sizeof(bits));
+		qToBigEndian(bits, dst + i * sizeof(bits));
+	}
+
+	std::unique_ptr<MemoryFITSStorage> storage{new MemoryFITSStorage(bytes.release(), total_size)};
+	return std::unique_ptr<FITS>(new FITS(storage.release()));
+}
+
+QString MemoryFITSStorage::stringValue(const QString& value) {
+	// Strings are at least 8 characters long, quotes are doubled
+	return "'" + QString(value).replace("'", "''").leftJustified(8) + "'";
+}
@@ -1,9 +1,16 @@
 #include <mmapfitsstorage.h>
+#include <tracer.h>
+
+namespace {
+	quint8* map(QFileDevice* file_device) {
+		Tracer::Scope trace_scope("MMapFITSStorage map", "startup");
+
+		return static_cast<quint8*>(file_device->map(static_cast<qint64>(0), file_device->size(), QFileDevice::MapPrivateOption));
+	}
+}
 
 MMapFITSStorage::MMapFITSStorage(QFileDevice* file_device):
-	AbstractFITSStorage(
-		static_cast<quint8*>(file_device->map(static_cast<qint64>(0), file_device->size(), QFileDevice::MapPrivateOption)),
-		file_device->size()),
+	AbstractFITSStorage(map(file_device), file_device->size()),
 	file_device_(file_device) {
 }
 MMapFITSStorage::~MMapFITSStorage() {
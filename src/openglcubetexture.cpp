@@ -0,0 +1,156 @@
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#ifndef QT_OPENGL_ES_2
+#include <QOpenGLFunctions_1_2>
+#endif
+
+#include <algorithm>
+
+#include <openglcubetexture.h>
+#include <tracer.h>
+
+OpenGLCubeTexture::OpenGLCubeTexture(const FITS::HeaderDataUnit& hdu, const OpenGLTexture& texture):
+	QOpenGLTexture(QOpenGLTexture::Target3D),
+	hdu_(&hdu),
+	texture_format_(texture.texture_format()),
+	pixel_format_(texture.pixel_format()),
+	pixel_type_(texture.pixel_type()),
+	swap_bytes_enabled_(texture.swap_bytes_enabled()),
+	layers_(0),
+	current_(0) {
+}
+
+bool OpenGLCubeTexture::allocate(qint64 budget) {
+	Tracer::Scope trace_scope("cube texture allocate", "gl");
+
+	auto functions = QOpenGLContext::currentContext()->functions();
+	GLint max_size = 0;
+	functions->glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max_size);
+
+	const auto image = hdu_->data().imageDataUnit();
+	const qint64 plane_size = std::max<qint64>(image->length(), 1);
+	layers_ = std::max<qint64>(1, std::min<qint64>(budget / plane_size, std::min<qint64>(depth(), max_size)));
+	resident_.assign(layers_, -1);
+
+	setMinificationFilter(QOpenGLTexture::Nearest);
+	setMagnificationFilter(QOpenGLTexture::Nearest);
+	setWrapMode(QOpenGLTexture::ClampToEdge);
+	setFormat(texture_format_);
+	setSize(image->width(), image->height(), layers_);
+
+	// Errors of the previous calls are not ours
+	while (functions->glGetError() != GL_NO_ERROR) {}
+	allocateStorage(pixel_format_, pixel_type_);
+	return isStorageAllocated() && functions->glGetError() == GL_NO_ERROR;
+}
+
+quint64 OpenGLCubeTexture::windowBegin() const {
+	const quint64 half = layers_ / 2;
+	return std::min(current_ > half ? current_ - half : 0, depth() - layers_);
+}
+
+void OpenGLCubeTexture::setCurrentPlane(quint64 plane) {
+	Q_ASSERT(plane < depth());
+
+	current_ = plane;
+}
+
+bool OpenGLCubeTexture::isResident(quint64 plane) const {
+	return resident_[plane % layers_] == static_cast<qint64>(plane);
+}
+
+bool OpenGLCubeTexture::hasPendingPlanes() const {
+	const quint64 begin = windowBegin();
+	for (quint64 plane = begin; plane < begin + layers_; ++plane) {
+		if (!isResident(plane))
+			return true;
+	}
+	return false;
+}
+
+bool OpenGLCubeTexture::uploadNextPlane() {
+	const quint64 begin = windowBegin();
+	const quint64 end = begin + layers_;
+
+	// Forward first, as the planes are usually scrubbed forward
+	for (quint64 distance = 0; distance < layers_; ++distance) {
+		const quint64 forward = current_ + distance;
+		if (forward < end && !isResident(forward)) {
+			upload(forward);
+			return true;
+		}
+		if (distance <= current_) {
+			const quint64 backward = current_ - distance;
+			if (backward >= begin && !isResident(backward)) {
+				upload(backward);
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+void OpenGLCubeTexture::upload(quint64 plane) {
+#ifndef QT_OPENGL_ES_2
+	Tracer::Scope trace_scope("cube plane upload", "gl");
+
+	auto functions = QOpenGLContext::currentContext()->versionFunctions<QOpenGLFunctions_1_2>();
+	Q_ASSERT(functions);
+	functions->initializeOpenGLFunctions();
+
+	const auto image = hdu_->data().imageDataUnit();
+	const quint64 layer = plane % layers_;
+
+	bind();
+	functions->glPixelStorei(GL_UNPACK_SWAP_BYTES, swap_bytes_enabled_ ? GL_TRUE : GL_FALSE);
+	functions->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+	functions->glTexSubImage3D(GL_TEXTURE_3D, 0, 0, 0, static_cast<GLint>(layer),
+		static_cast<GLsizei>(image->width()), static_cast<GLsizei>(image->height()), 1,
+		pixel_format_, pixel_type_, image->planeData(plane));
+	functions->glPixelStorei(GL_UNPACK_SWAP_BYTES, GL_FALSE);
+	functions->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	release();
+
+	resident_[layer] = plane;
+#else
+	Q_UNUSED(plane);
+	Q_ASSERT(0);
+#endif
+}
+
+float OpenGLCubeTexture::planeCoordinate(quint64 plane) const {
+	return (static_cast<float>(plane % layers_) + 0.5f) / static_cast<float>(layers_);
+}
+
+bool OpenGLCubeTexture::isSupported(const QSize& size) {
+#ifndef QT_OPENGL_ES_2
+	auto context = QOpenGLContext::currentContext();
+	if (!context || context->isOpenGLES() || !context->versionFunctions<QOpenGLFunctions_1_2>())
+		return false;
+
+	GLint max_size = 0;
+	context->functions()->glGetIntegerv(GL_MAX_3D_TEXTURE_SIZE, &max_size);
+	return size.width() <= max_size && size.height() <= max_size;
+#else
+	Q_UNUSED(size);
+	return false;
+#endif
+}
+
+qint64 OpenGLCubeTexture::budget() {
+	// Kilobytes of the free memory reported by the vendor extensions
+	static const GLenum gpu_memory_info_current_available_vidmem_nvx = 0x9049;
+	static const GLenum texture_free_memory_ati = 0x87FC;
+
+	auto context = QOpenGLContext::currentContext();
+	GLint available[4] = {0, 0, 0, 0};
+	if (context->hasExtension("GL_NVX_gpu_memory_info")) {
+		context->functions()->glGetIntegerv(gpu_memory_info_current_available_vidmem_nvx, available);
+	} else if (context->hasExtension("GL_ATI_meminfo")) {
+		context->functions()->glGetIntegerv(texture_free_memory_ati, available);
+	}
+
+	if (available[0] > 0)
+		return std::min(default_budget, (static_cast<qint64>(available[0]) << 10) / 2);
+	return default_budget;
+}
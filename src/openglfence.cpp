@@ -0,0 +1,56 @@
+#include <QOpenGLContext>
+
+#include <openglfence.h>
+
+namespace {
+	// Constants from GL_ARB_sync extension documentation:
+	// https://www.khronos.org/registry/OpenGL/extensions/ARB/ARB_sync.txt
+	const GLenum sync_gpu_commands_complete = 0x9117;
+	const quint64 timeout_ignored = Q_UINT64_C(0xFFFFFFFFFFFFFFFF);
+}
+
+bool OpenGLFence::resolve(Functions* functions) {
+	auto context = QOpenGLContext::currentContext();
+	if (!context)
+		return false;
+
+	const auto version = context->format().version();
+	const bool is_core = (context->isOpenGLES() ? version >= qMakePair(3, 0) : version >= qMakePair(3, 2));
+	if (!is_core && !context->hasExtension("GL_ARB_sync"))
+		return false;
+
+	functions->fence_sync  = reinterpret_cast<fence_sync_type>(context->getProcAddress("glFenceSync"));
+	functions->wait_sync   = reinterpret_cast<wait_sync_type>(context->getProcAddress("glWaitSync"));
+	functions->delete_sync = reinterpret_cast<delete_sync_type>(context->getProcAddress("glDeleteSync"));
+	return functions->fence_sync && functions->wait_sync && functions->delete_sync;
+}
+
+OpenGLFence::Sync OpenGLFence::insert() {
+	auto gl = QOpenGLContext::currentContext()->functions();
+	Functions functions;
+	if (!resolve(&functions)) {
+		gl->glFinish();
+		return Q_NULLPTR;
+	}
+
+	const auto sync = functions.fence_sync(sync_gpu_commands_complete, 0);
+	gl->glFlush();
+	return sync;
+}
+
+void OpenGLFence::wait(Sync sync) {
+	Functions functions;
+	if (!sync || !resolve(&functions))
+		return;
+
+	functions.wait_sync(sync, 0, timeout_ignored);
+	functions.delete_sync(sync);
+}
+
+void OpenGLFence::remove(Sync sync) {
+	Functions functions;
+	if (!sync || !resolve(&functions))
+		return;
+
+	functions.delete_sync(sync);
+}
@@ -0,0 +1,158 @@
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QFile>
+#include <QOpenGLContext>
+#include <QStandardPaths>
+
+#include <cachefile.h>
+#include <openglprogrambinarycache.h>
+
+namespace {
+	// Constants from GL_ARB_get_program_binary extension documentation:
+	// https://www.khronos.org/registry/OpenGL/extensions/ARB/ARB_get_program_binary.txt
+	const GLenum program_binary_retrievable_hint = 0x8257;
+	const GLenum program_binary_length = 0x8741;
+	const GLenum num_program_binary_formats = 0x87FE;
+
+	const quint32 file_magic = 0x46505242;  // "FPRB"
+	const quint32 file_version = 1;
+}
+
+OpenGLProgramBinaryCache::OpenGLProgramBinaryCache(const QString& directory):
+	directory_(directory) {
+}
+
+bool OpenGLProgramBinaryCache::resolve(Functions* functions) {
+	auto context = QOpenGLContext::currentContext();
+	if (!context)
+		return false;
+
+	const auto version = context->format().version();
+	const bool is_core = (context->isOpenGLES() ? version >= qMakePair(3, 0) : version >= qMakePair(4, 1));
+
+	if (is_core || context->hasExtension("GL_ARB_get_program_binary")) {
+		functions->get_program_binary = reinterpret_cast<get_program_binary_type>(context->getProcAddress("glGetProgramBinary"));
+		functions->program_binary     = reinterpret_cast<program_binary_type>(context->getProcAddress("glProgramBinary"));
+		functions->program_parameteri = reinterpret_cast<program_parameteri_type>(context->getProcAddress("glProgramParameteri"));
+	} else if (context->hasExtension("GL_OES_get_program_binary")) {
+		functions->get_program_binary = reinterpret_cast<get_program_binary_type>(context->getProcAddress("glGetProgramBinaryOES"));
+		functions->program_binary     = reinterpret_cast<program_binary_type>(context->getProcAddress("glProgramBinaryOES"));
+		functions->program_parameteri = Q_NULLPTR;
+	} else {
+		return false;
+	}
+
+	if (!functions->get_program_binary || !functions->program_binary)
+		return false;
+
+	// Some drivers expose the extension without supporting any binary format
+	GLint formats = 0;
+	context->functions()->glGetIntegerv(num_program_binary_formats, &formats);
+	return formats > 0;
+}
+
+QByteArray OpenGLProgramBinaryCache::renderer() {
+	auto functions = QOpenGLContext::currentContext()->functions();
+	QByteArray renderer;
+
+	for (auto name: {GL_VENDOR, GL_RENDERER, GL_VERSION}) {
+		renderer.append(reinterpret_cast<const char*>(functions->glGetString(name)));
+		renderer.append('\n');
+	}
+
+	return renderer;
+}
+
+QString OpenGLProgramBinaryCache::path(const QByteArray& key) const {
+	return directory_ + QString("/") + QString::fromLatin1(key) + QString(".bin");
+}
+
+QByteArray OpenGLProgramBinaryCache::key(const QByteArray& vertex_source, const QByteArray& fragment_source) {
+	QCryptographicHash hash(QCryptographicHash::Sha1);
+	hash.addData(renderer());
+	hash.addData(vertex_source);
+	hash.addData("\0", 1);
+	hash.addData(fragment_source);
+
+	return hash.result().toHex();
+}
+
+void OpenGLProgramBinaryCache::prepare(QOpenGLShaderProgram* program) const {
+	Functions functions;
+
+	if (directory_.isEmpty() || !resolve(&functions) || !functions.program_parameteri)
+		return;
+
+	if (program->create())
+		functions.program_parameteri(program->programId(), program_binary_retrievable_hint, GL_TRUE);
+}
+
+bool OpenGLProgramBinaryCache::load(QOpenGLShaderProgram* program, const QByteArray& key) const {
+	Functions functions;
+
+	if (directory_.isEmpty() || !resolve(&functions))
+		return false;
+
+	QFile file(path(key));
+	if (!file.open(QIODevice::ReadOnly))
+		return false;
+
+	QDataStream stream(&file);
+	quint32 magic = 0, version = 0, binary_format = 0;
+	QByteArray renderer, binary;
+	stream >> magic >> version >> renderer >> binary_format >> binary;
+
+	if (stream.status() != QDataStream::Ok
+		|| magic != file_magic
+		|| version != file_version
+		|| renderer != OpenGLProgramBinaryCache::renderer()
+		|| binary.isEmpty()) {
+
+		file.remove();
+		return false;
+	}
+
+	if (!program->create())
+		return false;
+
+	functions.program_binary(program->programId(), binary_format, binary.constData(), binary.size());
+	// QOpenGLShaderProgram::link() checks GL_LINK_STATUS when there are no shaders attached
+	if (!program->link()) {
+		// Discard GL_INVALID_ENUM from unknown binary format
+		QOpenGLContext::currentContext()->functions()->glGetError();
+		file.remove();
+		return false;
+	}
+
+	return true;
+}
+
+bool OpenGLProgramBinaryCache::store(QOpenGLShaderProgram* program, const QByteArray& key) const {
+	Functions functions;
+
+	if (directory_.isEmpty() || !resolve(&functions) || !program->isLinked())
+		return false;
+
+	GLint length = 0;
+	QOpenGLContext::currentContext()->functions()->glGetProgramiv(program->programId(), program_binary_length, &length);
+	if (length <= 0)
+		return false;
+
+	QByteArray binary(length, Qt::Uninitialized);
+	GLsizei written = 0;
+	GLenum binary_format = 0;
+	functions.get_program_binary(program->programId(), length, &written, &binary_format, binary.data());
+	if (written <= 0)
+		return false;
+	binary.resize(written);
+
+	return writeCacheFile(path(key), [&] (QDataStream& stream) {
+		stream << file_magic << file_version << renderer() << static_cast<quint32>(binary_format) << binary;
+	});
+}
+
+QString OpenGLProgramBinaryCache::defaultDirectory() {
+	const auto location = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+
+	return (location.isEmpty() ? QString() : location + QString("/shaders"));
+}
@@ -0,0 +1,295 @@
+#include <openglrenderer.h>
+#include <tracer.h>
+
+OpenGLRenderer::Exception::Exception(const QString &what, GLenum gl_error_code):
+	::Exception(what + ": " + glErrorString(gl_error_code)) {
+}
+void OpenGLRenderer::Exception::raise() const {
+	throw *this;
+}
+QException* OpenGLRenderer::Exception::clone() const {
+	return new OpenGLRenderer::Exception(*this);
+}
+// From OpenGL ES 2.0 documentation:
+// https://www.khronos.org/registry/OpenGL-Refpages/es2.0/xhtml/glGetError.xml
+QString OpenGLRenderer::Exception::glErrorString(GLenum gl_error_code) {
+	switch (gl_error_code) {
+//		case GL_NO_ERROR:
+//			return "No error has been recorded. The value of this symbolic constant is guaranteed to be 0.";
+		case GL_INVALID_ENUM:
+			return "An unacceptable value is specified for an enumerated argument. "
+					"The offending command is ignored and has no other side effect than to set the error flag.";
+		case GL_INVALID_VALUE:
+			return "A numeric argument is out of range. "
+					"The offending command is ignored and has no other side effect than to set the error flag.";
+		case GL_INVALID_OPERATION:
+			return "The specified operation is not allowed in the current state. "
+					"The offending command is ignored and has no other side effect than to set the error flag.";
+		case GL_INVALID_FRAMEBUFFER_OPERATION:
+			return "The command is trying to render to or read from the framebuffer while the currently bound framebuffer is not framebuffer complete (i.e. the return value from glCheckFramebufferStatus is not GL_FRAMEBUFFER_COMPLETE). "
+					"The offending command is ignored and has no other side effect than to set the error flag.";
+		case GL_OUT_OF_MEMORY:
+			return "There is not enough memory left to execute the command. "
+					"The state of the GL is undefined, except for the state of the error flags, after this error is recorded.";
+		default:
+			return "Unknown error";
+	}
+}
+OpenGLRenderer::ShaderLoadError::ShaderLoadError(GLenum gl_error_code):
+	OpenGLRenderer::Exception("Cannot load the shader", gl_error_code) {
+}
+void OpenGLRenderer::ShaderLoadError::raise() const {
+	throw *this;
+}
+QException* OpenGLRenderer::ShaderLoadError::clone() const {
+	return new OpenGLRenderer::ShaderLoadError(*this);
+}
+OpenGLRenderer::ShaderBindError::ShaderBindError(GLenum gl_error_code):
+	OpenGLRenderer::Exception("Cannot bind the shader", gl_error_code) {
+}
+void OpenGLRenderer::ShaderBindError::raise() const {
+	throw *this;
+}
+QException* OpenGLRenderer::ShaderBindError::clone() const {
+	return new OpenGLRenderer::ShaderBindError(*this);
+}
+OpenGLRenderer::ShaderCompileError::ShaderCompileError(GLenum gl_error_code):
+	OpenGLRenderer::Exception("Cannot compile the shader", gl_error_code) {
+}
+void OpenGLRenderer::ShaderCompileError::raise() const {
+	throw *this;
+}
+QException* OpenGLRenderer::ShaderCompileError::clone() const {
+	return new OpenGLRenderer::ShaderCompileError(*this);
+}
+OpenGLRenderer::TextureCreateError::TextureCreateError(GLenum gl_error_code):
+		OpenGLRenderer::Exception("Cannot create texture", gl_error_code) {
+}
+void OpenGLRenderer::TextureCreateError::raise() const {
+	throw *this;
+}
+QException* OpenGLRenderer::TextureCreateError::clone() const {
+	return new OpenGLRenderer::TextureCreateError(*this);
+}
+
+OpenGLRenderer::State::State():
+	viewrect(0, 0, 1, 1),
+	has_levels(false),
+	levels(0, 0),
+	colormap_index(0),
+	stretch(OpenGLShaderUniforms::LinearStretch),
+	stretch_parameter(0),
+	plane(0) {
+}
+
+OpenGLRenderer::OpenGLRenderer(OpenGLResourceRegistry& registry, const FITS::HeaderDataUnit& hdu, const QString& texture_key, std::shared_ptr<const OpenGLTexture::Statistics> statistics):
+	registry_(&registry),
+	hdu_(&hdu),
+	texture_key_(texture_key),
+	statistics_(std::move(statistics)),
+	cube_texture_enabled_(true),
+	shown_plane_(0),
+	uploaded_levels_(0, 0),
+	uploaded_colormap_index_(-1),
+	uploaded_stretch_(OpenGLShaderUniforms::LinearStretch),
+	uploaded_stretch_parameter_(0),
+	uploaded_plane_coordinate_(-1) {
+}
+
+OpenGLRenderer::~OpenGLRenderer() {
+	vbo_.destroy();
+	profiler_.destroy();
+	cube_texture_.reset();
+	plane_texture_.reset();
+	// Shared resources are deleted when the last reference is dropped
+	texture_.reset();
+	program_.reset();
+	for (auto& x: colormaps_) {
+		x.reset();
+	}
+}
+
+void OpenGLRenderer::initialize() {
+	Tracer::Scope trace_scope("renderer initialize", "startup");
+
+	initializeOpenGLFunctions();
+
+	texture_ = registry_->texture(texture_key_, *hdu_, statistics_);
+	shader_uniforms_.reset(new OpenGLShaderUniforms(texture_->channels(), texture_->channel_size(), hdu_->header().bzero(), hdu_->header().bscale()));
+	colormaps_ = registry_->colormaps();
+
+	const auto image = hdu_->data().imageDataUnit();
+	if (cube_texture_enabled_ && image && image->depth() > 1 && OpenGLCubeTexture::isSupported(image->size())) {
+		std::unique_ptr<OpenGLCubeTexture> cube_texture{new OpenGLCubeTexture(*hdu_, *texture_)};
+		// Per-plane textures are used when there is no room for the cube
+		if (cube_texture->allocate(OpenGLCubeTexture::budget())) {
+			// The first plane is shown right away, the others are uploaded in background
+			cube_texture->uploadNextPlane();
+			cube_texture_ = std::move(cube_texture);
+		}
+	}
+
+	auto program = registry_->program(hdu_->header().header("BITPIX"), static_cast<bool>(cube_texture_));
+
+	vbo_.create();
+	vbo_.bind();
+	vbo_.allocate(vbo_data, sizeof(vbo_data));
+	vbo_.release();
+
+	if (! program->bind()) throw ShaderBindError(glGetError());
+	program->setUniformValue("texture",  program_texture_uniform_);
+	program->setUniformValue("colormap", program_colormap_uniform_);
+	program->setUniformValue("equalization", program_equalization_uniform_);
+
+	profiler_.initialize();
+	program_ = program;
+}
+
+void OpenGLRenderer::setTexture(std::shared_ptr<OpenGLTexture> texture, const FITS::HeaderDataUnit& hdu) {
+	Q_ASSERT(isInitialized());
+
+	plane_texture_.reset();
+	plane_hdu_.reset();
+	shown_plane_ = 0;
+	texture_ = std::move(texture);
+	hdu_ = &hdu;
+	shader_uniforms_.reset(new OpenGLShaderUniforms(texture_->channels(), texture_->channel_size(), hdu_->header().bzero(), hdu_->header().bscale()));
+	// BZERO, BSCALE and histogram may differ, so the uniforms are uploaded again
+	uploaded_colormap_index_ = -1;
+}
+
+void OpenGLRenderer::updateFrame(const FITS::HeaderDataUnit& hdu) {
+	Q_ASSERT(isInitialized());
+	Q_ASSERT(!cube_texture_ && !plane_texture_);
+
+	Tracer::Scope trace_scope("frame update", "watch");
+
+	if (!frame_bands_)
+		frame_bands_.reset(new FrameBands);
+	const auto bands = frame_bands_->update(hdu);
+	texture_->update(&hdu, bands, frame_bands_->minmax());
+	hdu_ = &hdu;
+	shader_uniforms_.reset(new OpenGLShaderUniforms(texture_->channels(), texture_->channel_size(), hdu_->header().bzero(), hdu_->header().bscale()));
+	// Histogram has changed, so the uniforms are uploaded again
+	uploaded_colormap_index_ = -1;
+}
+
+void OpenGLRenderer::render(const State& state) {
+	Q_ASSERT(isInitialized());
+	Q_ASSERT(state.colormap_index >= 0 && state.colormap_index < static_cast<int>(colormaps_.size()));
+
+	Tracer::Scope trace_scope("render", "frame");
+	profiler_.beginFrame();
+
+	showPlane(state.plane);
+
+	glViewport(0, 0, state.size.width(), state.size.height());
+	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+	glDisable(GL_DEPTH_TEST);
+	glClear(GL_COLOR_BUFFER_BIT);
+
+	program_->bind();
+	vbo_.bind();
+	program_->enableAttributeArray(OpenGLShaderProgram::vertex_coord_attribute);
+	program_->enableAttributeArray(OpenGLShaderProgram::vertex_uv_attribute);
+	program_->setAttributeBuffer(OpenGLShaderProgram::vertex_coord_attribute, GL_FLOAT, 0, 3, 3 * sizeof(GLfloat));
+	program_->setAttributeBuffer(OpenGLShaderProgram::vertex_uv_attribute,    GL_FLOAT, 0, 2, 3 * sizeof(GLfloat));
+
+	// Another renderer sharing the program may have overwritten the uniforms
+	const bool claimed = program_->claimUniforms(this);
+
+	if (claimed || state.viewrect != uploaded_viewrect_) {
+		QMatrix4x4 mvp(base_mvp_);
+		// QT and OpenGL have different coordinate systems, we should change y-axes direction
+		mvp.ortho(state.viewrect.left(), state.viewrect.right(), 1 - state.viewrect.bottom(), 1 - state.viewrect.top(), -1.0f, 1.0f);
+		program_->setUniformValue("MVP", mvp);
+		uploaded_viewrect_ = state.viewrect;
+	}
+
+	// The histogram is scanned when the equalization is used for the first time
+	if (state.stretch == OpenGLShaderUniforms::EqualizationStretch)
+		shader_uniforms_->setHistogram(&texture_->histogram(*hdu_));
+
+	const auto levels = (state.has_levels ? state.levels : texture_->hdu_minmax());
+	if (claimed || levels != uploaded_levels_ || state.colormap_index != uploaded_colormap_index_ ||
+			state.stretch != uploaded_stretch_ || state.stretch_parameter != uploaded_stretch_parameter_) {
+		shader_uniforms_->setMinMax(levels);
+		shader_uniforms_->setColorMapSize(colormaps_[state.colormap_index]->width());
+		shader_uniforms_->setStretch(state.stretch, state.stretch_parameter);
+		program_->setUniformValueArray("c", shader_uniforms_->get_c().data(), 1, shader_uniforms_->channels);
+		program_->setUniformValueArray("z", shader_uniforms_->get_z().data(), 1, shader_uniforms_->channels);
+		// Stretch parameters depend on the levels and the colormap size too
+		program_->setUniformValue("stretch", static_cast<GLint>(shader_uniforms_->get_stretch()));
+		program_->setUniformValueArray("stretch_parameters", shader_uniforms_->get_stretch_parameters().data(), 1, 4);
+		program_->setUniformValueArray("colormap_range", shader_uniforms_->get_colormap_range().data(), 1, 2);
+		uploaded_levels_ = levels;
+		uploaded_colormap_index_ = state.colormap_index;
+		uploaded_stretch_ = state.stretch;
+		uploaded_stretch_parameter_ = state.stretch_parameter;
+	}
+
+	if (cube_texture_) {
+		const float plane_coordinate = cube_texture_->planeCoordinate(shown_plane_);
+		if (claimed || plane_coordinate != uploaded_plane_coordinate_) {
+			program_->setUniformValue("plane", plane_coordinate);
+			uploaded_plane_coordinate_ = plane_coordinate;
+		}
+	}
+	profiler_.endPhase(FrameProfiler::UniformsPhase);
+
+	if (cube_texture_) {
+		cube_texture_->bind(program_texture_uniform_);
+	} else if (plane_texture_) {
+		plane_texture_->bind(program_texture_uniform_);
+	} else {
+		texture_->bind(program_texture_uniform_);
+	}
+	colormaps_[state.colormap_index]->bind(program_colormap_uniform_);
+	if (state.stretch == OpenGLShaderUniforms::EqualizationStretch)
+		texture_->equalization().bind(program_equalization_uniform_);
+	profiler_.endPhase(FrameProfiler::BindPhase);
+
+	glDrawArrays(GL_TRIANGLES, 0, 6);
+	profiler_.endPhase(FrameProfiler::DrawPhase);
+
+	vbo_.release();
+	profiler_.endFrame();
+}
+
+void OpenGLRenderer::showPlane(quint64 plane) {
+	const auto image = hdu_->data().imageDataUnit();
+	if (plane == shown_plane_ || !image || plane >= image->depth())
+		return;
+
+	Tracer::Scope trace_scope("plane switch", "frame");
+
+	if (cube_texture_) {
+		// The plane is uploaded first of the pending ones
+		cube_texture_->setCurrentPlane(plane);
+		if (!cube_texture_->isResident(plane))
+			cube_texture_->uploadNextPlane();
+	} else if (plane == 0) {
+		plane_texture_.reset();
+		plane_hdu_.reset();
+	} else {
+		// Levels and equalization of the first plane are kept for all the planes
+		std::unique_ptr<FITS::HeaderDataUnit> plane_hdu{new FITS::HeaderDataUnit(*hdu_, plane)};
+		std::shared_ptr<const OpenGLTexture::Statistics> statistics{new OpenGLTexture::Statistics{texture_->hdu_minmax(), texture_->histogram()}};
+		std::unique_ptr<OpenGLTexture> plane_texture{new OpenGLTexture(plane_hdu.get(), std::move(statistics))};
+		plane_texture->initialize();
+		plane_texture_ = std::move(plane_texture);
+		plane_hdu_ = std::move(plane_hdu);
+	}
+	shown_plane_ = plane;
+}
+
+bool OpenGLRenderer::hasPendingPlanes() const {
+	return cube_texture_ && cube_texture_->hasPendingPlanes();
+}
+
+void OpenGLRenderer::uploadNextPlane() {
+	if (cube_texture_)
+		cube_texture_->uploadNextPlane();
+}
+
+constexpr const GLfloat OpenGLRenderer::vbo_data[];
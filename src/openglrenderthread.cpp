@@ -0,0 +1,310 @@
+#include <QCoreApplication>
+#include <QDebug>
+#include <QMutexLocker>
+#include <QOpenGLFunctions>
+
+#include <openglrenderthread.h>
+#include <tracer.h>
+
+OpenGLRenderThread::ContextError::ContextError():
+	::Exception("Cannot make the render thread OpenGL context current") {
+}
+void OpenGLRenderThread::ContextError::raise() const {
+	throw *this;
+}
+QException* OpenGLRenderThread::ContextError::clone() const {
+	return new OpenGLRenderThread::ContextError(*this);
+}
+
+OpenGLRenderThread::OpenGLRenderThread() {
+	auto share_context = QOpenGLContext::globalShareContext();
+	if (!share_context)
+		throw ContextError();
+
+	// Offscreen surface has to be created in the GUI thread
+	surface_.setFormat(share_context->format());
+	surface_.create();
+
+	context_.reset(new QOpenGLContext);
+	context_->setFormat(share_context->format());
+	context_->setShareContext(share_context);
+	if (!context_->create())
+		throw ContextError();
+	context_->moveToThread(&thread_);
+
+	/* Emitted from the render thread itself just before it finishes. The
+	 * connection has to be direct, the thread object lives in the GUI
+	 * thread, which is blocked in wait(). The context can be pushed to
+	 * another thread only by the one it lives in. */
+	QObject::connect(&thread_, &QThread::finished, context_.get(), [this] () {
+		context_->doneCurrent();
+		context_->moveToThread(QCoreApplication::instance()->thread());
+	}, Qt::DirectConnection);
+
+	thread_.setObjectName("OpenGLRenderThread");
+	thread_.start();
+}
+
+OpenGLRenderThread::~OpenGLRenderThread() {
+	thread_.quit();
+	thread_.wait();
+}
+
+void OpenGLRenderThread::makeCurrent() {
+	Q_ASSERT(QThread::currentThread() == &thread_);
+
+	if (QOpenGLContext::currentContext() != context_.get() && !context_->makeCurrent(&surface_))
+		throw ContextError();
+}
+
+OpenGLRenderWorker::Frame::Frame():
+	drawn(Q_NULLPTR),
+	sequence_index(-1) {
+}
+
+OpenGLRenderWorker::State::State():
+	OpenGLRenderer::State(),
+	statistics_visible(false),
+	sequence_index(-1) {
+}
+
+OpenGLRenderWorker::OpenGLRenderWorker(OpenGLRenderThread& render_thread, OpenGLResourceRegistry& registry, const FITS::HeaderDataUnit& hdu, const QString& texture_key, std::shared_ptr<const OpenGLTexture::Statistics> statistics, std::shared_ptr<const Sequence> sequence):
+	QObject(Q_NULLPTR),
+	render_thread_(&render_thread),
+	renderer_(new OpenGLRenderer(registry, hdu, texture_key, std::move(statistics))),
+	render_scheduled_(false),
+	released_(false),
+	failed_(false),
+	upload_scheduled_(false),
+	sequence_(std::move(sequence)),
+	shown_index_(0),
+	requested_index_(0),
+	direction_(1) {
+
+	// Signals are delivered to the GUI thread through the event queue
+	qRegisterMetaType<const OpenGLTexture*>("const OpenGLTexture*");
+
+	moveToThread(render_thread.thread());
+
+	if (sequence_) {
+		// Frames of a sequence replace the texture, so a cube texture would be uploaded in vain
+		renderer_->setCubeTextureEnabled(false);
+
+		// Called from the pool threads, stage() runs in the render thread
+		ring_.reset(new TextureRing(sequence_, ring_capacity, [this] () {
+			QMetaObject::invokeMethod(this, "stage", Qt::QueuedConnection);
+		}));
+	}
+}
+
+OpenGLRenderWorker::~OpenGLRenderWorker() = default;
+
+void OpenGLRenderWorker::post(const State& state) {
+	states_.writeSlot() = state;
+	states_.publish();
+
+	// Render is already queued, it is going to take the latest state
+	if (!render_scheduled_.exchange(true))
+		QMetaObject::invokeMethod(this, "render", Qt::QueuedConnection);
+}
+
+void OpenGLRenderWorker::updateFrame(std::shared_ptr<const Sequence::OpenedFrame> frame) {
+	bool scheduled;
+	{
+		QMutexLocker locker(&frame_mutex_);
+		scheduled = static_cast<bool>(pending_frame_);
+		pending_frame_ = std::move(frame);
+	}
+
+	// Staging is already queued, it is going to take the latest frame
+	if (!scheduled)
+		QMetaObject::invokeMethod(this, "stageFrame", Qt::QueuedConnection);
+}
+
+void OpenGLRenderWorker::frameDrawn() {
+	auto& frame = frames_.readSlot();
+	// Expose repaints draw the same frame again, only the last drawing matters
+	OpenGLFence::remove(frame.drawn);
+	frame.drawn = OpenGLFence::insert();
+}
+
+void OpenGLRenderWorker::release() {
+	QMetaObject::invokeMethod(this, "releaseInThread", Qt::BlockingQueuedConnection);
+}
+
+void OpenGLRenderWorker::render() {
+	render_scheduled_.store(false);
+
+	if (released_ || failed_ || !states_.fetch())
+		return;
+
+	renderState(states_.readSlot());
+}
+
+void OpenGLRenderWorker::stage() {
+	if (released_ || failed_)
+		return;
+
+	try {
+		render_thread_->makeCurrent();
+
+		// Render the requested frame if it has just been uploaded
+		const auto& state = states_.readSlot();
+		if (ring_->stage() > 0 && renderer_->isInitialized() && state.sequence_index != shown_index_)
+			renderState(state);
+	} catch (const std::exception& e) {
+		qWarning() << "Cannot stage sequence frame:" << e.what();
+		failed_ = true;
+		emit renderFailed(QString(e.what()));
+	}
+}
+
+void OpenGLRenderWorker::stageFrame() {
+	if (released_ || failed_)
+		return;
+
+	// The frame is uploaded by the first render after the initialization
+	if (!renderer_->isInitialized())
+		return;
+
+	try {
+		render_thread_->makeCurrent();
+
+		if (applyPendingFrame())
+			renderState(states_.readSlot());
+	} catch (const std::exception& e) {
+		qWarning() << "Cannot update frame:" << e.what();
+		failed_ = true;
+		emit renderFailed(QString(e.what()));
+	}
+}
+
+bool OpenGLRenderWorker::applyPendingFrame() {
+	std::shared_ptr<const Sequence::OpenedFrame> frame;
+	{
+		QMutexLocker locker(&frame_mutex_);
+		frame = std::move(pending_frame_);
+		pending_frame_.reset();
+	}
+	if (!frame)
+		return false;
+
+	renderer_->updateFrame(*frame->hdu);
+	// The previous frame is not used by the renderer anymore
+	updated_frame_ = std::move(frame);
+	// Levels follow the new frame
+	emit textureInitialized(renderer_->texture());
+	return true;
+}
+
+void OpenGLRenderWorker::scheduleUpload() {
+	if (upload_scheduled_ || !renderer_->hasPendingPlanes())
+		return;
+
+	upload_scheduled_ = true;
+	QMetaObject::invokeMethod(this, "uploadPlane", Qt::QueuedConnection);
+}
+
+void OpenGLRenderWorker::uploadPlane() {
+	upload_scheduled_ = false;
+
+	if (released_ || failed_)
+		return;
+
+	try {
+		render_thread_->makeCurrent();
+
+		renderer_->uploadNextPlane();
+		scheduleUpload();
+	} catch (const std::exception& e) {
+		qWarning() << "Cannot upload cube plane:" << e.what();
+		failed_ = true;
+		emit renderFailed(QString(e.what()));
+	}
+}
+
+void OpenGLRenderWorker::showSequenceFrame(int index) {
+	if (!ring_ || index < 0)
+		return;
+
+	// Playback direction is guessed by the shortest way around the loop
+	const int count = sequence_->size();
+	const int delta = ((index - requested_index_) % count + count) % count;
+	if (delta != 0)
+		direction_ = (delta > count / 2 ? -1 : 1);
+	requested_index_ = index;
+
+	ring_->prefetch(index, direction_);
+	if (index == shown_index_)
+		return;
+
+	if (auto entry = ring_->frame(index)) {
+		renderer_->setTexture(entry->texture, *entry->frame.hdu);
+		shown_ = std::move(entry);
+		shown_index_ = index;
+	}
+}
+
+void OpenGLRenderWorker::renderState(const State& state) {
+	if (state.size.isEmpty())
+		return;
+
+	try {
+		render_thread_->makeCurrent();
+
+		if (!renderer_->isInitialized()) {
+			renderer_->initialize();
+			emit textureInitialized(renderer_->texture());
+			applyPendingFrame();
+		}
+		showSequenceFrame(state.sequence_index);
+
+		auto& frame = frames_.writeSlot();
+		// The GUI thread may still be sampling the framebuffer of the slot
+		OpenGLFence::wait(frame.drawn);
+		frame.drawn = Q_NULLPTR;
+		if (!frame.fbo || frame.fbo->size() != state.size)
+			frame.fbo.reset(new QOpenGLFramebufferObject(state.size));
+
+		frame.fbo->bind();
+		renderer_->render(state);
+		frame.fbo->release();
+
+		// The frame is sampled in another context, so it has to be complete
+		// before it is published
+		QOpenGLContext::currentContext()->functions()->glFinish();
+		renderer_->profiler().frameSwapped();
+
+		frame.statistics = (state.statistics_visible ? renderer_->profiler().summary() : QString());
+		frame.sequence_index = (ring_ ? shown_index_ : -1);
+		frames_.publish();
+		emit frameReady();
+
+		scheduleUpload();
+	} catch (const std::exception& e) {
+		qWarning() << "Cannot render frame:" << e.what();
+		failed_ = true;
+		emit renderFailed(QString(e.what()));
+	}
+}
+
+void OpenGLRenderWorker::releaseInThread() {
+	released_ = true;
+
+	try {
+		render_thread_->makeCurrent();
+
+		renderer_.reset();
+		shown_.reset();
+		updated_frame_.reset();
+		ring_.reset();
+		for (auto& frame: frames_.allSlots()) {
+			OpenGLFence::remove(frame.drawn);
+			frame.fbo.reset();
+		}
+	} catch (const std::exception& e) {
+		qWarning() << "Cannot release render worker:" << e.what();
+	}
+
+	deleteLater();
+}
@@ -0,0 +1,163 @@
+#include <QDateTime>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QThread>
+
+#include <frameprofiler.h>
+#include <openglresourceregistry.h>
+#include <tracer.h>
+
+OpenGLResourceRegistry::ContextError::ContextError():
+	::Exception("Cannot make the shared OpenGL context current") {
+}
+void OpenGLResourceRegistry::ContextError::raise() const {
+	throw *this;
+}
+QException* OpenGLResourceRegistry::ContextError::clone() const {
+	return new OpenGLResourceRegistry::ContextError(*this);
+}
+
+OpenGLResourceRegistry::ShareContextScope::ShareContextScope(QOffscreenSurface* surface):
+	context_(QOpenGLContext::globalShareContext()),
+	previous_context_(QOpenGLContext::currentContext()),
+	previous_surface_(previous_context_ ? previous_context_->surface() : Q_NULLPTR) {
+
+	if (QThread::currentThread() != context_->thread()) {
+		// The calling thread is responsible for its own context
+		context_ = Q_NULLPTR;
+		if (!previous_context_ || !QOpenGLContext::areSharing(previous_context_, QOpenGLContext::globalShareContext()))
+			throw ContextError();
+		return;
+	}
+
+	if (!context_->makeCurrent(surface))
+		throw ContextError();
+}
+OpenGLResourceRegistry::ShareContextScope::~ShareContextScope() {
+	if (!context_)
+		return;
+
+	if (previous_context_) {
+		previous_context_->makeCurrent(previous_surface_);
+	} else {
+		context_->doneCurrent();
+	}
+}
+
+OpenGLResourceRegistry::OpenGLResourceRegistry() = default;
+OpenGLResourceRegistry::~OpenGLResourceRegistry() = default;
+
+QOffscreenSurface* OpenGLResourceRegistry::surface() {
+	if (!QOpenGLContext::globalShareContext())
+		throw ContextError();
+
+	// Surfaces can be created in the GUI thread only
+	if (!surface_ && QThread::currentThread() == QOpenGLContext::globalShareContext()->thread()) {
+		surface_.reset(new QOffscreenSurface);
+		surface_->setFormat(QOpenGLContext::globalShareContext()->format());
+		surface_->create();
+	}
+
+	return surface_.get();
+}
+
+OpenGLColorMap* OpenGLResourceRegistry::createColorMap(std::size_t index) {
+	switch (index) {
+	case 0:
+		return new GrayscaleColorMap();
+	case 1:
+		return new PurpleBlueColorMap();
+	default:
+		Q_ASSERT(0);
+		return Q_NULLPTR;
+	}
+}
+
+std::shared_ptr<OpenGLTexture> OpenGLResourceRegistry::texture(const QString& key, const FITS::HeaderDataUnit& hdu, std::shared_ptr<const OpenGLTexture::Statistics> statistics) {
+	if (!key.isEmpty()) {
+		QMutexLocker locker(&mutex_);
+		auto it = textures_.find(key);
+		if (it != textures_.end()) {
+			if (auto texture = it->second.lock())
+				return texture;
+			textures_.erase(it);
+		}
+	}
+
+	std::shared_ptr<OpenGLTexture> texture{new OpenGLTexture(&hdu, std::move(statistics))};
+	{
+		ShareContextScope scope(surface());
+		Tracer::Scope trace_scope("texture initialize", "gl");
+		GPUTraceScope gpu_trace_scope("texture upload", "gl");
+		texture->initialize();
+	}
+
+	if (!key.isEmpty()) {
+		QMutexLocker locker(&mutex_);
+		textures_[key] = texture;
+	}
+
+	return texture;
+}
+
+std::shared_ptr<OpenGLShaderProgram> OpenGLResourceRegistry::program(const QString& bitpix, bool cube) {
+	const QString key = (cube ? bitpix + QString("/cube") : bitpix);
+	{
+		QMutexLocker locker(&mutex_);
+		auto it = programs_.find(key);
+		if (it != programs_.end()) {
+			if (auto program = it->second.lock())
+				return program;
+			programs_.erase(it);
+		}
+	}
+
+	std::shared_ptr<OpenGLShaderProgram> program{new OpenGLShaderProgram(bitpix, cube)};
+	{
+		ShareContextScope scope(surface());
+		Tracer::Scope trace_scope("program build", "gl");
+		program->build(&program_binary_cache_);
+	}
+
+	{
+		QMutexLocker locker(&mutex_);
+		programs_[key] = program;
+	}
+
+	return program;
+}
+
+OpenGLResourceRegistry::colormaps_type OpenGLResourceRegistry::colormaps() {
+	colormaps_type colormaps;
+
+	for (std::size_t i = 0; i < colormaps.size(); ++i) {
+		{
+			QMutexLocker locker(&mutex_);
+			colormaps[i] = colormaps_[i].lock();
+		}
+		if (colormaps[i])
+			continue;
+
+		colormaps[i].reset(createColorMap(i));
+		{
+			ShareContextScope scope(surface());
+			colormaps[i]->initialize();
+		}
+
+		QMutexLocker locker(&mutex_);
+		colormaps_[i] = colormaps[i];
+	}
+
+	return colormaps;
+}
+
+QString OpenGLResourceRegistry::textureKey(const QString& filename, quint64 hdu_index) {
+	const QFileInfo file_info(filename);
+	if (!file_info.exists())
+		return filename + QString("#") + QString::number(hdu_index);
+
+	// The file rewritten in place gets another texture
+	return file_info.canonicalFilePath() + QString("#") + QString::number(hdu_index)
+		+ QString("@") + QString::number(file_info.size())
+		+ QString(":") + QString::number(file_info.lastModified().toMSecsSinceEpoch());
+}
@@ -0,0 +1,155 @@
+#include <QOpenGLContext>
+#include <QOpenGLFunctions>
+#include <QOpenGLShader>
+
+#include <fits.h>
+#include <openglrenderer.h>
+#include <openglshaderprogram.h>
+#include <tracer.h>
+
+namespace {
+	/* Image data are stored in the texture as big-endian integers split into
+	 * normalized unsigned channels, see OpenGLTexture and OpenGLShaderUniforms.
+	 * The most significant channel is signed, so its value is corrected by
+	 * base / (base - 1) when it is greater than a half. */
+	struct Variant {
+		const char* bitpix;
+		const char* type;            // GLSL type of raw value and c, z uniforms
+		const char* swizzle;         // Texel components holding raw value
+		const char* sign_correction; // base / (base - 1), or null for unsigned and float data
+	};
+
+	const Variant variants[] = {
+		{"8",   "float", ".a",  Q_NULLPTR},
+		{"16",  "vec2",  ".ga", "1.003921568627451"},  // 256.0 / 255.0
+		{"32",  "vec4",  "",    "1.003921568627451"},  // 256.0 / 255.0
+		{"64",  "vec4",  "",    "1.0000152590218967"}, // 65536.0 / 65535.0
+		{"-32", "float", ".a",  Q_NULLPTR},
+	};
+
+	const char vertex_shader_source[] =
+		"attribute vec2 VertexUV;\n"
+		"attribute vec3 vertexCoord;\n"
+		"varying vec2 UV;\n"
+		"uniform mat4 MVP;\n"
+		"void main() {\n"
+		"	gl_Position = MVP * vec4(vertexCoord,1);\n"
+		"	UV = VertexUV;\n"
+		"}\n";
+
+	/* %1 is type, %2 is swizzle, %3 is sign correction statement, %4 is
+	 * sampler declaration, %5 is texel fetch.
+	 *
+	 * The level transform gives the colormap coordinate, the stretch is
+	 * applied to it normalized into [0, 1], see OpenGLShaderUniforms. The
+	 * equalization lookup table holds 16-bit values in luminance and alpha. */
+	const char fragment_shader_template[] =
+		"#ifdef GL_ES\n"
+		"	#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
+		"		precision highp float;\n"
+		"		precision highp sampler2D;\n"
+		"	#else\n"
+		"		precision mediump float;\n"
+		"		precision mediump sampler2D;\n"
+		"	#endif\n"
+		"#endif\n"
+		"varying vec2 UV;\n"
+		"%4"
+		"uniform sampler1D colormap;\n"
+		"uniform sampler1D equalization;\n"
+		"uniform %1 c;\n"
+		"uniform %1 z;\n"
+		"uniform int stretch;\n"
+		"uniform vec4 stretch_parameters;\n"
+		"uniform vec2 colormap_range;\n"
+		"float stretched(float x) {\n"
+		"	vec4 p = stretch_parameters;\n"
+		"	if (stretch == 1) return sqrt(x);\n"
+		"	if (stretch == 2) return log(p.x * x + 1.0) * p.y;\n"
+		"	if (stretch == 3) { float y = p.x * x; return log(y + sqrt(y * y + 1.0)) * p.y; }\n"
+		"	if (stretch == 4) return pow(x, p.x);\n"
+		"	if (stretch == 5) {\n"
+		"		vec2 cdf = texture1D(equalization, x * p.x + p.y).ra;\n"
+		"		return (dot(cdf, vec2(65280.0, 255.0) / 65535.0) - p.z) * p.w;\n"
+		"	}\n"
+		"	return x;\n"
+		"}\n"
+		"void main() {\n"
+		"	%1 raw_value = %5%2;\n"
+		"%3"
+		"	float value = dot(c, raw_value - z);\n"
+		"	if (stretch != 0) {\n"
+		"		float x = clamp((value - colormap_range.x) / colormap_range.y, 0.0, 1.0);\n"
+		"		value = colormap_range.x + clamp(stretched(x), 0.0, 1.0) * colormap_range.y;\n"
+		"	}\n"
+		"	gl_FragColor = texture1D(colormap, clamp(value, 0.0, 1.0));\n"
+		"}\n";
+
+	inline GLenum glError() {
+		return QOpenGLContext::currentContext()->functions()->glGetError();
+	}
+}
+
+OpenGLShaderProgram::OpenGLShaderProgram(const QString& bitpix, bool cube, QObject* parent):
+	QOpenGLShaderProgram(parent),
+	bitpix_(bitpix),
+	cube_(cube),
+	uniforms_owner_(Q_NULLPTR) {
+}
+
+OpenGLShaderProgram::~OpenGLShaderProgram() = default;
+
+const char* OpenGLShaderProgram::vertexShaderSource() {
+	return vertex_shader_source;
+}
+
+QString OpenGLShaderProgram::fragmentShaderSource(const QString& bitpix, bool cube) {
+	for (const auto& variant: variants) {
+		if (bitpix != variant.bitpix)
+			continue;
+
+		const QString sign_correction = (variant.sign_correction ?
+			QString("	raw_value.x -= float(raw_value.x > 0.5) * %1;\n").arg(QString(variant.sign_correction)) :
+			QString());
+
+		// Plane is the texture coordinate of the layer holding it
+		const QString sampler = (cube ?
+			QString("uniform sampler3D texture;\nuniform float plane;\n") :
+			QString("uniform sampler2D texture;\n"));
+		const QString fetch = (cube ?
+			QString("texture3D(texture, vec3(UV, plane))") :
+			QString("texture2D(texture, UV)"));
+
+		return QString(fragment_shader_template).arg(QString(variant.type), QString(variant.swizzle), sign_correction, sampler, fetch);
+	}
+
+	throw FITS::UnsupportedBitpix(bitpix);
+}
+
+void OpenGLShaderProgram::build(OpenGLProgramBinaryCache* cache) {
+	const QByteArray vertex_source(vertexShaderSource());
+	const QByteArray fragment_source(fragmentShaderSource(bitpix_, cube_).toLatin1());
+
+	QByteArray key;
+	if (cache) {
+		Tracer::Scope trace_scope("program binary load", "startup");
+		key = OpenGLProgramBinaryCache::key(vertex_source, fragment_source);
+		if (cache->load(this, key))
+			return;
+	}
+
+	Tracer::Scope trace_scope("shader compile", "startup");
+	QOpenGLShader *vshader = new QOpenGLShader(QOpenGLShader::Vertex, this);
+	if (! vshader->compileSourceCode(vertex_source)) throw OpenGLRenderer::ShaderCompileError(glError());
+	QOpenGLShader *fshader = new QOpenGLShader(QOpenGLShader::Fragment, this);
+	if (! fshader->compileSourceCode(fragment_source)) throw OpenGLRenderer::ShaderCompileError(glError());
+
+	if (! addShader(vshader)) throw OpenGLRenderer::ShaderLoadError(glError());
+	if (! addShader(fshader)) throw OpenGLRenderer::ShaderLoadError(glError());
+	bindAttributeLocation("vertexCoord", vertex_coord_attribute);
+	bindAttributeLocation("vertexUV",    vertex_uv_attribute);
+	if (cache) cache->prepare(this);
+	if (! link()) throw OpenGLRenderer::ShaderLoadError(glError());
+
+	if (cache) cache->store(this, key);
+}
@@ -1,6 +1,13 @@
 #include <openglshaderunifroms.h>
 
 OpenGLShaderUniforms::OpenGLShaderUniforms(quint8 channels, quint8 channel_size, double bzero, double bscale) :
+		minmax_(0, 1),
+		colormap_size_(2),
+		stretch_(LinearStretch),
+		stretch_parameter_(0),
+		histogram_(Q_NULLPTR),
+		colormap_range_{{0, 1}},
+		stretch_parameters_{{0, 0, 0, 0}},
 		channels(channels),
 		channel_size(channel_size),
 		bzero(bzero),
@@ -16,12 +23,15 @@ OpenGLShaderUniforms::OpenGLShaderUniforms(quint8 channels, quint8 channel_size,
 		a_[0] = 1;
 		Q_ASSERT(channels == 1);
 	}
+	update_cz();
+	update_stretch();
 }
 
 void OpenGLShaderUniforms::setMinMax(const std::pair<double,double>& minmax) {
 	if (minmax != minmax_) {
 		minmax_ = minmax;
 		update_cz();
+		update_stretch();
 	}
 }
 
@@ -29,6 +39,56 @@ void OpenGLShaderUniforms::setColorMapSize(int colormap_size) {
 	if (colormap_size != colormap_size_) {
 		colormap_size_ = colormap_size;
 		update_cz();
+		update_stretch();
+	}
+}
+
+void OpenGLShaderUniforms::setStretch(Stretch stretch, double parameter) {
+	Q_ASSERT(stretch >= LinearStretch && stretch < StretchCount);
+	if (stretch != stretch_ || parameter != stretch_parameter_) {
+		stretch_ = stretch;
+		stretch_parameter_ = parameter;
+		update_stretch();
+	}
+}
+
+void OpenGLShaderUniforms::setHistogram(const Histogram* histogram) {
+	if (histogram != histogram_) {
+		histogram_ = histogram;
+		update_stretch();
+	}
+}
+
+double OpenGLShaderUniforms::defaultStretchParameter(Stretch stretch) {
+	switch (stretch) {
+	case LogStretch:
+		return 1000.0;
+	case AsinhStretch:
+		return 0.1;
+	case PowerStretch:
+		return 2.0;
+	default:
+		return 0.0;
+	}
+}
+
+const char* OpenGLShaderUniforms::stretchName(Stretch stretch) {
+	switch (stretch) {
+	case LinearStretch:
+		return "Linear";
+	case SqrtStretch:
+		return "Square root";
+	case LogStretch:
+		return "Logarithmic";
+	case AsinhStretch:
+		return "Asinh";
+	case PowerStretch:
+		return "Power";
+	case EqualizationStretch:
+		return "Histogram equalization";
+	default:
+		Q_ASSERT(0);
+		return Q_NULLPTR;
 	}
 }
 
@@ -51,3 +111,44 @@ void OpenGLShaderUniforms::update_cz() {
 		z_[0] = static_cast<GLfloat>(minus_d / a_[0]);
 	}
 }
+
+/* The shader maps dot(c, raw - z) from the colormap range back into [0, 1],
+ * applies the stretch and maps the result into the colormap range again, so
+ * c and z do not depend on the stretch. */
+void OpenGLShaderUniforms::update_stretch() {
+	colormap_range_[0] = static_cast<GLfloat>(0.5 / colormap_size_);
+	colormap_range_[1] = static_cast<GLfloat>(1.0 - 1.0 / colormap_size_);
+
+	stretch_parameters_.fill(0);
+	switch (stretch_) {
+	case LogStretch:
+		stretch_parameters_[0] = static_cast<GLfloat>(stretch_parameter_);
+		stretch_parameters_[1] = static_cast<GLfloat>(1.0 / std::log(stretch_parameter_ + 1.0));
+		break;
+	case AsinhStretch:
+		stretch_parameters_[0] = static_cast<GLfloat>(1.0 / stretch_parameter_);
+		stretch_parameters_[1] = static_cast<GLfloat>(1.0 / std::asinh(1.0 / stretch_parameter_));
+		break;
+	case PowerStretch:
+		stretch_parameters_[0] = static_cast<GLfloat>(stretch_parameter_);
+		break;
+	case EqualizationStretch:
+		if (histogram_ && !histogram_->isEmpty()) {
+			// Position of the levels in the histogram range, the result is
+			// scaled to make the levels exactly 0 and 1
+			const auto& range = histogram_->range();
+			const auto width = (range.second > range.first ? range.second - range.first : 1.0);
+			const auto scale = (minmax_.second - minmax_.first) / width;
+			const auto offset = (minmax_.first - range.first) / width;
+			const auto from = histogram_->at(offset);
+			const auto to = histogram_->at(offset + scale);
+			stretch_parameters_[0] = static_cast<GLfloat>(scale);
+			stretch_parameters_[1] = static_cast<GLfloat>(offset);
+			stretch_parameters_[2] = static_cast<GLfloat>(from);
+			stretch_parameters_[3] = static_cast<GLfloat>(to > from ? 1.0 / (to - from) : 0.0);
+		}
+		break;
+	default:
+		break;
+	}
+}
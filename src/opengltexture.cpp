@@ -1,11 +1,17 @@
-#include <QDebug>
 #include <QOpenGLContext>
 #include <QOpenGLPixelTransferOptions>
 #include <QtGlobal>
 
+#include <cstdlib>
+#include <vector>
+
 #include <opengltexture.h>
+#include <tracer.h>
 
 namespace {
+	// GL_UNPACK_SWAP_BYTES, which OpenGL ES headers lack
+	const GLenum unpack_swap_bytes = 0x0CF0;
+
 	template<std::size_t N> struct bswap_traits;
 	template<> struct bswap_traits<1> {
 		using type = quint8;
@@ -66,12 +72,29 @@ namespace {
 	}
 }
 
-OpenGLTexture::OpenGLTexture(const FITS::HeaderDataUnit* hdu):
+OpenGLTexture::OpenGLTexture(const FITS::HeaderDataUnit* hdu, std::shared_ptr<const Statistics> statistics):
 		QOpenGLTexture(QOpenGLTexture::Target2D),
-		hdu_(hdu) {
+		hdu_(hdu),
+		size_(hdu->data().imageDataUnit()->size()),
+		statistics_(std::move(statistics)),
+		minmax_(0, 0),
+		instrumental_minmax_(0, 0),
+		equalization_(QOpenGLTexture::Target1D) {
 }
 
 void OpenGLTexture::initialize() {
+	prepare();
+	upload();
+}
+
+OpenGLTexture::Statistics OpenGLTexture::scan(const FITS::HeaderDataUnit& hdu) {
+	OpenGLTexture texture(&hdu);
+	texture.prepare();
+	// Scanned in advance, so the equalization of the opened frame never scans
+	return Statistics{texture.minmax_, Histogram(hdu, texture.minmax_)};
+}
+
+void OpenGLTexture::prepare() {
 	struct Loader {
 		const FITS::HeaderDataUnit* hdu_;
 		QOpenGLTexture::TextureFormat* texture_format;
@@ -82,6 +105,16 @@ void OpenGLTexture::initialize() {
 		bool* swap_bytes_enabled;
 		std::pair<double, double>* minmax;
 		std::pair<double, double>* instrumental_minmax;
+		bool scan_minmax;
+
+		template<class T> void scan(const FITS::DataUnit<T>& data) const {
+			if (!scan_minmax)
+				return;
+
+			*minmax = swaped_minmax_element(data.data(), data.data() + data.length());
+			minmax->first = minmax->first  * hdu_->header().bscale() + hdu_->header().bzero();
+			minmax->second = minmax->second * hdu_->header().bscale() + hdu_->header().bzero();
+		}
 
 		void operator() (const FITS::DataUnit<quint8>& data) const {
 			*texture_format = QOpenGLTexture::AlphaFormat;
@@ -91,9 +124,7 @@ void OpenGLTexture::initialize() {
 			*channels = 1;
 			*channel_size = 1;
 
-			*minmax = swaped_minmax_element(data.data(), data.data() + data.length());
-			minmax->first = minmax->first  * hdu_->header().bscale() + hdu_->header().bzero();
-			minmax->second = minmax->second * hdu_->header().bscale() + hdu_->header().bzero();
+			scan(data);
 
 			instrumental_minmax->first  = hdu_->header().bzero();
 			instrumental_minmax->second = static_cast<double>(std::numeric_limits<quint8>::max()) * hdu_->header().bscale() + hdu_->header().bzero();
@@ -107,9 +138,7 @@ void OpenGLTexture::initialize() {
 			*channels = 2;
 			*channel_size = 1;
 
-			*minmax = swaped_minmax_element(data.data(), data.data() + data.length());
-			minmax->first = minmax->first  * hdu_->header().bscale() + hdu_->header().bzero();
-			minmax->second = minmax->second * hdu_->header().bscale() + hdu_->header().bzero();
+			scan(data);
 
 			instrumental_minmax->first  = static_cast<double>(std::numeric_limits<qint16>::min()) * hdu_->header().bscale() + hdu_->header().bzero();
 			instrumental_minmax->second = static_cast<double>(std::numeric_limits<qint16>::max()) * hdu_->header().bscale() + hdu_->header().bzero();
@@ -122,9 +151,7 @@ void OpenGLTexture::initialize() {
 			*channels = 4;
 			*channel_size = 1;
 
-			*minmax = swaped_minmax_element(data.data(), data.data() + data.length());
-			minmax->first = minmax->first  * hdu_->header().bscale() + hdu_->header().bzero();
-			minmax->second = minmax->second * hdu_->header().bscale() + hdu_->header().bzero();
+			scan(data);
 
 			instrumental_minmax->first  = static_cast<double>(std::numeric_limits<qint32>::min()) * hdu_->header().bscale() + hdu_->header().bzero();
 			instrumental_minmax->second = static_cast<double>(std::numeric_limits<qint32>::max()) * hdu_->header().bscale() + hdu_->header().bzero();
@@ -137,67 +164,150 @@ void OpenGLTexture::initialize() {
 			*channels = 4;
 			*channel_size = 2;
 
-			*minmax = swaped_minmax_element(data.data(), data.data() + data.length());
-			minmax->first = minmax->first  * hdu_->header().bscale() + hdu_->header().bzero();
-			minmax->second = minmax->second * hdu_->header().bscale() + hdu_->header().bzero();
+			scan(data);
 
 			instrumental_minmax->first  = static_cast<double>(std::numeric_limits<qint64>::min()) * hdu_->header().bscale() + hdu_->header().bzero();
 			instrumental_minmax->second = static_cast<double>(std::numeric_limits<qint64>::max()) * hdu_->header().bscale() + hdu_->header().bzero();
 		}
 		void operator() (const FITS::DataUnit<float>& data) const {
-			// TODO: Check GL_ARB_color_buffer_float, GL_OES_texture_float.
-			if (! QOpenGLContext::currentContext()->hasExtension("GL_ARB_texture_float")) {
-				// TODO: recode data from float into (u)int32
-				qDebug() << "BITPIX==-32 is not implemented for this hardware";
-			} else {
-				// Constant from GL_ARB_texture_float extension documentation:
-				// https://www.khronos.org/registry/OpenGL/extensions/ARB/ARB_texture_float.txt
-				static const quint64 alpha32f_arb = 0x8816;
-				*texture_format = static_cast<QOpenGLTexture::TextureFormat>(alpha32f_arb);
-				*pixel_format = QOpenGLTexture::Alpha;
-				*pixel_type = QOpenGLTexture::Float32;
-				*swap_bytes_enabled = true;
-				*channels = 1;
-				*channel_size = 0;  // special value for float channel
-
-				*minmax = swaped_minmax_element(data.data(), data.data() + data.length());
-				minmax->first = minmax->first  * hdu_->header().bscale() + hdu_->header().bzero();
-				minmax->second = minmax->second * hdu_->header().bscale() + hdu_->header().bzero();
-
-				instrumental_minmax->first  = minmax->first;
-				instrumental_minmax->second = minmax->second;
-			}
+			// Constant from GL_ARB_texture_float extension documentation:
+			// https://www.khronos.org/registry/OpenGL/extensions/ARB/ARB_texture_float.txt
+			// The extension is checked by upload()
+			static const quint64 alpha32f_arb = 0x8816;
+			*texture_format = static_cast<QOpenGLTexture::TextureFormat>(alpha32f_arb);
+			*pixel_format = QOpenGLTexture::Alpha;
+			*pixel_type = QOpenGLTexture::Float32;
+			*swap_bytes_enabled = true;
+			*channels = 1;
+			*channel_size = 0;  // special value for float channel
+
+			scan(data);
+
+			instrumental_minmax->first  = minmax->first;
+			instrumental_minmax->second = minmax->second;
 		}
 		void operator() (const FITS::DataUnit<double>&) const {
-			qDebug() << "BITPIX==-64 is not implemented";
+			throw FITS::Exception("BITPIX=-64 images are not supported");
 		}
 		void operator() (const FITS::EmptyDataUnit&) const {
 			Q_ASSERT(0);
 		}
+		void operator() (const FITS::TableDataUnit&) const {
+			Q_ASSERT(0);
+		}
 	};
 
-	hdu_->data().apply(Loader{
-			hdu_,
-			&texture_format_,
-			&pixel_format_,
-			&pixel_type_,
-			&channels_, &channel_size_,
-			&swap_bytes_enabled_,
-			&minmax_,
-			&instrumental_minmax_
-	});
+	if (statistics_)
+		minmax_ = statistics_->minmax;
+
+	{
+		Tracer::Scope trace_scope("min/max scan", "startup");
+		hdu_->data().apply(Loader{
+				hdu_,
+				&texture_format_,
+				&pixel_format_,
+				&pixel_type_,
+				&channels_, &channel_size_,
+				&swap_bytes_enabled_,
+				&minmax_,
+				&instrumental_minmax_,
+				!statistics_
+		});
+	}
+
+	// Otherwise scanned when the equalization is used for the first time
+	if (statistics_)
+		histogram_ = statistics_->histogram;
+}
+
+void OpenGLTexture::upload() {
+	if (channel_size_ == 0 && ! QOpenGLContext::currentContext()->hasExtension("GL_ARB_texture_float"))
+		throw FITS::Exception("BITPIX=-32 images need GL_ARB_texture_float, which this OpenGL lacks");
 
 	setMinificationFilter(QOpenGLTexture::Nearest);
 	setMagnificationFilter(QOpenGLTexture::Nearest);
 	setFormat(texture_format_);
 //	throwIfGLError<TextureCreateError>();
-	setSize(hdu_->data().imageDataUnit()->width(), hdu_->data().imageDataUnit()->height());
+	setSize(size_.width(), size_.height());
 //	throwIfGLError<TextureCreateError>();
-	// We use this overloading to provide a possibility to use texture internal format unsupported by QT
-	allocateStorage(pixel_format_, pixel_type_);
+	{
+		Tracer::Scope trace_scope("texture allocate", "startup");
+		// We use this overloading to provide a possibility to use texture internal format unsupported by QT
+		allocateStorage(pixel_format_, pixel_type_);
+	}
 //	throwIfGLError<TextureCreateError>();
 	QOpenGLPixelTransferOptions pixel_transfer_options;
 	pixel_transfer_options.setSwapBytesEnabled(swap_bytes_enabled_);
-	this->setData(pixel_format_, pixel_type_, hdu_->data().data(), &pixel_transfer_options);
+	{
+		Tracer::Scope trace_scope("texture upload", "startup");
+		this->setData(pixel_format_, pixel_type_, hdu_->data().data(), &pixel_transfer_options);
+	}
 //	throwIfGLError<TextureCreateError>();
+
+	if (!histogram_.isEmpty())
+		uploadEqualization();
+	hdu_ = Q_NULLPTR;
+}
+
+void OpenGLTexture::update(const FITS::HeaderDataUnit* hdu, const std::vector<FrameBands::Band>& bands, const std::pair<double, double>& minmax) {
+	Q_ASSERT(hdu->data().imageDataUnit()->size() == size_);
+
+	statistics_.reset();
+	minmax_ = minmax;
+	// Float texture has no instrumental range, its levels follow the data
+	if (channel_size_ == 0)
+		instrumental_minmax_ = minmax;
+	// Scanned again only if the equalization is used for this frame
+	histogram_ = Histogram();
+
+	auto functions = QOpenGLContext::currentContext()->functions();
+	const auto image = hdu->data().imageDataUnit();
+	const quint64 row_bytes = image->width() * std::abs(hdu->header().header_as<int>("BITPIX")) / 8;
+
+	{
+		Tracer::Scope trace_scope("texture bands upload", "watch");
+		bind();
+		/* QOpenGLTexture::setData() of Qt 5.5 has no sub-image overloading.
+		 * Swapping is desktop-only as it is for QOpenGLPixelTransferOptions. */
+		functions->glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+		if (swap_bytes_enabled_)
+			functions->glPixelStorei(unpack_swap_bytes, GL_TRUE);
+		for (const auto& band: bands) {
+			functions->glTexSubImage2D(GL_TEXTURE_2D, 0, 0, static_cast<GLint>(band.first_row),
+					static_cast<GLsizei>(image->width()), static_cast<GLsizei>(band.rows),
+					static_cast<GLenum>(pixel_format_), static_cast<GLenum>(pixel_type_), hdu->data().data() + band.first_row * row_bytes);
+		}
+		if (swap_bytes_enabled_)
+			functions->glPixelStorei(unpack_swap_bytes, GL_FALSE);
+		functions->glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		release();
+	}
+}
+
+const Histogram& OpenGLTexture::histogram(const FITS::HeaderDataUnit& hdu) {
+	if (histogram_.isEmpty()) {
+		Tracer::Scope trace_scope("histogram", "frame");
+		histogram_ = Histogram(hdu, minmax_);
+		uploadEqualization();
+	}
+	return histogram_;
+}
+
+void OpenGLTexture::uploadEqualization() {
+	std::vector<quint8> cdf_bytes;
+	cdf_bytes.reserve(2 * histogram_.cdf().size());
+	for (auto x: histogram_.cdf()) {
+		cdf_bytes.push_back(static_cast<quint8>(x >> 8));
+		cdf_bytes.push_back(static_cast<quint8>(x & 0xFF));
+	}
+	// Called again for the updated frames, the histogram size is the same
+	if (!equalization_.isStorageAllocated()) {
+		equalization_.setMinificationFilter(QOpenGLTexture::Nearest);
+		equalization_.setMagnificationFilter(QOpenGLTexture::Nearest);
+		equalization_.setWrapMode(QOpenGLTexture::ClampToEdge);
+		equalization_.setFormat(QOpenGLTexture::LuminanceAlphaFormat);
+		equalization_.setSize(histogram_.size());
+		equalization_.allocateStorage(QOpenGLTexture::LuminanceAlpha, QOpenGLTexture::UInt8);
+	}
+	equalization_.setData(QOpenGLTexture::LuminanceAlpha, QOpenGLTexture::UInt8, cdf_bytes.data());
 }
@@ -1,231 +1,123 @@
 #include <QFile>
+#include <QGuiApplication>
+#include <QMessageBox>
+#include <QPainter>
 #include <QPoint>
+#include <QScreen>
 
+#include <application.h>
 #include <openglwidget.h>
-
-OpenGLWidget::Exception::Exception(const QString &what, GLenum gl_error_code):
-	::Exception(what + ": " + glErrorString(gl_error_code)) {
-}
-void OpenGLWidget::Exception::raise() const {
-	throw *this;
-}
-QException* OpenGLWidget::Exception::clone() const {
-	return new OpenGLWidget::Exception(*this);
-}
-// From OpenGL ES 2.0 documentation:
-// https://www.khronos.org/registry/OpenGL-Refpages/es2.0/xhtml/glGetError.xml
-QString OpenGLWidget::Exception::glErrorString(GLenum gl_error_code) {
-	switch (gl_error_code) {
-//		case GL_NO_ERROR:
-//			return "No error has been recorded. The value of this symbolic constant is guaranteed to be 0.";
-		case GL_INVALID_ENUM:
-			return "An unacceptable value is specified for an enumerated argument. "
-					"The offending command is ignored and has no other side effect than to set the error flag.";
-		case GL_INVALID_VALUE:
-			return "A numeric argument is out of range. "
-					"The offending command is ignored and has no other side effect than to set the error flag.";
-		case GL_INVALID_OPERATION:
-			return "The specified operation is not allowed in the current state. "
-					"The offending command is ignored and has no other side effect than to set the error flag.";
-		case GL_INVALID_FRAMEBUFFER_OPERATION:
-			return "The command is trying to render to or read from the framebuffer while the currently bound framebuffer is not framebuffer complete (i.e. the return value from glCheckFramebufferStatus is not GL_FRAMEBUFFER_COMPLETE). "
-					"The offending command is ignored and has no other side effect than to set the error flag.";
-		case GL_OUT_OF_MEMORY:
-			return "There is not enough memory left to execute the command. "
-					"The state of the GL is undefined, except for the state of the error flags, after this error is recorded.";
-		default:
-			return "Unknown error";
-	}
-}
-OpenGLWidget::ShaderLoadError::ShaderLoadError(GLenum gl_error_code):
-	OpenGLWidget::Exception("Cannot load the shader", gl_error_code) {
-}
-void OpenGLWidget::ShaderLoadError::raise() const {
-	throw *this;
-}
-QException* OpenGLWidget::ShaderLoadError::clone() const {
-	return new OpenGLWidget::ShaderLoadError(*this);
-}
-OpenGLWidget::ShaderBindError::ShaderBindError(GLenum gl_error_code):
-	OpenGLWidget::Exception("Cannot bind the shader", gl_error_code) {
-}
-void OpenGLWidget::ShaderBindError::raise() const {
-	throw *this;
-}
-QException* OpenGLWidget::ShaderBindError::clone() const {
-	return new OpenGLWidget::ShaderBindError(*this);
-}
-OpenGLWidget::ShaderCompileError::ShaderCompileError(GLenum gl_error_code):
-	OpenGLWidget::Exception("Cannot compile the shader", gl_error_code) {
-}
-void OpenGLWidget::ShaderCompileError::raise() const {
-	throw *this;
-}
-QException* OpenGLWidget::ShaderCompileError::clone() const {
-	return new OpenGLWidget::ShaderCompileError(*this);
-}
-OpenGLWidget::TextureCreateError::TextureCreateError(GLenum gl_error_code):
-		OpenGLWidget::Exception("Cannot create texture", gl_error_code) {
-}
-void OpenGLWidget::TextureCreateError::raise() const {
-	throw *this;
-}
-QException* OpenGLWidget::TextureCreateError::clone() const {
-	return new OpenGLWidget::TextureCreateError(*this);
+#include <tracer.h>
+
+namespace {
+	const char composite_vertex_shader_source[] =
+		"attribute vec2 vertexUV;\n"
+		"attribute vec3 vertexCoord;\n"
+		"varying vec2 UV;\n"
+		"void main() {\n"
+		"	gl_Position = vec4(2.0 * vertexCoord.xy - 1.0, 0, 1);\n"
+		"	UV = vertexUV;\n"
+		"}\n";
+
+	const char composite_fragment_shader_source[] =
+		"#ifdef GL_ES\n"
+		"	precision mediump float;\n"
+		"#endif\n"
+		"varying vec2 UV;\n"
+		"uniform sampler2D frame;\n"
+		"void main() {\n"
+		"	gl_FragColor = texture2D(frame, UV);\n"
+		"}\n";
 }
 
-OpenGLWidget::OpenGLWidget(QWidget *parent, const FITS::HeaderDataUnit& hdu):
+OpenGLWidget::OpenGLWidget(QWidget *parent, const FITS::HeaderDataUnit& hdu, const QString& texture_key, std::shared_ptr<const OpenGLTexture::Statistics> statistics, std::shared_ptr<const Sequence> sequence):
 	QOpenGLWidget(parent),
 	hdu_(&hdu),
-	texture_deleter_(this),
-	texture_(new OpenGLTexture(hdu_), texture_deleter_),
-	pixel_transfer_options_deleter_(this),
-	pixel_transfer_options_(new QOpenGLPixelTransferOptions, pixel_transfer_options_deleter_),
-	program_deleter_(this),
-	program_(new QOpenGLShaderProgram, program_deleter_),
+	worker_(Q_NULLPTR),
 	viewrect_(0, 0, 1, 1),
 	pixel_viewrect_(QPoint(0, 0), image_size()),
-	shader_uniforms_(new OpenGLShaderUniforms(1, 1, 0, 1)),
-	colormaps_{{
-		openGL_unique_ptr<OpenGLColorMap>(new GrayscaleColorMap() , colormap_deleter_type(this)),
-		openGL_unique_ptr<OpenGLColorMap>(new PurpleBlueColorMap(), colormap_deleter_type(this)),
-	}},
-	colormap_index_(0) {
+	colormaps_(Application::instance()->resourceRegistry().colormaps()),
+	colormap_index_(0),
+	has_levels_(false),
+	levels_(0, 0),
+	stretch_(OpenGLShaderUniforms::LinearStretch),
+	stretch_parameter_(0),
+	frame_statistics_visible_(false),
+	first_frame_presented_(false),
+	requested_sequence_index_(-1),
+	plane_(0) {
+
+	// Repaints started by Qt itself, e.g. expose, show the last frame, so the
+	// framebuffer has to be kept between the paints
+	setUpdateBehavior(QOpenGLWidget::PartialUpdate);
+
+	if (sequence) {
+		playback_.reset(new SequencePlayback(sequence->size(), 25));
+		requested_sequence_index_ = 0;
+
+		playback_timer_.setSingleShot(true);
+		playback_timer_.setTimerType(Qt::PreciseTimer);
+		connect(&playback_timer_, SIGNAL(timeout()), this, SLOT(advancePlayback()));
+	}
+
+	auto application = Application::instance();
+	worker_ = new OpenGLRenderWorker(application->renderThread(), application->resourceRegistry(), hdu, texture_key, std::move(statistics), std::move(sequence));
+
+	connect(this, SIGNAL(frameSwapped()), this, SLOT(notifyFrameSwapped()));
+	connect(worker_, SIGNAL(textureInitialized(const OpenGLTexture*)), this, SIGNAL(textureInitialized(const OpenGLTexture*)));
+	connect(worker_, SIGNAL(frameReady()), this, SLOT(notifyFrameReady()));
+	connect(worker_, SIGNAL(renderFailed(const QString&)), this, SLOT(notifyRenderFailed(const QString&)));
 }
 
 OpenGLWidget::~OpenGLWidget() {
+	// Waits for the frame being rendered
+	worker_->release();
+
 	makeCurrent();
 
 	vbo_.destroy();
+	composite_program_.reset();
+	// Shared resources are deleted when the last reference is dropped, so
+	// the context has to be current here.
+	for (auto& x: colormaps_) {
+		x.reset();
+	}
 
 	doneCurrent();
 }
 
 void OpenGLWidget::initializeGL() {
-	initializeOpenGLFunctions();
+	Tracer::Scope trace_scope("initializeGL", "startup");
 
-	struct ShaderLoader {
-		QString* fragment_shader_source_main_;
-
-		void operator() (const FITS::DataUnit<quint8>&) const {
-			*fragment_shader_source_main_ =
-					"uniform float c;\n"
-					"uniform float z;\n"
-					"void main() {\n"
-					"	float value = c * (texture2D(texture, UV).a - z);\n";
-		}
-		void operator() (const FITS::DataUnit<qint16>&) const {
-			*fragment_shader_source_main_ =
-					"uniform vec2 c;\n"
-					"uniform vec2 z;\n"
-					"void main() {\n"
-					"	vec2 raw_value = texture2D(texture, UV).ga;\n"
-					"   raw_value.x -= float(raw_value.x > 0.5) * 1.003921568627451;  // 256.0 / 255.0\n"
-					"	float value = dot(c, raw_value - z);\n";
-		}
-		void operator() (const FITS::DataUnit<qint32>&) const {
-			*fragment_shader_source_main_ =
-					"uniform vec4 c;\n"
-					"uniform vec4 z;\n"
-					"void main() {\n"
-					"	vec4 raw_value = texture2D(texture, UV);\n"
-					"   raw_value.x -= float(raw_value.x > 0.5) * 1.003921568627451;  // 256.0 / 255.0\n"
-					"	float value = dot(c, raw_value - z);\n";
-		}
-		void operator() (const FITS::DataUnit<qint64>&) const {
-			*fragment_shader_source_main_ =
-					"uniform vec4 c;\n"
-					"uniform vec4 z;\n"
-					"void main() {\n"
-					"	vec4 raw_value = texture2D(texture, UV);\n"
-					"   raw_value.x -= float(raw_value.x > 0.5) * 1.0000152590218967;  // 65536.0 / 65535.0\n"
-					"	float value = dot(c, raw_value - z);\n";
-		}
-		void operator() (const FITS::DataUnit<float>&) const {
-			// TODO: Check GL_ARB_color_buffer_float, GL_OES_texture_float.
-			if (! QOpenGLContext::currentContext()->hasExtension("GL_ARB_texture_float")) {
-				// TODO: recode data from float into (u)int32
-				qDebug() << "BITPIX==-32 is not implemented for this hardware";
-			} else {
-				*fragment_shader_source_main_ =
-						"uniform float c;\n"
-						"uniform float z;\n"
-						"void main() {\n"
-						"	float value = c * (texture2D(texture, UV).a - z);\n";
-			}
-		}
-		void operator() (const FITS::DataUnit<double>&) const {
-			qDebug() << "BITPIX==-64 is not implemented";
-		}
-		void operator() (const FITS::EmptyDataUnit&) const {
-			Q_ASSERT(0);
-		}
-	};
-
-	QString fragment_shader_source_main;
-	hdu_->data().apply(ShaderLoader{&fragment_shader_source_main});
+	initializeOpenGLFunctions();
 
 	glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
 	glDisable(GL_DEPTH_TEST);
 
-	texture_->initialize();
-	emit textureInitialized(texture_.get());
-	shader_uniforms_.reset(new OpenGLShaderUniforms(texture_->channels(), texture_->channel_size(), hdu_->header().bzero(), hdu_->header().bscale()));
-	shader_uniforms_->setMinMax(texture_->hdu_minmax());
-
-	for (auto& x: colormaps_) {
-		x->initialize();
-	}
-	shader_uniforms_->setColorMapSize(colormaps_[colormap_index_]->width());
+	composite_program_.reset(new QOpenGLShaderProgram);
+	if (! composite_program_->addShaderFromSourceCode(QOpenGLShader::Vertex, composite_vertex_shader_source)) throw OpenGLRenderer::ShaderCompileError(glGetError());
+	if (! composite_program_->addShaderFromSourceCode(QOpenGLShader::Fragment, composite_fragment_shader_source)) throw OpenGLRenderer::ShaderCompileError(glGetError());
+	composite_program_->bindAttributeLocation("vertexCoord", OpenGLShaderProgram::vertex_coord_attribute);
+	composite_program_->bindAttributeLocation("vertexUV",    OpenGLShaderProgram::vertex_uv_attribute);
+	if (! composite_program_->link()) throw OpenGLRenderer::ShaderLoadError(glGetError());
 
 	vbo_.create();
 	vbo_.bind();
-	vbo_.allocate(vbo_data, sizeof(vbo_data));
-
-	QOpenGLShader *vshader = new QOpenGLShader(QOpenGLShader::Vertex, this);
-	const char *vsrc =
-			"attribute vec2 VertexUV;\n"
-			"attribute vec3 vertexCoord;\n"
-			"varying vec2 UV;\n"
-			"uniform mat4 MVP;\n"
-			"void main() {\n"
-			"	gl_Position = MVP * vec4(vertexCoord,1);\n"
-			"	UV = VertexUV;\n"
-			"}\n";
-	if (! vshader->compileSourceCode(vsrc)) throw ShaderCompileError(glGetError());
-
-	QString fsrc =
-			"#ifdef GL_ES\n"
-			"	#ifdef GL_FRAGMENT_PRECISION_HIGH\n"
-			"		precision highp float;\n"
-			"		precision highp sampler2D;\n"
-			"	#else\n"
-			"		precision mediump float;\n"
-			"		precision mediump sampler2D;\n"
-			"	#endif\n"
-			"#endif\n"
-			"varying vec2 UV;\n"
-			"uniform sampler2D texture;\n"
-			"uniform sampler1D colormap;\n"
-			+ fragment_shader_source_main +
-			"	gl_FragColor = texture1D(colormap, clamp(value, 0.0, 1.0));\n"
-			"}\n";
-	QOpenGLShader *fshader = new QOpenGLShader(QOpenGLShader::Fragment, this);
-	if (! fshader->compileSourceCode(fsrc)) throw ShaderCompileError(glGetError());
-
-	if (! program_->addShader(vshader)) throw ShaderLoadError(glGetError());
-	if (! program_->addShader(fshader)) throw ShaderLoadError(glGetError());
-	program_->bindAttributeLocation("vertexCoord", program_vertex_coord_attribute_);
-	program_->bindAttributeLocation("vertexUV",    program_vertex_uv_attribute_);
-	if (! program_->link()) throw ShaderLoadError(glGetError());
-	if (! program_->bind()) throw ShaderBindError(glGetError());
-	program_->enableAttributeArray(program_vertex_coord_attribute_);
-	program_->enableAttributeArray(program_vertex_uv_attribute_);
-	program_->setAttributeBuffer(program_vertex_coord_attribute_, GL_FLOAT, 0, 3, 3 * sizeof(GLfloat));
-	program_->setAttributeBuffer(program_vertex_uv_attribute_,    GL_FLOAT, 0, 2, 3 * sizeof(GLfloat));
-
-	program_->setUniformValue("texture",  program_texture_uniform_);
-	program_->setUniformValue("colormap", program_colormap_uniform_);
+	vbo_.allocate(OpenGLRenderer::vbo_data, sizeof(OpenGLRenderer::vbo_data));
+
+	if (! composite_program_->bind()) throw OpenGLRenderer::ShaderBindError(glGetError());
+	composite_program_->setUniformValue("frame", 0);
+
+	if (auto screen = QGuiApplication::primaryScreen())
+		frame_scheduler_.setRefreshRate(screen->refreshRate());
+	frame_scheduler_.markDirty(FrameScheduler::AllDirty);
+}
+
+void OpenGLWidget::resizeGL(int, int) {
+	// Qt paints the new framebuffer right after resize, the old frame is
+	// stretched until the one of the new size is rendered
+	frame_scheduler_.markDirty(FrameScheduler::AllDirty);
+	requestFrame(FrameScheduler::SurfaceDirty);
 }
 
 void OpenGLWidget::resizeEvent(QResizeEvent* event) {
@@ -249,34 +141,196 @@ void OpenGLWidget::resizeEvent(QResizeEvent* event) {
 }
 
 void OpenGLWidget::changeLevels(const std::pair<double, double>& minmax) {
-	shader_uniforms_->setMinMax(minmax);
-	update();
+	has_levels_ = true;
+	levels_ = minmax;
+	requestFrame(FrameScheduler::LevelsDirty);
 }
 
 void OpenGLWidget::changeColorMap(int colormap_index) {
 	Q_ASSERT(colormap_index >= 0 && colormap_index < colormaps_.size());
 	if (colormap_index != colormap_index_) {
 		colormap_index_ = colormap_index;
-		shader_uniforms_->setColorMapSize(colormaps_[colormap_index]->width());
-		update();
+		requestFrame(FrameScheduler::ColorMapDirty | FrameScheduler::LevelsDirty);
 	}
 }
 
+void OpenGLWidget::changeStretch(int stretch, double parameter) {
+	Q_ASSERT(stretch >= 0 && stretch < OpenGLShaderUniforms::StretchCount);
+	if (stretch != stretch_ || parameter != stretch_parameter_) {
+		stretch_ = static_cast<OpenGLShaderUniforms::Stretch>(stretch);
+		stretch_parameter_ = parameter;
+		requestFrame(FrameScheduler::StretchDirty);
+	}
+}
+
+OpenGLRenderWorker::State OpenGLWidget::renderState() const {
+	OpenGLRenderWorker::State state;
+
+	state.viewrect = viewrect_;
+	state.has_levels = has_levels_;
+	state.levels = levels_;
+	state.colormap_index = colormap_index_;
+	state.stretch = stretch_;
+	state.stretch_parameter = stretch_parameter_;
+	state.size = size() * devicePixelRatio();
+	state.statistics_visible = frame_statistics_visible_;
+	state.sequence_index = requested_sequence_index_;
+	state.plane = plane_;
+
+	return state;
+}
+
+void OpenGLWidget::requestFrame(int dirty) {
+	// The render thread renders the latest posted state, the changes posted
+	// meanwhile are coalesced there
+	worker_->post(renderState());
+	frame_scheduler_.markDirty(dirty);
+}
+
+void OpenGLWidget::notifyFrameReady() {
+	/* Frames published while the paint is pending are shown by it. The
+	 * scheduler accounts them and the latency until the frame is
+	 * presented. */
+	if (frame_scheduler_.request(FrameScheduler::SurfaceDirty, Tracer::instance().now()))
+		update();
+}
+
+void OpenGLWidget::notifyRenderFailed(const QString& reason) {
+	QMessageBox::critical(this, tr("An error occured"), reason);
+}
+
 void OpenGLWidget::paintGL() {
+	const int dirty = frame_scheduler_.beginFrame();
+	// Framebuffer still holds the image, nothing to do
+	if (!dirty)
+		return;
+
+	Tracer::Scope trace_scope("paintGL", "frame");
+
+	const bool fetched = worker_->fetchFrame();
+	const auto& frame = worker_->frame();
+	if (fetched && playback_)
+		playback_->presented(frame.sequence_index, Tracer::instance().now());
+
 	glClear(GL_COLOR_BUFFER_BIT);
 
-	QMatrix4x4 mvp(base_mvp_);
-	// QT and OpenGL have different coordinate systems, we should change y-axes direction
-	mvp.ortho(viewrect_.left(), viewrect_.right(), 1 - viewrect_.bottom(), 1 - viewrect_.top(), -1.0f, 1.0f);
-	program_->setUniformValue("MVP", mvp);
+	if (frame.fbo) {
+		// Vertex attribute state belongs to the context and is reset by QPainter,
+		// so it is set up every frame
+		composite_program_->bind();
+		vbo_.bind();
+		composite_program_->enableAttributeArray(OpenGLShaderProgram::vertex_coord_attribute);
+		composite_program_->enableAttributeArray(OpenGLShaderProgram::vertex_uv_attribute);
+		composite_program_->setAttributeBuffer(OpenGLShaderProgram::vertex_coord_attribute, GL_FLOAT, 0, 3, 3 * sizeof(GLfloat));
+		composite_program_->setAttributeBuffer(OpenGLShaderProgram::vertex_uv_attribute,    GL_FLOAT, 0, 2, 3 * sizeof(GLfloat));
+
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, frame.fbo->texture());
+		glDrawArrays(GL_TRIANGLES, 0, 6);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		worker_->frameDrawn();
+	}
+
+	if (frame_statistics_visible_)
+		paintFrameStatistics();
+}
+
+void OpenGLWidget::paintFrameStatistics() {
+	QPainter painter(this);
+	painter.setPen(Qt::yellow);
+	painter.setFont(QFont("Monospace"));
+	auto text = worker_->frame().statistics + frame_scheduler_.summary();
+	if (playback_)
+		text += playback_->summary(Tracer::instance().now());
+	painter.drawText(rect().adjusted(8, 8, -8, -8), Qt::AlignLeft | Qt::AlignTop, text);
+}
+
+void OpenGLWidget::togglePlayback() {
+	if (!playback_)
+		return;
+
+	const auto now = Tracer::instance().now();
+	if (playback_->isPlaying()) {
+		playback_->pause(now);
+	} else {
+		playback_->play(now);
+	}
+	advancePlayback();
+}
+
+void OpenGLWidget::nextSequenceFrame() {
+	if (!playback_)
+		return;
 
-	program_->setUniformValueArray("c", shader_uniforms_->get_c().data(), 1, shader_uniforms_->channels);
-	program_->setUniformValueArray("z", shader_uniforms_->get_z().data(), 1, shader_uniforms_->channels);
+	playback_->step(1, Tracer::instance().now());
+	advancePlayback();
+}
 
-	texture_->bind(program_texture_uniform_);
-	colormaps_[colormap_index_]->bind(program_colormap_uniform_);
+void OpenGLWidget::previousSequenceFrame() {
+	if (!playback_)
+		return;
 
-	glDrawArrays(GL_TRIANGLES, 0, 6);
+	playback_->step(-1, Tracer::instance().now());
+	advancePlayback();
+}
+
+void OpenGLWidget::setSequenceFrameRate(double frame_rate) {
+	if (!playback_)
+		return;
+
+	playback_->setFrameRate(frame_rate, Tracer::instance().now());
+	advancePlayback();
+}
+
+void OpenGLWidget::advancePlayback() {
+	const auto now = Tracer::instance().now();
+	const int index = playback_->index(now);
+	if (index != requested_sequence_index_) {
+		requested_sequence_index_ = index;
+		requestFrame(FrameScheduler::SequenceDirty);
+	}
+
+	if (playback_->isPlaying()) {
+		// Rounded up, so the timer never fires before the frame is due
+		const auto interval = (playback_->timeToNextFrame(now) + 999999) / 1000000;
+		playback_timer_.start(static_cast<int>(interval));
+	} else {
+		playback_timer_.stop();
+	}
+}
+
+void OpenGLWidget::setPlane(quint64 plane) {
+	Q_ASSERT(plane < hdu_->data().imageDataUnit()->depth());
+	if (plane != plane_) {
+		plane_ = plane;
+		requestFrame(FrameScheduler::PlaneDirty);
+	}
+}
+
+void OpenGLWidget::updateFrame(std::shared_ptr<const Sequence::OpenedFrame> frame) {
+	Q_ASSERT(frame->hdu->data().imageDataUnit()->size() == image_size());
+
+	hdu_ = frame->hdu;
+	frame_ = frame;
+	// The worker renders the frame as soon as it is uploaded
+	worker_->updateFrame(std::move(frame));
+	frame_scheduler_.markDirty(FrameScheduler::FrameDirty);
+}
+
+void OpenGLWidget::setFrameStatisticsVisible(bool visible) {
+	if (visible != frame_statistics_visible_) {
+		frame_statistics_visible_ = visible;
+		requestFrame(FrameScheduler::SurfaceDirty);
+	}
+}
+
+void OpenGLWidget::notifyFrameSwapped() {
+	frame_scheduler_.frameSwapped(Tracer::instance().now());
+
+	if (!first_frame_presented_ && worker_->frame().fbo) {
+		first_frame_presented_ = true;
+		Application::instance()->notifyFirstFrameSwapped();
+	}
 }
 
 QSize OpenGLWidget::sizeHint() const {
@@ -289,8 +343,11 @@ void OpenGLWidget::setViewrect(const QRectF &viewrect) {
 	const QRect old_pixel_viewrect(pixel_viewrect_);
 	pixel_viewrect_ = viewrectToPixelViewrect(viewrect_);
 	if (pixel_viewrect_ != old_pixel_viewrect) {
-		update();
+		requestFrame(FrameScheduler::ViewDirty);
 		emit pixelViewrectChanged(pixel_viewrect_);
+	} else {
+		// Subpixel change is shown with the next frame
+		frame_scheduler_.markDirty(FrameScheduler::ViewDirty);
 	}
 }
 
@@ -338,5 +395,3 @@ bool OpenGLWidget::correct_viewrect() {
 	}
 	return false;
 }
-
-constexpr const GLfloat OpenGLWidget::vbo_data[];
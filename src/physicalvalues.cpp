@@ -0,0 +1,96 @@
+#include <QtEndian>
+
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <physicalvalues.h>
+
+namespace {
+	template<class T> inline T fromBigEndian(const T* src) {
+		return qFromBigEndian<T>(reinterpret_cast<const uchar*>(src));
+	}
+	template<> inline float fromBigEndian<float>(const float* src) {
+		const auto bits = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(src));
+		float x;
+		std::memcpy(&x, &bits, sizeof(x));
+		return x;
+	}
+	template<> inline double fromBigEndian<double>(const double* src) {
+		const auto bits = qFromBigEndian<quint64>(reinterpret_cast<const uchar*>(src));
+		double x;
+		std::memcpy(&x, &bits, sizeof(x));
+		return x;
+	}
+
+	template<class T> void convert(const T* src, quint64 count, double bscale, double bzero, float* dst) {
+		for (quint64 i = 0; i < count; ++i) {
+			dst[i] = static_cast<float>(fromBigEndian(src + i) * bscale + bzero);
+		}
+	}
+
+	// 16-bit values are exact in float, so the vector path is used
+	void convert(const qint16* src, quint64 count, double bscale, double bzero, float* dst) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		const __m128 scale = _mm_set1_ps(static_cast<float>(bscale));
+		const __m128 zero = _mm_set1_ps(static_cast<float>(bzero));
+		for (; i + 8 <= count; i += 8) {
+			__m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			v = _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+			// Every word is put into the high half and shifted back with sign
+			const __m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			const __m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			_mm_storeu_ps(dst + i,     _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(lo), scale), zero));
+			_mm_storeu_ps(dst + i + 4, _mm_add_ps(_mm_mul_ps(_mm_cvtepi32_ps(hi), scale), zero));
+		}
+#endif
+		for (; i < count; ++i) {
+			dst[i] = static_cast<float>(fromBigEndian(src + i) * bscale + bzero);
+		}
+	}
+
+	void convert(const float* src, quint64 count, double bscale, double bzero, float* dst) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		const __m128 scale = _mm_set1_ps(static_cast<float>(bscale));
+		const __m128 zero = _mm_set1_ps(static_cast<float>(bzero));
+		const __m128i byte_mask = _mm_set1_epi32(0xFF00);
+		for (; i + 4 <= count; i += 4) {
+			const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+			const __m128i swapped = _mm_or_si128(
+				_mm_or_si128(_mm_slli_epi32(v, 24), _mm_srli_epi32(v, 24)),
+				_mm_or_si128(_mm_and_si128(_mm_srli_epi32(v, 8), byte_mask), _mm_slli_epi32(_mm_and_si128(v, byte_mask), 8)));
+			_mm_storeu_ps(dst + i, _mm_add_ps(_mm_mul_ps(_mm_castsi128_ps(swapped), scale), zero));
+		}
+#endif
+		for (; i < count; ++i) {
+			dst[i] = static_cast<float>(fromBigEndian(src + i) * bscale + bzero);
+		}
+	}
+
+	struct Converter {
+		quint64 offset;
+		quint64 count;
+		double bscale;
+		double bzero;
+		float* dst;
+
+		template<class T> void operator() (const FITS::DataUnit<T>& data) const {
+			convert(data.data() + offset, count, bscale, bzero, dst);
+		}
+		void operator() (const FITS::EmptyDataUnit&) const {
+			Q_ASSERT(0);
+		}
+		void operator() (const FITS::TableDataUnit&) const {
+			Q_ASSERT(0);
+		}
+	};
+}
+
+void convertToPhysical(const FITS::HeaderDataUnit& hdu, quint64 offset, quint64 count, float* dst) {
+	const auto& header = hdu.header();
+	hdu.data().apply(Converter{offset, count, header.bscale(), header.bzero(), dst});
+}
@@ -3,10 +3,10 @@
 
 #include <scrollzoomarea.h>
 
-ScrollZoomArea::ScrollZoomArea(QWidget *parent, const FITS::HeaderDataUnit& hdu):
+ScrollZoomArea::ScrollZoomArea(QWidget *parent, const FITS::HeaderDataUnit& hdu, const QString& texture_key, std::shared_ptr<const OpenGLTexture::Statistics> statistics, std::shared_ptr<const Sequence> sequence):
 	QAbstractScrollArea(parent) {
 
-	std::unique_ptr<OpenGLWidget> open_gl_widget{new OpenGLWidget(this, hdu)};
+	std::unique_ptr<OpenGLWidget> open_gl_widget{new OpenGLWidget(this, hdu, texture_key, std::move(statistics), std::move(sequence))};
 	/* setViewport promises to take ownership */
 	setViewport(open_gl_widget.release());
 
@@ -0,0 +1,129 @@
+#include <QFile>
+
+#include <gzipfitsstorage.h>
+#include <httpfitsstorage.h>
+#include <mmapfitsstorage.h>
+#include <sequence.h>
+#include <tracer.h>
+
+Sequence::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void Sequence::Exception::raise() const {
+	throw *this;
+}
+QException* Sequence::Exception::clone() const {
+	return new Sequence::Exception(*this);
+}
+
+Sequence::FrameMismatch::FrameMismatch(const QString& filename):
+	Sequence::Exception(filename + ": the frame differs from the first one by shape or BITPIX") {
+}
+void Sequence::FrameMismatch::raise() const {
+	throw *this;
+}
+QException* Sequence::FrameMismatch::clone() const {
+	return new Sequence::FrameMismatch(*this);
+}
+
+Sequence::Sequence(const QStringList& filenames) {
+	if (filenames.isEmpty())
+		throw Exception("The sequence is empty");
+
+	if (filenames.size() == 1) {
+		first_ = open(Frame{filenames.front(), -1});
+
+		// All the image HDUs of the single file
+		const FITS::HeaderDataUnit* hdu = &first_.fits->primary_hdu();
+		int index = 0;
+		for (auto it = first_.fits->begin(); ; ++it, ++index) {
+			if (hdu->data().imageDataUnit() && !hdu->data().imageDataUnit()->size().isEmpty())
+				frames_.push_back(Frame{filenames.front(), index});
+			if (it == first_.fits->end())
+				break;
+			hdu = &(*it);
+		}
+	} else {
+		for (const auto& filename: filenames) {
+			frames_.push_back(Frame{filename, -1});
+		}
+		first_ = open(frames_.front());
+	}
+
+	size_ = first_.hdu->data().imageDataUnit()->size();
+	bitpix_ = first_.hdu->header().header("BITPIX");
+}
+
+Sequence::Sequence(const std::vector<Frame>& frames):
+	frames_(frames) {
+
+	if (frames_.empty())
+		throw Exception("The sequence is empty");
+
+	first_ = open(frames_.front(), FrameOnly);
+	size_ = first_.hdu->data().imageDataUnit()->size();
+	bitpix_ = first_.hdu->header().header("BITPIX");
+}
+
+Sequence::OpenedFrame Sequence::open(int index) const {
+	Q_ASSERT(index >= 0 && index < size());
+
+	auto opened = open(frames_[index], FrameOnly);
+	if (opened.hdu->data().imageDataUnit()->size() != size_ || opened.hdu->header().header("BITPIX") != bitpix_)
+		throw FrameMismatch(frames_[index].filename);
+
+	return opened;
+}
+
+Sequence::OpenedFrame Sequence::open(const Frame& frame, Extent extent) {
+	Tracer::Scope trace_scope("sequence frame open", "sequence");
+
+	std::unique_ptr<AbstractFITSStorage> storage;
+	if (HttpFITSStorage::isUrl(frame.filename)) {
+		// Frame only opens fetch the headers and the data of the frame
+		storage.reset(new HttpFITSStorage(QUrl(frame.filename), (extent == FrameOnly ? frame.hdu_index : HttpFITSStorage::whole_file)));
+	} else {
+		std::unique_ptr<QFile> file{new QFile(frame.filename)};
+		if (!file->open(QIODevice::ReadOnly))
+			throw Exception(frame.filename + ": " + file->errorString());
+
+		if (GzipFITSStorage::isGzip(file.get())) {
+			storage.reset(new GzipFITSStorage(file.release(), (extent == FrameOnly ? frame.hdu_index : GzipFITSStorage::whole_file)));
+		} else {
+			storage.reset(new MMapFITSStorage(file.release()));
+		}
+	}
+
+	if (frame.offset == 0)
+		return open(std::unique_ptr<FITS>(new FITS(storage.release())), frame.hdu_index, frame.filename);
+
+	// The headers of the preceding HDUs are not parsed
+	OpenedFrame opened;
+	opened.fits.reset(new FITS(storage.release(), frame.offset));
+	opened.hdu = &opened.fits->primary_hdu();
+	opened.hdu_index = frame.hdu_index;
+	if (!opened.hdu->data().imageDataUnit())
+		throw Exception(frame.filename + ": the file has no image content");
+
+	return opened;
+}
+
+Sequence::OpenedFrame Sequence::open(std::unique_ptr<FITS> fits, int hdu_index, const QString& source) {
+	OpenedFrame opened;
+	opened.fits = std::move(fits);
+	opened.hdu = &opened.fits->primary_hdu();
+	opened.hdu_index = 0;
+
+	for (auto it = opened.fits->begin(); ; ++it, ++opened.hdu_index) {
+		if (hdu_index < 0 ? static_cast<bool>(opened.hdu->data().imageDataUnit()) : static_cast<int>(opened.hdu_index) == hdu_index)
+			break;
+		if (it == opened.fits->end())
+			throw Exception(source + ": the file has no image content");
+		opened.hdu = &(*it);
+	}
+
+	if (!opened.hdu->data().imageDataUnit())
+		throw Exception(source + ": the file has no image content");
+
+	return opened;
+}
@@ -0,0 +1,104 @@
+#include <sequenceplayback.h>
+
+SequencePlayback::SequencePlayback(int count, double frame_rate):
+	count_(count),
+	frame_interval_(0),
+	playing_(false),
+	start_time_(0),
+	start_index_(0),
+	index_(0),
+	last_presented_(-1),
+	first_presented_time_(0),
+	last_presented_time_(0),
+	session_presented_(0),
+	presented_(0),
+	dropped_(0) {
+
+	Q_ASSERT(count > 0);
+	setFrameRate(frame_rate, 0);
+}
+
+void SequencePlayback::setFrameRate(double frame_rate, qint64 now) {
+	if (frame_rate <= 0)
+		return;
+
+	if (playing_) {
+		start_index_ = index(now);
+		start_time_ = now;
+	}
+	frame_interval_ = qMax(static_cast<qint64>(1e9 / frame_rate), static_cast<qint64>(1));
+}
+
+void SequencePlayback::play(qint64 now) {
+	if (playing_)
+		return;
+
+	playing_ = true;
+	start_time_ = now;
+	start_index_ = index_;
+	last_presented_ = -1;
+	session_presented_ = 0;
+}
+
+void SequencePlayback::pause(qint64 now) {
+	if (!playing_)
+		return;
+
+	index_ = index(now);
+	playing_ = false;
+}
+
+void SequencePlayback::step(int delta, qint64 now) {
+	index_ = ((index(now) + delta) % count_ + count_) % count_;
+	playing_ = false;
+}
+
+int SequencePlayback::index(qint64 now) const {
+	if (!playing_)
+		return index_;
+
+	const auto frames = qMax(now - start_time_, static_cast<qint64>(0)) / frame_interval_;
+	return static_cast<int>((start_index_ + frames) % count_);
+}
+
+qint64 SequencePlayback::timeToNextFrame(qint64 now) const {
+	const auto elapsed = qMax(now - start_time_, static_cast<qint64>(0));
+	return frame_interval_ - elapsed % frame_interval_;
+}
+
+void SequencePlayback::presented(int index, qint64 now) {
+	// Frame has been presented again, e.g. after a view change
+	if (index == last_presented_)
+		return;
+
+	++presented_;
+	if (!playing_) {
+		last_presented_ = index;
+		return;
+	}
+
+	if (session_presented_ == 0) {
+		first_presented_time_ = now;
+	} else {
+		dropped_ += (index - last_presented_ + count_) % count_ - 1;
+	}
+	++session_presented_;
+	last_presented_ = index;
+	last_presented_time_ = now;
+}
+
+double SequencePlayback::sustainedFrameRate() const {
+	if (session_presented_ < 2 || last_presented_time_ <= first_presented_time_)
+		return 0.0;
+
+	return (session_presented_ - 1) * 1e9 / (last_presented_time_ - first_presented_time_);
+}
+
+QString SequencePlayback::summary(qint64 now) const {
+	return QString("Playback: frame %1/%2, %3 of %4 fps, dropped %5\n")
+		.arg(index(now) + 1)
+		.arg(count_)
+		.arg(sustainedFrameRate(), 0, 'f', 1)
+		.arg(targetFrameRate(), 0, 'f', 1)
+		.arg(dropped_);
+}
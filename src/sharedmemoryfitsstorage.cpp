@@ -0,0 +1,12 @@
+#include <sharedmemoryfitsstorage.h>
+
+SharedMemoryFITSStorage::SharedMemoryFITSStorage(std::shared_ptr<SharedMemoryRing> ring, int hold, quint64 sequence, quint8* data, qint64 size):
+	AbstractFITSStorage(data, size),
+	ring_(std::move(ring)),
+	hold_(hold),
+	sequence_(sequence) {
+}
+
+SharedMemoryFITSStorage::~SharedMemoryFITSStorage() {
+	ring_->release(hold_);
+}
@@ -0,0 +1,248 @@
+#include <QtGlobal>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <new>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <sharedmemoryfitsstorage.h>
+#include <sharedmemoryring.h>
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2, "Atomics in shared memory have to be lock-free");
+
+namespace {
+	const char magic[8] = {'F', 'I', 'P', 'S', 'R', 'I', 'N', 'G'};
+
+	inline quint64 pageAligned(quint64 size) {
+		return (size + SharedMemoryRing::control_size - 1) / SharedMemoryRing::control_size * SharedMemoryRing::control_size;
+	}
+
+	QString errorString() {
+		return QString(std::strerror(errno));
+	}
+}
+
+SharedMemoryRing::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void SharedMemoryRing::Exception::raise() const {
+	throw *this;
+}
+QException* SharedMemoryRing::Exception::clone() const {
+	return new SharedMemoryRing::Exception(*this);
+}
+
+SharedMemoryRing::SharedMemoryRing(const QString& name, bool producer):
+	name_(name),
+	producer_(producer),
+	data_(Q_NULLPTR),
+	size_(0),
+	control_(Q_NULLPTR),
+	next_sequence_(1),
+	next_slot_(0),
+	writing_slot_(max_slot_count) {
+}
+
+SharedMemoryRing::~SharedMemoryRing() {
+#ifdef Q_OS_UNIX
+	if (data_)
+		::munmap(data_, size_);
+#endif
+}
+
+void SharedMemoryRing::map(int fd, quint64 size) {
+#ifdef Q_OS_UNIX
+	void* data = ::mmap(Q_NULLPTR, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED)
+		throw Exception(name_ + ": " + errorString());
+
+	data_ = static_cast<quint8*>(data);
+	size_ = size;
+	control_ = reinterpret_cast<Control*>(data_);
+#else
+	Q_UNUSED(fd);
+	Q_UNUSED(size);
+#endif
+}
+
+std::shared_ptr<SharedMemoryRing> SharedMemoryRing::create(const QString& name, quint32 slot_count, quint64 slot_size) {
+	static_assert(sizeof(Control) <= control_size, "Control block has to fit the control page");
+
+	if (slot_count < hold_count + 2 || slot_count > max_slot_count)
+		throw Exception(name + ": " + QString("the number of slots has to be from %1 to %2").arg(static_cast<int>(hold_count + 2)).arg(static_cast<int>(max_slot_count)));
+
+	std::shared_ptr<SharedMemoryRing> ring{new SharedMemoryRing(name, true)};
+#ifdef Q_OS_UNIX
+	slot_size = pageAligned(slot_size);
+	const quint64 size = control_size + slot_count * slot_size;
+
+	::shm_unlink(name.toLocal8Bit().constData());
+	const int fd = ::shm_open(name.toLocal8Bit().constData(), O_RDWR | O_CREAT | O_EXCL, 0600);
+	if (fd < 0)
+		throw Exception(name + ": " + errorString());
+	if (::ftruncate(fd, static_cast<off_t>(size)) != 0) {
+		const auto error = errorString();
+		::close(fd);
+		throw Exception(name + ": " + error);
+	}
+	ring->map(fd, size);
+
+	auto control = new (ring->data_) Control;
+	control->version = version;
+	control->slot_count = slot_count;
+	control->slot_size = slot_size;
+	for (auto& hold: control->holds)
+		hold.store(free_hold);
+	for (auto& slot: control->slots) {
+		slot.state.store(0);
+		slot.size = 0;
+	}
+	control->latest.store(0);
+	// Readers check the magic last
+	std::atomic_thread_fence(std::memory_order_release);
+	std::memcpy(control->magic, magic, sizeof(magic));
+#else
+	throw Exception(name + ": shared memory is not supported on this platform");
+#endif
+	return ring;
+}
+
+std::shared_ptr<SharedMemoryRing> SharedMemoryRing::open(const QString& name) {
+	std::shared_ptr<SharedMemoryRing> ring{new SharedMemoryRing(name, false)};
+#ifdef Q_OS_UNIX
+	// Hold registers are written by the viewer too
+	const int fd = ::shm_open(name.toLocal8Bit().constData(), O_RDWR, 0);
+	if (fd < 0)
+		throw Exception(name + ": " + errorString());
+
+	struct stat info;
+	if (::fstat(fd, &info) != 0 || static_cast<quint64>(info.st_size) < control_size) {
+		::close(fd);
+		throw Exception(name + ": the segment is not a frame ring");
+	}
+	ring->map(fd, static_cast<quint64>(info.st_size));
+
+	const auto control = ring->control_;
+	std::atomic_thread_fence(std::memory_order_acquire);
+	if (std::memcmp(control->magic, magic, sizeof(magic)) != 0 || control->version != version)
+		throw Exception(name + ": the segment is not a frame ring of version " + QString::number(version));
+	if (control->slot_count > max_slot_count || control_size + control->slot_count * control->slot_size > ring->size_)
+		throw Exception(name + ": the segment is truncated");
+#else
+	throw Exception(name + ": shared memory is not supported on this platform");
+#endif
+	return ring;
+}
+
+void SharedMemoryRing::unlink(const QString& name) {
+#ifdef Q_OS_UNIX
+	::shm_unlink(name.toLocal8Bit().constData());
+#else
+	Q_UNUSED(name);
+#endif
+}
+
+bool SharedMemoryRing::isHeld(quint32 slot) const {
+	for (const auto& hold: control_->holds) {
+		if (hold.load() == slot)
+			return true;
+	}
+	return false;
+}
+
+quint8* SharedMemoryRing::beginFrame() {
+	Q_ASSERT(producer_);
+
+	const quint32 slot_count = control_->slot_count;
+	const quint32 latest_slot = static_cast<quint32>(control_->latest.load() & 0xff);
+	// There is always a slot which is neither pinned nor the latest
+	for (quint32 i = 0; ; ++i) {
+		const quint32 slot = (next_slot_ + i) % slot_count;
+		if (control_->latest.load() != 0 && slot == latest_slot)
+			continue;
+
+		auto& state = control_->slots[slot].state;
+		const quint64 previous = state.load();
+		/* The slot is marked before the holds are checked, and the viewer
+		 * pins it before it checks the mark, so either the viewer sees the
+		 * slot is written or the producer sees it is pinned. */
+		state.store(2 * next_sequence_ + 1);
+		if (isHeld(slot)) {
+			state.store(previous);
+			continue;
+		}
+
+		writing_slot_ = slot;
+		next_slot_ = (slot + 1) % slot_count;
+		return data_ + control_size + slot * control_->slot_size;
+	}
+}
+
+quint64 SharedMemoryRing::publishFrame(quint64 size) {
+	Q_ASSERT(producer_ && writing_slot_ < max_slot_count);
+	Q_ASSERT(size <= control_->slot_size);
+
+	const quint64 sequence = next_sequence_++;
+	auto& slot = control_->slots[writing_slot_];
+	slot.size = size;
+	slot.state.store(2 * sequence, std::memory_order_release);
+	control_->latest.store(sequence << 8 | writing_slot_, std::memory_order_release);
+	writing_slot_ = max_slot_count;
+
+	return sequence;
+}
+
+quint64 SharedMemoryRing::latestSequence() const {
+	return control_->latest.load(std::memory_order_acquire) >> 8;
+}
+
+std::unique_ptr<SharedMemoryFITSStorage> SharedMemoryRing::acquireLatest(quint64* sequence) {
+	int hold = -1;
+	for (int i = 0; i < hold_count; ++i) {
+		quint32 expected = free_hold;
+		if (control_->holds[i].compare_exchange_strong(expected, reserved_hold)) {
+			hold = i;
+			break;
+		}
+	}
+	if (hold < 0)
+		return std::unique_ptr<SharedMemoryFITSStorage>();
+
+	// The producer may take the slot between the reads, then the newer frame is tried
+	for (int attempt = 0; attempt < 16; ++attempt) {
+		const quint64 latest = control_->latest.load();
+		if (latest == 0)
+			break;
+
+		const quint32 slot = static_cast<quint32>(latest & 0xff);
+		const quint64 latest_sequence = latest >> 8;
+		if (slot >= control_->slot_count)
+			break;
+		control_->holds[hold].store(slot);
+		if (control_->slots[slot].state.load() != 2 * latest_sequence) {
+			control_->holds[hold].store(reserved_hold);
+			continue;
+		}
+
+		const qint64 size = static_cast<qint64>(std::min(control_->slots[slot].size, control_->slot_size));
+		if (sequence)
+			*sequence = latest_sequence;
+		return std::unique_ptr<SharedMemoryFITSStorage>(new SharedMemoryFITSStorage(shared_from_this(), hold, latest_sequence, data_ + control_size + slot * control_->slot_size, size));
+	}
+
+	release(hold);
+	return std::unique_ptr<SharedMemoryFITSStorage>();
+}
+
+void SharedMemoryRing::release(int hold) {
+	Q_ASSERT(hold >= 0 && hold < hold_count);
+	control_->holds[hold].store(free_hold);
+}
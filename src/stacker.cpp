@@ -0,0 +1,280 @@
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <memoryfitsstorage.h>
+#include <parallel.h>
+#include <physicalvalues.h>
+#include <stacker.h>
+#include <tracer.h>
+
+namespace {
+	// Weight is 1 for the values and 0 for NaN, which are replaced by 0
+	void maskNaN(float* v, float* w, quint64 count) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		const __m128 one = _mm_set1_ps(1.0f);
+		for (; i + 4 <= count; i += 4) {
+			const __m128 x = _mm_loadu_ps(v + i);
+			const __m128 ordered = _mm_cmpord_ps(x, x);
+			_mm_storeu_ps(v + i, _mm_and_ps(x, ordered));
+			_mm_storeu_ps(w + i, _mm_and_ps(one, ordered));
+		}
+#endif
+		for (; i < count; ++i) {
+			const bool ordered = (v[i] == v[i]);
+			w[i] = (ordered ? 1.0f : 0.0f);
+			v[i] = (ordered ? v[i] : 0.0f);
+		}
+	}
+
+	// sum += w * v, weight += w
+	void accumulate(const float* v, const float* w, float* sum, float* weight, quint64 count) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		for (; i + 4 <= count; i += 4) {
+			const __m128 x = _mm_loadu_ps(v + i), y = _mm_loadu_ps(w + i);
+			_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(x, y)));
+			_mm_storeu_ps(weight + i, _mm_add_ps(_mm_loadu_ps(weight + i), y));
+		}
+#endif
+		for (; i < count; ++i) {
+			sum[i] += v[i] * w[i];
+			weight[i] += w[i];
+		}
+	}
+
+	// sum += w * (v - mean)^2
+	void accumulateSquares(const float* v, const float* w, const float* mean, float* sum, quint64 count) {
+		quint64 i = 0;
+#ifdef __SSE2__
+		for (; i + 4 <= count; i += 4) {
+			const __m128 d = _mm_sub_ps(_mm_loadu_ps(v + i), _mm_loadu_ps(mean + i));
+			_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(_mm_mul_ps(d, d), _mm_loadu_ps(w + i))));
+		}
+#endif
+		for (; i < count; ++i) {
+			const float d = v[i] - mean[i];
+			sum[i] += d * d * w[i];
+		}
+	}
+
+	// Rejects the values deviating by more than limit, returns true if any
+	bool clip(const float* v, float* w, const float* mean, const float* limit, quint64 count) {
+		bool clipped = false;
+		quint64 i = 0;
+#ifdef __SSE2__
+		const __m128 abs_mask = _mm_castsi128_ps(_mm_set1_epi32(0x7FFFFFFF));
+		for (; i + 4 <= count; i += 4) {
+			const __m128 d = _mm_and_ps(_mm_sub_ps(_mm_loadu_ps(v + i), _mm_loadu_ps(mean + i)), abs_mask);
+			const __m128 y = _mm_loadu_ps(w + i);
+			const __m128 kept = _mm_and_ps(y, _mm_cmple_ps(d, _mm_loadu_ps(limit + i)));
+			clipped |= (_mm_movemask_ps(_mm_cmpneq_ps(kept, y)) != 0);
+			_mm_storeu_ps(w + i, kept);
+		}
+#endif
+		for (; i < count; ++i) {
+			if (w[i] != 0.0f && !(std::abs(v[i] - mean[i]) <= limit[i])) {
+				w[i] = 0.0f;
+				clipped = true;
+			}
+		}
+		return clipped;
+	}
+
+	void divide(const float* sum, const float* weight, float* dst, quint64 count) {
+		const float nan = std::numeric_limits<float>::quiet_NaN();
+		for (quint64 i = 0; i < count; ++i) {
+			dst[i] = (weight[i] > 0.0f ? sum[i] / weight[i] : nan);
+		}
+	}
+
+	// Values of the band are frame by frame, count pixels each
+	void mean(const float* v, const float* w, int frames, quint64 count, float* dst) {
+		std::vector<float> sum(count, 0.0f), weight(count, 0.0f);
+		for (int f = 0; f < frames; ++f) {
+			accumulate(v + f * count, w + f * count, sum.data(), weight.data(), count);
+		}
+		divide(sum.data(), weight.data(), dst, count);
+	}
+
+	void median(const float* v, const float* w, int frames, quint64 count, float* dst) {
+		std::vector<float> values;
+		values.reserve(frames);
+		for (quint64 i = 0; i < count; ++i) {
+			values.clear();
+			for (int f = 0; f < frames; ++f) {
+				if (w[f * count + i] != 0.0f)
+					values.push_back(v[f * count + i]);
+			}
+
+			if (values.empty()) {
+				dst[i] = std::numeric_limits<float>::quiet_NaN();
+				continue;
+			}
+
+			const auto middle = values.begin() + values.size() / 2;
+			std::nth_element(values.begin(), middle, values.end());
+			if (values.size() % 2) {
+				dst[i] = *middle;
+			} else {
+				const float lower = *std::max_element(values.begin(), middle);
+				dst[i] = (lower + *middle) / 2;
+			}
+		}
+	}
+
+	void sigmaClip(const float* v, float* w, int frames, quint64 count, double sigma, int iterations, float* dst) {
+		std::vector<float> sum(count), weight(count), means(count), limit(count);
+		for (int iteration = 0; iteration < iterations; ++iteration) {
+			std::fill(sum.begin(), sum.end(), 0.0f);
+			std::fill(weight.begin(), weight.end(), 0.0f);
+			for (int f = 0; f < frames; ++f) {
+				accumulate(v + f * count, w + f * count, sum.data(), weight.data(), count);
+			}
+			divide(sum.data(), weight.data(), means.data(), count);
+
+			std::fill(sum.begin(), sum.end(), 0.0f);
+			for (int f = 0; f < frames; ++f) {
+				accumulateSquares(v + f * count, w + f * count, means.data(), sum.data(), count);
+			}
+			for (quint64 i = 0; i < count; ++i) {
+				limit[i] = static_cast<float>(sigma) * std::sqrt(sum[i] / weight[i]);
+			}
+
+			bool clipped = false;
+			for (int f = 0; f < frames; ++f) {
+				clipped |= clip(v + f * count, w + f * count, means.data(), limit.data(), count);
+			}
+			if (!clipped)
+				break;
+		}
+
+		mean(v, w, frames, count, dst);
+	}
+}
+
+Stacker::Exception::Exception(const QString& what):
+	::Exception(what) {
+}
+void Stacker::Exception::raise() const {
+	throw *this;
+}
+QException* Stacker::Exception::clone() const {
+	return new Stacker::Exception(*this);
+}
+
+Stacker::ShapeMismatch::ShapeMismatch(int index):
+	Stacker::Exception(QString("Frame %1 differs from the first one by shape").arg(index)) {
+}
+void Stacker::ShapeMismatch::raise() const {
+	throw *this;
+}
+QException* Stacker::ShapeMismatch::clone() const {
+	return new Stacker::ShapeMismatch(*this);
+}
+
+Stacker::Options::Options():
+	method(MeanMethod),
+	sigma(3.0),
+	iterations(5) {
+}
+
+Stacker::Stacker(const std::vector<const FITS::HeaderDataUnit*>& hdus):
+	hdus_(hdus),
+	width_(0),
+	height_(0) {
+
+	if (hdus_.empty())
+		throw Exception("No frames to stack");
+
+	for (int i = 0; i < count(); ++i) {
+		auto image = hdus_[i]->data().imageDataUnit();
+		if (!image)
+			throw ShapeMismatch(i);
+
+		if (i == 0) {
+			width_ = image->width();
+			height_ = image->height();
+		} else if (image->size() != size()) {
+			throw ShapeMismatch(i);
+		}
+	}
+}
+
+std::vector<float> Stacker::stack(const Options& options) const {
+	Tracer::Scope trace_scope("stack", "processing");
+
+	const int frames = count();
+	const quint64 width = width_;
+	std::vector<float> result(width * height_);
+
+	const qint64 row_size = static_cast<qint64>(frames) * width * 2 * sizeof(float);
+	const int band = static_cast<int>(std::max<qint64>(1, band_budget / std::max<qint64>(row_size, 1)));
+
+	parallelFor(height_, band, [&] (int begin, int end) {
+		const quint64 pixels = (end - begin) * width;
+		std::vector<float> values(frames * pixels), weights(frames * pixels);
+
+		for (int f = 0; f < frames; ++f) {
+			float* v = values.data() + f * pixels;
+			convertToPhysical(*hdus_[f], begin * width, pixels, v);
+			maskNaN(v, weights.data() + f * pixels, pixels);
+		}
+
+		float* dst = result.data() + begin * width;
+		switch (options.method) {
+		case MeanMethod:
+			mean(values.data(), weights.data(), frames, pixels, dst);
+			break;
+		case MedianMethod:
+			median(values.data(), weights.data(), frames, pixels, dst);
+			break;
+		case SigmaClipMethod:
+			sigmaClip(values.data(), weights.data(), frames, pixels, options.sigma, options.iterations, dst);
+			break;
+		default:
+			Q_ASSERT(0);
+		}
+	});
+
+	return result;
+}
+
+std::unique_ptr<FITS> Stacker::stackToFITS(const Options& options) const {
+	const auto result = stack(options);
+
+	MemoryFITSStorage::cards_type cards;
+	cards.emplace_back("NCOMBINE", QString::number(count()));
+	cards.emplace_back("COMBTYPE", MemoryFITSStorage::stringValue(QString(methodName(options.method)).toUpper()));
+	if (options.method == SigmaClipMethod)
+		cards.emplace_back("CLIPSIG", QString::number(options.sigma));
+
+	return MemoryFITSStorage::createFloatImage(size(), result.data(), cards);
+}
+
+const char* Stacker::methodName(Method method) {
+	switch (method) {
+	case MeanMethod:
+		return "mean";
+	case MedianMethod:
+		return "median";
+	case SigmaClipMethod:
+		return "sigma-clip";
+	default:
+		Q_ASSERT(0);
+		return "";
+	}
+}
+
+Stacker::Method Stacker::methodFromName(const QString& name) {
+	for (int i = 0; i < MethodCount; ++i) {
+		if (name == methodName(static_cast<Method>(i)))
+			return static_cast<Method>(i);
+	}
+	return MethodCount;
+}
@@ -0,0 +1,53 @@
+#include <stretchwidget.h>
+
+namespace {
+	inline bool hasParameter(int stretch) {
+		return stretch == OpenGLShaderUniforms::LogStretch ||
+			stretch == OpenGLShaderUniforms::AsinhStretch ||
+			stretch == OpenGLShaderUniforms::PowerStretch;
+	}
+}
+
+StretchWidget::StretchWidget(QWidget* parent, const OpenGLWidget& open_gl_widget):
+	QWidget(parent),
+	button_group_(new QButtonGroup(this)),
+	parameter_(new QDoubleSpinBox(this)) {
+
+	for (int i = 0; i < OpenGLShaderUniforms::StretchCount; ++i) {
+		const auto stretch = static_cast<OpenGLShaderUniforms::Stretch>(i);
+		button_group_->addButton(new QRadioButton(tr(OpenGLShaderUniforms::stretchName(stretch)), this), i);
+	}
+	button_group_->buttons()[open_gl_widget.stretch()]->setChecked(true);
+
+	parameter_->setDecimals(3);
+	parameter_->setRange(0.001, 100000.0);
+	parameter_->setValue(open_gl_widget.stretchParameter());
+	parameter_->setEnabled(hasParameter(open_gl_widget.stretch()));
+
+	connect(button_group_.get(), SIGNAL(buttonClicked(int)), this, SLOT(notifyButtonClicked(int)));
+	connect(parameter_.get(), SIGNAL(valueChanged(double)), this, SLOT(notifyParameterChanged(double)));
+
+	std::unique_ptr<QVBoxLayout> widget_layout{new QVBoxLayout(this)};
+	for (auto &button: button_group_->buttons()) {
+		widget_layout->addWidget(button);
+	}
+	widget_layout->addWidget(parameter_.get());
+	widget_layout->addStretch(1);
+	setLayout(widget_layout.release());
+}
+
+void StretchWidget::notifyButtonClicked(int stretch) {
+	const auto parameter = OpenGLShaderUniforms::defaultStretchParameter(static_cast<OpenGLShaderUniforms::Stretch>(stretch));
+
+	parameter_->blockSignals(true);
+	parameter_->setEnabled(hasParameter(stretch));
+	if (hasParameter(stretch))
+		parameter_->setValue(parameter);
+	parameter_->blockSignals(false);
+
+	emit stretchChanged(stretch, parameter);
+}
+
+void StretchWidget::notifyParameterChanged(double parameter) {
+	emit stretchChanged(button_group_->checkedId(), parameter);
+}
@@ -0,0 +1,62 @@
+#include <algorithm>
+#include <limits>
+
+#include <tablemodel.h>
+
+TableModel::TableModel(std::shared_ptr<const FITS::HeaderDataUnit> hdu, QObject* parent):
+	QAbstractTableModel(parent),
+	hdu_(std::move(hdu)),
+	table_(dynamic_cast<const FITS::TableDataUnit*>(&hdu_->data())) {
+
+	Q_ASSERT(table_);
+}
+
+int TableModel::rowCount(const QModelIndex& parent) const {
+	if (parent.isValid())
+		return 0;
+	return static_cast<int>(std::min<quint64>(table_->rows(), std::numeric_limits<int>::max()));
+}
+
+int TableModel::columnCount(const QModelIndex& parent) const {
+	if (parent.isValid())
+		return 0;
+	return static_cast<int>(table_->columns().size());
+}
+
+QVariant TableModel::data(const QModelIndex& index, int role) const {
+	if (!index.isValid())
+		return QVariant();
+
+	switch (role) {
+		case Qt::DisplayRole:
+			return table_->text(index.column(), index.row());
+		case Qt::ToolTipRole:
+			// Longer arrays than the cell shows
+			return table_->text(index.column(), index.row(), 256);
+		case Qt::TextAlignmentRole: {
+			const char type = table_->columns()[index.column()].type;
+			return static_cast<int>((type == 'A' || type == 'X' || type == 'L' ? Qt::AlignLeft : Qt::AlignRight) | Qt::AlignVCenter);
+		}
+		default:
+			return QVariant();
+	}
+}
+
+QVariant TableModel::headerData(int section, Qt::Orientation orientation, int role) const {
+	if (orientation == Qt::Vertical) {
+		// FITS rows are numbered from 1
+		return (role == Qt::DisplayRole ? QVariant(section + 1) : QVariant());
+	}
+
+	const auto& column = table_->columns()[section];
+	switch (role) {
+		case Qt::DisplayRole: {
+			const QString name = (column.name.isEmpty() ? QString("COL%1").arg(section + 1) : column.name);
+			return (column.unit.isEmpty() ? name : QString("%1 [%2]").arg(name, column.unit));
+		}
+		case Qt::ToolTipRole:
+			return QString("TFORM%1 = %2").arg(section + 1).arg(column.format);
+		default:
+			return QVariant();
+	}
+}
@@ -0,0 +1,134 @@
+#include <QDebug>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include <frameprofiler.h>
+#include <texturering.h>
+#include <tracer.h>
+
+class TextureRing::Job: public QRunnable {
+private:
+	std::shared_ptr<const Sequence> sequence_;
+	std::shared_ptr<Shared> shared_;
+	int index_;
+public:
+	Job(std::shared_ptr<const Sequence> sequence, std::shared_ptr<Shared> shared, int index):
+		sequence_(std::move(sequence)),
+		shared_(std::move(shared)),
+		index_(index) {
+	}
+
+	virtual void run() override {
+		{
+			QMutexLocker locker(&shared_->mutex);
+			if (shared_->cancelled)
+				return;
+		}
+
+		Tracer::Scope trace_scope("sequence frame prepare", "sequence");
+
+		try {
+			auto entry = std::make_shared<Entry>();
+			entry->frame = sequence_->open(index_);
+			entry->texture = std::make_shared<OpenGLTexture>(entry->frame.hdu);
+			entry->texture->prepare();
+
+			QMutexLocker locker(&shared_->mutex);
+			if (shared_->cancelled)
+				return;
+			shared_->prepared.emplace_back(index_, std::move(entry));
+			shared_->notify();
+		} catch (const std::exception& e) {
+			qWarning() << "Cannot prepare sequence frame" << index_ << ":" << e.what();
+
+			QMutexLocker locker(&shared_->mutex);
+			if (shared_->cancelled)
+				return;
+			shared_->failed.push_back(index_);
+			shared_->notify();
+		}
+	}
+};
+
+TextureRing::TextureRing(std::shared_ptr<const Sequence> sequence, int capacity, std::function<void()> notify):
+	sequence_(std::move(sequence)),
+	capacity_(qBound(1, capacity, sequence_->size())),
+	shared_(std::make_shared<Shared>()) {
+
+	shared_->cancelled = false;
+	shared_->notify = std::move(notify);
+}
+
+TextureRing::~TextureRing() {
+	QMutexLocker locker(&shared_->mutex);
+	shared_->cancelled = true;
+	shared_->notify = std::function<void()>();
+	// Prepared textures have not been created, so they may be released by
+	// any thread
+	shared_->prepared.clear();
+}
+
+void TextureRing::prefetch(int index, int direction) {
+	const int count = sequence_->size();
+	Q_ASSERT(index >= 0 && index < count);
+
+	window_.clear();
+	for (int i = 0; i < capacity_; ++i) {
+		window_.insert(((index + i * direction) % count + count) % count);
+	}
+
+	for (auto it = entries_.begin(); it != entries_.end(); ) {
+		if (window_.count(it->first)) {
+			++it;
+		} else {
+			it = entries_.erase(it);
+		}
+	}
+
+	for (auto x: window_) {
+		if (entries_.count(x) || pending_.count(x) || failed_.count(x))
+			continue;
+
+		pending_.insert(x);
+		QThreadPool::globalInstance()->start(new Job(sequence_, shared_, x));
+	}
+}
+
+int TextureRing::stage() {
+	decltype(shared_->prepared) prepared;
+	decltype(shared_->failed) failed;
+	{
+		QMutexLocker locker(&shared_->mutex);
+		prepared.swap(shared_->prepared);
+		failed.swap(shared_->failed);
+	}
+
+	for (auto x: failed) {
+		pending_.erase(x);
+		failed_.insert(x);
+	}
+
+	int uploaded = 0;
+	for (auto& x: prepared) {
+		pending_.erase(x.first);
+		// The window has been moved away while the frame was prepared
+		if (!window_.count(x.first))
+			continue;
+
+		{
+			Tracer::Scope trace_scope("sequence frame upload", "sequence");
+			GPUTraceScope gpu_trace_scope("sequence frame upload", "sequence");
+			x.second->texture->upload();
+		}
+		entries_[x.first] = std::move(x.second);
+		++uploaded;
+	}
+
+	return uploaded;
+}
+
+std::shared_ptr<const TextureRing::Entry> TextureRing::frame(int index) const {
+	auto it = entries_.find(index);
+	return (it != entries_.end() ? it->second : std::shared_ptr<const Entry>());
+}
@@ -0,0 +1,924 @@
+#include <QDebug>
+#include <QRegExp>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include <zlib.h>
+
+#include <parallel.h>
+#include <tilecompressedimage.h>
+#include <tracer.h>
+
+namespace {
+	const int random_count = 10000;
+	const qint64 zero_value = -2147483646;
+
+	/* Uniform random numbers of the quantization dither, the same sequence
+	 * as fits_init_randoms() of CFITSIO generates */
+	const std::vector<float>& randomValues() {
+		static const std::vector<float> values = [] () {
+			std::vector<float> values(random_count);
+			const double a = 16807.0, m = 2147483647.0;
+			double seed = 1.0;
+			for (auto& value: values) {
+				const double temp = a * seed;
+				seed = temp - m * static_cast<int>(temp / m);
+				value = static_cast<float>(seed / m);
+			}
+			return values;
+		}();
+		return values;
+	}
+
+	std::vector<quint8> inflateTile(const quint8* data, quint64 size, quint64 length) {
+		std::vector<quint8> out(length);
+
+		z_stream strm;
+		std::memset(&strm, 0, sizeof(strm));
+		// Either zlib or gzip format
+		if (inflateInit2(&strm, 15 + 32) != Z_OK)
+			throw TileCompressedImage::Exception("Cannot initialize zlib");
+
+		strm.next_in = const_cast<Bytef*>(data);
+		strm.avail_in = static_cast<uInt>(size);
+		strm.next_out = out.data();
+		strm.avail_out = static_cast<uInt>(length);
+		const int ret = inflate(&strm, Z_FINISH);
+		const auto total = strm.total_out;
+		inflateEnd(&strm);
+
+		if (ret != Z_STREAM_END || total != length)
+			throw TileCompressedImage::Exception("The gzip tile is corrupted");
+		return out;
+	}
+
+	// Inverse of GZIP_2 shuffling, which stores the first bytes of all the pixels first
+	std::vector<quint8> unshuffle(const std::vector<quint8>& shuffled, int bytes) {
+		std::vector<quint8> out(shuffled.size());
+		const std::size_t pixels = shuffled.size() / bytes;
+		for (int byte = 0; byte < bytes; ++byte) {
+			const quint8* in = shuffled.data() + byte * pixels;
+			for (std::size_t i = 0; i < pixels; ++i) {
+				out[i * bytes + byte] = in[i];
+			}
+		}
+		return out;
+	}
+
+	std::vector<qint64> bigEndianValues(const std::vector<quint8>& data, int bytes, bool is_unsigned) {
+		std::vector<qint64> values(data.size() / bytes);
+		for (std::size_t i = 0; i < values.size(); ++i) {
+			const quint64 value = FITS::TableDataUnit::readBigEndian(data.data() + i * bytes, bytes);
+			if (is_unsigned || bytes == 8) {
+				values[i] = static_cast<qint64>(value);
+			} else {
+				const int shift = 64 - 8 * bytes;
+				values[i] = static_cast<qint64>(value << shift) >> shift;
+			}
+		}
+		return values;
+	}
+
+	/* Rice decoding of fits_rdecomp() of CFITSIO: blocks of block_size
+	 * differences, each with its own split position fs. Pixels of bytes
+	 * width, which are unsigned for bytes = 1. */
+	std::vector<qint64> riceDecode(const quint8* in, quint64 size, quint64 pixels, int block_size, int bytes) {
+		int fs_bits, fs_max;
+		switch (bytes) {
+			case 1: fs_bits = 3; fs_max = 6; break;
+			case 2: fs_bits = 4; fs_max = 14; break;
+			case 4: fs_bits = 5; fs_max = 25; break;
+			default: throw TileCompressedImage::Exception(QString("Unsupported RICE_1 BYTEPIX %1").arg(bytes));
+		}
+		const int b_bits = 1 << fs_bits;
+		const quint32 mask = (bytes == 4 ? 0xffffffffu : (1u << (8 * bytes)) - 1);
+
+		const quint8* end = in + size;
+		auto next = [&in, end] () -> quint32 {
+			if (in >= end)
+				throw TileCompressedImage::Exception("The RICE_1 tile is truncated");
+			return *in++;
+		};
+
+		std::vector<qint64> values(pixels);
+		if (size < static_cast<quint64>(bytes) + 1)
+			throw TileCompressedImage::Exception("The RICE_1 tile is truncated");
+
+		// The first pixel is stored as is
+		quint32 last = static_cast<quint32>(FITS::TableDataUnit::readBigEndian(in, bytes));
+		in += bytes;
+
+		quint32 b = next();
+		int nbits = 8;
+		auto output = [&values, &last, mask] (quint64 i, quint32 diff) {
+			// Undo the mapping of the signed differences
+			diff = ((diff & 1) == 0 ? diff >> 1 : ~(diff >> 1));
+			last = (diff + last) & mask;
+			values[i] = last;
+		};
+
+		for (quint64 i = 0; i < pixels; ) {
+			nbits -= fs_bits;
+			while (nbits < 0) {
+				b = (b << 8) | next();
+				nbits += 8;
+			}
+			const int fs = static_cast<int>(b >> nbits) - 1;
+			b &= (1u << nbits) - 1;
+
+			const quint64 block_end = std::min<quint64>(i + block_size, pixels);
+			if (fs < 0) {
+				// All the differences are zero
+				for (; i < block_end; ++i) {
+					values[i] = last;
+				}
+			} else if (fs == fs_max) {
+				// Differences stored directly
+				for (; i < block_end; ++i) {
+					int k = b_bits - nbits;
+					quint32 diff = (k < 32 ? b << k : 0);
+					for (k -= 8; k >= 0; k -= 8) {
+						b = next();
+						diff |= b << k;
+					}
+					if (nbits > 0) {
+						b = next();
+						diff |= b >> (-k);
+						b &= (1u << nbits) - 1;
+					} else {
+						b = 0;
+					}
+					output(i, diff);
+				}
+			} else {
+				for (; i < block_end; ++i) {
+					// Unary coded high bits
+					while (b == 0) {
+						nbits += 8;
+						b = next();
+					}
+					int width = 0;
+					for (quint32 x = b; x; x >>= 1) {
+						++width;
+					}
+					const int nzero = nbits - width;
+					nbits -= nzero + 1;
+					b ^= 1u << nbits;
+
+					nbits -= fs;
+					while (nbits < 0) {
+						b = (b << 8) | next();
+						nbits += 8;
+					}
+					output(i, (static_cast<quint32>(nzero) << fs) | (b >> nbits));
+					b &= (1u << nbits) - 1;
+				}
+			}
+		}
+
+		// Pixels wider than byte are signed
+		if (bytes > 1) {
+			const int shift = 64 - 8 * bytes;
+			for (auto& value: values) {
+				value = static_cast<qint64>(static_cast<quint64>(value) << shift) >> shift;
+			}
+		}
+		return values;
+	}
+
+	/* H-transform decoding of fits_hdecompress64() of CFITSIO, without
+	 * smoothing. The bit planes of the four quadrants of the transform are
+	 * quadtree-coded. */
+	class Hdecoder {
+	private:
+		const quint8* in_;
+		quint64 size_;
+		quint64 next_;
+		quint32 buffer_;
+		int bits_to_go_;
+
+		quint32 byte() {
+			if (next_ >= size_)
+				throw TileCompressedImage::Exception("The HCOMPRESS_1 tile is truncated");
+			return in_[next_++];
+		}
+		quint64 bytes(int count) {
+			quint64 value = 0;
+			for (int i = 0; i < count; ++i) {
+				value = (value << 8) | byte();
+			}
+			return value;
+		}
+
+		void startBits() {
+			bits_to_go_ = 0;
+		}
+		int bit() {
+			if (bits_to_go_ == 0) {
+				buffer_ = byte();
+				bits_to_go_ = 8;
+			}
+			--bits_to_go_;
+			return (buffer_ >> bits_to_go_) & 1;
+		}
+		int bits(int n) {
+			if (bits_to_go_ < n) {
+				buffer_ = (buffer_ << 8) | byte();
+				bits_to_go_ += 8;
+			}
+			bits_to_go_ -= n;
+			return (buffer_ >> bits_to_go_) & ((1 << n) - 1);
+		}
+		int nybble() {
+			return bits(4);
+		}
+		int huffman() {
+			int c = bits(3);
+			if (c < 4)
+				return 1 << c;
+
+			c = bit() | (c << 1);
+			switch (c) {
+				case 8: return 3;
+				case 9: return 5;
+				case 10: return 10;
+				case 11: return 12;
+				case 12: return 15;
+			}
+
+			c = bit() | (c << 1);
+			switch (c) {
+				case 26: return 6;
+				case 27: return 7;
+				case 28: return 9;
+				case 29: return 11;
+				case 30: return 13;
+			}
+
+			c = bit() | (c << 1);
+			return (c == 62 ? 0 : 14);
+		}
+
+		static int log2Ceil(int n) {
+			if (n <= 1)
+				return 0;
+			int log2n = static_cast<int>(std::log(static_cast<float>(n)) / std::log(2.0) + 0.5);
+			if (n > (1 << log2n))
+				++log2n;
+			return log2n;
+		}
+
+		/* Expands the 4-bit values of a[(nx+1)/2][(ny+1)/2] to 2x2 blocks of
+		 * single bits in b[nx][n], a and b may be the same */
+		static void copy(quint8* a, int nx, int ny, quint8* b, int n) {
+			const int nx2 = (nx + 1) / 2, ny2 = (ny + 1) / 2;
+			int k = ny2 * (nx2 - 1) + ny2 - 1;
+			for (int i = nx2 - 1; i >= 0; --i) {
+				int s00 = 2 * (n * i + ny2 - 1);
+				for (int j = ny2 - 1; j >= 0; --j) {
+					b[s00] = a[k];
+					--k;
+					s00 -= 2;
+				}
+			}
+
+			int i = 0;
+			for (; i < nx - 1; i += 2) {
+				int s00 = n * i, s10 = s00 + n;
+				int j = 0;
+				for (; j < ny - 1; j += 2) {
+					const quint8 v = b[s00];
+					b[s10 + 1] = v & 1;
+					b[s10] = (v >> 1) & 1;
+					b[s00 + 1] = (v >> 2) & 1;
+					b[s00] = (v >> 3) & 1;
+					s00 += 2;
+					s10 += 2;
+				}
+				if (j < ny) {
+					b[s10] = (b[s00] >> 1) & 1;
+					b[s00] = (b[s00] >> 3) & 1;
+				}
+			}
+			if (i < nx) {
+				int s00 = n * i;
+				int j = 0;
+				for (; j < ny - 1; j += 2) {
+					b[s00 + 1] = (b[s00] >> 2) & 1;
+					b[s00] = (b[s00] >> 3) & 1;
+					s00 += 2;
+				}
+				if (j < ny)
+					b[s00] = (b[s00] >> 3) & 1;
+			}
+		}
+
+		// Inserts the 2x2 blocks of a[(nx+1)/2][(ny+1)/2] into bit plane of b[nx][n]
+		static void bitins(const quint8* a, int nx, int ny, qint64* b, int n, int bit) {
+			const qint64 plane = Q_INT64_C(1) << bit;
+			int k = 0, i = 0;
+			for (; i < nx - 1; i += 2) {
+				int s00 = n * i;
+				int j = 0;
+				for (; j < ny - 1; j += 2) {
+					const quint8 v = a[k++];
+					if (v & 8) b[s00] |= plane;
+					if (v & 4) b[s00 + 1] |= plane;
+					if (v & 2) b[s00 + n] |= plane;
+					if (v & 1) b[s00 + n + 1] |= plane;
+					s00 += 2;
+				}
+				if (j < ny) {
+					const quint8 v = a[k++];
+					if (v & 8) b[s00] |= plane;
+					if (v & 2) b[s00 + n] |= plane;
+				}
+			}
+			if (i < nx) {
+				int s00 = n * i;
+				int j = 0;
+				for (; j < ny - 1; j += 2) {
+					const quint8 v = a[k++];
+					if (v & 8) b[s00] |= plane;
+					if (v & 4) b[s00 + 1] |= plane;
+					s00 += 2;
+				}
+				if (j < ny) {
+					const quint8 v = a[k++];
+					if (v & 8) b[s00] |= plane;
+				}
+			}
+		}
+
+		void quadtree(qint64* a, int n, int nqx, int nqy, int planes) {
+			const int log2n = log2Ceil(std::max(nqx, nqy));
+			const int count = ((nqx + 1) / 2) * ((nqy + 1) / 2);
+			std::vector<quint8> scratch(std::max(count, 1));
+
+			for (int bit = planes - 1; bit >= 0; --bit) {
+				const int format = nybble();
+				if (format == 0) {
+					// Bit plane written directly, 4 pixels in a nybble
+					for (int i = 0; i < count; ++i) {
+						scratch[i] = static_cast<quint8>(nybble());
+					}
+				} else if (format == 0xf) {
+					scratch[0] = static_cast<quint8>(huffman());
+					int nx = 1, ny = 1, nfx = nqx, nfy = nqy, c = 1 << log2n;
+					for (int k = 1; k < log2n; ++k) {
+						c >>= 1;
+						nx <<= 1;
+						ny <<= 1;
+						if (nfx <= c) { --nx; } else { nfx -= c; }
+						if (nfy <= c) { --ny; } else { nfy -= c; }
+
+						copy(scratch.data(), nx, ny, scratch.data(), ny);
+						for (int i = nx * ny - 1; i >= 0; --i) {
+							if (scratch[i])
+								scratch[i] = static_cast<quint8>(huffman());
+						}
+					}
+				} else {
+					throw TileCompressedImage::Exception("The HCOMPRESS_1 tile has wrong quadtree format");
+				}
+				bitins(scratch.data(), nqx, nqy, a, n, bit);
+			}
+		}
+
+		static void unshuffle(qint64* a, int n, int n2, qint64* tmp) {
+			const int nhalf = (n + 1) >> 1;
+			for (int i = nhalf; i < n; ++i) {
+				tmp[i - nhalf] = a[n2 * i];
+			}
+			for (int i = nhalf - 1; i >= 0; --i) {
+				a[2 * n2 * i] = a[n2 * i];
+			}
+			for (int i = 1, k = 0; i < n; i += 2, ++k) {
+				a[n2 * i] = tmp[k];
+			}
+		}
+
+		// Inverse H-transform of a[nx][ny]
+		static void inverse(qint64* a, int nx, int ny) {
+			const int nmax = std::max(nx, ny);
+			const int log2n = log2Ceil(nmax);
+			// Single pixel is not transformed
+			if (log2n == 0)
+				return;
+			std::vector<qint64> tmp((nmax + 1) / 2);
+
+			int shift = 1;
+			qint64 bit0 = Q_INT64_C(1) << (log2n - 1);
+			qint64 bit1 = bit0 << 1, bit2 = bit0 << 2;
+			qint64 mask0 = -bit0, mask1 = mask0 * 2, mask2 = mask0 * 4;
+			qint64 prnd0 = bit0 >> 1, prnd1 = bit1 >> 1, prnd2 = bit2 >> 1;
+			qint64 nrnd0 = prnd0 - 1, nrnd1 = prnd1 - 1, nrnd2 = prnd2 - 1;
+
+			a[0] = (a[0] + (a[0] >= 0 ? prnd2 : nrnd2)) & mask2;
+
+			int nxtop = 1, nytop = 1, nxf = nx, nyf = ny, c = 1 << log2n;
+			for (int k = log2n - 1; k >= 0; --k) {
+				c >>= 1;
+				nxtop <<= 1;
+				nytop <<= 1;
+				if (nxf <= c) { --nxtop; } else { nxf -= c; }
+				if (nyf <= c) { --nytop; } else { nyf -= c; }
+
+				if (k == 0) {
+					nrnd0 = 0;
+					shift = 2;
+				}
+
+				for (int i = 0; i < nxtop; ++i) {
+					unshuffle(a + ny * i, nytop, 1, tmp.data());
+				}
+				for (int j = 0; j < nytop; ++j) {
+					unshuffle(a + j, nxtop, ny, tmp.data());
+				}
+
+				const int oddx = nxtop % 2, oddy = nytop % 2;
+				int i = 0;
+				for (; i < nxtop - oddx; i += 2) {
+					int s00 = ny * i, s10 = s00 + ny;
+					for (int j = 0; j < nytop - oddy; j += 2) {
+						qint64 h0 = a[s00], hx = a[s10], hy = a[s00 + 1], hc = a[s10 + 1];
+
+						hx = (hx + (hx >= 0 ? prnd1 : nrnd1)) & mask1;
+						hy = (hy + (hy >= 0 ? prnd1 : nrnd1)) & mask1;
+						hc = (hc + (hc >= 0 ? prnd0 : nrnd0)) & mask0;
+
+						const qint64 lowbit0 = hc & bit0;
+						hx = (hx >= 0 ? hx - lowbit0 : hx + lowbit0);
+						hy = (hy >= 0 ? hy - lowbit0 : hy + lowbit0);
+
+						const qint64 lowbit1 = (hc ^ hx ^ hy) & bit1;
+						h0 = (h0 >= 0 ? h0 + lowbit0 - lowbit1 : h0 + (lowbit0 == 0 ? lowbit1 : lowbit0 - lowbit1));
+
+						a[s10 + 1] = (h0 + hx + hy + hc) >> shift;
+						a[s10] = (h0 + hx - hy - hc) >> shift;
+						a[s00 + 1] = (h0 - hx + hy - hc) >> shift;
+						a[s00] = (h0 - hx - hy + hc) >> shift;
+						s00 += 2;
+						s10 += 2;
+					}
+					if (oddy) {
+						qint64 h0 = a[s00], hx = a[s10];
+						hx = (hx + (hx >= 0 ? prnd1 : nrnd1)) & mask1;
+						const qint64 lowbit1 = hx & bit1;
+						h0 = (h0 >= 0 ? h0 - lowbit1 : h0 + lowbit1);
+						a[s10] = (h0 + hx) >> shift;
+						a[s00] = (h0 - hx) >> shift;
+					}
+				}
+				if (oddx) {
+					int s00 = ny * i;
+					for (int j = 0; j < nytop - oddy; j += 2) {
+						qint64 h0 = a[s00], hy = a[s00 + 1];
+						hy = (hy + (hy >= 0 ? prnd1 : nrnd1)) & mask1;
+						const qint64 lowbit1 = hy & bit1;
+						h0 = (h0 >= 0 ? h0 - lowbit1 : h0 + lowbit1);
+						a[s00 + 1] = (h0 + hy) >> shift;
+						a[s00] = (h0 - hy) >> shift;
+						s00 += 2;
+					}
+					if (oddy)
+						a[s00] = a[s00] >> shift;
+				}
+
+				bit2 = bit1;
+				bit1 = bit0;
+				bit0 >>= 1;
+				mask1 = mask0;
+				mask0 >>= 1;
+				prnd1 = prnd0;
+				prnd0 >>= 1;
+				nrnd1 = nrnd0;
+				nrnd0 = prnd0 - 1;
+			}
+		}
+	public:
+		Hdecoder(const quint8* in, quint64 size): in_(in), size_(size), next_(0), buffer_(0), bits_to_go_(0) {}
+
+		std::vector<qint64> decode(quint64 pixels) {
+			if (bytes(2) != 0xdd99)
+				throw TileCompressedImage::Exception("The HCOMPRESS_1 tile has wrong magic");
+			const int nx = static_cast<qint32>(bytes(4));
+			const int ny = static_cast<qint32>(bytes(4));
+			const int scale = static_cast<qint32>(bytes(4));
+			if (nx <= 0 || ny <= 0 || static_cast<quint64>(nx) * ny != pixels)
+				throw TileCompressedImage::Exception("The HCOMPRESS_1 tile has wrong size");
+			const qint64 sum = static_cast<qint64>(bytes(8));
+			int planes[3];
+			for (auto& p: planes) {
+				p = static_cast<int>(byte());
+				if (p > 62)
+					throw TileCompressedImage::Exception("The HCOMPRESS_1 tile has wrong bit planes");
+			}
+
+			std::vector<qint64> a(pixels, 0);
+			const int nx2 = (nx + 1) / 2, ny2 = (ny + 1) / 2;
+			startBits();
+			quadtree(&a[0], ny, nx2, ny2, planes[0]);
+			quadtree(&a[ny2], ny, nx2, ny / 2, planes[1]);
+			quadtree(&a[ny * nx2], ny, nx / 2, ny2, planes[1]);
+			quadtree(&a[ny * nx2 + ny2], ny, nx / 2, ny / 2, planes[2]);
+			if (nybble() != 0)
+				throw TileCompressedImage::Exception("The HCOMPRESS_1 tile has wrong bit planes");
+
+			// Signs of the nonzero coefficients
+			startBits();
+			for (auto& value: a) {
+				if (value && bit())
+					value = -value;
+			}
+			a[0] = sum;
+
+			if (scale > 1) {
+				for (auto& value: a) {
+					value = static_cast<qint64>(static_cast<quint64>(value) * static_cast<quint64>(scale));
+				}
+			}
+			inverse(a.data(), nx, ny);
+			return a;
+		}
+	};
+}
+
+TileCompressedImage::Exception::Exception(const QString& what): FITS::Exception(what) {
+}
+void TileCompressedImage::Exception::raise() const {
+	throw *this;
+}
+QException* TileCompressedImage::Exception::clone() const {
+	return new TileCompressedImage::Exception(*this);
+}
+
+TileCompressedImage::TileCompressedImage(const FITS::HeaderUnit& header, const quint8* table, quint64 extent):
+	table_(table),
+	scale_(header.header_as<double>("ZSCALE", 1.0)),
+	zero_(header.header_as<double>("ZZERO", 0.0)),
+	has_blank_(header.header("ZBLANK", QString()) != QString()),
+	blank_(header.header_as<qint64>("ZBLANK", 0)),
+	dither_seed_(header.header_as<qint64>("ZDITHER0", 1)) {
+
+	bool ok = false;
+	row_length_ = header.header("NAXIS1").toULongLong(&ok);
+	if (!ok)
+		throw FITS::WrongHeaderValue("NAXIS1", header.header("NAXIS1"));
+	const quint64 rows = header.header("NAXIS2").toULongLong(&ok);
+	if (!ok)
+		throw FITS::WrongHeaderValue("NAXIS2", header.header("NAXIS2"));
+	const quint64 heap_offset = header.header_as<quint64>("THEAP", row_length_ * rows);
+	if (heap_offset > extent || row_length_ * rows > extent)
+		throw FITS::UnexpectedEnd();
+	heap_ = table_ + heap_offset;
+	heap_size_ = extent - heap_offset;
+
+	bitpix_ = header.header("ZBITPIX").toInt(&ok);
+	if (!ok || (bitpix_ != 8 && bitpix_ != 16 && bitpix_ != 32 && bitpix_ != 64 && bitpix_ != -32 && bitpix_ != -64))
+		throw FITS::UnsupportedBitpix(header.header("ZBITPIX"));
+
+	const int naxis = header.header("ZNAXIS").toInt(&ok);
+	if (!ok || (naxis != 2 && naxis != 3))
+		throw FITS::WrongHeaderValue("ZNAXIS", header.header("ZNAXIS"));
+	for (int i = 0; i < 3; ++i) {
+		const QString n = QString::number(i + 1);
+		axes_[i] = 1;
+		if (i < naxis) {
+			axes_[i] = header.header("ZNAXIS" + n).toULongLong(&ok);
+			if (!ok)
+				throw FITS::WrongHeaderValue("ZNAXIS" + n, header.header("ZNAXIS" + n));
+		}
+		// Rows by default
+		tile_[i] = header.header_as<quint64>("ZTILE" + n, i == 0 ? axes_[0] : 1);
+		if (tile_[i] == 0 && axes_[i] != 0)
+			throw FITS::WrongHeaderValue("ZTILE" + n, header.header("ZTILE" + n));
+		tiles_[i] = (axes_[i] ? (axes_[i] - 1) / tile_[i] + 1 : 0);
+	}
+	if (tileCount() > rows)
+		throw Exception("The table has fewer rows than tiles");
+
+	const QString type = FITS::HeaderUnit::unquoted(header.header("ZCMPTYPE"));
+	if (type == "RICE_1" || type == "RICE_ONE") {
+		compression_ = Compression::Rice;
+	} else if (type == "GZIP_1") {
+		compression_ = Compression::Gzip1;
+	} else if (type == "GZIP_2") {
+		compression_ = Compression::Gzip2;
+	} else if (type == "HCOMPRESS_1") {
+		compression_ = Compression::Hcompress;
+	} else if (type == "NOCOMPRESS") {
+		compression_ = Compression::None;
+	} else {
+		throw Exception("Unsupported tile compression " + type);
+	}
+
+	// Columns
+	const int fields = header.header_as<int>("TFIELDS", 0);
+	Column* columns[] = {&compressed_data_, &gzip_compressed_data_, &uncompressed_data_, &zscale_, &zzero_, &zblank_};
+	const char* names[] = {"COMPRESSED_DATA", "GZIP_COMPRESSED_DATA", "UNCOMPRESSED_DATA", "ZSCALE", "ZZERO", "ZBLANK"};
+	for (auto column: columns) {
+		*column = Column{-1, 0, 0};
+	}
+	const QRegExp tform("^(\\d*)([LXBIJKAEDCMPQ])([LXBIJKAEDCM]?)");
+	quint64 offset = 0;
+	for (int i = 1; i <= fields; ++i) {
+		const QString n = QString::number(i);
+		const QString form = FITS::HeaderUnit::unquoted(header.header("TFORM" + n));
+		if (tform.indexIn(form) == -1)
+			throw FITS::WrongHeaderValue("TFORM" + n, form);
+
+		const quint64 repeat = (tform.cap(1).isEmpty() ? 1 : tform.cap(1).toULongLong());
+		const char code = tform.cap(2).at(0).toLatin1();
+		// Element type of variable-length arrays
+		const char element = (tform.cap(3).isEmpty() ? 0 : tform.cap(3).at(0).toLatin1());
+		const QString name = FITS::HeaderUnit::unquoted(header.header("TTYPE" + n, QString())).toUpper();
+		for (int c = 0; c < 6; ++c) {
+			if (name == names[c] && repeat == 1)
+				*columns[c] = Column{static_cast<int>(offset), code, element};
+		}
+		offset += (code == 'X' ? (repeat + 7) / 8 : repeat * FITS::TableDataUnit::elementSize(code));
+	}
+	if (offset > row_length_)
+		throw FITS::WrongHeaderValue("NAXIS1", header.header("NAXIS1"));
+	for (auto column: {&compressed_data_, &gzip_compressed_data_, &uncompressed_data_}) {
+		if (column->offset >= 0 && ((column->type != 'P' && column->type != 'Q') || column->element == 'X' || FITS::TableDataUnit::elementSize(column->element) == 0))
+			throw Exception("Tile data column is not a variable-length array");
+	}
+	for (auto column: {&zscale_, &zzero_, &zblank_}) {
+		if (column->offset >= 0 && column->type != 'D' && column->type != 'E' && column->type != 'J' && column->type != 'K')
+			throw Exception("Unsupported type of tile parameter column");
+	}
+	if (compressed_data_.offset < 0 && uncompressed_data_.offset < 0)
+		throw Exception("The table has no COMPRESSED_DATA column");
+	if (zblank_.offset >= 0)
+		has_blank_ = true;
+
+	// Floating point images are usually quantized to integers
+	const bool quantized = bitpix_ < 0 && (zscale_.offset >= 0 || header.header("ZSCALE", QString()) != QString());
+	const QString method = FITS::HeaderUnit::unquoted(header.header("ZQUANTIZ", QString()));
+	if (!quantized) {
+		quantization_ = Quantization::None;
+	} else if (method == "SUBTRACTIVE_DITHER_1") {
+		quantization_ = Quantization::SubtractiveDither1;
+	} else if (method == "SUBTRACTIVE_DITHER_2") {
+		quantization_ = Quantization::SubtractiveDither2;
+	} else {
+		quantization_ = Quantization::NoDither;
+	}
+
+	// Compression parameters
+	block_size_ = 32;
+	bytepix_ = (quantized ? 4 : std::abs(bitpix_) / 8);
+	for (int i = 1; header.header("ZNAME" + QString::number(i), QString()) != QString(); ++i) {
+		const QString n = QString::number(i);
+		const QString name = FITS::HeaderUnit::unquoted(header.header("ZNAME" + n)).toUpper();
+		if (name == "BLOCKSIZE") {
+			block_size_ = header.header_as<int>("ZVAL" + n, block_size_);
+		} else if (name == "BYTEPIX") {
+			bytepix_ = header.header_as<int>("ZVAL" + n, bytepix_);
+		}
+	}
+	if (block_size_ <= 0)
+		throw Exception("Wrong RICE_1 block size");
+	if (compression_ == Compression::Rice && bytepix_ != 1 && bytepix_ != 2 && bytepix_ != 4)
+		throw Exception(QString("Unsupported RICE_1 BYTEPIX %1").arg(bytepix_));
+	if (compression_ == Compression::Hcompress && tile_[2] > 1 && tile_[1] > 1)
+		throw Exception("HCOMPRESS_1 tiles must be two-dimensional");
+}
+
+TileCompressedImage::~TileCompressedImage() = default;
+
+quint64 TileCompressedImage::length() const {
+	return axes_[0] * axes_[1] * axes_[2] * (std::abs(bitpix_) / 8);
+}
+
+const quint8* TileCompressedImage::heapData(const Column& column, quint64 row, quint64* size) const {
+	*size = 0;
+	if (column.offset < 0)
+		return nullptr;
+
+	const quint8* descriptor = table_ + row * row_length_ + column.offset;
+	const int bytes = (column.type == 'P' ? 4 : 8);
+	const quint64 count = FITS::TableDataUnit::readBigEndian(descriptor, bytes) * FITS::TableDataUnit::elementSize(column.element);
+	const quint64 offset = FITS::TableDataUnit::readBigEndian(descriptor + bytes, bytes);
+	if (offset > heap_size_ || count > heap_size_ - offset)
+		throw Exception("Tile data is out of the heap");
+
+	*size = count;
+	return heap_ + offset;
+}
+
+double TileCompressedImage::doubleValue(const Column& column, quint64 row, double def) const {
+	if (column.offset < 0)
+		return def;
+
+	const quint8* field = table_ + row * row_length_ + column.offset;
+	switch (column.type) {
+		case 'D': {
+			const quint64 bits = FITS::TableDataUnit::readBigEndian(field, 8);
+			double value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+		case 'E': {
+			const quint32 bits = static_cast<quint32>(FITS::TableDataUnit::readBigEndian(field, 4));
+			float value;
+			std::memcpy(&value, &bits, sizeof(value));
+			return value;
+		}
+		case 'J':
+			return static_cast<qint32>(FITS::TableDataUnit::readBigEndian(field, 4));
+		default:
+			return static_cast<double>(static_cast<qint64>(FITS::TableDataUnit::readBigEndian(field, 8)));
+	}
+}
+
+std::vector<qint64> TileCompressedImage::decompress(const quint8* data, quint64 size, quint64 pixels) const {
+	switch (compression_) {
+		case Compression::Rice:
+			return riceDecode(data, size, pixels, block_size_, bytepix_);
+		case Compression::Hcompress:
+			return Hdecoder(data, size).decode(pixels);
+		default: {
+			const int bytes = (quantization_ != Quantization::None ? 4 : std::abs(bitpix_) / 8);
+			auto raw = inflateTile(data, size, pixels * bytes);
+			if (compression_ == Compression::Gzip2)
+				raw = unshuffle(raw, bytes);
+			return bigEndianValues(raw, bytes, bitpix_ == 8);
+		}
+	}
+}
+
+quint64 TileCompressedImage::tileSize(quint64 row, quint64* origin, quint64* extent) const {
+	quint64 index = row, pixels = 1;
+	for (int i = 0; i < 3; ++i) {
+		origin[i] = (index % tiles_[i]) * tile_[i];
+		extent[i] = std::min(tile_[i], axes_[i] - origin[i]);
+		index /= tiles_[i];
+		pixels *= extent[i];
+	}
+	return pixels;
+}
+
+void TileCompressedImage::store(quint64 row, const std::vector<qint64>& values, quint8* tile) const {
+	const int bytes = std::abs(bitpix_) / 8;
+
+	if (quantization_ == Quantization::None) {
+		for (std::size_t i = 0; i < values.size(); ++i) {
+			const quint64 value = static_cast<quint64>(values[i]);
+			for (int byte = 0; byte < bytes; ++byte) {
+				tile[i * bytes + byte] = static_cast<quint8>(value >> (8 * (bytes - 1 - byte)));
+			}
+		}
+		return;
+	}
+
+	const double scale = doubleValue(zscale_, row, scale_);
+	const double zero = doubleValue(zzero_, row, zero_);
+	const bool has_blank = has_blank_;
+	const qint64 blank = static_cast<qint64>(doubleValue(zblank_, row, static_cast<double>(blank_)));
+	const bool dither = (quantization_ != Quantization::NoDither);
+
+	const auto& random = randomValues();
+	int seed = static_cast<int>((row + dither_seed_ - 1) % random_count);
+	int next = static_cast<int>(random[seed] * 500);
+
+	for (std::size_t i = 0; i < values.size(); ++i) {
+		double value;
+		if (has_blank && values[i] == blank) {
+			value = std::numeric_limits<double>::quiet_NaN();
+		} else if (!dither) {
+			value = static_cast<double>(values[i]) * scale + zero;
+		} else if (quantization_ == Quantization::SubtractiveDither2 && values[i] == zero_value) {
+			value = 0.0;
+		} else {
+			value = (static_cast<double>(values[i]) - random[next] + 0.5) * scale + zero;
+		}
+
+		if (dither && ++next == random_count) {
+			seed = (seed + 1) % random_count;
+			next = static_cast<int>(random[seed] * 500);
+		}
+
+		if (bitpix_ == -32) {
+			const float x = static_cast<float>(value);
+			quint32 bits;
+			std::memcpy(&bits, &x, sizeof(bits));
+			qToBigEndian(bits, tile + i * 4);
+		} else {
+			quint64 bits;
+			std::memcpy(&bits, &value, sizeof(bits));
+			qToBigEndian(bits, tile + i * 8);
+		}
+	}
+}
+
+void TileCompressedImage::decodeTile(quint64 row, quint8* image) const {
+	quint64 origin[3], extent[3];
+	const quint64 pixels = tileSize(row, origin, extent);
+	const int bytes = std::abs(bitpix_) / 8;
+
+	std::vector<quint8> tile;
+	quint64 size;
+	const quint8* data = heapData(compressed_data_, row, &size);
+	if (size == 0) {
+		// Tile which could not be compressed or quantized is stored in the other columns
+		quint64 gzip_size, raw_size;
+		const quint8* gzip = heapData(gzip_compressed_data_, row, &gzip_size);
+		const quint8* raw = heapData(uncompressed_data_, row, &raw_size);
+		if (gzip_size) {
+			tile = inflateTile(gzip, gzip_size, pixels * bytes);
+		} else if (raw_size == pixels * bytes) {
+			tile.assign(raw, raw + raw_size);
+		} else {
+			throw Exception("The tile has no data");
+		}
+	} else if (compression_ == Compression::None) {
+		if (size != pixels * bytes)
+			throw Exception("Uncompressed tile has wrong size");
+		tile.assign(data, data + size);
+	} else if (quantization_ == Quantization::None && (compression_ == Compression::Gzip1 || compression_ == Compression::Gzip2)) {
+		// Pixels are gzipped as they are stored in images
+		tile = inflateTile(data, size, pixels * bytes);
+		if (compression_ == Compression::Gzip2)
+			tile = unshuffle(tile, bytes);
+	} else {
+		tile.resize(pixels * bytes);
+		store(row, decompress(data, size, pixels), tile.data());
+	}
+
+	const quint8* in = tile.data();
+	for (quint64 z = 0; z < extent[2]; ++z) {
+		for (quint64 y = 0; y < extent[1]; ++y) {
+			const quint64 offset = ((origin[2] + z) * axes_[1] + origin[1] + y) * axes_[0] + origin[0];
+			std::memcpy(image + offset * bytes, in, extent[0] * bytes);
+			in += extent[0] * bytes;
+		}
+	}
+}
+
+const quint8* TileCompressedImage::data() const {
+	std::call_once(decoded_, [this] () {
+		Tracer::Scope trace_scope("tile decompression", "startup");
+
+		data_.reset(new quint8[length()]());
+		quint8* image = data_.get();
+		parallelFor(static_cast<int>(tileCount()), 1, [this, image] (int begin, int end) {
+			for (int row = begin; row < end; ++row) {
+				try {
+					decodeTile(row, image);
+				} catch (const ::Exception& e) {
+					qWarning() << "Cannot decode tile" << row << ":" << e.what();
+				}
+			}
+		});
+	});
+	return data_.get();
+}
+
+bool TileCompressedImage::isTileCompressed(const FITS::HeaderUnit& header) {
+	return FITS::HeaderUnit::unquoted(header.header("XTENSION", QString())) == "BINTABLE" && header.header("ZIMAGE", QString()) == "T";
+}
+
+std::map<QString, QString> TileCompressedImage::imageHeaders(const FITS::HeaderUnit& header) {
+	auto headers = header.headers();
+
+	// Keywords of the table
+	for (const auto& key: {"TFIELDS", "THEAP", "PCOUNT", "GCOUNT", "NAXIS1", "NAXIS2"}) {
+		headers.erase(key);
+	}
+	const int fields = header.header_as<int>("TFIELDS", 0);
+	for (int i = 1; i <= fields; ++i) {
+		for (const auto& key: {"TTYPE", "TFORM", "TUNIT", "TSCAL", "TZERO", "TNULL", "TDISP", "TDIM"}) {
+			headers.erase(key + QString::number(i));
+		}
+	}
+
+	// Keywords of the image
+	const std::pair<const char*, const char*> renamed[] = {
+		{"ZSIMPLE", "SIMPLE"}, {"ZTENSION", "XTENSION"}, {"ZBITPIX", "BITPIX"}, {"ZNAXIS", "NAXIS"},
+		{"ZPCOUNT", "PCOUNT"}, {"ZGCOUNT", "GCOUNT"}, {"ZEXTEND", "EXTEND"}, {"ZBLOCKED", "BLOCKED"},
+	};
+	for (const auto& rename: renamed) {
+		auto it = headers.find(rename.first);
+		if (it != headers.end()) {
+			headers[rename.second] = it->second;
+			headers.erase(it);
+		}
+	}
+	const int naxis = header.header_as<int>("ZNAXIS", 0);
+	for (int i = 1; i <= naxis; ++i) {
+		const QString n = QString::number(i);
+		auto it = headers.find("ZNAXIS" + n);
+		if (it != headers.end()) {
+			headers["NAXIS" + n] = it->second;
+			headers.erase(it);
+		}
+	}
+	return headers;
+}
@@ -0,0 +1,158 @@
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+
+#include <algorithm>
+#include <map>
+
+#include <tracer.h>
+
+Tracer::Scope::Scope(const char* name, const char* category):
+	name_(name),
+	category_(category),
+	begin_(Tracer::instance().now()) {
+}
+Tracer::Scope::~Scope() {
+	auto& tracer = Tracer::instance();
+
+	if (tracer.isEnabled())
+		tracer.addEvent(name_, category_, begin_, tracer.now() - begin_);
+}
+
+Tracer::Tracer():
+	enabled_(true),
+	dropped_events_(0) {
+
+	timer_.start();
+}
+
+Tracer& Tracer::instance() {
+	static Tracer tracer;
+
+	return tracer;
+}
+
+void Tracer::setEnabled(bool enabled) {
+	QMutexLocker locker(&mutex_);
+
+	enabled_.store(enabled, std::memory_order_relaxed);
+	if (!enabled) {
+		std::vector<Event>().swap(events_);
+		dropped_events_ = 0;
+	}
+}
+
+quint64 Tracer::currentThreadId() {
+	return static_cast<quint64>(reinterpret_cast<quintptr>(QThread::currentThreadId()));
+}
+
+void Tracer::addEvent(const char* name, const char* category, qint64 begin, qint64 duration, quint64 thread_id) {
+	if (!isEnabled())
+		return;
+
+	QMutexLocker locker(&mutex_);
+
+	if (events_.size() >= max_events) {
+		++dropped_events_;
+		return;
+	}
+
+	events_.push_back(Event{name, category, begin, duration, thread_id});
+}
+
+std::vector<Tracer::Event> Tracer::events() const {
+	QMutexLocker locker(&mutex_);
+
+	return events_;
+}
+
+bool Tracer::writeChromeTrace(QIODevice* device) const {
+	const auto events = this->events();
+	const auto pid = QCoreApplication::applicationPid();
+
+	QTextStream stream(device);
+	stream.setRealNumberNotation(QTextStream::FixedNotation);
+	stream.setRealNumberPrecision(3);
+
+	stream << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+	stream << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << pid << ",\"tid\":" << gpu_thread_id << ",\"args\":{\"name\":\"GPU\"}}";
+	for (const auto& event: events) {
+		// Timestamps are in microseconds
+		stream << ",\n{\"name\":\"" << event.name
+			<< "\",\"cat\":\"" << event.category
+			<< "\",\"ph\":\"X\",\"ts\":" << event.begin / 1000.0
+			<< ",\"dur\":" << event.duration / 1000.0
+			<< ",\"pid\":" << pid
+			<< ",\"tid\":" << event.thread_id << "}";
+	}
+	stream << "\n]}\n";
+	stream.flush();
+
+	return stream.status() == QTextStream::Ok;
+}
+
+std::vector<Tracer::Span> Tracer::spans(qint64 until) const {
+	auto events = this->events();
+
+	events.erase(std::remove_if(events.begin(), events.end(), [until] (const Event& x) {
+		return x.begin >= until;
+	}), events.end());
+	// Enclosing span goes first
+	std::stable_sort(events.begin(), events.end(), [] (const Event& x, const Event& y) {
+		return x.begin < y.begin || (x.begin == y.begin && x.duration > y.duration);
+	});
+
+	std::vector<Span> spans;
+	std::map<quint64, std::vector<qint64>> open_ends;
+	for (const auto& event: events) {
+		auto& ends = open_ends[event.thread_id];
+		while (!ends.empty() && ends.back() <= event.begin)
+			ends.pop_back();
+
+		spans.push_back(Span{event, static_cast<int>(ends.size())});
+		ends.push_back(event.begin + event.duration);
+	}
+
+	return spans;
+}
+
+bool Tracer::writeSummary(QIODevice* device, qint64 until) const {
+	const auto spans = this->spans(until);
+
+	QTextStream stream(device);
+	stream.setRealNumberNotation(QTextStream::FixedNotation);
+	stream.setRealNumberPrecision(3);
+
+	stream << qSetFieldWidth(12) << "begin, ms" << "duration, ms" << qSetFieldWidth(20) << "thread" << qSetFieldWidth(0) << "  span\n";
+	for (const auto& span: spans) {
+		stream << qSetFieldWidth(12) << span.event.begin / 1e6 << span.event.duration / 1e6
+			<< qSetFieldWidth(20) << span.event.thread_id << qSetFieldWidth(0) << "  "
+			<< QString(2 * span.depth, QChar(' ')) << span.event.name << "\n";
+	}
+	stream.flush();
+
+	return stream.status() == QTextStream::Ok;
+}
+
+bool Tracer::writeJSON(QIODevice* device, qint64 until) const {
+	const auto spans = this->spans(until);
+
+	QTextStream stream(device);
+
+	stream << "{\"until_ns\":" << until << ",\"spans\":[";
+	for (std::size_t i = 0; i < spans.size(); ++i) {
+		const auto& event = spans[i].event;
+		stream << (i ? ",\n" : "\n")
+			<< "{\"name\":\"" << event.name
+			<< "\",\"category\":\"" << event.category
+			<< "\",\"begin_ns\":" << event.begin
+			<< ",\"duration_ns\":" << event.duration
+			<< ",\"thread\":" << event.thread_id
+			<< ",\"depth\":" << spans[i].depth << "}";
+	}
+	stream << "\n]}\n";
+	stream.flush();
+
+	return stream.status() == QTextStream::Ok;
+}
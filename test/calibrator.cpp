@@ -0,0 +1,182 @@
+#include <QtTest/QtTest>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include <calibrator.h>
+#include <fits.h>
+#include <memoryfitsstorage.h>
+
+#include "fitsbuilder.h"
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+class TestCalibrator: public QObject
+{
+	Q_OBJECT
+private slots:
+	void test_calibrate();
+	void test_cards();
+	void test_cache();
+	void test_rewritten();
+	void test_darkExposure();
+	void test_shapeMismatch();
+};
+
+namespace {
+	const QSize size(4, 3);
+
+	// Writes BITPIX=-32 image file, exposure is not written when negative
+	QString writeImage(const QTemporaryDir& dir, const QString& name, const std::vector<float>& data, double exposure) {
+		QStringList cards{"SIMPLE  =                    T", "BITPIX  =                  -32", "NAXIS   =                    2",
+				FITSBuilder::card("NAXIS1", size.width()), FITSBuilder::card("NAXIS2", size.height())};
+		if (exposure >= 0)
+			cards << QString("EXPTIME = %1").arg(exposure, 20);
+
+		QByteArray pixels;
+		for (auto x: data) {
+			quint32 bits;
+			std::memcpy(&bits, &x, sizeof(bits));
+			uchar be[sizeof(bits)];
+			qToBigEndian(bits, be);
+			pixels.append(reinterpret_cast<const char*>(be), sizeof(be));
+		}
+		const QByteArray bytes = FITSBuilder::header(cards) + FITSBuilder::padded(pixels);
+
+		const auto filename = dir.path() + "/" + name;
+		QFile file(filename);
+		if (!file.open(QIODevice::WriteOnly) || file.write(bytes) != bytes.size())
+			qFatal("Cannot write %s", qPrintable(filename));
+		return filename;
+	}
+
+	float valueAt(const FITS& fits, int index) {
+		auto data = dynamic_cast<const FITS::DataUnit<float>&>(fits.primary_hdu().data()).data();
+		const auto bits = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data + index));
+		float x;
+		std::memcpy(&x, &bits, sizeof(x));
+		return x;
+	}
+
+	/* Bias is 100, dark current is 2 per second, flat varies by 10% around
+	 * the mean, the signal of raw frame is 10 * (i + 1) */
+	struct Frames {
+		QTemporaryDir dir;
+		Calibrator::Masters masters;
+		std::unique_ptr<FITS> raw;
+
+		Frames() {
+			const int length = size.width() * size.height();
+			std::vector<float> bias(length, 100), dark(length, 100 + 2 * 10), flat(length), raw_data(length);
+			for (int i = 0; i < length; ++i) {
+				const float gain = 1.0f + 0.1f * (i % 3 - 1);
+				flat[i] = 100 + 1000 * gain;
+				raw_data[i] = 100 + 2 * 5 + 10 * (i + 1) * gain;
+			}
+
+			masters.bias = writeImage(dir, "bias.fits", bias, -1);
+			masters.dark = writeImage(dir, "dark.fits", dark, 10);
+			masters.flat = writeImage(dir, "flat.fits", flat, 1);
+			raw = MemoryFITSStorage::createFloatImage(size, raw_data.data(), {{"EXPTIME", "5"}});
+		}
+	};
+}
+
+void TestCalibrator::test_calibrate() {
+	Frames frames;
+	Calibrator calibrator(frames.masters);
+	QCOMPARE(calibrator.size(), size);
+
+	const auto result = calibrator.calibrate(frames.raw->primary_hdu());
+	QCOMPARE(static_cast<int>(result.size()), size.width() * size.height());
+	for (std::size_t i = 0; i < result.size(); ++i) {
+		QVERIFY(std::abs(result[i] - 10.0f * (i + 1)) < 1e-3f);
+	}
+}
+
+void TestCalibrator::test_cards() {
+	Frames frames;
+	Calibrator calibrator(frames.masters);
+
+	const auto fits = calibrator.calibrateToFITS(frames.raw->primary_hdu());
+	const auto& header = fits->header_unit();
+	QCOMPARE(header.header("BITPIX"), QString("-32"));
+	QCOMPARE(header.header_as<double>("EXPTIME"), 5.0);
+	QCOMPARE(header.header("ZEROCOR"), QString("'bias.fits'"));
+	QCOMPARE(header.header("DARKCOR"), QString("'dark.fits'"));
+	QCOMPARE(header.header("FLATCOR"), QString("'flat.fits'"));
+	QVERIFY(std::abs(valueAt(*fits, 0) - 10.0f) < 1e-3f);
+}
+
+void TestCalibrator::test_cache() {
+	Calibrator::Masters masters;
+	masters.bias = DATA_ROOT "/sombrero16.fits";
+	Calibrator calibrator(masters);
+
+	// The frame minus itself
+	const auto first = calibrator.calibrated(DATA_ROOT "/sombrero16.fits");
+	QCOMPARE(calibrator.misses(), Q_UINT64_C(1));
+	QCOMPARE(valueAt(*first, 0), 0.0f);
+	QCOMPARE(valueAt(*first, 800 * 448 - 1), 0.0f);
+
+	const auto second = calibrator.calibrated(DATA_ROOT "/sombrero16.fits");
+	QCOMPARE(second.get(), first.get());
+	QCOMPARE(calibrator.hits(), Q_UINT64_C(1));
+	QCOMPARE(calibrator.usage(), qint64(800 * 448 * sizeof(float)));
+
+	// The most recent entry is kept within zero budget
+	calibrator.setBudget(0);
+	calibrator.calibrated(DATA_ROOT "/sombrero8.fits");
+	QCOMPARE(calibrator.usage(), qint64(800 * 448 * sizeof(float)));
+	calibrator.calibrated(DATA_ROOT "/sombrero16.fits");
+	QCOMPARE(calibrator.misses(), Q_UINT64_C(3));
+}
+
+void TestCalibrator::test_rewritten() {
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	const QString filename = dir.path() + "/raw.fits";
+	QVERIFY(QFile::copy(DATA_ROOT "/sombrero16.fits", filename));
+
+	Calibrator::Masters masters;
+	masters.bias = DATA_ROOT "/sombrero16.fits";
+	Calibrator calibrator(masters);
+	const auto first = calibrator.calibrated(filename);
+	QCOMPARE(valueAt(*first, 800 * 224 + 400), 0.0f);
+
+	QVERIFY(QFile::remove(filename));
+	QVERIFY(QFile::copy(DATA_ROOT "/sombrero8.fits", filename));
+	const auto rewritten = calibrator.calibrated(filename);
+	QVERIFY(rewritten.get() != first.get());
+	QCOMPARE(calibrator.misses(), Q_UINT64_C(2));
+}
+
+void TestCalibrator::test_darkExposure() {
+	Calibrator::Masters masters;
+	masters.dark = DATA_ROOT "/sombrero16.fits";
+	QVERIFY_EXCEPTION_THROWN(Calibrator calibrator(masters), Calibrator::Exception);
+
+	// Raw frame without exposure can not be calibrated by dark
+	Frames frames;
+	Calibrator calibrator(frames.masters);
+	std::vector<float> data(size.width() * size.height(), 0);
+	const auto raw = MemoryFITSStorage::createFloatImage(size, data.data());
+	QVERIFY_EXCEPTION_THROWN(calibrator.calibrate(raw->primary_hdu()), Calibrator::Exception);
+}
+
+void TestCalibrator::test_shapeMismatch() {
+	Calibrator::Masters masters;
+	masters.bias = DATA_ROOT "/sombrero8.fits";
+	masters.flat = DATA_ROOT "/gradient.fits";
+	QVERIFY_EXCEPTION_THROWN(Calibrator calibrator(masters), Calibrator::ShapeMismatch);
+
+	Frames frames;
+	Calibrator calibrator(frames.masters);
+	QVERIFY_EXCEPTION_THROWN(calibrator.calibrated(DATA_ROOT "/sombrero8.fits"), Calibrator::ShapeMismatch);
+}
+
+QTEST_MAIN(TestCalibrator)
+#include "calibrator.moc"
@@ -0,0 +1,172 @@
+#include <QtTest/QtTest>
+#include <QFile>
+#include <QtEndian>
+
+#include <cstring>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include <checksum.h>
+#include <memoryfitsstorage.h>
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+class TestChecksum: public QObject
+{
+	Q_OBJECT
+private:
+	// HDUs written with the keywords by astropy, the last one without them
+	std::unique_ptr<FITS> readFITS(QByteArray* bytes) const;
+	std::vector<const FITS::HeaderDataUnit*> hdus(const FITS& fits) const;
+private slots:
+	void test_add();
+	void test_sum();
+	void test_parallelSum();
+	void test_extents();
+	void test_valid();
+	void test_corruptedData();
+	void test_corruptedHeader();
+};
+
+std::unique_ptr<FITS> TestChecksum::readFITS(QByteArray* bytes) const {
+	if (bytes->isEmpty()) {
+		QFile file(DATA_ROOT "/checksum.fits");
+		if (!file.open(QIODevice::ReadOnly))
+			return std::unique_ptr<FITS>();
+		*bytes = file.readAll();
+	}
+
+	std::unique_ptr<quint8[]> data{new quint8[bytes->size()]};
+	std::memcpy(data.get(), bytes->constData(), bytes->size());
+	std::unique_ptr<MemoryFITSStorage> storage{new MemoryFITSStorage(data.release(), bytes->size())};
+	return std::unique_ptr<FITS>(new FITS(storage.release()));
+}
+
+std::vector<const FITS::HeaderDataUnit*> TestChecksum::hdus(const FITS& fits) const {
+	std::vector<const FITS::HeaderDataUnit*> hdus{&fits.primary_hdu()};
+	for (const auto& hdu: fits) {
+		hdus.push_back(&hdu);
+	}
+	return hdus;
+}
+
+void TestChecksum::test_add() {
+	QCOMPARE(Checksum::add(0, 0), quint32(0));
+	QCOMPARE(Checksum::add(0xFFFFFFFF, 1), quint32(1));
+	QCOMPARE(Checksum::add(0x80000000, 0x80000000), quint32(1));
+	QCOMPARE(Checksum::add(0xFFFFFFFE, 1), quint32(0xFFFFFFFF));
+	// -0 is the identity as well
+	QCOMPARE(Checksum::add(0xFFFFFFFF, 12345), quint32(12345));
+}
+
+void TestChecksum::test_sum() {
+	const quint8 words[] = {0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x01, 0x12, 0x34, 0x56};
+	QCOMPARE(Checksum::sum(words, 0), quint32(0));
+	QCOMPARE(Checksum::sum(words, 4), quint32(0xFFFFFFFF));
+	QCOMPARE(Checksum::sum(words, 8), quint32(1));
+	QCOMPARE(Checksum::sum(words + 4, 4, 0xFFFFFFFF), quint32(1));
+	// The last word is padded with zeros
+	QCOMPARE(Checksum::sum(words + 8, 3), quint32(0x12345600));
+	QCOMPARE(Checksum::sum(words, 11), quint32(0x12345601));
+}
+
+void TestChecksum::test_parallelSum() {
+	// Many bands, the vector loop and the scalar tail
+	const std::size_t length = (std::size_t(9) << 20) + 4 * 5 + 3;
+	std::vector<quint8> data(length);
+	std::mt19937 generator(42);
+	for (auto& x: data) {
+		x = static_cast<quint8>(generator());
+	}
+
+	quint64 expected = 0;
+	for (std::size_t i = 0; i + 4 <= length; i += 4) {
+		expected += qFromBigEndian<quint32>(data.data() + i);
+	}
+	const quint8 last[4] = {data[length - 3], data[length - 2], data[length - 1], 0};
+	expected += qFromBigEndian<quint32>(last);
+	while (expected >> 32) {
+		expected = (expected & 0xFFFFFFFF) + (expected >> 32);
+	}
+
+	QCOMPARE(Checksum::sum(data.data(), length), quint32(expected));
+	// Sums of the parts are combined exactly
+	const std::size_t split = 4 * 123457;
+	QCOMPARE(Checksum::sum(data.data() + split, length - split, Checksum::sum(data.data(), split)), quint32(expected));
+
+	// Every word is the maximum
+	std::fill(data.begin(), data.end(), 0xFF);
+	QCOMPARE(Checksum::sum(data.data(), length / 4 * 4), quint32(0xFFFFFFFF));
+}
+
+void TestChecksum::test_extents() {
+	QByteArray bytes;
+	const auto fits = readFITS(&bytes);
+	QVERIFY(fits);
+
+	const auto all = hdus(*fits);
+	QCOMPARE(all.size(), std::size_t(4));
+	for (std::size_t i = 0; i < all.size(); ++i) {
+		QVERIFY(all[i]->rawHeader() == all[0]->rawHeader() + i * 5760);
+		QCOMPARE(all[i]->headerExtent(), quint64(2880));
+		QCOMPARE(all[i]->dataExtent(), quint64(2880));
+	}
+}
+
+void TestChecksum::test_valid() {
+	QByteArray bytes;
+	const auto fits = readFITS(&bytes);
+	QVERIFY(fits);
+
+	const auto all = hdus(*fits);
+	const quint32 datasums[] = {765930271u, 3423404080u, 4064661883u};
+	for (int i = 0; i < 3; ++i) {
+		const Checksum checksum(*all[i]);
+		QCOMPARE(checksum.checksum(), Checksum::Valid);
+		QCOMPARE(checksum.datasum(), Checksum::Valid);
+		QCOMPARE(checksum.dataSum(), datasums[i]);
+		QCOMPARE(checksum.hduSum(), quint32(0xFFFFFFFF));
+		QVERIFY(checksum.isValid());
+	}
+
+	const Checksum missing(*all[3]);
+	QCOMPARE(missing.checksum(), Checksum::Missing);
+	QCOMPARE(missing.datasum(), Checksum::Missing);
+	QVERIFY(missing.isMissing());
+	QVERIFY(missing.isValid());
+}
+
+void TestChecksum::test_corruptedData() {
+	QByteArray bytes;
+	QVERIFY(readFITS(&bytes));
+	// A pixel of the image extension
+	const int pixel = 2 * 5760 + 2880 + 5;
+	bytes[pixel] = static_cast<char>(bytes[pixel] ^ 0x10);
+
+	const auto fits = readFITS(&bytes);
+	const auto all = hdus(*fits);
+	const Checksum checksum(*all[2]);
+	QCOMPARE(checksum.checksum(), Checksum::Invalid);
+	QCOMPARE(checksum.datasum(), Checksum::Invalid);
+	QVERIFY(!checksum.isValid());
+
+	QVERIFY(Checksum(*all[0]).isValid());
+	QVERIFY(Checksum(*all[1]).isValid());
+}
+
+void TestChecksum::test_corruptedHeader() {
+	QByteArray bytes;
+	QVERIFY(readFITS(&bytes));
+	const int object = bytes.indexOf("checksum test");
+	QVERIFY(object > 0 && object < 2880);
+	bytes[object] = 'C';
+
+	const auto fits = readFITS(&bytes);
+	const Checksum checksum(fits->primary_hdu());
+	QCOMPARE(checksum.checksum(), Checksum::Invalid);
+	QCOMPARE(checksum.datasum(), Checksum::Valid);
+}
+
+QTEST_MAIN(TestChecksum)
+#include "checksum.moc"
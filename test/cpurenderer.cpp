@@ -0,0 +1,170 @@
+#include <QtTest/QtTest>
+#include <QFile>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#include <cpurenderer.h>
+#include <fits.h>
+#include <histogram.h>
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+class TestCPURenderer: public QObject
+{
+	Q_OBJECT
+private slots:
+	void renderGrayscale_data();
+	void renderGrayscale();
+	void renderStretch_data();
+	void renderStretch();
+	void renderOutside();
+	void unsupportedBitpix();
+};
+
+namespace {
+	struct PhysicalValue {
+		quint64 index;
+		double* value;
+
+		template<class T> void operator() (const FITS::DataUnit<T>& data) const {
+			*value = qFromBigEndian<T>(reinterpret_cast<const uchar*>(data.data() + index));
+		}
+		void operator() (const FITS::DataUnit<float>& data) const {
+			const auto bits = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data.data() + index));
+			float x;
+			std::memcpy(&x, &bits, sizeof(x));
+			*value = x;
+		}
+		void operator() (const FITS::DataUnit<double>&) const {
+			QFAIL("Wrong overloading");
+		}
+		void operator() (const FITS::EmptyDataUnit&) const {
+			QFAIL("Wrong overloading");
+		}
+		void operator() (const FITS::TableDataUnit&) const {
+			QFAIL("Wrong overloading");
+		}
+	};
+
+	double physicalValue(const FITS::HeaderDataUnit& hdu, quint64 index) {
+		double value = 0;
+		hdu.data().apply(PhysicalValue{index, &value});
+		return value * hdu.header().bscale() + hdu.header().bzero();
+	}
+}
+
+void TestCPURenderer::renderGrayscale_data() {
+	QTest::addColumn<QString>("filename");
+
+	QTest::newRow("8")   << DATA_ROOT "/sombrero8.fits";
+	QTest::newRow("16")  << DATA_ROOT "/sombrero16.fits";
+	QTest::newRow("32")  << DATA_ROOT "/sombrero32.fits";
+	QTest::newRow("64")  << DATA_ROOT "/sombrero64.fits";
+	QTest::newRow("-32") << DATA_ROOT "/sombrero-32.fits";
+}
+void TestCPURenderer::renderGrayscale() {
+	QFETCH(QString, filename);
+
+	QFile* file = new QFile(filename);
+	QVERIFY(file->open(QIODevice::ReadOnly));
+	FITS fits(file);
+	const auto& hdu = fits.primary_hdu();
+	const auto size = hdu.data().imageDataUnit()->size();
+
+	CPURenderer renderer(hdu);
+	const auto minmax = renderer.hduMinMax();
+	const auto image = renderer.render(size);
+	QCOMPARE(image.size(), size);
+
+	// Grayscale maps the levels onto [0, 255] linearly, the first image row
+	// is the bottom one
+	int max_difference = 0;
+	for (int y = 0; y < size.height(); ++y) {
+		const auto line = reinterpret_cast<const QRgb*>(image.constScanLine(size.height() - 1 - y));
+		for (int x = 0; x < size.width(); ++x) {
+			const auto value = physicalValue(hdu, static_cast<quint64>(y) * size.width() + x);
+			const int expected = static_cast<int>(std::lround(255 * (value - minmax.first) / (minmax.second - minmax.first)));
+			QCOMPARE(qAlpha(line[x]), 255);
+			max_difference = std::max(max_difference, std::abs(qRed(line[x]) - expected));
+		}
+	}
+	QVERIFY(max_difference <= 1);
+}
+void TestCPURenderer::renderStretch_data() {
+	QTest::addColumn<int>("stretch");
+
+	QTest::newRow("sqrt")         << static_cast<int>(OpenGLShaderUniforms::SqrtStretch);
+	QTest::newRow("log")          << static_cast<int>(OpenGLShaderUniforms::LogStretch);
+	QTest::newRow("asinh")        << static_cast<int>(OpenGLShaderUniforms::AsinhStretch);
+	QTest::newRow("power")        << static_cast<int>(OpenGLShaderUniforms::PowerStretch);
+	QTest::newRow("equalization") << static_cast<int>(OpenGLShaderUniforms::EqualizationStretch);
+}
+void TestCPURenderer::renderStretch() {
+	QFETCH(int, stretch);
+
+	QFile* file = new QFile(DATA_ROOT "/sombrero8.fits");
+	QVERIFY(file->open(QIODevice::ReadOnly));
+	FITS fits(file);
+	const auto& hdu = fits.primary_hdu();
+	const auto size = hdu.data().imageDataUnit()->size();
+
+	CPURenderer renderer(hdu);
+	const auto minmax = renderer.hduMinMax();
+	const auto parameter = OpenGLShaderUniforms::defaultStretchParameter(static_cast<OpenGLShaderUniforms::Stretch>(stretch));
+	renderer.setStretch(static_cast<OpenGLShaderUniforms::Stretch>(stretch), parameter);
+	const auto image = renderer.render(size);
+
+	const Histogram histogram(hdu, minmax);
+	const auto stretched = [&] (double x) -> double {
+		switch (stretch) {
+		case OpenGLShaderUniforms::SqrtStretch:
+			return std::sqrt(x);
+		case OpenGLShaderUniforms::LogStretch:
+			return std::log(parameter * x + 1) / std::log(parameter + 1);
+		case OpenGLShaderUniforms::AsinhStretch:
+			return std::asinh(x / parameter) / std::asinh(1 / parameter);
+		case OpenGLShaderUniforms::PowerStretch:
+			return std::pow(x, parameter);
+		default:
+			return (histogram.at(x) - histogram.at(0)) / (histogram.at(1) - histogram.at(0));
+		}
+	};
+
+	int max_difference = 0;
+	for (int y = 0; y < size.height(); ++y) {
+		const auto line = reinterpret_cast<const QRgb*>(image.constScanLine(size.height() - 1 - y));
+		for (int x = 0; x < size.width(); ++x) {
+			const auto value = physicalValue(hdu, static_cast<quint64>(y) * size.width() + x);
+			const int expected = static_cast<int>(std::lround(255 * stretched((value - minmax.first) / (minmax.second - minmax.first))));
+			max_difference = std::max(max_difference, std::abs(qRed(line[x]) - expected));
+		}
+	}
+	QVERIFY(max_difference <= 1);
+}
+void TestCPURenderer::renderOutside() {
+	QFile* file = new QFile(DATA_ROOT "/sombrero8.fits");
+	QVERIFY(file->open(QIODevice::ReadOnly));
+	FITS fits(file);
+
+	CPURenderer renderer(fits.primary_hdu());
+	// The image takes the left half of the output
+	const auto image = renderer.render(QSize(64, 32), QRectF(0, 0, 2, 1));
+	for (int y = 0; y < image.height(); ++y) {
+		const auto line = reinterpret_cast<const QRgb*>(image.constScanLine(y));
+		for (int x = 0; x < image.width(); ++x) {
+			QCOMPARE(qAlpha(line[x]), x < image.width() / 2 ? 255 : 0);
+		}
+	}
+}
+void TestCPURenderer::unsupportedBitpix() {
+	QFile* file = new QFile(DATA_ROOT "/sombrero-64.fits");
+	QVERIFY(file->open(QIODevice::ReadOnly));
+	FITS fits(file);
+
+	QVERIFY_EXCEPTION_THROWN(CPURenderer renderer(fits.primary_hdu()), FITS::UnsupportedBitpix);
+}
+
+QTEST_MAIN(TestCPURenderer)
+#include "cpurenderer.moc"
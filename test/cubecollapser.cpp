@@ -0,0 +1,132 @@
+#include <QtTest/QtTest>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+#include <cubecollapser.h>
+#include <fits.h>
+#include <memoryfitsstorage.h>
+
+#include "fitsbuilder.h"
+
+class TestCubeCollapser: public QObject
+{
+	Q_OBJECT
+private slots:
+	void test_planes();
+	void test_collapse_data();
+	void test_collapse();
+	void test_range();
+	void test_cards();
+};
+
+namespace {
+	const int width = 5, height = 3, depth = 4;
+
+	// BITPIX=16 cube with BZERO=1000, the value of plane p at pixel i is 10 * p + i
+	std::unique_ptr<FITS> makeCube(double cdelt3) {
+		const auto header = FITSBuilder::header({"SIMPLE  =                    T", "BITPIX  =                   16", "NAXIS   =                    3",
+				FITSBuilder::card("NAXIS1", width), FITSBuilder::card("NAXIS2", height), FITSBuilder::card("NAXIS3", depth),
+				"BZERO   =                 1000", QString("CDELT3  = %1").arg(cdelt3, 20)});
+
+		const qint64 header_size = header.size();
+		const qint64 data_size = FITSBuilder::padded(QByteArray(width * height * depth * 2, '\0')).size();
+		std::unique_ptr<quint8[]> bytes{new quint8[header_size + data_size]};
+		std::memcpy(bytes.get(), header.constData(), header_size);
+		std::memset(bytes.get() + header_size, 0, data_size);
+
+		auto data = bytes.get() + header_size;
+		for (int p = 0; p < depth; ++p) {
+			for (int i = 0; i < width * height; ++i) {
+				qToBigEndian<qint16>(10 * p + i - 1000, data + 2 * (p * width * height + i));
+			}
+		}
+
+		std::unique_ptr<MemoryFITSStorage> storage{new MemoryFITSStorage(bytes.release(), header_size + data_size)};
+		return std::unique_ptr<FITS>(new FITS(storage.release()));
+	}
+
+	qint16 rawAt(const FITS::AbstractDataUnit& data, int index) {
+		auto x = dynamic_cast<const FITS::DataUnit<qint16>&>(data).data();
+		return qFromBigEndian<qint16>(reinterpret_cast<const uchar*>(x + index));
+	}
+}
+
+void TestCubeCollapser::test_planes() {
+	const auto fits = makeCube(1);
+	const auto& hdu = fits->primary_hdu();
+	const auto image = hdu.data().imageDataUnit();
+	QVERIFY(image);
+	QCOMPARE(image->depth(), quint64(depth));
+	QCOMPARE(image->size(), QSize(width, height));
+	// The cube is the image of its first plane
+	QCOMPARE(image->length(), quint64(width * height * 2));
+
+	for (int p = 0; p < depth; ++p) {
+		FITS::HeaderDataUnit plane(hdu, p);
+		QCOMPARE(plane.data().imageDataUnit()->depth(), quint64(1));
+		QCOMPARE(plane.data().imageDataUnit()->size(), QSize(width, height));
+		QCOMPARE(plane.data().data(), image->planeData(p));
+		QCOMPARE(plane.header().bzero(), 1000.0);
+		QCOMPARE(rawAt(plane.data(), 7) + 1000, 10 * p + 7);
+	}
+}
+
+void TestCubeCollapser::test_collapse_data() {
+	QTest::addColumn<int>("operation");
+	QTest::addColumn<float>("expected");
+
+	// Pixel 7 has 7, 17, 27, 37 in the planes
+	QTest::newRow("sum")      << static_cast<int>(CubeCollapser::SumOperation)     << 88.0f;
+	QTest::newRow("mean")     << static_cast<int>(CubeCollapser::MeanOperation)    << 22.0f;
+	QTest::newRow("max")      << static_cast<int>(CubeCollapser::MaxOperation)     << 37.0f;
+	QTest::newRow("moment-0") << static_cast<int>(CubeCollapser::Moment0Operation) << 44.0f;
+}
+void TestCubeCollapser::test_collapse() {
+	QFETCH(int, operation);
+	QFETCH(float, expected);
+
+	const auto fits = makeCube(-0.5);
+	CubeCollapser::Options options;
+	options.operation = static_cast<CubeCollapser::Operation>(operation);
+
+	const auto result = CubeCollapser(fits->primary_hdu()).collapse(options);
+	QCOMPARE(static_cast<int>(result.size()), width * height);
+	QCOMPARE(result[7], expected);
+}
+
+void TestCubeCollapser::test_range() {
+	const auto fits = makeCube(1);
+	CubeCollapser collapser(fits->primary_hdu());
+
+	CubeCollapser::Options options;
+	options.operation = CubeCollapser::MeanOperation;
+	options.first = 1;
+	options.last = 2;
+	QCOMPARE(collapser.collapse(options)[0], 15.0f);
+
+	options.first = 3;
+	QVERIFY_EXCEPTION_THROWN(collapser.collapse(options), CubeCollapser::Exception);
+}
+
+void TestCubeCollapser::test_cards() {
+	const auto fits = makeCube(1);
+	CubeCollapser::Options options;
+	options.operation = CubeCollapser::MaxOperation;
+	options.first = 1;
+
+	const auto collapsed = CubeCollapser(fits->primary_hdu()).collapseToFITS(options);
+	const auto& header = collapsed->header_unit();
+	QCOMPARE(header.header("NAXIS"), QString("2"));
+	QCOMPARE(header.header("COLLAPSE"), QString("'MAX     '"));
+	QCOMPARE(header.header("PLANE1"), QString("2"));
+	QCOMPARE(header.header("PLANE2"), QString("4"));
+	QCOMPARE(collapsed->data_unit().imageDataUnit()->depth(), quint64(1));
+
+	QCOMPARE(CubeCollapser::operationFromName("moment-0"), CubeCollapser::Moment0Operation);
+	QCOMPARE(CubeCollapser::operationFromName("median"), CubeCollapser::OperationCount);
+}
+
+QTEST_MAIN(TestCubeCollapser)
+#include "cubecollapser.moc"
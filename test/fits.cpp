@@ -1,5 +1,9 @@
 #include <QtTest/QtTest>
 #include <QFile>
+
+#include <iterator>
+#include <vector>
+
 #include <fits.h>
 
 #define DATA_ROOT PROJECT_ROOT "/test/data"
@@ -19,6 +23,8 @@ private slots:
 	void parseHeaderBscale1();
 	void parseDataUnitShape();
 	void visitDataUnit1();
+	void parseBinaryTable();
+	void decodeTableColumn();
 };
 
 void TestFits::pageAdvance1() {
@@ -126,6 +132,9 @@ void TestFits::visitDataUnit1() {
 		void operator() (const FITS::EmptyDataUnit&) const {
 			QFAIL("Wrong overloading");
 		}
+		void operator() (const FITS::TableDataUnit&) const {
+			QFAIL("Wrong overloading");
+		}
 		void operator() (const FITS::DataUnit<quint8>&) const {
 			QFAIL("Wrong overloading");
 		}
@@ -147,5 +156,72 @@ void TestFits::visitDataUnit1() {
 	fits.data_unit().apply(test_fun{});
 }
 
+void TestFits::parseBinaryTable() {
+	QFile* file = new QFile(DATA_ROOT "/table.fits");
+	file->open(QIODevice::ReadOnly);
+	const FITS fits(file);
+	QCOMPARE(static_cast<int>(std::distance(fits.begin(), fits.end())), 2);
+
+	auto table = dynamic_cast<const FITS::TableDataUnit*>(&fits.begin()->data());
+	QVERIFY(table);
+	QVERIFY(!fits.begin()->data().imageDataUnit());
+	QCOMPARE(table->rows(), quint64(5));
+	QCOMPARE(table->rowLength(), quint64(73));
+	QCOMPARE(table->columns().size(), std::size_t(11));
+
+	const auto& vec = table->columns()[6];
+	QCOMPARE(vec.name, QString("VEC"));
+	QCOMPARE(vec.type, 'J');
+	QCOMPARE(vec.offset, quint64(31));
+	QCOMPARE(vec.dimensions, (std::vector<quint64>{3, 2}));
+	QCOMPARE(table->columns()[4].unit, QString("Jy"));
+
+	QCOMPARE(table->text(0, 1), QString("beta"));
+	QCOMPARE(table->text(1, 1), QString("F"));
+	// Unsigned by TZERO
+	QCOMPARE(table->text(2, 2), QString("40000"));
+	QCOMPARE(table->text(3, 3), QString("1099511627776"));
+	QCOMPARE(table->text(4, 1), QString("-2.25"));
+	QCOMPARE(table->text(6, 1), QString("[6, 7, 8, 9, 10, 11]"));
+	QCOMPARE(table->text(6, 1, 2), QString("[6, 7, ...]"));
+	// TNULL
+	QCOMPARE(table->text(7, 1), QString());
+	QCOMPARE(table->text(8, 1), QString("(3, -4)"));
+	QCOMPARE(table->text(9, 0), QString("10110"));
+	// Variable-length arrays in the heap
+	QCOMPARE(table->text(10, 4), QString("[9, 8, 7, 6]"));
+	QCOMPARE(table->text(10, 1), QString("[]"));
+
+	// The heap is skipped
+	auto image = std::next(fits.begin())->data().imageDataUnit();
+	QVERIFY(image);
+	QCOMPARE(image->size(), QSize(4, 3));
+	QCOMPARE(qFromBigEndian<qint16>(image->data() + 2 * 5), qint16(5));
+}
+void TestFits::decodeTableColumn() {
+	QFile* file = new QFile(DATA_ROOT "/table.fits");
+	file->open(QIODevice::ReadOnly);
+	const FITS fits(file);
+	auto table = dynamic_cast<const FITS::TableDataUnit*>(&fits.begin()->data());
+	QVERIFY(table);
+
+	auto view = table->view(5);
+	QCOMPARE(view.stride, quint64(73));
+	QCOMPARE(view.field(2), table->data() + 2 * 73 + 23);
+
+	std::vector<qint32> vec(12);
+	table->decode(6, 1, 2, vec.data());
+	for (int i = 0; i < 12; ++i) {
+		QCOMPARE(vec[i], 6 + i);
+	}
+	std::vector<double> mag(5);
+	table->decode(5, 0, 5, mag.data());
+	QCOMPARE(mag[0], 10.125);
+	QCOMPARE(mag[4], 14.5);
+
+	std::vector<qint64> wrong(5);
+	QVERIFY_EXCEPTION_THROWN(table->decode(5, 0, 5, wrong.data()), FITS::WrongHeaderValue);
+}
+
 QTEST_MAIN(TestFits)
 #include "fits.moc"
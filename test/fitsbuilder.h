@@ -0,0 +1,55 @@
+#ifndef _FITSBUILDER_H
+#define _FITSBUILDER_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+/* FITS files built in memory by the tests. Cards are padded to 80
+ * characters, headers and data to whole 2880-byte blocks. */
+namespace FITSBuilder {
+	const int block_size = 2880;
+
+	// Header of the cards terminated by END
+	inline QByteArray header(const QStringList& cards) {
+		QByteArray header;
+		for (const auto& card: cards) {
+			header += card.leftJustified(80, ' ', true).toLatin1();
+		}
+		header += QString("END").leftJustified(80, ' ').toLatin1();
+		header += QByteArray((block_size - header.size() % block_size) % block_size, ' ');
+		return header;
+	}
+
+	inline QByteArray padded(QByteArray data) {
+		data += QByteArray((block_size - data.size() % block_size) % block_size, '\0');
+		return data;
+	}
+
+	// Fixed-format card of an integral value
+	inline QString card(const QString& keyword, qint64 value) {
+		return keyword.leftJustified(8, ' ') + QString("= %1").arg(value, 20);
+	}
+
+	const int large_width = 2400, large_height = 2400;
+
+	/* Empty primary HDU, small BITPIX=16 image and large BITPIX=8 image of
+	 * large_width x large_height pixels */
+	inline QByteArray threeImages(const QByteArray& large) {
+		QByteArray fits = header({"SIMPLE  =                    T", "BITPIX  =                    8", "NAXIS   =                    0", "EXTEND  =                    T"});
+
+		fits += header({"XTENSION= 'IMAGE   '", "BITPIX  =                   16", "NAXIS   =                    2", card("NAXIS1", 20), card("NAXIS2", 10)});
+		QByteArray small(20 * 10 * 2, '\0');
+		for (int i = 0; i < small.size(); ++i) {
+			small[i] = static_cast<char>(i % 251);
+		}
+		fits += padded(small);
+
+		fits += header({"XTENSION= 'IMAGE   '", "BITPIX  =                    8", "NAXIS   =                    2", card("NAXIS1", large_width), card("NAXIS2", large_height)});
+		fits += padded(large);
+
+		return fits;
+	}
+}
+
+#endif //_FITSBUILDER_H
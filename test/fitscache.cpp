@@ -0,0 +1,130 @@
+#include <QtTest/QtTest>
+#include <QFile>
+#include <QFileInfo>
+#include <QTemporaryDir>
+
+#include <vector>
+
+#include <fitscache.h>
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+class TestFITSCache: public QObject
+{
+	Q_OBJECT
+private slots:
+	void test_open();
+	void test_prefetch();
+	void test_evict();
+	void test_pinned();
+	void test_missing();
+	void test_rewritten();
+	void test_prefetchOrder();
+};
+
+void TestFITSCache::test_open() {
+	const QString filename = DATA_ROOT "/sombrero16.fits";
+	FITSCache cache;
+
+	auto entry = cache.open(filename);
+	QVERIFY(entry->frame.hdu->data().imageDataUnit());
+	QCOMPARE(entry->size, QFileInfo(filename).size());
+	QVERIFY(!entry->statistics);
+
+	QCOMPARE(cache.open(filename).get(), entry.get());
+	QCOMPARE(cache.hits(), quint64(1));
+	QCOMPARE(cache.misses(), quint64(1));
+	QCOMPARE(cache.size(), 1);
+	QCOMPARE(cache.usage(), entry->size);
+}
+
+void TestFITSCache::test_prefetch() {
+	const QString filename = DATA_ROOT "/sombrero32.fits";
+	FITSCache cache;
+
+	cache.prefetch(QStringList() << filename);
+	QTRY_VERIFY(cache.contains(filename));
+
+	auto entry = cache.open(filename);
+	QCOMPARE(cache.hits(), quint64(1));
+	QVERIFY(entry->statistics);
+	QVERIFY(entry->statistics->minmax.first < entry->statistics->minmax.second);
+	QVERIFY(!entry->statistics->histogram.isEmpty());
+}
+
+void TestFITSCache::test_evict() {
+	const QString first  = DATA_ROOT "/sombrero8.fits";
+	const QString second = DATA_ROOT "/sombrero16.fits";
+	const QString third  = DATA_ROOT "/sombrero32.fits";
+	FITSCache cache(QFileInfo(second).size() + QFileInfo(third).size());
+
+	cache.open(first);
+	cache.open(second);
+	// The first one is the least recently used
+	cache.open(third);
+
+	QVERIFY(!cache.contains(first));
+	QVERIFY(cache.contains(second));
+	QVERIFY(cache.contains(third));
+	QVERIFY(cache.usage() <= cache.budget());
+
+	cache.open(second);
+	cache.open(first);
+	QVERIFY(cache.contains(first));
+	QVERIFY(cache.contains(second));
+	QVERIFY(!cache.contains(third));
+}
+
+void TestFITSCache::test_pinned() {
+	const QString filename = DATA_ROOT "/sombrero16.fits";
+	FITSCache cache(0);
+
+	auto entry = cache.open(filename);
+	QVERIFY(cache.contains(filename));
+	QCOMPARE(cache.usage(), entry->size);
+
+	cache.setBudget(0);
+	QVERIFY(cache.contains(filename));
+
+	entry.reset();
+	cache.setBudget(0);
+	QVERIFY(!cache.contains(filename));
+	QCOMPARE(cache.usage(), qint64(0));
+}
+
+void TestFITSCache::test_missing() {
+	FITSCache cache;
+
+	QVERIFY_EXCEPTION_THROWN(cache.open(DATA_ROOT "/missing.fits"), Sequence::Exception);
+	QCOMPARE(cache.size(), 0);
+}
+
+void TestFITSCache::test_rewritten() {
+	QTemporaryDir dir;
+	QVERIFY(dir.isValid());
+	const QString filename = dir.path() + "/frame.fits";
+	QVERIFY(QFile::copy(DATA_ROOT "/sombrero16.fits", filename));
+	FITSCache cache;
+
+	auto entry = cache.open(filename);
+	QCOMPARE(entry->frame.hdu->header().header_as<int>("BITPIX"), 16);
+
+	QVERIFY(QFile::remove(filename));
+	QVERIFY(QFile::copy(DATA_ROOT "/sombrero8.fits", filename));
+	auto rewritten = cache.open(filename);
+	QVERIFY(rewritten.get() != entry.get());
+	QCOMPARE(rewritten->frame.hdu->header().header_as<int>("BITPIX"), 8);
+	QCOMPARE(cache.misses(), quint64(2));
+	QVERIFY(cache.contains(filename));
+}
+
+void TestFITSCache::test_prefetchOrder() {
+	QCOMPARE(FITSCache::prefetchOrder(5, 1, 10, 3), std::vector<int>({6, 7, 8, 4}));
+	QCOMPARE(FITSCache::prefetchOrder(5, -1, 10, 3), std::vector<int>({4, 3, 2, 6}));
+	QCOMPARE(FITSCache::prefetchOrder(8, 1, 10, 3), std::vector<int>({9, 7}));
+	QCOMPARE(FITSCache::prefetchOrder(0, -1, 10, 3), std::vector<int>({1}));
+	QCOMPARE(FITSCache::prefetchOrder(0, 1, 1, 3), std::vector<int>());
+}
+
+QTEST_MAIN(TestFITSCache)
+#include "fitscache.moc"
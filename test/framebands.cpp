@@ -0,0 +1,116 @@
+#include <QtTest/QtTest>
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <fits.h>
+#include <framebands.h>
+#include <memoryfitsstorage.h>
+
+class TestFrameBands: public QObject
+{
+	Q_OBJECT
+private slots:
+	void test_firstFrame();
+	void test_changedBands();
+	void test_minmax();
+	void test_shapeChange();
+};
+
+namespace {
+	const int width = 10, height = 100;
+
+	std::vector<float> ramp() {
+		std::vector<float> data(width * height);
+		for (std::size_t i = 0; i < data.size(); ++i) {
+			data[i] = static_cast<float>(i % 1000);
+		}
+		return data;
+	}
+
+	std::unique_ptr<FITS> frame(const std::vector<float>& data, int frame_height = height) {
+		return MemoryFITSStorage::createFloatImage(QSize(width, frame_height), data.data());
+	}
+}
+
+void TestFrameBands::test_firstFrame() {
+	FrameBands bands(32);
+	auto data = ramp();
+	const auto changed = bands.update(frame(data)->primary_hdu());
+
+	// Bands of 32, 32, 32 and 4 rows are merged
+	QCOMPARE(bands.size(), std::size_t(4));
+	QCOMPARE(changed.size(), std::size_t(1));
+	QCOMPARE(changed[0].first_row, quint64(0));
+	QCOMPARE(changed[0].rows, quint64(height));
+	QCOMPARE(bands.minmax(), std::make_pair(0.0, 999.0));
+}
+
+void TestFrameBands::test_changedBands() {
+	FrameBands bands(32);
+	auto data = ramp();
+	bands.update(frame(data)->primary_hdu());
+
+	// Same frame
+	QVERIFY(bands.update(frame(data)->primary_hdu()).empty());
+
+	// Rows 40 and 99 are in the second and the last, shorter, band
+	data[40 * width + 3] = 5000.0f;
+	data[99 * width] = -1.0f;
+	auto changed = bands.update(frame(data)->primary_hdu());
+	QCOMPARE(changed.size(), std::size_t(2));
+	QCOMPARE(changed[0].first_row, quint64(32));
+	QCOMPARE(changed[0].rows, quint64(32));
+	QCOMPARE(changed[1].first_row, quint64(96));
+	QCOMPARE(changed[1].rows, quint64(4));
+
+	// Adjacent bands are merged
+	data[70 * width] = 1.0f;
+	data[90 * width] = 2.0f;
+	data[99 * width] = -2.0f;
+	changed = bands.update(frame(data)->primary_hdu());
+	QCOMPARE(changed.size(), std::size_t(1));
+	QCOMPARE(changed[0].first_row, quint64(64));
+	QCOMPARE(changed[0].rows, quint64(36));
+}
+
+void TestFrameBands::test_minmax() {
+	FrameBands bands(32);
+	auto data = ramp();
+	data[5] = std::numeric_limits<float>::quiet_NaN();
+	bands.update(frame(data)->primary_hdu());
+	QCOMPARE(bands.minmax(), std::make_pair(0.0, 999.0));
+
+	// Extremes of the unchanged bands are kept
+	data[50 * width] = -7.0f;
+	bands.update(frame(data)->primary_hdu());
+	QCOMPARE(bands.minmax(), std::make_pair(-7.0, 999.0));
+
+	// Extremes of the changed band are rescanned
+	data[50 * width] = 500.0f;
+	bands.update(frame(data)->primary_hdu());
+	QCOMPARE(bands.minmax(), std::make_pair(0.0, 999.0));
+
+	// Image of NaN only
+	std::fill(data.begin(), data.end(), std::numeric_limits<float>::quiet_NaN());
+	bands.update(frame(data)->primary_hdu());
+	QCOMPARE(bands.minmax(), std::make_pair(0.0, 0.0));
+}
+
+void TestFrameBands::test_shapeChange() {
+	FrameBands bands(32);
+	auto data = ramp();
+	bands.update(frame(data)->primary_hdu());
+
+	// Same bytes of another shape
+	const auto changed = bands.update(frame(data, height / 2)->primary_hdu());
+	QCOMPARE(bands.size(), std::size_t(2));
+	QCOMPARE(changed.size(), std::size_t(1));
+	QCOMPARE(changed[0].rows, quint64(height / 2));
+	QCOMPARE(bands.minmax(), std::make_pair(0.0, 499.0));
+}
+
+QTEST_MAIN(TestFrameBands)
+#include "framebands.moc"
@@ -0,0 +1,63 @@
+#include <QtTest/QtTest>
+
+#include <framescheduler.h>
+
+class TestFrameScheduler: public QObject
+{
+Q_OBJECT
+private slots:
+	void test_coalesce();
+	void test_skip();
+	void test_request_during_frame();
+	void test_dropped();
+};
+
+void TestFrameScheduler::test_coalesce() {
+	FrameScheduler fs;
+	QVERIFY(fs.request(FrameScheduler::ViewDirty, 0));
+	QVERIFY(!fs.request(FrameScheduler::ViewDirty, 1));
+	QVERIFY(!fs.request(FrameScheduler::LevelsDirty, 2));
+	QCOMPARE(fs.beginFrame(), FrameScheduler::ViewDirty | FrameScheduler::LevelsDirty);
+	QCOMPARE(fs.requested(), static_cast<quint64>(3));
+	QCOMPARE(fs.coalesced(), static_cast<quint64>(2));
+	QCOMPARE(fs.rendered(), static_cast<quint64>(1));
+}
+
+void TestFrameScheduler::test_skip() {
+	FrameScheduler fs;
+	QCOMPARE(fs.beginFrame(), 0);
+	fs.markDirty(FrameScheduler::SurfaceDirty);
+	QCOMPARE(fs.beginFrame(), static_cast<int>(FrameScheduler::SurfaceDirty));
+	QCOMPARE(fs.beginFrame(), 0);
+	QCOMPARE(fs.skipped(), static_cast<quint64>(2));
+	QCOMPARE(fs.rendered(), static_cast<quint64>(1));
+}
+
+void TestFrameScheduler::test_request_during_frame() {
+	FrameScheduler fs;
+	QVERIFY(fs.request(FrameScheduler::ViewDirty, 0));
+	fs.beginFrame();
+	// The frame has been taken already, new change needs a new frame
+	QVERIFY(fs.request(FrameScheduler::LevelsDirty, 1));
+	fs.frameSwapped(2);
+	QCOMPARE(fs.beginFrame(), static_cast<int>(FrameScheduler::LevelsDirty));
+}
+
+void TestFrameScheduler::test_dropped() {
+	FrameScheduler fs;
+	fs.setRefreshRate(100.0);
+	const qint64 interval = 10000000;
+
+	fs.request(FrameScheduler::ViewDirty, 0);
+	fs.beginFrame();
+	fs.frameSwapped(interval);
+	QCOMPARE(fs.dropped(), static_cast<quint64>(0));
+
+	fs.request(FrameScheduler::ViewDirty, 2 * interval);
+	fs.beginFrame();
+	fs.frameSwapped(5 * interval + 1);
+	QCOMPARE(fs.dropped(), static_cast<quint64>(3));
+}
+
+QTEST_MAIN(TestFrameScheduler)
+#include "framescheduler.moc"
@@ -0,0 +1,219 @@
+#include <QtTest/QtTest>
+
+#include <cstring>
+#include <iterator>
+#include <memory>
+
+#include <zlib.h>
+
+#include <fits.h>
+#include <gzipfitsstorage.h>
+
+#include "fitsbuilder.h"
+
+class TestGzipFITSStorage: public QObject
+{
+	Q_OBJECT
+private:
+	QTemporaryDir directory_;
+	QByteArray fits_;
+
+	QString write(const QString& name, const QByteArray& data) const;
+	QString indexDirectory() const { return directory_.path() + "/index"; }
+private slots:
+	void initTestCase();
+	void test_inflate();
+	void test_partial();
+	void test_firstImage();
+	void test_wholeFile();
+	void test_bgzf();
+	void test_corrupted();
+};
+
+namespace {
+	/* Empty primary HDU, small BITPIX=16 image and large BITPIX=8 image,
+	 * which is longer than the span of the seek points */
+	QByteArray makeFITS() {
+		QByteArray large(FITSBuilder::large_width * FITSBuilder::large_height, '\0');
+		quint32 x = 1;
+		for (int i = 0; i < large.size(); ++i) {
+			x = x * 1103515245 + 12345;
+			large[i] = static_cast<char>((x >> 16) % 4 + (i / 4096) % 64);
+		}
+		return FITSBuilder::threeImages(large);
+	}
+
+	// Single gzip member, with BGZF block size subfield when bgzf is set
+	QByteArray gzipMember(const char* data, int size, bool bgzf) {
+		z_stream strm;
+		std::memset(&strm, 0, sizeof(strm));
+		deflateInit2(&strm, 6, Z_DEFLATED, 31, 8, Z_DEFAULT_STRATEGY);
+
+		gz_header header;
+		std::memset(&header, 0, sizeof(header));
+		unsigned char extra[6] = {'B', 'C', 2, 0, 0, 0};
+		if (bgzf) {
+			header.extra = extra;
+			header.extra_len = sizeof(extra);
+			deflateSetHeader(&strm, &header);
+		}
+
+		QByteArray member(static_cast<int>(deflateBound(&strm, size)) + 64, '\0');
+		strm.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+		strm.avail_in = size;
+		strm.next_out = reinterpret_cast<Bytef*>(member.data());
+		strm.avail_out = member.size();
+		deflate(&strm, Z_FINISH);
+		member.resize(strm.total_out);
+		deflateEnd(&strm);
+
+		if (bgzf) {
+			const int block_size = member.size() - 1;
+			member[16] = static_cast<char>(block_size & 0xff);
+			member[17] = static_cast<char>(block_size >> 8);
+		}
+		return member;
+	}
+
+	QByteArray gzip(const QByteArray& data, bool bgzf = false) {
+		if (!bgzf)
+			return gzipMember(data.constData(), data.size(), false);
+
+		QByteArray members;
+		for (int offset = 0; offset < data.size(); offset += 60000) {
+			members += gzipMember(data.constData() + offset, std::min(60000, data.size() - offset), true);
+		}
+		return members;
+	}
+
+	std::unique_ptr<GzipFITSStorage> open(const QString& filename, int hdu_index, const QString& index_directory) {
+		std::unique_ptr<QFile> file{new QFile(filename)};
+		if (!file->open(QIODevice::ReadOnly))
+			return std::unique_ptr<GzipFITSStorage>();
+		return std::unique_ptr<GzipFITSStorage>(new GzipFITSStorage(file.release(), hdu_index, index_directory));
+	}
+}
+
+QString TestGzipFITSStorage::write(const QString& name, const QByteArray& data) const {
+	const QString filename = directory_.path() + "/" + name;
+	QFile file(filename);
+	if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size())
+		return QString();
+	return filename;
+}
+
+void TestGzipFITSStorage::initTestCase() {
+	QVERIFY(directory_.isValid());
+	fits_ = makeFITS();
+}
+
+void TestGzipFITSStorage::test_inflate() {
+	const auto filename = write("inflate.fits.gz", gzip(fits_));
+	QVERIFY(!filename.isEmpty());
+
+	auto storage = open(filename, 2, indexDirectory());
+	QVERIFY(storage);
+	QVERIFY(!storage->isPartial());
+	QCOMPARE(storage->size(), static_cast<qint64>(fits_.size()));
+	QVERIFY(std::memcmp(storage->data(), fits_.constData(), fits_.size()) == 0);
+	// Storage buffer is page-aligned
+	QCOMPARE(reinterpret_cast<quintptr>(storage->data()) % 4096, quintptr(0));
+
+	const auto& index = storage->index();
+	QCOMPARE(index.units.size(), std::size_t(3));
+	QVERIFY(!index.units[0].image);
+	QVERIFY(index.units[1].image);
+	QCOMPARE(index.units[2].end, static_cast<quint64>(fits_.size()));
+	// The large image spans a seek point inside the stream
+	QVERIFY(index.points.size() > 1);
+	QVERIFY(!index.points.back().member);
+	QCOMPARE(index.points.back().window.size(), 32768);
+
+	FITS fits(storage.release());
+	QCOMPARE(static_cast<int>(std::distance(fits.begin(), fits.end())), 2);
+}
+
+void TestGzipFITSStorage::test_partial() {
+	const auto filename = write("partial.fits.gz", gzip(fits_));
+	QVERIFY(!filename.isEmpty());
+	open(filename, -1, indexDirectory());
+
+	auto storage = open(filename, 2, indexDirectory());
+	QVERIFY(storage);
+	QVERIFY(storage->isPartial());
+
+	const auto& units = storage->index().units;
+	const auto data = storage->data();
+	// Headers and the data of the requested HDU only
+	for (const auto& unit: units) {
+		QVERIFY(std::memcmp(data + unit.begin, fits_.constData() + unit.begin, unit.data - unit.begin) == 0);
+	}
+	QVERIFY(std::memcmp(data + units[2].data, fits_.constData() + units[2].data, units[2].end - units[2].data) == 0);
+	QCOMPARE(data[units[1].data + 1], quint8(0));
+
+	FITS fits(storage.release());
+	const auto& hdu = *std::next(fits.begin());
+	QCOMPARE(hdu.data().imageDataUnit()->size(), QSize(FITSBuilder::large_width, FITSBuilder::large_height));
+}
+
+void TestGzipFITSStorage::test_firstImage() {
+	const auto filename = write("first.fits.gz", gzip(fits_));
+	QVERIFY(!filename.isEmpty());
+	open(filename, 2, indexDirectory());
+
+	// The following HDUs are not included
+	auto storage = open(filename, -1, indexDirectory());
+	QVERIFY(storage);
+	QVERIFY(storage->isPartial());
+	QCOMPARE(static_cast<quint64>(storage->size()), storage->index().units[1].end);
+
+	FITS fits(storage.release());
+	QCOMPARE(static_cast<int>(std::distance(fits.begin(), fits.end())), 1);
+	QCOMPARE(fits.begin()->data().imageDataUnit()->size(), QSize(20, 10));
+}
+
+void TestGzipFITSStorage::test_wholeFile() {
+	const auto filename = write("whole.fits.gz", gzip(fits_));
+	QVERIFY(!filename.isEmpty());
+
+	// The second open inflates from the index saved by the first one, both
+	// see every HDU as the viewer needs
+	for (int i = 0; i < 2; ++i) {
+		auto storage = open(filename, GzipFITSStorage::whole_file, indexDirectory());
+		QVERIFY(storage);
+		QVERIFY(!storage->isPartial());
+		QCOMPARE(storage->size(), static_cast<qint64>(fits_.size()));
+		QVERIFY(std::memcmp(storage->data(), fits_.constData(), fits_.size()) == 0);
+
+		FITS fits(storage.release());
+		QCOMPARE(static_cast<int>(std::distance(fits.begin(), fits.end())), 2);
+	}
+}
+
+void TestGzipFITSStorage::test_bgzf() {
+	const auto filename = write("bgzf.fits.gz", gzip(fits_, true));
+	QVERIFY(!filename.isEmpty());
+
+	// Without the index every member is a seek point
+	auto storage = open(filename, -1, QString());
+	QVERIFY(storage);
+	QVERIFY(!storage->isPartial());
+	QCOMPARE(storage->index().points.size(), static_cast<std::size_t>((fits_.size() + 59999) / 60000));
+	QCOMPARE(storage->size(), static_cast<qint64>(fits_.size()));
+	QVERIFY(std::memcmp(storage->data(), fits_.constData(), fits_.size()) == 0);
+}
+
+void TestGzipFITSStorage::test_corrupted() {
+	const auto compressed = gzip(fits_);
+	const auto filename = write("truncated.fits.gz", compressed.left(compressed.size() / 2));
+	QVERIFY(!filename.isEmpty());
+
+	QFile file(filename);
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	QVERIFY(GzipFITSStorage::isGzip(&file));
+
+	QVERIFY_EXCEPTION_THROWN(open(filename, -1, QString()), GzipFITSStorage::Exception);
+}
+
+QTEST_MAIN(TestGzipFITSStorage)
+#include "gzipfitsstorage.moc"
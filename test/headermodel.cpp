@@ -0,0 +1,134 @@
+#include <QtTest/QtTest>
+#include <QFile>
+
+#include <memory>
+#include <vector>
+
+#include <headermodel.h>
+#include <memoryfitsstorage.h>
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+class TestHeaderModel: public QObject
+{
+	Q_OBJECT
+private slots:
+	void test_cards();
+	void test_parseCard();
+	void test_find();
+	void test_longHeader();
+	void test_tileCompressed();
+};
+
+namespace {
+	std::shared_ptr<const FITS> openFITS(const QString& filename) {
+		std::unique_ptr<QFile> file{new QFile(filename)};
+		if (!file->open(QIODevice::ReadOnly))
+			return std::shared_ptr<const FITS>();
+		return std::make_shared<const FITS>(file.release());
+	}
+
+	std::shared_ptr<const FITS::HeaderDataUnit> primaryHDU(std::shared_ptr<const FITS> fits) {
+		return std::shared_ptr<const FITS::HeaderDataUnit>(fits, &fits->primary_hdu());
+	}
+
+	QString cardText(const HeaderModel& model, int row, int column) {
+		return model.data(model.index(row, column)).toString();
+	}
+}
+
+void TestHeaderModel::test_cards() {
+	auto fits = openFITS(DATA_ROOT "/sombrero8.fits");
+	QVERIFY(fits);
+
+	HeaderModel model(primaryHDU(fits));
+	// END is not shown
+	QCOMPARE(model.rowCount(), 6);
+	QCOMPARE(model.columnCount(), static_cast<int>(HeaderModel::ColumnCount));
+	QCOMPARE(cardText(model, 0, HeaderModel::KeywordColumn), QString("SIMPLE"));
+	QCOMPARE(cardText(model, 0, HeaderModel::ValueColumn), QString("T"));
+	QCOMPARE(cardText(model, 0, HeaderModel::CommentColumn), QString("conforms to FITS standard"));
+	QCOMPARE(cardText(model, 3, HeaderModel::KeywordColumn), QString("NAXIS1"));
+	QCOMPARE(cardText(model, 3, HeaderModel::ValueColumn), QString("800"));
+	QCOMPARE(cardText(model, 3, HeaderModel::CommentColumn), QString());
+	QCOMPARE(model.data(model.index(3, 0), Qt::ToolTipRole).toString().size(), 80);
+	QCOMPARE(model.headerData(0, Qt::Vertical).toInt(), 1);
+}
+
+void TestHeaderModel::test_parseCard() {
+	const auto card = [] (const QString& text) { return text.leftJustified(80, ' ', true).toLatin1(); };
+
+	auto parsed = HeaderModel::parseCard(card("OBJECT  = 'M 31 / the core''s' / the target").constData());
+	QCOMPARE(parsed.keyword, QString("OBJECT"));
+	QCOMPARE(parsed.value, QString("'M 31 / the core''s'"));
+	QCOMPARE(parsed.comment, QString("the target"));
+
+	parsed = HeaderModel::parseCard(card("EXPTIME =                 60.0 / [s]").constData());
+	QCOMPARE(parsed.value, QString("60.0"));
+	QCOMPARE(parsed.comment, QString("[s]"));
+
+	parsed = HeaderModel::parseCard(card("HISTORY flat fielded = divided / by the mean").constData());
+	QCOMPARE(parsed.keyword, QString("HISTORY"));
+	QCOMPARE(parsed.value, QString("flat fielded = divided / by the mean"));
+	QCOMPARE(parsed.comment, QString());
+
+	// Unterminated string takes the rest of the card
+	parsed = HeaderModel::parseCard(card("OBJECT  = 'M 31 / core").constData());
+	QCOMPARE(parsed.value, QString("'M 31 / core"));
+	QCOMPARE(parsed.comment, QString());
+
+	parsed = HeaderModel::parseCard(card("").constData());
+	QCOMPARE(parsed.keyword, QString());
+	QCOMPARE(parsed.value, QString());
+}
+
+void TestHeaderModel::test_find() {
+	auto fits = openFITS(DATA_ROOT "/sombrero8.fits");
+	QVERIFY(fits);
+	HeaderModel model(primaryHDU(fits));
+
+	QCOMPARE(model.find("naxis", 0), 2);
+	QCOMPARE(model.find("NAXIS", 3), 3);
+	QCOMPARE(model.find("naxis", 5), 2);
+	QCOMPARE(model.find("naxis", 1, -1), 4);
+	QCOMPARE(model.find("standard", 3), 0);
+	QCOMPARE(model.find("fits standard", -1), 0);
+	QCOMPARE(model.find("M31", 0), -1);
+	QCOMPARE(model.find(QByteArray(), 0), -1);
+	QCOMPARE(model.find(QByteArray(81, ' '), 0), -1);
+	// Matches do not span the cards
+	QCOMPARE(model.find("800NAXIS2", 0), -1);
+}
+
+void TestHeaderModel::test_longHeader() {
+	const int count = 20000;
+	MemoryFITSStorage::cards_type cards;
+	for (int i = 0; i < count; ++i) {
+		cards.emplace_back(QString("KEY%1").arg(i, 5, 10, QChar('0')), QString::number(i));
+	}
+	const std::vector<float> data(4 * 3, 0.0f);
+	std::shared_ptr<const FITS> fits = MemoryFITSStorage::createFloatImage(QSize(4, 3), data.data(), cards);
+
+	HeaderModel model(primaryHDU(fits));
+	QCOMPARE(model.rowCount(), 5 + count);
+	QCOMPARE(cardText(model, 5 + 12345, HeaderModel::KeywordColumn), QString("KEY12345"));
+	QCOMPARE(cardText(model, 5 + 12345, HeaderModel::ValueColumn), QString("12345"));
+	QCOMPARE(model.find("key19999", 0), 5 + 19999);
+	QCOMPARE(model.find("key00000", 5 + 1, -1), 5);
+}
+
+void TestHeaderModel::test_tileCompressed() {
+	auto fits = openFITS(DATA_ROOT "/tiles.fits");
+	QVERIFY(fits);
+
+	// The cards of the table rather than the keywords of the image
+	const auto& hdu = *fits->begin();
+	HeaderModel model(std::shared_ptr<const FITS::HeaderDataUnit>(fits, &hdu));
+	QCOMPARE(model.rowCount(), 31);
+	QCOMPARE(cardText(model, 0, HeaderModel::KeywordColumn), QString("XTENSION"));
+	QVERIFY(model.find("ZBITPIX", 0) >= 0);
+	QCOMPARE(hdu.header().header("BITPIX"), QString("16"));
+}
+
+QTEST_MAIN(TestHeaderModel)
+#include "headermodel.moc"
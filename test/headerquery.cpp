@@ -0,0 +1,85 @@
+#include <QtTest/QtTest>
+
+#include <map>
+
+#include <headerquery.h>
+
+class TestHeaderQuery: public QObject
+{
+	Q_OBJECT
+private slots:
+	void test_parse();
+	void test_wrongCondition();
+	void test_numbers();
+	void test_strings();
+	void test_matches();
+};
+
+namespace {
+	// Raw values as FITS::HeaderUnit keeps them
+	const std::map<QString, QString> cards = {
+		{"EXPTIME", "120.0"},
+		{"GAIN", "1.5D0"},
+		{"FILTER", "'R       '"},
+		{"OBJECT", "'M 31'"},
+		{"SIMPLE", "T"}};
+}
+
+void TestHeaderQuery::test_parse() {
+	auto condition = HeaderQuery::parseCondition("exptime>=60");
+	QCOMPARE(condition.key, QString("EXPTIME"));
+	QCOMPARE(condition.op, HeaderQuery::GreaterOrEqual);
+	QCOMPARE(condition.value, QString("60"));
+
+	condition = HeaderQuery::parseCondition(" OBJECT != 'M 31' ");
+	QCOMPARE(condition.key, QString("OBJECT"));
+	QCOMPARE(condition.op, HeaderQuery::NotEqual);
+	QCOMPARE(condition.value, QString("M 31"));
+
+	condition = HeaderQuery::parseCondition("DATE-OBS<2019-01-01");
+	QCOMPARE(condition.key, QString("DATE-OBS"));
+	QCOMPARE(condition.op, HeaderQuery::Less);
+	QCOMPARE(condition.value, QString("2019-01-01"));
+}
+
+void TestHeaderQuery::test_wrongCondition() {
+	QVERIFY_EXCEPTION_THROWN(HeaderQuery::parseCondition("EXPTIME"), HeaderQuery::Exception);
+	QVERIFY_EXCEPTION_THROWN(HeaderQuery::parseCondition("=60"), HeaderQuery::Exception);
+	QVERIFY_EXCEPTION_THROWN(HeaderQuery(QStringList() << "FILTER=R" << "EXPTIME"), HeaderQuery::Exception);
+}
+
+void TestHeaderQuery::test_numbers() {
+	// Compared as numbers, not as strings
+	QVERIFY(HeaderQuery::holds(HeaderQuery::parseCondition("EXPTIME>60"), "120.0"));
+	QVERIFY(HeaderQuery::holds(HeaderQuery::parseCondition("EXPTIME=120"), "120.0"));
+	QVERIFY(!HeaderQuery::holds(HeaderQuery::parseCondition("EXPTIME<=100"), "120.0"));
+	QVERIFY(HeaderQuery::holds(HeaderQuery::parseCondition("GAIN=1.5"), "1.5D0"));
+
+	double number = 0;
+	QVERIFY(HeaderQuery::toNumber("-2.5E-3", &number));
+	QCOMPARE(number, -2.5e-3);
+	QVERIFY(!HeaderQuery::toNumber("'60'", &number));
+	QVERIFY(!HeaderQuery::toNumber("T", &number));
+}
+
+void TestHeaderQuery::test_strings() {
+	QVERIFY(HeaderQuery::holds(HeaderQuery::parseCondition("FILTER=R"), "'R       '"));
+	QVERIFY(HeaderQuery::holds(HeaderQuery::parseCondition("FILTER=r"), "'R       '"));
+	QVERIFY(!HeaderQuery::holds(HeaderQuery::parseCondition("FILTER=V"), "'R       '"));
+	QVERIFY(HeaderQuery::holds(HeaderQuery::parseCondition("DATE-OBS<2019-01-01"), "'2018-12-31T23:59:59'"));
+	QVERIFY(HeaderQuery::holds(HeaderQuery::parseCondition("SIMPLE=T"), "T"));
+}
+
+void TestHeaderQuery::test_matches() {
+	QVERIFY(HeaderQuery().matches(cards));
+	QVERIFY(HeaderQuery(QStringList() << "FILTER=R" << "EXPTIME>60").matches(cards));
+	QVERIFY(!HeaderQuery(QStringList() << "FILTER=R" << "EXPTIME>600").matches(cards));
+	QVERIFY(HeaderQuery(QStringList() << "OBJECT='M 31'").matches(cards));
+
+	// Missing keyword does not satisfy any condition
+	QVERIFY(!HeaderQuery(QStringList() << "AIRMASS<2").matches(cards));
+	QVERIFY(!HeaderQuery(QStringList() << "AIRMASS!=2").matches(cards));
+}
+
+QTEST_MAIN(TestHeaderQuery)
+#include "headerquery.moc"
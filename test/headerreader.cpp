@@ -0,0 +1,196 @@
+#include <QtTest/QtTest>
+#include <QFile>
+
+#include <iterator>
+#include <memory>
+
+#include <zlib.h>
+
+#include <fits.h>
+#include <headerreader.h>
+
+#include "fitsbuilder.h"
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+class TestHeaderReader: public QObject
+{
+	Q_OBJECT
+private:
+	QTemporaryDir directory_;
+
+	QString manyHDUs() const { return directory_.path() + "/many.fits"; }
+private slots:
+	void initTestCase();
+	void test_sameAsFITS_data();
+	void test_sameAsFITS();
+	void test_offsets();
+	void test_maxCount();
+	void test_gzip();
+	void test_unexpectedEnd();
+	void benchmark_headerReader();
+	void benchmark_fullFITS();
+	void benchmark_readFile();
+};
+
+namespace {
+	const int many_count = 64;
+	const int many_width = 1024, many_height = 1024;
+
+	std::unique_ptr<FITS> openFITS(const QString& filename) {
+		std::unique_ptr<QFile> file{new QFile(filename)};
+		if (!file->open(QIODevice::ReadOnly))
+			return std::unique_ptr<FITS>();
+		return std::unique_ptr<FITS>(new FITS(file.release()));
+	}
+
+	/* Empty primary HDU and many_count BITPIX=16 images. The data is
+	 * written, not left sparse, so the baselines read real pages. */
+	bool writeManyHDUs(const QString& filename) {
+		QFile file(filename);
+		if (!file.open(QIODevice::WriteOnly))
+			return false;
+
+		const QByteArray primary = FITSBuilder::header({"SIMPLE  =                    T", "BITPIX  =                   16", "NAXIS   =                    0", "EXTEND  =                    T"});
+		if (file.write(primary) != primary.size())
+			return false;
+
+		QByteArray data(many_width * many_height * 2, '\0');
+		for (int i = 0; i < data.size(); ++i) {
+			data[i] = static_cast<char>(i % 251);
+		}
+		data = FITSBuilder::padded(data);
+		for (int i = 0; i < many_count; ++i) {
+			const QByteArray header = FITSBuilder::header({"XTENSION= 'IMAGE   '", "BITPIX  =                   16", "NAXIS   =                    2",
+					FITSBuilder::card("NAXIS1", many_width), FITSBuilder::card("NAXIS2", many_height), QString("EXTNAME = 'FRAME%1'").arg(i)});
+			if (file.write(header) != header.size() || file.write(data) != data.size())
+				return false;
+		}
+		return true;
+	}
+}
+
+void TestHeaderReader::initTestCase() {
+	QVERIFY(directory_.isValid());
+	// The index of the gzip-compressed file is not saved into the user cache
+	QStandardPaths::setTestModeEnabled(true);
+	QVERIFY(writeManyHDUs(manyHDUs()));
+}
+
+void TestHeaderReader::test_sameAsFITS_data() {
+	QTest::addColumn<QString>("filename");
+
+	// Tile-compressed images are not here, since FITS replaces their headers
+	QTest::newRow("image") << DATA_ROOT "/sombrero8.fits";
+	QTest::newRow("table") << DATA_ROOT "/table.fits";
+	QTest::newRow("float") << DATA_ROOT "/sombrero-32.fits";
+}
+
+void TestHeaderReader::test_sameAsFITS() {
+	QFETCH(QString, filename);
+
+	const auto hdus = HeaderReader::read(filename);
+	const auto fits = openFITS(filename);
+	QVERIFY(fits);
+
+	QCOMPARE(hdus.size(), std::size_t(1 + std::distance(fits->begin(), fits->end())));
+	QVERIFY(hdus[0].header.headers() == fits->header_unit().headers());
+	auto it = fits->begin();
+	for (std::size_t i = 1; i < hdus.size(); ++i, ++it) {
+		QVERIFY(hdus[i].header.headers() == it->header().headers());
+	}
+}
+
+void TestHeaderReader::test_offsets() {
+	const auto hdus = HeaderReader::read(DATA_ROOT "/table.fits");
+	// Empty primary HDU, binary table and image
+	QCOMPARE(hdus.size(), std::size_t(3));
+
+	QCOMPARE(hdus[0].offset, quint64(0));
+	QCOMPARE(hdus[0].data_length, quint64(0));
+	QCOMPARE(hdus[1].offset, hdus[0].data_offset);
+	QCOMPARE(FITS::HeaderUnit::unquoted(hdus[1].header.header("XTENSION")), QString("BINTABLE"));
+	QCOMPARE(hdus[1].data_length, hdus[1].header.header_as<quint64>("NAXIS1") * hdus[1].header.header_as<quint64>("NAXIS2") + hdus[1].header.header_as<quint64>("PCOUNT", 0));
+	QCOMPARE(hdus[2].offset, hdus[1].data_offset + (hdus[1].data_length + 2879) / 2880 * 2880);
+	QCOMPARE(hdus[2].data_length, quint64(4 * 3 * 2));
+	QVERIFY(hdus[2].data_offset + hdus[2].data_length <= static_cast<quint64>(QFileInfo(DATA_ROOT "/table.fits").size()));
+}
+
+void TestHeaderReader::test_maxCount() {
+	const auto hdus = HeaderReader::read(DATA_ROOT "/table.fits", 1);
+	QCOMPARE(hdus.size(), std::size_t(1));
+}
+
+void TestHeaderReader::test_gzip() {
+	QFile file(DATA_ROOT "/table.fits");
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	const auto data = file.readAll();
+
+	const QString filename = directory_.path() + "/table.fits.gz";
+	gzFile gz = gzopen(QFile::encodeName(filename).constData(), "wb");
+	QVERIFY(gz);
+	QCOMPARE(gzwrite(gz, data.constData(), data.size()), data.size());
+	gzclose(gz);
+
+	const auto hdus = HeaderReader::read(filename);
+	const auto expected = HeaderReader::read(DATA_ROOT "/table.fits");
+	QCOMPARE(hdus.size(), expected.size());
+	for (std::size_t i = 0; i < hdus.size(); ++i) {
+		QCOMPARE(hdus[i].offset, expected[i].offset);
+		QCOMPARE(hdus[i].data_length, expected[i].data_length);
+		QVERIFY(hdus[i].header.headers() == expected[i].header.headers());
+	}
+}
+
+void TestHeaderReader::test_unexpectedEnd() {
+	QVERIFY_EXCEPTION_THROWN(HeaderReader::read(DATA_ROOT "/header_unexpected_end.fits"), FITS::Exception);
+	QVERIFY_EXCEPTION_THROWN(HeaderReader::read(directory_.path() + "/missing.fits"), FITS::Exception);
+}
+
+void TestHeaderReader::benchmark_headerReader() {
+	std::size_t count = 0;
+	QBENCHMARK {
+		count = HeaderReader::read(manyHDUs()).size();
+	}
+	QCOMPARE(count, std::size_t(1 + many_count));
+}
+
+// Baseline of opening the file with FITS and touching every data page
+void TestHeaderReader::benchmark_fullFITS() {
+	std::size_t count = 0;
+	quint64 sum = 0;
+	QBENCHMARK {
+		const auto fits = openFITS(manyHDUs());
+		QVERIFY(fits);
+		count = 1;
+		for (const auto& hdu: *fits) {
+			const auto data = hdu.data().data();
+			for (quint64 i = 0; i < hdu.data().length(); i += 4096) {
+				sum += data[i];
+			}
+			++count;
+		}
+	}
+	QCOMPARE(count, std::size_t(1 + many_count));
+	QVERIFY(sum > 0);
+}
+
+// Baseline of reading the whole file
+void TestHeaderReader::benchmark_readFile() {
+	QFile file(manyHDUs());
+	QVERIFY(file.open(QIODevice::ReadOnly | QIODevice::Unbuffered));
+	QByteArray buffer(1 << 20, Qt::Uninitialized);
+	qint64 total = 0;
+	QBENCHMARK {
+		QVERIFY(file.seek(0));
+		total = 0;
+		qint64 read;
+		while ((read = file.read(buffer.data(), buffer.size())) > 0) {
+			total += read;
+		}
+	}
+	QCOMPARE(total, file.size());
+}
+
+QTEST_MAIN(TestHeaderReader)
+#include "headerreader.moc"
@@ -0,0 +1,264 @@
+#include <QtTest/QtTest>
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <memory>
+
+#include <fits.h>
+#include <httpfitsstorage.h>
+
+#include "fitsbuilder.h"
+
+namespace {
+	/* Minimal HTTP/1.1 server of a single file, answering HEAD and GET with
+	 * optional Range, runs in its own thread as the storage blocks the
+	 * caller while it fetches. */
+	class RangeServer: public QThread {
+	private:
+		mutable QMutex mutex_;
+		QByteArray content_;
+		QByteArray etag_;
+		bool ranges_;
+		int heads_;
+		int gets_;
+		quint16 port_;
+		QSemaphore listening_;
+
+		QByteArray respond(const QByteArray& request) {
+			QMutexLocker locker(&mutex_);
+
+			const auto lines = request.split('\n');
+			const auto request_line = lines.front().trimmed().split(' ');
+			QByteArray range;
+			for (const auto& line: lines) {
+				if (line.toLower().startsWith("range:"))
+					range = line.mid(6).trimmed();
+			}
+
+			if (request_line.value(1) != "/file.fits")
+				return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+
+			const QByteArray headers = "ETag: " + etag_ + "\r\nLast-Modified: Tue, 01 Jan 2019 00:00:00 GMT\r\n";
+			if (request_line.front() == "HEAD") {
+				++heads_;
+				return "HTTP/1.1 200 OK\r\n" + headers + "Content-Length: " + QByteArray::number(content_.size()) + "\r\n\r\n";
+			}
+
+			++gets_;
+			if (!ranges_ || !range.startsWith("bytes="))
+				return "HTTP/1.1 200 OK\r\n" + headers + "Content-Length: " + QByteArray::number(content_.size()) + "\r\n\r\n" + content_;
+
+			const auto bounds = range.mid(6).split('-');
+			const int begin = bounds.value(0).toInt();
+			const int end = std::min(bounds.value(1).toInt() + 1, content_.size());
+			return "HTTP/1.1 206 Partial Content\r\n" + headers +
+				"Content-Range: bytes " + QByteArray::number(begin) + "-" + QByteArray::number(end - 1) + "/" + QByteArray::number(content_.size()) + "\r\n" +
+				"Content-Length: " + QByteArray::number(end - begin) + "\r\n\r\n" + content_.mid(begin, end - begin);
+		}
+	protected:
+		virtual void run() override {
+			QTcpServer server;
+			server.listen(QHostAddress::LocalHost);
+			port_ = server.serverPort();
+
+			QObject::connect(&server, &QTcpServer::newConnection, [this, &server] () {
+				auto socket = server.nextPendingConnection();
+				auto buffer = std::make_shared<QByteArray>();
+				QObject::connect(socket, &QTcpSocket::readyRead, [this, socket, buffer] () {
+					*buffer += socket->readAll();
+					for (int end; (end = buffer->indexOf("\r\n\r\n")) >= 0; ) {
+						socket->write(respond(buffer->left(end)));
+						buffer->remove(0, end + 4);
+					}
+				});
+				QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+			});
+
+			listening_.release();
+			exec();
+		}
+	public:
+		explicit RangeServer(const QByteArray& content):
+			content_(content),
+			etag_("\"1\""),
+			ranges_(true),
+			heads_(0),
+			gets_(0),
+			port_(0) {
+
+			start();
+			listening_.acquire();
+		}
+		virtual ~RangeServer() override {
+			quit();
+			wait();
+		}
+
+		QString url(const QString& path = QString("/file.fits")) const {
+			return QString("http://127.0.0.1:%1%2").arg(port_).arg(path);
+		}
+		void setETag(const QByteArray& etag) {
+			QMutexLocker locker(&mutex_);
+			etag_ = etag;
+		}
+		void setRanges(bool ranges) {
+			QMutexLocker locker(&mutex_);
+			ranges_ = ranges;
+		}
+		int heads() const {
+			QMutexLocker locker(&mutex_);
+			return heads_;
+		}
+		int gets() const {
+			QMutexLocker locker(&mutex_);
+			return gets_;
+		}
+	};
+
+	/* Empty primary HDU, small BITPIX=16 image and large BITPIX=8 image,
+	 * which spans several blocks */
+	QByteArray makeFITS() {
+		QByteArray large(FITSBuilder::large_width * FITSBuilder::large_height, '\0');
+		for (int i = 0; i < large.size(); ++i) {
+			large[i] = static_cast<char>((i * 7 + i / 4096) % 253);
+		}
+		return FITSBuilder::threeImages(large);
+	}
+}
+
+class TestHttpFITSStorage: public QObject
+{
+	Q_OBJECT
+private:
+	QTemporaryDir directory_;
+	QByteArray fits_;
+
+	QString cacheDirectory() const { return directory_.path() + "/cache"; }
+	bool sameData(const HttpFITSStorage& storage, int hdu_index) const;
+private slots:
+	void initTestCase();
+	void test_isUrl();
+	void test_partial();
+	void test_parallel();
+	void test_wholeFile();
+	void test_cache();
+	void test_staleCache();
+	void test_noRanges();
+	void test_missing();
+};
+
+bool TestHttpFITSStorage::sameData(const HttpFITSStorage& storage, int hdu_index) const {
+	const auto& unit = storage.units()[hdu_index];
+	return std::memcmp(storage.data() + unit.begin, fits_.constData() + unit.begin, unit.end - unit.begin) == 0;
+}
+
+void TestHttpFITSStorage::initTestCase() {
+	QVERIFY(directory_.isValid());
+	fits_ = makeFITS();
+	QVERIFY(static_cast<quint64>(fits_.size()) > 4 * HttpFITSStorage::block_size);
+}
+
+void TestHttpFITSStorage::test_isUrl() {
+	QVERIFY(HttpFITSStorage::isUrl("http://fips.space/file.fits"));
+	QVERIFY(HttpFITSStorage::isUrl("https://fips.space/file.fits"));
+	QVERIFY(!HttpFITSStorage::isUrl("/data/file.fits"));
+	QVERIFY(!HttpFITSStorage::isUrl("file.fits"));
+}
+
+void TestHttpFITSStorage::test_partial() {
+	RangeServer server(fits_);
+	HttpFITSStorage storage(QUrl(server.url()), -1, QString());
+
+	// The first block holds the headers and the data of the small image
+	QVERIFY(storage.isPartial());
+	QCOMPARE(storage.units().size(), std::size_t(2));
+	QCOMPARE(static_cast<quint64>(storage.size()), storage.units()[1].end);
+	QCOMPARE(storage.downloaded(), quint64(HttpFITSStorage::block_size));
+	QCOMPARE(server.heads(), 1);
+	QCOMPARE(server.gets(), 1);
+	QVERIFY(sameData(storage, 1));
+}
+
+void TestHttpFITSStorage::test_parallel() {
+	RangeServer server(fits_);
+	std::unique_ptr<HttpFITSStorage> storage{new HttpFITSStorage(QUrl(server.url()), 2, QString())};
+	QCOMPARE(storage->units().size(), std::size_t(3));
+	QCOMPARE(static_cast<quint64>(storage->size()), static_cast<quint64>(fits_.size()));
+	QVERIFY(sameData(*storage, 2));
+	// The first block, then the rest of the large image by two requests at once
+	QCOMPARE(server.gets(), 3);
+
+	FITS fits(storage.release());
+	auto it = fits.begin();
+	++it;
+	QCOMPARE(it->data().imageDataUnit()->size(), QSize(FITSBuilder::large_width, FITSBuilder::large_height));
+}
+
+void TestHttpFITSStorage::test_wholeFile() {
+	RangeServer server(fits_);
+	// The cache holds the blocks of the first image only
+	HttpFITSStorage(QUrl(server.url()), -1, cacheDirectory());
+
+	// The viewer opens of the same file see every HDU
+	for (int i = 0; i < 2; ++i) {
+		std::unique_ptr<HttpFITSStorage> storage{new HttpFITSStorage(QUrl(server.url()), HttpFITSStorage::whole_file, cacheDirectory())};
+		QVERIFY(!storage->isPartial());
+		QCOMPARE(storage->units().size(), std::size_t(3));
+		QCOMPARE(static_cast<quint64>(storage->size()), static_cast<quint64>(fits_.size()));
+		QVERIFY(std::memcmp(storage->data(), fits_.constData(), fits_.size()) == 0);
+
+		FITS fits(storage.release());
+		QCOMPARE(static_cast<int>(std::distance(fits.begin(), fits.end())), 2);
+	}
+}
+
+void TestHttpFITSStorage::test_cache() {
+	RangeServer server(fits_);
+	{
+		HttpFITSStorage storage(QUrl(server.url()), 2, cacheDirectory());
+		QVERIFY(storage.downloaded() > 0);
+	}
+	const int gets = server.gets();
+
+	// Only the size is asked again
+	HttpFITSStorage storage(QUrl(server.url()), 2, cacheDirectory());
+	QCOMPARE(storage.downloaded(), quint64(0));
+	QCOMPARE(server.gets(), gets);
+	QCOMPARE(server.heads(), 2);
+	QVERIFY(sameData(storage, 0));
+	QVERIFY(sameData(storage, 2));
+}
+
+void TestHttpFITSStorage::test_staleCache() {
+	RangeServer server(fits_);
+	{
+		HttpFITSStorage storage(QUrl(server.url()), 1, cacheDirectory());
+	}
+
+	server.setETag("\"2\"");
+	HttpFITSStorage storage(QUrl(server.url()), 1, cacheDirectory());
+	QCOMPARE(storage.downloaded(), quint64(HttpFITSStorage::block_size));
+	QVERIFY(sameData(storage, 1));
+}
+
+void TestHttpFITSStorage::test_noRanges() {
+	RangeServer server(fits_);
+	server.setRanges(false);
+
+	HttpFITSStorage storage(QUrl(server.url()), 2, QString());
+	QCOMPARE(storage.downloaded(), static_cast<quint64>(fits_.size()));
+	QCOMPARE(server.gets(), 1);
+	QVERIFY(sameData(storage, 1));
+	QVERIFY(sameData(storage, 2));
+}
+
+void TestHttpFITSStorage::test_missing() {
+	RangeServer server(fits_);
+	QVERIFY_EXCEPTION_THROWN(HttpFITSStorage(QUrl(server.url("/missing.fits")), -1, QString()), HttpFITSStorage::Exception);
+}
+
+QTEST_MAIN(TestHttpFITSStorage)
+#include "httpfitsstorage.moc"
@@ -0,0 +1,234 @@
+#include <QtTest/QtTest>
+#include <QDir>
+#include <QFile>
+
+#include <cstring>
+
+#include <keywordindex.h>
+#include <sequence.h>
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+class TestKeywordIndex: public QObject
+{
+	Q_OBJECT
+private:
+	QTemporaryDir directory_;
+
+	QString indexDirectory() const { return directory_.path() + "/index"; }
+	QString makeArchive(const QString& name) const;
+	const KeywordIndex::Match* findMatch(const std::vector<KeywordIndex::Match>& matches, const QString& filename, int hdu_index) const;
+private slots:
+	void initTestCase();
+	void test_update();
+	void test_describe();
+	void test_incremental();
+	void test_query();
+	void test_openAtOffset();
+	void test_brokenIndex();
+	void test_notDirectory();
+};
+
+/* Image, images and table in a subdirectory, tile-compressed images, a file
+ * which cannot be read and a file which is not FITS */
+QString TestKeywordIndex::makeArchive(const QString& name) const {
+	const QString root = directory_.path() + "/" + name;
+	if (!QDir().mkpath(root + "/night1"))
+		return QString();
+
+	const bool copied = QFile::copy(DATA_ROOT "/sombrero8.fits", root + "/sombrero8.fits") &&
+		QFile::copy(DATA_ROOT "/table.fits", root + "/night1/table.fits") &&
+		QFile::copy(DATA_ROOT "/tiles.fits", root + "/night1/tiles.fits") &&
+		QFile::copy(DATA_ROOT "/header_unexpected_end.fits", root + "/night1/broken.fits") &&
+		QFile::copy(DATA_ROOT "/table.fits", root + "/notes.txt");
+	return (copied ? root : QString());
+}
+
+const KeywordIndex::Match* TestKeywordIndex::findMatch(const std::vector<KeywordIndex::Match>& matches, const QString& filename, int hdu_index) const {
+	for (const auto& match: matches) {
+		if (match.filename.endsWith(filename) && match.hdu_index == hdu_index)
+			return &match;
+	}
+	return nullptr;
+}
+
+void TestKeywordIndex::initTestCase() {
+	QVERIFY(directory_.isValid());
+	// The indices of the inflated files are not saved into the user cache
+	QStandardPaths::setTestModeEnabled(true);
+}
+
+void TestKeywordIndex::test_update() {
+	const auto root = makeArchive("update");
+	QVERIFY(!root.isEmpty());
+
+	KeywordIndex index(root, indexDirectory());
+	QVERIFY(index.files().empty());
+
+	const auto statistics = index.update(QStringList() << "*.fits");
+	QCOMPARE(statistics.added, 4);
+	QCOMPARE(statistics.updated, 0);
+	QCOMPARE(statistics.removed, 0);
+	QCOMPARE(statistics.unchanged, 0);
+	QCOMPARE(statistics.errors.size(), 1);
+	QVERIFY(statistics.errors.front().startsWith("night1/broken.fits"));
+
+	QCOMPARE(index.files().size(), std::size_t(4));
+	QCOMPARE(index.files().at("sombrero8.fits").hdus.size(), std::size_t(1));
+	QCOMPARE(index.files().at("night1/table.fits").hdus.size(), std::size_t(3));
+	QCOMPARE(index.files().at("night1/tiles.fits").hdus.size(), std::size_t(7));
+	QVERIFY(index.files().at("night1/broken.fits").hdus.empty());
+	QVERIFY(index.files().at("night1/table.fits").isUnchanged(QFileInfo(root + "/night1/table.fits")));
+}
+
+void TestKeywordIndex::test_describe() {
+	const auto root = makeArchive("describe");
+	QVERIFY(!root.isEmpty());
+
+	KeywordIndex index(root, QString());
+	index.update(QStringList() << "*.fits");
+
+	const auto& table = index.files().at("night1/table.fits").hdus;
+	QCOMPARE(table[0].offset, quint64(0));
+	QVERIFY(!table[0].image);
+	QVERIFY(!table[1].image);
+	QCOMPARE(table[2].offset, quint64(8640));
+	QVERIFY(table[2].image);
+	QCOMPARE(table[2].bitpix, 16);
+	QVERIFY(table[2].shape == std::vector<quint64>({4, 3}));
+	QVERIFY(table[2].cards.count("XTENSION"));
+	QVERIFY(!table[2].cards.count(QString()));
+
+	// The shape and BITPIX of the image rather than of the table
+	const auto& tiles = index.files().at("night1/tiles.fits").hdus;
+	QCOMPARE(tiles[1].offset, quint64(2880));
+	QVERIFY(tiles[1].image);
+	QCOMPARE(tiles[1].bitpix, 16);
+	QVERIFY(tiles[1].shape == std::vector<quint64>({53, 37}));
+	QCOMPARE(tiles[5].bitpix, -32);
+}
+
+void TestKeywordIndex::test_incremental() {
+	const auto root = makeArchive("incremental");
+	QVERIFY(!root.isEmpty());
+	{
+		KeywordIndex index(root, indexDirectory());
+		index.update(QStringList() << "*.fits");
+	}
+
+	// Loaded as saved
+	KeywordIndex index(root, indexDirectory());
+	QCOMPARE(index.files().size(), std::size_t(4));
+	QCOMPARE(index.files().at("night1/table.fits").hdus[2].offset, quint64(8640));
+	QCOMPARE(index.files().at("night1/table.fits").hdus[2].cards.at("BITPIX"), QString("16"));
+
+	auto statistics = index.update(QStringList() << "*.fits");
+	QCOMPARE(statistics.added, 0);
+	QCOMPARE(statistics.updated, 0);
+	QCOMPARE(statistics.removed, 0);
+	QCOMPARE(statistics.unchanged, 4);
+	// The unreadable file is not read again until it changes
+	QVERIFY(statistics.errors.isEmpty());
+
+	QVERIFY(QFile::remove(root + "/sombrero8.fits"));
+	QVERIFY(QFile::remove(root + "/night1/table.fits"));
+	QVERIFY(QFile::copy(DATA_ROOT "/sombrero16.fits", root + "/night1/table.fits"));
+	QVERIFY(QFile::copy(DATA_ROOT "/sombrero32.fits", root + "/night1/sombrero32.fits"));
+
+	statistics = index.update(QStringList() << "*.fits");
+	QCOMPARE(statistics.added, 1);
+	QCOMPARE(statistics.updated, 1);
+	QCOMPARE(statistics.removed, 1);
+	QCOMPARE(statistics.unchanged, 2);
+	QCOMPARE(index.files().size(), std::size_t(4));
+	QVERIFY(!index.files().count("sombrero8.fits"));
+	QCOMPARE(index.files().at("night1/table.fits").hdus.size(), std::size_t(1));
+	QCOMPARE(index.files().at("night1/sombrero32.fits").hdus.front().bitpix, 32);
+
+	// The changes are saved for the next run
+	KeywordIndex reloaded(root, indexDirectory());
+	QCOMPARE(reloaded.files().size(), std::size_t(4));
+	QVERIFY(reloaded.files().count("night1/sombrero32.fits"));
+	QVERIFY(!reloaded.files().count("sombrero8.fits"));
+}
+
+void TestKeywordIndex::test_query() {
+	const auto root = makeArchive("query");
+	QVERIFY(!root.isEmpty());
+
+	KeywordIndex index(root, QString());
+	index.update(QStringList() << "*.fits");
+
+	auto matches = index.query(HeaderQuery(QStringList() << "XTENSION=IMAGE"));
+	QCOMPARE(matches.size(), std::size_t(1));
+	QCOMPARE(matches.front().filename, QFileInfo(root + "/night1/table.fits").canonicalFilePath());
+	QCOMPARE(matches.front().hdu_index, 2);
+	QCOMPARE(matches.front().hdu->offset, quint64(8640));
+
+	matches = index.query(HeaderQuery(QStringList() << "ZIMAGE=T" << "ZBITPIX<0"));
+	QCOMPARE(matches.size(), std::size_t(1));
+	QVERIFY(findMatch(matches, "/night1/tiles.fits", 5));
+
+	// Every HDU
+	matches = index.query(HeaderQuery());
+	QCOMPARE(matches.size(), std::size_t(1 + 3 + 7));
+}
+
+void TestKeywordIndex::test_openAtOffset() {
+	const auto root = makeArchive("open");
+	QVERIFY(!root.isEmpty());
+
+	KeywordIndex index(root, QString());
+	index.update(QStringList() << "*.fits");
+	const auto matches = index.query(HeaderQuery());
+
+	for (const auto& x: {std::make_pair(QString("/night1/table.fits"), 2), std::make_pair(QString("/night1/tiles.fits"), 5), std::make_pair(QString("/sombrero8.fits"), 0)}) {
+		const auto match = findMatch(matches, x.first, x.second);
+		QVERIFY(match);
+
+		const auto expected = Sequence::open(Sequence::Frame{match->filename, match->hdu_index, 0});
+		const auto opened = Sequence::open(Sequence::Frame{match->filename, match->hdu_index, match->hdu->offset});
+		QCOMPARE(opened.hdu_index, expected.hdu_index);
+		QVERIFY(opened.hdu->header().headers() == expected.hdu->header().headers());
+
+		const auto image = opened.hdu->data().imageDataUnit();
+		const auto expected_image = expected.hdu->data().imageDataUnit();
+		QCOMPARE(image->size(), expected_image->size());
+		QCOMPARE(image->length(), expected_image->length());
+		QVERIFY(std::memcmp(image->data(), expected_image->data(), image->length()) == 0);
+	}
+
+	// Not a header at the offset past the end
+	QVERIFY_EXCEPTION_THROWN(Sequence::open(Sequence::Frame{root + "/sombrero8.fits", 1, quint64(1) << 40}), FITS::Exception);
+}
+
+void TestKeywordIndex::test_brokenIndex() {
+	const auto root = makeArchive("broken");
+	QVERIFY(!root.isEmpty());
+	const QString index_directory = directory_.path() + "/broken-index";
+	{
+		KeywordIndex index(root, index_directory);
+		index.update(QStringList() << "*.fits");
+	}
+
+	const auto entries = QDir(index_directory).entryList(QStringList() << "*.idx", QDir::Files);
+	QCOMPARE(entries.size(), 1);
+	const QString path = index_directory + "/" + entries.front();
+	{
+		QFile file(path);
+		QVERIFY(file.open(QIODevice::ReadWrite));
+		QVERIFY(file.resize(file.size() - 16));
+	}
+
+	KeywordIndex index(root, index_directory);
+	QVERIFY(index.files().empty());
+	QVERIFY(!QFile::exists(path));
+}
+
+void TestKeywordIndex::test_notDirectory() {
+	QVERIFY_EXCEPTION_THROWN(KeywordIndex(DATA_ROOT "/sombrero8.fits", QString()), KeywordIndex::Exception);
+	QVERIFY_EXCEPTION_THROWN(KeywordIndex(directory_.path() + "/missing", QString()), KeywordIndex::Exception);
+}
+
+QTEST_MAIN(TestKeywordIndex)
+#include "keywordindex.moc"
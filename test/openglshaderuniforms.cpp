@@ -12,6 +12,9 @@ private slots:
 	void test_z21();
 	void test_512_514();
 	void test_kgo_image();
+	void test_colormap_range();
+	void test_log_stretch();
+	void test_equalization();
 };
 
 void TestOpenGLShaderUniforms::test_a11() {
@@ -79,6 +82,43 @@ void TestOpenGLShaderUniforms::test_kgo_image() {
 	QVERIFY(qAbs(d_actual - d_expected) < 0.5);
 }
 
+void TestOpenGLShaderUniforms::test_colormap_range() {
+	OpenGLShaderUniforms su(1, 1, 0, 1);
+	su.setMinMax(std::make_pair(0.0, 255.0));
+	su.setColorMapSize(4);
+	QCOMPARE(su.get_colormap_range()[0], 0.125f);
+	QCOMPARE(su.get_colormap_range()[1], 0.75f);
+	// Levels are mapped onto the colormap range
+	QVERIFY(qAbs((0.0 - su.get_z()[0]) * su.get_c()[0] - 0.125) < 1e-6);
+	QVERIFY(qAbs((1.0 - su.get_z()[0]) * su.get_c()[0] - 0.875) < 1e-6);
+}
+
+void TestOpenGLShaderUniforms::test_log_stretch() {
+	OpenGLShaderUniforms su(1, 1, 0, 1);
+	QCOMPARE(static_cast<int>(su.get_stretch()), static_cast<int>(OpenGLShaderUniforms::LinearStretch));
+	su.setStretch(OpenGLShaderUniforms::LogStretch, 1000);
+	const auto& p = su.get_stretch_parameters();
+	QCOMPARE(p[0], 1000.0f);
+	// Stretch keeps the ends of the range
+	QVERIFY(qAbs(std::log(p[0] * 1.0 + 1.0) * p[1] - 1.0) < 1e-6);
+}
+
+void TestOpenGLShaderUniforms::test_equalization() {
+	// Data in [0, 4], a quarter of pixels per bin
+	const Histogram histogram(std::make_pair(0.0, 4.0), std::vector<quint16>{16384, 32768, 49151, 65535});
+	OpenGLShaderUniforms su(1, 1, 0, 1);
+	su.setHistogram(&histogram);
+	su.setStretch(OpenGLShaderUniforms::EqualizationStretch, 0);
+	su.setMinMax(std::make_pair(1.0, 3.0));
+	const auto& p = su.get_stretch_parameters();
+	// Levels are the middle half of the histogram range
+	QCOMPARE(p[0], 0.5f);
+	QCOMPARE(p[1], 0.25f);
+	const auto at = [&] (double x) { return (histogram.at(x * p[0] + p[1]) - p[2]) * p[3]; };
+	QVERIFY(qAbs(at(0.0)) < 1e-6);
+	QVERIFY(qAbs(at(1.0) - 1.0) < 1e-6);
+	QVERIFY(qAbs(at(0.6) - 0.5) < 1e-4);
+}
 
 QTEST_MAIN(TestOpenGLShaderUniforms)
 #include "openglshaderuniforms.moc"
\ No newline at end of file
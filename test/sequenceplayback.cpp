@@ -0,0 +1,72 @@
+#include <QtTest/QtTest>
+
+#include <sequenceplayback.h>
+
+class TestSequencePlayback: public QObject
+{
+Q_OBJECT
+private slots:
+	void test_index();
+	void test_pause_step();
+	void test_dropped();
+	void test_sustained();
+};
+
+namespace {
+	// 10 fps
+	const qint64 interval = 100000000;
+}
+
+void TestSequencePlayback::test_index() {
+	SequencePlayback sp(4, 10.0);
+	QCOMPARE(sp.index(0), 0);
+	sp.play(1000);
+	QCOMPARE(sp.index(1000), 0);
+	QCOMPARE(sp.index(1000 + interval - 1), 0);
+	QCOMPARE(sp.index(1000 + interval), 1);
+	// Sequence is looped
+	QCOMPARE(sp.index(1000 + 5 * interval), 1);
+	QCOMPARE(sp.timeToNextFrame(1000 + interval / 4), interval - interval / 4);
+}
+
+void TestSequencePlayback::test_pause_step() {
+	SequencePlayback sp(4, 10.0);
+	sp.play(0);
+	sp.pause(2 * interval);
+	QVERIFY(!sp.isPlaying());
+	QCOMPARE(sp.index(10 * interval), 2);
+	sp.step(-3, 10 * interval);
+	QCOMPARE(sp.index(10 * interval), 3);
+	// Playback continues from the current frame
+	sp.play(20 * interval);
+	QCOMPARE(sp.index(21 * interval), 0);
+}
+
+void TestSequencePlayback::test_dropped() {
+	SequencePlayback sp(10, 10.0);
+	sp.play(0);
+	sp.presented(0, 0);
+	sp.presented(1, interval);
+	// Presented again, e.g. after zoom
+	sp.presented(1, interval + 1);
+	sp.presented(4, 4 * interval);
+	// Across the end of the sequence
+	sp.presented(1, 11 * interval);
+	QCOMPARE(sp.presented(), static_cast<quint64>(4));
+	QCOMPARE(sp.dropped(), static_cast<quint64>(2 + 6));
+}
+
+void TestSequencePlayback::test_sustained() {
+	SequencePlayback sp(100, 10.0);
+	QCOMPARE(sp.sustainedFrameRate(), 0.0);
+	sp.play(0);
+	for (int i = 0; i < 11; ++i) {
+		// Every second frame is presented
+		sp.presented(2 * i, 2 * i * interval);
+	}
+	QVERIFY(qAbs(sp.sustainedFrameRate() - 5.0) < 1e-9);
+	QCOMPARE(sp.dropped(), static_cast<quint64>(10));
+}
+
+QTEST_MAIN(TestSequencePlayback)
+#include "sequenceplayback.moc"
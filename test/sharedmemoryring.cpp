@@ -0,0 +1,178 @@
+#include <QtTest/QtTest>
+
+#include <atomic>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <fits.h>
+#include <sharedmemoryfitsstorage.h>
+#include <sharedmemoryring.h>
+
+#include "fitsbuilder.h"
+
+class TestSharedMemoryRing: public QObject
+{
+	Q_OBJECT
+private:
+	QString name_;
+	std::shared_ptr<SharedMemoryRing> producer_;
+
+	quint64 publish(quint8 value);
+private slots:
+	void init();
+	void cleanup();
+	void test_latestFrame();
+	void test_staleFrames();
+	void test_pinnedSlot();
+	void test_holds();
+	void test_invalid();
+	void test_concurrent();
+};
+
+namespace {
+	const int slot_count = 6;
+	const int width = 16, height = 16;
+
+	// Every pixel of the frame is the value
+	quint8 pixel(const FITS& fits, int index) {
+		return fits.primary_hdu().data().imageDataUnit()->data()[index];
+	}
+}
+
+quint64 TestSharedMemoryRing::publish(quint8 value) {
+	static const QByteArray fits_header = FITSBuilder::header({"SIMPLE  =                    T", "BITPIX  =                    8", "NAXIS   =                    2",
+			FITSBuilder::card("NAXIS1", width), FITSBuilder::card("NAXIS2", height)});
+	auto data = producer_->beginFrame();
+	std::memcpy(data, fits_header.constData(), fits_header.size());
+	std::memset(data + 2880, value, 2880);
+	return producer_->publishFrame(2 * 2880);
+}
+
+void TestSharedMemoryRing::init() {
+	name_ = QString("/fips-test-%1").arg(QCoreApplication::applicationPid());
+	producer_ = SharedMemoryRing::create(name_, slot_count, 2 * 2880);
+}
+
+void TestSharedMemoryRing::cleanup() {
+	producer_.reset();
+	SharedMemoryRing::unlink(name_);
+}
+
+void TestSharedMemoryRing::test_latestFrame() {
+	auto ring = SharedMemoryRing::open(name_);
+	QCOMPARE(ring->slotCount(), quint32(slot_count));
+	QCOMPARE(ring->slotSize(), quint64(8192));
+	QCOMPARE(ring->latestSequence(), quint64(0));
+	QVERIFY(!ring->acquireLatest());
+
+	QCOMPARE(publish(7), quint64(1));
+	QCOMPARE(ring->latestSequence(), quint64(1));
+
+	quint64 sequence = 0;
+	auto storage = ring->acquireLatest(&sequence);
+	QVERIFY(storage);
+	QCOMPARE(sequence, quint64(1));
+	QCOMPARE(storage->sequence(), quint64(1));
+	QCOMPARE(storage->size(), qint64(2 * 2880));
+
+	FITS fits(storage.release());
+	QCOMPARE(fits.primary_hdu().data().imageDataUnit()->size(), QSize(width, height));
+	QCOMPARE(pixel(fits, 0), quint8(7));
+}
+
+void TestSharedMemoryRing::test_staleFrames() {
+	auto ring = SharedMemoryRing::open(name_);
+	for (quint8 i = 1; i <= 3; ++i) {
+		publish(i);
+	}
+
+	// The frames in between are skipped
+	quint64 sequence = 0;
+	FITS fits(ring->acquireLatest(&sequence).release());
+	QCOMPARE(sequence, quint64(3));
+	QCOMPARE(pixel(fits, width * height - 1), quint8(3));
+}
+
+void TestSharedMemoryRing::test_pinnedSlot() {
+	auto ring = SharedMemoryRing::open(name_);
+	publish(1);
+	FITS pinned(ring->acquireLatest().release());
+
+	// The producer goes around the ring many times, but not over the pinned slot
+	for (int i = 2; i <= 5 * slot_count; ++i) {
+		publish(static_cast<quint8>(i));
+	}
+	for (int i = 0; i < width * height; ++i) {
+		QCOMPARE(pixel(pinned, i), quint8(1));
+	}
+
+	quint64 sequence = 0;
+	FITS latest(ring->acquireLatest(&sequence).release());
+	QCOMPARE(sequence, quint64(5 * slot_count));
+	QCOMPARE(pixel(latest, 0), quint8(5 * slot_count));
+}
+
+void TestSharedMemoryRing::test_holds() {
+	auto ring = SharedMemoryRing::open(name_);
+	publish(1);
+
+	std::vector<std::unique_ptr<SharedMemoryFITSStorage>> storages;
+	for (int i = 0; i < SharedMemoryRing::hold_count; ++i) {
+		storages.push_back(ring->acquireLatest());
+		QVERIFY(storages.back());
+		publish(static_cast<quint8>(i + 2));
+	}
+	// All the hold registers are taken
+	QVERIFY(!ring->acquireLatest());
+
+	storages.front().reset();
+	QVERIFY(ring->acquireLatest());
+}
+
+void TestSharedMemoryRing::test_invalid() {
+	QVERIFY_EXCEPTION_THROWN(SharedMemoryRing::open(name_ + "-missing"), SharedMemoryRing::Exception);
+	QVERIFY_EXCEPTION_THROWN(SharedMemoryRing::create(name_ + "-small", SharedMemoryRing::hold_count + 1, 2880), SharedMemoryRing::Exception);
+}
+
+void TestSharedMemoryRing::test_concurrent() {
+	auto ring = SharedMemoryRing::open(name_);
+	const int frames = 5000;
+
+	std::atomic<bool> done(false);
+	std::thread producer([this, &done] () {
+		for (int i = 1; i <= frames; ++i) {
+			publish(static_cast<quint8>(i));
+		}
+		done = true;
+	});
+
+	// A pinned frame is never torn, and the sequence never goes back
+	quint64 last = 0;
+	int torn = 0, acquired = 0;
+	while (!done || last < frames) {
+		quint64 sequence = 0;
+		auto storage = ring->acquireLatest(&sequence);
+		if (!storage)
+			continue;
+		if (sequence < last)
+			++torn;
+		last = sequence;
+		++acquired;
+
+		const auto data = storage->data() + 2880;
+		for (int i = 0; i < width * height; ++i) {
+			if (data[i] != static_cast<quint8>(sequence))
+				++torn;
+		}
+	}
+	producer.join();
+
+	QCOMPARE(torn, 0);
+	QVERIFY(acquired > 0);
+	QCOMPARE(last, quint64(frames));
+}
+
+QTEST_MAIN(TestSharedMemoryRing)
+#include "sharedmemoryring.moc"
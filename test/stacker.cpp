@@ -0,0 +1,152 @@
+#include <QtTest/QtTest>
+#include <QFile>
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <fits.h>
+#include <memoryfitsstorage.h>
+#include <stacker.h>
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+class TestStacker: public QObject
+{
+	Q_OBJECT
+private slots:
+	void test_floatImage();
+	void test_methods_data();
+	void test_methods();
+	void test_nan();
+	void test_scaled();
+	void test_shapeMismatch();
+};
+
+namespace {
+	const QSize size(5, 3);
+
+	// Every frame has value + frame index, frame 0 has outlier at pixel 1
+	std::vector<std::unique_ptr<FITS>> makeFrames(int count, float value, float outlier) {
+		std::vector<std::unique_ptr<FITS>> frames;
+		for (int f = 0; f < count; ++f) {
+			std::vector<float> data(size.width() * size.height(), value + f);
+			if (f == 0)
+				data[1] = outlier;
+			frames.push_back(MemoryFITSStorage::createFloatImage(size, data.data()));
+		}
+		return frames;
+	}
+
+	std::vector<const FITS::HeaderDataUnit*> hdus(const std::vector<std::unique_ptr<FITS>>& frames) {
+		std::vector<const FITS::HeaderDataUnit*> result;
+		for (const auto& x: frames) {
+			result.push_back(&x->primary_hdu());
+		}
+		return result;
+	}
+
+	float valueAt(const FITS& fits, int index) {
+		auto data = dynamic_cast<const FITS::DataUnit<float>&>(fits.primary_hdu().data()).data();
+		const auto bits = qFromBigEndian<quint32>(reinterpret_cast<const uchar*>(data + index));
+		float x;
+		std::memcpy(&x, &bits, sizeof(x));
+		return x;
+	}
+}
+
+void TestStacker::test_floatImage() {
+	std::vector<float> data(size.width() * size.height());
+	for (std::size_t i = 0; i < data.size(); ++i) {
+		data[i] = i * 0.25f - 1;
+	}
+	MemoryFITSStorage::cards_type cards{{"OBJECT", MemoryFITSStorage::stringValue("M31")}};
+
+	auto fits = MemoryFITSStorage::createFloatImage(size, data.data(), cards);
+	QCOMPARE(fits->header_unit().header("BITPIX"), QString("-32"));
+	QCOMPARE(fits->header_unit().header("OBJECT"), QString("'M31     '"));
+	QCOMPARE(fits->data_unit().imageDataUnit()->size(), size);
+	for (std::size_t i = 0; i < data.size(); ++i) {
+		QCOMPARE(valueAt(*fits, i), data[i]);
+	}
+}
+
+void TestStacker::test_methods_data() {
+	QTest::addColumn<int>("method");
+	QTest::addColumn<float>("expected");
+	QTest::addColumn<float>("expected_outlier");
+
+	// Frames have 10, 11, ..., 29, the outlier replaces 10 by 1000, so the
+	// median is between 20 and 21 and the outlier is clipped
+	QTest::newRow("mean")       << static_cast<int>(Stacker::MeanMethod)      << 19.5f << 19.5f + 990.0f / 20;
+	QTest::newRow("median")     << static_cast<int>(Stacker::MedianMethod)    << 19.5f << 20.5f;
+	QTest::newRow("sigma-clip") << static_cast<int>(Stacker::SigmaClipMethod) << 19.5f << 20.0f;
+}
+
+void TestStacker::test_methods() {
+	QFETCH(int, method);
+	QFETCH(float, expected);
+	QFETCH(float, expected_outlier);
+
+	const auto frames = makeFrames(20, 10, 1000);
+	Stacker stacker(hdus(frames));
+	QCOMPARE(stacker.count(), 20);
+	QCOMPARE(stacker.size(), size);
+
+	Stacker::Options options;
+	options.method = static_cast<Stacker::Method>(method);
+	const auto result = stacker.stack(options);
+	QCOMPARE(result.size(), std::size_t(size.width() * size.height()));
+	QCOMPARE(result[0], expected);
+	QCOMPARE(result[1], expected_outlier);
+	QCOMPARE(result.back(), expected);
+
+	auto fits = stacker.stackToFITS(options);
+	QCOMPARE(fits->header_unit().header("NCOMBINE"), QString("20"));
+	QCOMPARE(valueAt(*fits, 1), expected_outlier);
+}
+
+void TestStacker::test_nan() {
+	std::vector<float> data(size.width() * size.height(), 2);
+	data[0] = std::numeric_limits<float>::quiet_NaN();
+	std::vector<std::unique_ptr<FITS>> frames;
+	frames.push_back(MemoryFITSStorage::createFloatImage(size, data.data()));
+	data[0] = 4;
+	data[1] = std::numeric_limits<float>::quiet_NaN();
+	frames.push_back(MemoryFITSStorage::createFloatImage(size, data.data()));
+
+	const auto result = Stacker(hdus(frames)).stack(Stacker::Options());
+	QCOMPARE(result[0], 4.0f);
+	QVERIFY(std::isnan(result[1]));
+	QCOMPARE(result[2], 2.0f);
+}
+
+void TestStacker::test_scaled() {
+	QFile* file = new QFile(DATA_ROOT "/sombrero16.fits");
+	QVERIFY(file->open(QIODevice::ReadOnly));
+	FITS fits(file);
+	const auto& hdu = fits.primary_hdu();
+
+	Stacker::Options options;
+	options.method = Stacker::MedianMethod;
+	const auto result = Stacker({&hdu, &hdu, &hdu}).stack(options);
+
+	const auto& data = dynamic_cast<const FITS::DataUnit<qint16>&>(hdu.data());
+	for (quint64 i = 0; i < data.length(); i += 997) {
+		const double raw = qFromBigEndian<qint16>(reinterpret_cast<const uchar*>(data.data() + i));
+		QCOMPARE(result[i], static_cast<float>(raw * hdu.header().bscale() + hdu.header().bzero()));
+	}
+}
+
+void TestStacker::test_shapeMismatch() {
+	auto frames = makeFrames(2, 0, 0);
+	std::vector<float> data(4, 0);
+	frames.push_back(MemoryFITSStorage::createFloatImage(QSize(2, 2), data.data()));
+
+	QVERIFY_EXCEPTION_THROWN(Stacker stacker(hdus(frames)), Stacker::ShapeMismatch);
+}
+
+QTEST_MAIN(TestStacker)
+#include "stacker.moc"
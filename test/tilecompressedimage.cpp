@@ -0,0 +1,182 @@
+#include <QtTest/QtTest>
+#include <QFile>
+
+#include <cmath>
+#include <cstring>
+#include <iterator>
+
+#include <fits.h>
+#include <memoryfitsstorage.h>
+#include <tilecompressedimage.h>
+
+#define DATA_ROOT PROJECT_ROOT "/test/data"
+
+/* tiles.fits holds the images of tiles-raw.fits compressed by astropy:
+ * RICE16, HCOMPRESS16, GZIP2_8, GZIP1_32, DITHER_F32 quantized with
+ * SUBTRACTIVE_DITHER_2, having NaN at (5, 3) and zero at (40, 20), and
+ * CUBE16 of four planes. */
+class TestTileCompressedImage: public QObject
+{
+	Q_OBJECT
+private:
+	QByteArray tiles_;
+
+	std::unique_ptr<FITS> open(const QByteArray& data) const;
+	const FITS::HeaderDataUnit& hdu(const FITS& fits, const QString& extname) const;
+private slots:
+	void initTestCase();
+	void test_lossless();
+	void test_header();
+	void test_quantized();
+	void test_cube();
+	void test_corruptedTile();
+	void test_unsupported();
+};
+
+namespace {
+	float floatAt(const quint8* data, quint64 index) {
+		const quint32 bits = qFromBigEndian<quint32>(data + 4 * index);
+		float value;
+		std::memcpy(&value, &bits, sizeof(value));
+		return value;
+	}
+
+	// Offset of the data of the first extension
+	int firstExtensionData(const QByteArray& fits) {
+		for (int record = 2880; record < fits.size(); record += 80) {
+			if (fits.mid(record, 8) == "END     ")
+				return (record / 2880 + 1) * 2880;
+		}
+		return -1;
+	}
+}
+
+std::unique_ptr<FITS> TestTileCompressedImage::open(const QByteArray& data) const {
+	quint8* buffer = new quint8[data.size()];
+	std::memcpy(buffer, data.constData(), data.size());
+	return std::unique_ptr<FITS>(new FITS(new MemoryFITSStorage(buffer, data.size())));
+}
+
+const FITS::HeaderDataUnit& TestTileCompressedImage::hdu(const FITS& fits, const QString& extname) const {
+	for (const auto& hdu: fits) {
+		if (hdu.header().header("EXTNAME", QString()) == MemoryFITSStorage::stringValue(extname))
+			return hdu;
+	}
+	return fits.primary_hdu();
+}
+
+void TestTileCompressedImage::initTestCase() {
+	QFile file(DATA_ROOT "/tiles.fits");
+	QVERIFY(file.open(QIODevice::ReadOnly));
+	tiles_ = file.readAll();
+}
+
+void TestTileCompressedImage::test_lossless() {
+	auto tiles = open(tiles_);
+	QFile* file = new QFile(DATA_ROOT "/tiles-raw.fits");
+	QVERIFY(file->open(QIODevice::ReadOnly));
+	FITS raw(file);
+
+	for (const QString& extname: {"RICE16", "HCOMPRESS16", "GZIP2_8", "GZIP1_32", "CUBE16"}) {
+		const auto image = hdu(*tiles, extname).data().imageDataUnit();
+		const auto expected = hdu(raw, extname).data().imageDataUnit();
+		QVERIFY(image);
+		QCOMPARE(image->size(), expected->size());
+		QCOMPARE(image->depth(), expected->depth());
+		QCOMPARE(image->length(), expected->length());
+		QVERIFY2(std::memcmp(image->data(), expected->data(), image->length() * image->depth()) == 0, qPrintable(extname));
+	}
+}
+
+void TestTileCompressedImage::test_header() {
+	auto tiles = open(tiles_);
+	QCOMPARE(static_cast<int>(std::distance(tiles->begin(), tiles->end())), 6);
+
+	const auto& header = hdu(*tiles, "GZIP1_32").header();
+	QCOMPARE(header.header("XTENSION"), QString("'IMAGE   '"));
+	QCOMPARE(header.header("BITPIX"), QString("32"));
+	QCOMPARE(header.header("NAXIS"), QString("2"));
+	QCOMPARE(header.header("NAXIS1"), QString("53"));
+	QCOMPARE(header.header("NAXIS2"), QString("37"));
+	// The keywords of the table are gone
+	QCOMPARE(header.header("ZBITPIX", QString()), QString());
+	QCOMPARE(header.header("TFORM1", QString()), QString());
+	QCOMPARE(header.header("PCOUNT", QString()), QString("0"));
+
+	// Floating point image is of ZBITPIX
+	QVERIFY(dynamic_cast<const FITS::DataUnit<float>*>(&hdu(*tiles, "DITHER_F32").data()));
+}
+
+void TestTileCompressedImage::test_quantized() {
+	auto tiles = open(tiles_);
+	QFile* file = new QFile(DATA_ROOT "/tiles-raw.fits");
+	QVERIFY(file->open(QIODevice::ReadOnly));
+	FITS raw(file);
+
+	const auto image = hdu(*tiles, "DITHER_F32").data().imageDataUnit();
+	const auto expected = hdu(raw, "DITHER_F32").data().imageDataUnit();
+	QVERIFY(image);
+	QCOMPARE(image->size(), QSize(53, 37));
+
+	const quint64 nan_index = 3 * 53 + 5, zero_index = 20 * 53 + 40;
+	QVERIFY(std::isnan(floatAt(image->data(), nan_index)));
+	QCOMPARE(floatAt(image->data(), zero_index), 0.0f);
+
+	// Quantization step is about 1 for the noise of 10
+	for (quint64 i = 0; i < 53 * 37; ++i) {
+		if (i == nan_index)
+			continue;
+		QVERIFY(std::abs(floatAt(image->data(), i) - floatAt(expected->data(), i)) < 1.0f);
+	}
+}
+
+void TestTileCompressedImage::test_cube() {
+	auto tiles = open(tiles_);
+	const auto& cube = hdu(*tiles, "CUBE16");
+	const auto image = cube.data().imageDataUnit();
+	QCOMPARE(image->depth(), quint64(4));
+
+	// Planes differ by 10, the fourth from the first by 30
+	FITS::HeaderDataUnit plane(cube, 3);
+	const auto first = image->data();
+	const auto last = plane.data().imageDataUnit()->data();
+	for (quint64 i = 0; i < 53 * 37; ++i) {
+		const qint16 a = qFromBigEndian<qint16>(first + 2 * i);
+		const qint16 b = qFromBigEndian<qint16>(last + 2 * i);
+		QCOMPARE(b - a, 30);
+	}
+}
+
+void TestTileCompressedImage::test_corruptedTile() {
+	// Count of the descriptor of the first tile of RICE16 points out of the heap
+	QByteArray corrupted = tiles_;
+	const int data = firstExtensionData(corrupted);
+	QVERIFY(data > 0);
+	corrupted[data] = '\x7f';
+
+	auto tiles = open(corrupted);
+	auto raw = open(tiles_);
+	const auto image = hdu(*tiles, "RICE16").data().imageDataUnit();
+	const auto expected = hdu(*raw, "RICE16").data().imageDataUnit();
+
+	// The first tile is 20x8 and zeroed, the others are decoded
+	for (quint64 y = 0; y < 37; ++y) {
+		for (quint64 x = 0; x < 53; ++x) {
+			const quint64 offset = 2 * (y * 53 + x);
+			if (x < 20 && y < 8) {
+				QCOMPARE(qFromBigEndian<qint16>(image->data() + offset), qint16(0));
+			} else {
+				QCOMPARE(qFromBigEndian<qint16>(image->data() + offset), qFromBigEndian<qint16>(expected->data() + offset));
+			}
+		}
+	}
+}
+
+void TestTileCompressedImage::test_unsupported() {
+	QByteArray plio = tiles_;
+	plio.replace("'RICE_1  '", "'PLIO_1  '");
+	QVERIFY_EXCEPTION_THROWN(open(plio), TileCompressedImage::Exception);
+}
+
+QTEST_MAIN(TestTileCompressedImage)
+#include "tilecompressedimage.moc"
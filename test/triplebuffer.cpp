@@ -0,0 +1,62 @@
+#include <QtTest/QtTest>
+
+#include <thread>
+
+#include <triplebuffer.h>
+
+class TestTripleBuffer: public QObject
+{
+Q_OBJECT
+private slots:
+	void test_empty();
+	void test_latest();
+	void test_threads();
+};
+
+void TestTripleBuffer::test_empty() {
+	TripleBuffer<int> tb;
+	QVERIFY(!tb.fetch());
+}
+
+void TestTripleBuffer::test_latest() {
+	TripleBuffer<int> tb;
+	tb.writeSlot() = 1;
+	tb.publish();
+	tb.writeSlot() = 2;
+	tb.publish();
+	QVERIFY(tb.fetch());
+	QCOMPARE(tb.readSlot(), 2);
+	QVERIFY(!tb.fetch());
+	QCOMPARE(tb.readSlot(), 2);
+}
+
+void TestTripleBuffer::test_threads() {
+	struct Value {
+		int a, b;
+	};
+	const int count = 100000;
+	TripleBuffer<Value> tb;
+
+	std::thread producer([&tb, count] () {
+		for (int i = 1; i <= count; ++i) {
+			tb.writeSlot().a = i;
+			tb.writeSlot().b = -i;
+			tb.publish();
+		}
+	});
+
+	int last = 0;
+	while (last != count) {
+		if (!tb.fetch())
+			continue;
+		const auto& value = tb.readSlot();
+		// Values are never torn and never go back in time
+		QCOMPARE(value.a, -value.b);
+		QVERIFY(value.a > last);
+		last = value.a;
+	}
+	producer.join();
+}
+
+QTEST_MAIN(TestTripleBuffer)
+#include "triplebuffer.moc"
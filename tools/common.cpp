@@ -0,0 +1,40 @@
+#include <QFile>
+#include <QTextStream>
+#include <QThreadPool>
+
+#include <exception.h>
+
+#include "common.h"
+
+QByteArray Tools::tsvField(const QString& value) {
+	QString field(value);
+	field.replace(QChar('\t'), QChar(' ')).replace(QChar('\n'), QChar(' ')).replace(QChar('\r'), QChar(' '));
+	return field.toUtf8();
+}
+
+QStringList Tools::readList(const QString& list_filename) {
+	QFile file;
+	if (list_filename == "-") {
+		file.open(stdin, QIODevice::ReadOnly);
+	} else {
+		file.setFileName(list_filename);
+		if (!file.open(QIODevice::ReadOnly))
+			throw Exception(list_filename + ": " + file.errorString());
+	}
+
+	QStringList filenames;
+	QTextStream stream(&file);
+	while (!stream.atEnd()) {
+		const auto line = stream.readLine().trimmed();
+		if (!line.isEmpty())
+			filenames << line;
+	}
+
+	return filenames;
+}
+
+void Tools::setJobs(int jobs) {
+	// Reading is bound by the disk latency rather than CPU, so more threads than cores may help
+	if (jobs > 0)
+		QThreadPool::globalInstance()->setMaxThreadCount(jobs - 1);
+}
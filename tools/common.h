@@ -0,0 +1,20 @@
+#ifndef _TOOLS_COMMON_H_
+#define _TOOLS_COMMON_H_
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+// Helpers shared by the command-line tools
+namespace Tools {
+	// Tabs and line breaks would break the columns
+	QByteArray tsvField(const QString& value);
+
+	// Names of the files listed in list_filename one per line, - for stdin
+	QStringList readList(const QString& list_filename);
+
+	// Threads reading the files, non-positive jobs keep the default
+	void setJobs(int jobs);
+}
+
+#endif // _TOOLS_COMMON_H_
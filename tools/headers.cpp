@@ -0,0 +1,214 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QThreadPool>
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+
+#include <headerquery.h>
+#include <headerreader.h>
+#include <parallel.h>
+#include <tracer.h>
+
+#include "common.h"
+
+namespace {
+	// Files read in parallel before their output is written
+	const int chunk_size = 1024;
+
+	enum Format {
+		TSVFormat,
+		JSONFormat
+	};
+
+	struct Options {
+		QStringList keywords;  // All the cards when empty
+		HeaderQuery query;
+		int hdu_index;  // All the HDUs when negative
+		Format format;
+	};
+
+	struct Result {
+		QByteArray output;
+		QString error;
+	};
+
+	QJsonValue jsonValue(const QString& value) {
+		double number = 0;
+		if (value == "T" || value == "F")
+			return QJsonValue(value == "T");
+		if (HeaderQuery::toNumber(value, &number))
+			return QJsonValue(number);
+		return QJsonValue(FITS::HeaderUnit::unquoted(value));
+	}
+
+	QByteArray format(const QString& filename, int hdu_index, const HeaderReader::HDU& hdu, const Options& options) {
+		const auto& cards = hdu.header.headers();
+		QByteArray output;
+
+		if (options.format == JSONFormat) {
+			QJsonObject header;
+			if (options.keywords.isEmpty()) {
+				for (const auto& x: cards) {
+					if (!x.first.isEmpty())
+						header.insert(x.first, jsonValue(x.second));
+				}
+			} else {
+				for (const auto& keyword: options.keywords) {
+					auto it = cards.find(keyword);
+					header.insert(keyword, (it != cards.end() ? jsonValue(it->second) : QJsonValue()));
+				}
+			}
+
+			QJsonObject object;
+			object.insert("file", filename);
+			object.insert("hdu", hdu_index);
+			object.insert("offset", static_cast<double>(hdu.offset));
+			object.insert("header", header);
+			return QJsonDocument(object).toJson(QJsonDocument::Compact) + "\n";
+		}
+
+		const QByteArray prefix = Tools::tsvField(filename) + "\t" + QByteArray::number(hdu_index);
+		if (options.keywords.isEmpty()) {
+			for (const auto& x: cards) {
+				if (!x.first.isEmpty())
+					output += prefix + "\t" + Tools::tsvField(x.first) + "\t" + Tools::tsvField(FITS::HeaderUnit::unquoted(x.second)) + "\n";
+			}
+		} else {
+			output += prefix;
+			for (const auto& keyword: options.keywords) {
+				auto it = cards.find(keyword);
+				output += "\t" + (it != cards.end() ? Tools::tsvField(FITS::HeaderUnit::unquoted(it->second)) : QByteArray());
+			}
+			output += "\n";
+		}
+		return output;
+	}
+
+	Result process(const QString& filename, const Options& options) {
+		Result result;
+		try {
+			// The HDUs after the requested one are not read
+			const auto hdus = HeaderReader::read(filename, options.hdu_index < 0 ? -1 : options.hdu_index + 1);
+			for (int i = 0; i < static_cast<int>(hdus.size()); ++i) {
+				if (options.hdu_index >= 0 && i != options.hdu_index)
+					continue;
+				if (options.query.matches(hdus[i].header.headers()))
+					result.output += format(filename, i, hdus[i], options);
+			}
+		} catch (const std::exception& e) {
+			result.error = filename + ": " + e.what();
+		}
+		return result;
+	}
+}
+
+int main(int argc, char** argv) {
+	Tracer::instance().setEnabled(false);
+
+	try {
+		QCoreApplication app(argc, argv);
+		QCoreApplication::setApplicationName("fips");
+
+		QCommandLineParser parser;
+		parser.setApplicationDescription(QCoreApplication::translate("main", "Print header keywords of FITS files, reading the header blocks only."));
+		parser.addHelpOption();
+		parser.addPositionalArgument("files", QCoreApplication::translate("main", "FITS files to read."), "[files...]");
+		QCommandLineOption list_option("list",
+			QCoreApplication::translate("main", "Read names of the files from <file>, one per line, - for stdin."),
+			QCoreApplication::translate("main", "file"));
+		QCommandLineOption keyword_option(QStringList() << "k" << "keyword",
+			QCoreApplication::translate("main", "Print <keyword>, may be given many times. All the cards by default."),
+			QCoreApplication::translate("main", "keyword"));
+		QCommandLineOption where_option(QStringList() << "w" << "where",
+			QCoreApplication::translate("main", "Print only HDUs satisfying <condition>, e.g. FILTER=R or EXPTIME>60, may be given many times."),
+			QCoreApplication::translate("main", "condition"));
+		QCommandLineOption hdu_option("hdu",
+			QCoreApplication::translate("main", "Read HDU number <index> only, primary HDU is 0. All the HDUs by default."),
+			QCoreApplication::translate("main", "index"));
+		QCommandLineOption format_option("format",
+			QCoreApplication::translate("main", "Output <format>: tsv or json (an object per line)."),
+			QCoreApplication::translate("main", "format"), "tsv");
+		QCommandLineOption jobs_option(QStringList() << "j" << "jobs",
+			QCoreApplication::translate("main", "Read <count> files in parallel."),
+			QCoreApplication::translate("main", "count"), QString::number(QThreadPool::globalInstance()->maxThreadCount()));
+		parser.addOption(list_option);
+		parser.addOption(keyword_option);
+		parser.addOption(where_option);
+		parser.addOption(hdu_option);
+		parser.addOption(format_option);
+		parser.addOption(jobs_option);
+		parser.process(app);
+
+		Options options;
+		for (const auto& keyword: parser.values(keyword_option)) {
+			options.keywords << keyword.toUpper();
+		}
+		options.query = HeaderQuery(parser.values(where_option));
+		options.hdu_index = -1;
+		if (parser.isSet(hdu_option)) {
+			bool ok = false;
+			options.hdu_index = parser.value(hdu_option).toInt(&ok);
+			if (!ok || options.hdu_index < 0)
+				throw HeaderQuery::Exception("Wrong HDU index " + parser.value(hdu_option) + ", non-negative number expected");
+		}
+		if (parser.value(format_option) == "tsv") {
+			options.format = TSVFormat;
+		} else if (parser.value(format_option) == "json") {
+			options.format = JSONFormat;
+		} else {
+			throw HeaderQuery::Exception("Unknown format " + parser.value(format_option) + ", tsv or json expected");
+		}
+		Tools::setJobs(parser.value(jobs_option).toInt());
+
+		auto filenames = parser.positionalArguments();
+		if (parser.isSet(list_option))
+			filenames << Tools::readList(parser.value(list_option));
+		if (filenames.isEmpty())
+			parser.showHelp(1);
+
+		QFile output;
+		output.open(stdout, QIODevice::WriteOnly);
+		if (options.format == TSVFormat && !options.keywords.isEmpty()) {
+			QByteArray columns = "file\thdu";
+			for (const auto& keyword: options.keywords) {
+				columns += "\t" + Tools::tsvField(keyword);
+			}
+			output.write(columns + "\n");
+		}
+
+		// The output keeps the order of the files
+		bool failed = false;
+		std::vector<Result> results;
+		for (int first = 0; first < filenames.size(); first += chunk_size) {
+			const int count = std::min(chunk_size, filenames.size() - first);
+			results.assign(count, Result());
+			parallelFor(count, 1, [&] (int begin, int end) {
+				for (int i = begin; i < end; ++i) {
+					results[i] = process(filenames[first + i], options);
+				}
+			});
+
+			for (const auto& result: results) {
+				output.write(result.output);
+				if (!result.error.isEmpty()) {
+					qWarning().noquote() << result.error;
+					failed = true;
+				}
+			}
+			output.flush();
+		}
+
+		return (failed ? 1 : 0);
+	} catch (const std::exception& e) {
+		qCritical() << e.what();
+		return 1;
+	}
+
+	return 0;
+}
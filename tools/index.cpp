@@ -0,0 +1,107 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QThreadPool>
+
+#include <fits.h>
+#include <headerquery.h>
+#include <keywordindex.h>
+#include <tracer.h>
+
+#include "common.h"
+
+namespace {
+	QByteArray shape(const KeywordIndex::HDU& hdu) {
+		QByteArray shape;
+		for (const auto axis: hdu.shape) {
+			shape += (shape.isEmpty() ? "" : "x") + QByteArray::number(axis);
+		}
+		return shape;
+	}
+}
+
+int main(int argc, char** argv) {
+	Tracer::instance().setEnabled(false);
+
+	try {
+		QCoreApplication app(argc, argv);
+		// The index is shared with the viewer
+		QCoreApplication::setApplicationName("fips");
+
+		QCommandLineParser parser;
+		parser.setApplicationDescription(QCoreApplication::translate("main", "Index header keywords of the FITS files of a directory tree, or query the index."));
+		parser.addHelpOption();
+		parser.addPositionalArgument("directory", QCoreApplication::translate("main", "Root of the directory tree."));
+		QCommandLineOption where_option(QStringList() << "w" << "where",
+			QCoreApplication::translate("main", "Print the HDUs satisfying <condition>, e.g. FILTER=R or EXPTIME>60, may be given many times. The index is updated when no condition is given."),
+			QCoreApplication::translate("main", "condition"));
+		QCommandLineOption keyword_option(QStringList() << "k" << "keyword",
+			QCoreApplication::translate("main", "Print <keyword> of the found HDUs, may be given many times."),
+			QCoreApplication::translate("main", "keyword"));
+		QCommandLineOption update_option("update",
+			QCoreApplication::translate("main", "Update the index before the query."));
+		QCommandLineOption index_directory_option("index-directory",
+			QCoreApplication::translate("main", "Keep the index in <directory> instead of the cache directory."),
+			QCoreApplication::translate("main", "directory"), KeywordIndex::defaultIndexDirectory());
+		QCommandLineOption jobs_option(QStringList() << "j" << "jobs",
+			QCoreApplication::translate("main", "Read <count> files in parallel."),
+			QCoreApplication::translate("main", "count"), QString::number(QThreadPool::globalInstance()->maxThreadCount()));
+		parser.addOption(where_option);
+		parser.addOption(keyword_option);
+		parser.addOption(update_option);
+		parser.addOption(index_directory_option);
+		parser.addOption(jobs_option);
+		parser.process(app);
+
+		const auto args = parser.positionalArguments();
+		if (args.size() != 1)
+			parser.showHelp(1);
+
+		const HeaderQuery query(parser.values(where_option));
+		QStringList keywords;
+		for (const auto& keyword: parser.values(keyword_option)) {
+			keywords << keyword.toUpper();
+		}
+		Tools::setJobs(parser.value(jobs_option).toInt());
+
+		KeywordIndex index(args.front(), parser.value(index_directory_option));
+
+		bool failed = false;
+		if (query.isEmpty() || parser.isSet(update_option)) {
+			const auto statistics = index.update(FITS::nameFilters());
+			for (const auto& error: statistics.errors) {
+				qWarning().noquote() << error;
+			}
+			qInfo().noquote() << QString("%1 added, %2 updated, %3 removed, %4 unchanged").arg(statistics.added).arg(statistics.updated).arg(statistics.removed).arg(statistics.unchanged);
+			failed = !statistics.errors.isEmpty();
+		}
+		if (query.isEmpty())
+			return (failed ? 1 : 0);
+
+		QFile output;
+		output.open(stdout, QIODevice::WriteOnly);
+		QByteArray columns = "file\thdu\toffset\tbitpix\tshape";
+		for (const auto& keyword: keywords) {
+			columns += "\t" + Tools::tsvField(keyword);
+		}
+		output.write(columns + "\n");
+
+		for (const auto& match: index.query(query)) {
+			QByteArray row = Tools::tsvField(match.filename) + "\t" + QByteArray::number(match.hdu_index) + "\t" + QByteArray::number(match.hdu->offset) + "\t" +
+				QByteArray::number(match.hdu->bitpix) + "\t" + shape(*match.hdu);
+			for (const auto& keyword: keywords) {
+				auto it = match.hdu->cards.find(keyword);
+				row += "\t" + (it != match.hdu->cards.end() ? Tools::tsvField(FITS::HeaderUnit::unquoted(it->second)) : QByteArray());
+			}
+			output.write(row + "\n");
+		}
+
+		return (failed ? 1 : 0);
+	} catch (const std::exception& e) {
+		qCritical() << e.what();
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,170 @@
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QGuiApplication>
+#include <QSurfaceFormat>
+#include <QTextStream>
+#include <QThread>
+
+#include <batchrenderer.h>
+#include <tracer.h>
+
+#include "common.h"
+
+namespace {
+	std::pair<double, double> parseLevels(const QString& value) {
+		const auto parts = value.split(':');
+		bool min_ok = false, max_ok = false;
+		if (parts.size() == 2) {
+			const auto levels = std::make_pair(parts[0].toDouble(&min_ok), parts[1].toDouble(&max_ok));
+			if (min_ok && max_ok)
+				return levels;
+		}
+
+		throw BatchRenderer::Exception("Wrong levels " + value + ", <min>:<max> expected");
+	}
+
+	QSize parseSize(const QString& value) {
+		const auto parts = value.split('x');
+		bool width_ok = false, height_ok = false;
+		if (parts.size() == 2) {
+			const QSize size(parts[0].isEmpty() ? 0 : parts[0].toInt(&width_ok), parts[1].isEmpty() ? 0 : parts[1].toInt(&height_ok));
+			if ((width_ok || parts[0].isEmpty()) && (height_ok || parts[1].isEmpty()))
+				return size;
+		}
+
+		throw BatchRenderer::Exception("Wrong size " + value + ", <width>x<height> expected");
+	}
+
+	int parseColorMap(const QString& value) {
+		if (value.compare("grayscale", Qt::CaseInsensitive) == 0)
+			return 0;
+		if (value.compare("purpleblue", Qt::CaseInsensitive) == 0)
+			return 1;
+
+		throw BatchRenderer::Exception("Unknown colormap " + value + ", grayscale or purpleblue expected");
+	}
+
+	OpenGLShaderUniforms::Stretch parseStretch(const QString& value) {
+		const char* names[] = {"linear", "sqrt", "log", "asinh", "power", "equalization"};
+		static_assert(sizeof(names) / sizeof(names[0]) == OpenGLShaderUniforms::StretchCount, "Stretch name is missed");
+
+		for (int i = 0; i < OpenGLShaderUniforms::StretchCount; ++i) {
+			if (value.compare(names[i], Qt::CaseInsensitive) == 0)
+				return static_cast<OpenGLShaderUniforms::Stretch>(i);
+		}
+
+		throw BatchRenderer::Exception("Unknown stretch " + value + ", linear, sqrt, log, asinh, power or equalization expected");
+	}
+}
+
+int main(int argc, char** argv) {
+	Tracer::instance().setEnabled(false);
+
+	QSurfaceFormat surface_format;
+	surface_format.setVersion(2, 1);
+	QSurfaceFormat::setDefaultFormat(surface_format);
+	// Jobs create their contexts in the share group, see BatchRenderer
+	QCoreApplication::setAttribute(Qt::AA_ShareOpenGLContexts);
+
+	try {
+		QGuiApplication app(argc, argv);
+		// Share the program binary cache with the viewer
+		QCoreApplication::setApplicationName("fips");
+
+		QCommandLineParser parser;
+		parser.setApplicationDescription(QCoreApplication::translate("main", "Render images of FITS files without a window."));
+		parser.addHelpOption();
+		parser.addPositionalArgument("files", QCoreApplication::translate("main", "FITS files to render."), "[files...]");
+		QCommandLineOption list_option("list",
+			QCoreApplication::translate("main", "Read names of the files to render from <file>, one per line, - for stdin."),
+			QCoreApplication::translate("main", "file"));
+		QCommandLineOption hdu_option("hdu",
+			QCoreApplication::translate("main", "Render HDU number <index>, primary HDU is 0. The first HDU having image by default."),
+			QCoreApplication::translate("main", "index"));
+		QCommandLineOption levels_option("levels",
+			QCoreApplication::translate("main", "Levels as <min>:<max>. Data range of the image by default."),
+			QCoreApplication::translate("main", "min:max"));
+		QCommandLineOption colormap_option("colormap",
+			QCoreApplication::translate("main", "Colormap <name>: grayscale or purpleblue."),
+			QCoreApplication::translate("main", "name"), "grayscale");
+		QCommandLineOption stretch_option("stretch",
+			QCoreApplication::translate("main", "Stretch <name>: linear, sqrt, log, asinh, power or equalization."),
+			QCoreApplication::translate("main", "name"), "linear");
+		QCommandLineOption stretch_parameter_option("stretch-parameter",
+			QCoreApplication::translate("main", "Parameter <value> of log, asinh and power stretches."),
+			QCoreApplication::translate("main", "value"));
+		QCommandLineOption size_option("size",
+			QCoreApplication::translate("main", "Output size as <width>x<height>, omitted dimension keeps the aspect ratio. Image size by default."),
+			QCoreApplication::translate("main", "size"));
+		QCommandLineOption output_option(QStringList() << "o" << "output",
+			QCoreApplication::translate("main", "Write images into <directory>."),
+			QCoreApplication::translate("main", "directory"), ".");
+		QCommandLineOption format_option("format",
+			QCoreApplication::translate("main", "Output image <format>, e.g. png or jpg."),
+			QCoreApplication::translate("main", "format"), "png");
+		QCommandLineOption jobs_option(QStringList() << "j" << "jobs",
+			QCoreApplication::translate("main", "Render with <count> parallel contexts."),
+			QCoreApplication::translate("main", "count"), QString::number(QThread::idealThreadCount()));
+		QCommandLineOption software_option("software",
+			QCoreApplication::translate("main", "Render on CPU without OpenGL."));
+		parser.addOption(list_option);
+		parser.addOption(hdu_option);
+		parser.addOption(levels_option);
+		parser.addOption(colormap_option);
+		parser.addOption(stretch_option);
+		parser.addOption(stretch_parameter_option);
+		parser.addOption(size_option);
+		parser.addOption(output_option);
+		parser.addOption(format_option);
+		parser.addOption(jobs_option);
+		parser.addOption(software_option);
+		parser.process(app);
+
+		BatchRenderer::Options options;
+		if (parser.isSet(hdu_option))
+			options.hdu_index = parser.value(hdu_option).toInt();
+		if (parser.isSet(levels_option)) {
+			options.has_levels = true;
+			options.levels = parseLevels(parser.value(levels_option));
+		}
+		options.colormap_index = parseColorMap(parser.value(colormap_option));
+		options.stretch = parseStretch(parser.value(stretch_option));
+		options.stretch_parameter = OpenGLShaderUniforms::defaultStretchParameter(options.stretch);
+		if (parser.isSet(stretch_parameter_option)) {
+			bool ok = false;
+			options.stretch_parameter = parser.value(stretch_parameter_option).toDouble(&ok);
+			if (!ok || options.stretch_parameter <= 0)
+				throw BatchRenderer::Exception("Wrong stretch parameter " + parser.value(stretch_parameter_option) + ", positive number expected");
+		}
+		if (parser.isSet(size_option))
+			options.size = parseSize(parser.value(size_option));
+		options.output_directory = parser.value(output_option);
+		options.format = parser.value(format_option);
+		options.jobs = parser.value(jobs_option).toInt();
+		options.software = parser.isSet(software_option);
+
+		auto filenames = parser.positionalArguments();
+		if (parser.isSet(list_option))
+			filenames << Tools::readList(parser.value(list_option));
+		if (filenames.isEmpty())
+			parser.showHelp(1);
+
+		if (!QDir().mkpath(options.output_directory))
+			throw BatchRenderer::Exception("Cannot create " + options.output_directory);
+
+		BatchRenderer renderer(options);
+		const auto result = renderer.run(filenames);
+
+		QTextStream(stdout) << "Rendered " << result.rendered << " of " << filenames.size() << " frames in "
+			<< result.seconds << " s, " << result.fps() << " fps\n";
+
+		return (result.failed ? 1 : 0);
+	} catch (const std::exception& e) {
+		qCritical() << e.what();
+		return 1;
+	}
+
+	return 0;
+}
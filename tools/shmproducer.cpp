@@ -0,0 +1,94 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <sharedmemoryring.h>
+
+namespace {
+	std::atomic<bool> interrupted(false);
+
+	void interrupt(int) {
+		interrupted = true;
+	}
+}
+
+int main(int argc, char** argv) {
+	try {
+		QCoreApplication app(argc, argv);
+		QCoreApplication::setApplicationName("fips-shm-producer");
+
+		QCommandLineParser parser;
+		parser.setApplicationDescription(QCoreApplication::translate("main", "Publish FITS files into the shared-memory ring over and over, as camera software would."));
+		parser.addHelpOption();
+		parser.addPositionalArgument("name", QCoreApplication::translate("main", "Name of the ring, e.g. /fips-camera."));
+		parser.addPositionalArgument("files", QCoreApplication::translate("main", "FITS files to publish."), "files...");
+		QCommandLineOption fps_option("fps",
+			QCoreApplication::translate("main", "Publish <rate> frames per second, 25 by default."),
+			QCoreApplication::translate("main", "rate"), "25");
+		QCommandLineOption slots_option("slots",
+			QCoreApplication::translate("main", "Number of <count> slots of the ring, 8 by default."),
+			QCoreApplication::translate("main", "count"), "8");
+		QCommandLineOption count_option("count",
+			QCoreApplication::translate("main", "Stop after <frames> frames, 0 to run until interrupted."),
+			QCoreApplication::translate("main", "frames"), "0");
+		parser.addOption(fps_option);
+		parser.addOption(slots_option);
+		parser.addOption(count_option);
+		parser.process(app);
+
+		const auto args = parser.positionalArguments();
+		bool fps_ok = false, slots_ok = false, count_ok = false;
+		const double frame_rate = parser.value(fps_option).toDouble(&fps_ok);
+		const quint32 slot_count = parser.value(slots_option).toUInt(&slots_ok);
+		const quint64 count = parser.value(count_option).toULongLong(&count_ok);
+		if (args.size() < 2 || !fps_ok || frame_rate <= 0 || !slots_ok || !count_ok)
+			parser.showHelp(1);
+
+		// The frames are copied into the ring from memory, the disk does not limit the rate
+		std::vector<QByteArray> frames;
+		quint64 slot_size = 0;
+		for (const auto& filename: args.mid(1)) {
+			QFile file(filename);
+			if (!file.open(QIODevice::ReadOnly))
+				throw SharedMemoryRing::Exception(filename + ": " + file.errorString());
+			frames.push_back(file.readAll());
+			slot_size = std::max(slot_size, static_cast<quint64>(frames.back().size()));
+		}
+
+		const auto name = args.front();
+		auto ring = SharedMemoryRing::create(name, slot_count, slot_size);
+
+		std::signal(SIGINT, interrupt);
+		std::signal(SIGTERM, interrupt);
+
+		const auto period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / frame_rate));
+		auto deadline = std::chrono::steady_clock::now();
+		quint64 published = 0;
+		while (!interrupted && (count == 0 || published < count)) {
+			const auto& frame = frames[published % frames.size()];
+			std::memcpy(ring->beginFrame(), frame.constData(), frame.size());
+			published = ring->publishFrame(frame.size());
+
+			deadline += period;
+			std::this_thread::sleep_until(deadline);
+		}
+
+		SharedMemoryRing::unlink(name);
+		QTextStream(stdout) << "Published " << published << " frames into " << name << "\n";
+	} catch (const std::exception& e) {
+		qCritical() << e.what();
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QThreadPool>
+
+#include <memory>
+
+#include <checksum.h>
+#include <fits.h>
+#include <gzipfitsstorage.h>
+#include <tracer.h>
+
+#include "common.h"
+
+namespace {
+	struct Options {
+		// HDUs without the keywords fail
+		bool required;
+		// Only the failed HDUs are printed
+		bool quiet;
+	};
+
+	std::unique_ptr<FITS> open(const QString& filename) {
+		std::unique_ptr<QFile> file{new QFile(filename)};
+		if (!file->open(QIODevice::ReadOnly))
+			throw FITS::Exception(file->errorString());
+
+		// Every HDU is inflated, the index would leave the preceding data as zeros
+		if (GzipFITSStorage::isGzip(file.get()))
+			return std::unique_ptr<FITS>(new FITS(new GzipFITSStorage(file.release(), -1, QString())));
+		return std::unique_ptr<FITS>(new FITS(file.release()));
+	}
+
+	// Returns false when the HDU fails
+	bool verify(const QString& filename, int hdu_index, const FITS::HeaderDataUnit& hdu, const Options& options, QFile& output) {
+		const Checksum checksum(hdu);
+		const bool failed = !checksum.isValid() || (options.required && (checksum.checksum() == Checksum::Missing || checksum.datasum() == Checksum::Missing));
+		if (failed || !options.quiet) {
+			output.write(Tools::tsvField(filename) + "\t" + QByteArray::number(hdu_index) + "\t" +
+				Checksum::statusText(checksum.checksum()) + "\t" + Checksum::statusText(checksum.datasum()) + "\t" +
+				(checksum.isMissing() ? QByteArray() : QByteArray::number(checksum.dataSum())) + "\n");
+		}
+		return !failed;
+	}
+}
+
+int main(int argc, char** argv) {
+	Tracer::instance().setEnabled(false);
+
+	try {
+		QCoreApplication app(argc, argv);
+		QCoreApplication::setApplicationName("fips");
+
+		QCommandLineParser parser;
+		parser.setApplicationDescription(QCoreApplication::translate("main", "Verify CHECKSUM and DATASUM of every HDU of FITS files."));
+		parser.addHelpOption();
+		parser.addPositionalArgument("files", QCoreApplication::translate("main", "FITS files to verify."), "[files...]");
+		QCommandLineOption list_option("list",
+			QCoreApplication::translate("main", "Read names of the files from <file>, one per line, - for stdin."),
+			QCoreApplication::translate("main", "file"));
+		QCommandLineOption require_option("require",
+			QCoreApplication::translate("main", "Fail HDUs without CHECKSUM or DATASUM."));
+		QCommandLineOption quiet_option(QStringList() << "q" << "quiet",
+			QCoreApplication::translate("main", "Print the failed HDUs only."));
+		QCommandLineOption jobs_option(QStringList() << "j" << "jobs",
+			QCoreApplication::translate("main", "Sum the data in <count> threads."),
+			QCoreApplication::translate("main", "count"), QString::number(QThreadPool::globalInstance()->maxThreadCount()));
+		parser.addOption(list_option);
+		parser.addOption(require_option);
+		parser.addOption(quiet_option);
+		parser.addOption(jobs_option);
+		parser.process(app);
+
+		Options options;
+		options.required = parser.isSet(require_option);
+		options.quiet = parser.isSet(quiet_option);
+		Tools::setJobs(parser.value(jobs_option).toInt());
+
+		auto filenames = parser.positionalArguments();
+		if (parser.isSet(list_option))
+			filenames << Tools::readList(parser.value(list_option));
+		if (filenames.isEmpty())
+			parser.showHelp(1);
+
+		QFile output;
+		output.open(stdout, QIODevice::WriteOnly);
+		output.write("file\thdu\tchecksum\tdatasum\tsum\n");
+
+		// The HDUs of a file are summed one by one, each in parallel
+		bool failed = false;
+		for (const auto& filename: filenames) {
+			try {
+				const auto fits = open(filename);
+				int hdu_index = 0;
+				failed = !verify(filename, hdu_index++, fits->primary_hdu(), options, output) || failed;
+				for (const auto& hdu: *fits) {
+					failed = !verify(filename, hdu_index++, hdu, options, output) || failed;
+				}
+			} catch (const std::exception& e) {
+				qWarning().noquote() << filename + ": " + e.what();
+				failed = true;
+			}
+			output.flush();
+		}
+
+		return (failed ? 1 : 0);
+	} catch (const std::exception& e) {
+		qCritical() << e.what();
+		return 1;
+	}
+
+	return 0;
+}